@@ -9,14 +9,21 @@
 PB_BIND(GuiStatus, GuiStatus, AUTO)
 
 
-PB_BIND(ControllerStatus, ControllerStatus, AUTO)
+PB_BIND(ControllerStatus, ControllerStatus, 2)
 
 
 PB_BIND(VentParams, VentParams, AUTO)
 
 
+PB_BIND(BreathSummary, BreathSummary, AUTO)
+
+
+PB_BIND(SampleBatch, SampleBatch, AUTO)
+
+
 PB_BIND(SensorsProto, SensorsProto, AUTO)
 
 
+PB_BIND(Capabilities, Capabilities, AUTO)
 
 
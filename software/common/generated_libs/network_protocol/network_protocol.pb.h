@@ -21,7 +21,54 @@ typedef enum _VentMode {
     VentMode_HIGH_FLOW_NASAL_CANNULA = 3
 } VentMode;
 
+typedef enum _BreathTrigger {
+    BreathTrigger_MACHINE = 0,
+    BreathTrigger_PATIENT = 1
+} BreathTrigger;
+
+typedef enum _Feature {
+    Feature_NO_FEATURES = 0,
+    Feature_FRAMING = 1,
+    Feature_BATCHED_TELEMETRY = 2,
+    Feature_BREATH_SUMMARIES = 4,
+    Feature_PARAMS_ON_CHANGE = 8
+} Feature;
+
 /* Struct definitions */
+typedef struct _Capabilities {
+    uint32_t protocol_version;
+    uint32_t features;
+    uint32_t max_baud_rate;
+} Capabilities;
+
+typedef struct _SampleBatch {
+    uint32_t first_sample;
+    uint32_t sample_period_us;
+    pb_size_t patient_pressure_cm_h2o_x100_count;
+    int32_t patient_pressure_cm_h2o_x100[6];
+    pb_size_t flow_ml_per_min_count;
+    int32_t flow_ml_per_min[6];
+    pb_size_t volume_ml_x10_count;
+    int32_t volume_ml_x10[6];
+    pb_size_t pressure_setpoint_cm_h2o_x100_count;
+    int32_t pressure_setpoint_cm_h2o_x100[6];
+    pb_size_t fio2_x1000_count;
+    int32_t fio2_x1000[6];
+} SampleBatch;
+
+typedef struct _BreathSummary {
+    uint64_t breath_id;
+    float pip_cm_h2o;
+    float peep_cm_h2o;
+    float inspired_tidal_volume_ml;
+    float expired_tidal_volume_ml;
+    uint32_t inspiratory_time_ms;
+    uint32_t expiratory_time_ms;
+    float minute_volume_ml_per_min;
+    float leak_ml_per_min;
+    BreathTrigger trigger;
+} BreathSummary;
+
 typedef struct _SensorsProto {
     float patient_pressure_cm_h2o;
     float volume_ml;
@@ -46,15 +93,28 @@ typedef struct _VentParams {
 
 typedef struct _ControllerStatus {
     uint64_t uptime_ms;
+    bool has_active_params;
     VentParams active_params;
     SensorsProto sensor_readings;
     float pressure_setpoint_cm_h2o;
     float fan_power;
+    pb_size_t breath_summaries_count;
+    BreathSummary breath_summaries[3];
+    bool has_samples;
+    SampleBatch samples;
+    bool has_baud_rate;
+    uint32_t baud_rate;
+    bool has_capabilities;
+    Capabilities capabilities;
 } ControllerStatus;
 
 typedef struct _GuiStatus {
     uint64_t uptime_ms;
     VentParams desired_params;
+    bool has_max_baud_rate;
+    uint32_t max_baud_rate;
+    bool has_capabilities;
+    Capabilities capabilities;
 } GuiStatus;
 
 
@@ -62,19 +122,51 @@ typedef struct _GuiStatus {
 #define _VentMode_MIN VentMode_OFF
 #define _VentMode_MAX VentMode_HIGH_FLOW_NASAL_CANNULA
 #define _VentMode_ARRAYSIZE ((VentMode)(VentMode_HIGH_FLOW_NASAL_CANNULA+1))
+#define _BreathTrigger_MIN BreathTrigger_MACHINE
+#define _BreathTrigger_MAX BreathTrigger_PATIENT
+#define _BreathTrigger_ARRAYSIZE ((BreathTrigger)(BreathTrigger_PATIENT+1))
+#define _Feature_MIN Feature_NO_FEATURES
+#define _Feature_MAX Feature_PARAMS_ON_CHANGE
+#define _Feature_ARRAYSIZE ((Feature)(Feature_PARAMS_ON_CHANGE+1))
 
 
 /* Initializer values for message structs */
-#define GuiStatus_init_default                   {0, VentParams_init_default}
-#define ControllerStatus_init_default            {0, VentParams_init_default, SensorsProto_init_default, 0, 0}
+#define GuiStatus_init_default                   {0, VentParams_init_default, false, 0, false, Capabilities_init_default}
+#define ControllerStatus_init_default            {0, false, VentParams_init_default, SensorsProto_init_default, 0, 0, 0, {BreathSummary_init_default, BreathSummary_init_default, BreathSummary_init_default}, false, SampleBatch_init_default, false, 0, false, Capabilities_init_default}
 #define VentParams_init_default                  {_VentMode_MIN, 0, 0, 0, 0, 0, 0, 0}
+#define BreathSummary_init_default               {0, 0, 0, 0, 0, 0, 0, 0, 0, _BreathTrigger_MIN}
+#define SampleBatch_init_default                 {0, 0, 0, {0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0}}
 #define SensorsProto_init_default                {0, 0, 0, 0, 0, 0, 0, 0}
-#define GuiStatus_init_zero                      {0, VentParams_init_zero}
-#define ControllerStatus_init_zero               {0, VentParams_init_zero, SensorsProto_init_zero, 0, 0}
+#define Capabilities_init_default                {0, 0, 0}
+#define GuiStatus_init_zero                      {0, VentParams_init_zero, false, 0, false, Capabilities_init_zero}
+#define ControllerStatus_init_zero               {0, false, VentParams_init_zero, SensorsProto_init_zero, 0, 0, 0, {BreathSummary_init_zero, BreathSummary_init_zero, BreathSummary_init_zero}, false, SampleBatch_init_zero, false, 0, false, Capabilities_init_zero}
 #define VentParams_init_zero                     {_VentMode_MIN, 0, 0, 0, 0, 0, 0, 0}
+#define BreathSummary_init_zero                  {0, 0, 0, 0, 0, 0, 0, 0, 0, _BreathTrigger_MIN}
+#define SampleBatch_init_zero                    {0, 0, 0, {0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0}, 0, {0, 0, 0, 0, 0, 0}}
 #define SensorsProto_init_zero                   {0, 0, 0, 0, 0, 0, 0, 0}
+#define Capabilities_init_zero                   {0, 0, 0}
 
 /* Field tags (for use in manual encoding/decoding) */
+#define Capabilities_protocol_version_tag        1
+#define Capabilities_features_tag                2
+#define Capabilities_max_baud_rate_tag           3
+#define SampleBatch_first_sample_tag             1
+#define SampleBatch_sample_period_us_tag         2
+#define SampleBatch_patient_pressure_cm_h2o_x100_tag 3
+#define SampleBatch_flow_ml_per_min_tag          4
+#define SampleBatch_volume_ml_x10_tag            5
+#define SampleBatch_pressure_setpoint_cm_h2o_x100_tag 6
+#define SampleBatch_fio2_x1000_tag               7
+#define BreathSummary_breath_id_tag              1
+#define BreathSummary_pip_cm_h2o_tag             2
+#define BreathSummary_peep_cm_h2o_tag            3
+#define BreathSummary_inspired_tidal_volume_ml_tag 4
+#define BreathSummary_expired_tidal_volume_ml_tag 5
+#define BreathSummary_inspiratory_time_ms_tag    6
+#define BreathSummary_expiratory_time_ms_tag     7
+#define BreathSummary_minute_volume_ml_per_min_tag 8
+#define BreathSummary_leak_ml_per_min_tag        9
+#define BreathSummary_trigger_tag                10
 #define SensorsProto_patient_pressure_cm_h2o_tag 1
 #define SensorsProto_volume_ml_tag               2
 #define SensorsProto_flow_ml_per_min_tag         3
@@ -96,27 +188,43 @@ typedef struct _GuiStatus {
 #define ControllerStatus_sensor_readings_tag     3
 #define ControllerStatus_pressure_setpoint_cm_h2o_tag 5
 #define ControllerStatus_fan_power_tag           6
+#define ControllerStatus_breath_summaries_tag    7
+#define ControllerStatus_samples_tag             8
+#define ControllerStatus_baud_rate_tag           9
+#define ControllerStatus_capabilities_tag        10
 #define GuiStatus_uptime_ms_tag                  1
 #define GuiStatus_desired_params_tag             2
+#define GuiStatus_max_baud_rate_tag              3
+#define GuiStatus_capabilities_tag               4
 
 /* Struct field encoding specification for nanopb */
 #define GuiStatus_FIELDLIST(X, a) \
 X(a, STATIC,   REQUIRED, UINT64,   uptime_ms,         1) \
-X(a, STATIC,   REQUIRED, MESSAGE,  desired_params,    2)
+X(a, STATIC,   REQUIRED, MESSAGE,  desired_params,    2) \
+X(a, STATIC,   OPTIONAL, UINT32,   max_baud_rate,     3) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  capabilities,      4)
 #define GuiStatus_CALLBACK NULL
 #define GuiStatus_DEFAULT NULL
 #define GuiStatus_desired_params_MSGTYPE VentParams
+#define GuiStatus_capabilities_MSGTYPE Capabilities
 
 #define ControllerStatus_FIELDLIST(X, a) \
 X(a, STATIC,   REQUIRED, UINT64,   uptime_ms,         1) \
-X(a, STATIC,   REQUIRED, MESSAGE,  active_params,     2) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  active_params,     2) \
 X(a, STATIC,   REQUIRED, MESSAGE,  sensor_readings,   3) \
 X(a, STATIC,   REQUIRED, FLOAT,    pressure_setpoint_cm_h2o,   5) \
-X(a, STATIC,   REQUIRED, FLOAT,    fan_power,         6)
+X(a, STATIC,   REQUIRED, FLOAT,    fan_power,         6) \
+X(a, STATIC,   REPEATED, MESSAGE,  breath_summaries,   7) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  samples,           8) \
+X(a, STATIC,   OPTIONAL, UINT32,   baud_rate,         9) \
+X(a, STATIC,   OPTIONAL, MESSAGE,  capabilities,     10)
 #define ControllerStatus_CALLBACK NULL
 #define ControllerStatus_DEFAULT NULL
 #define ControllerStatus_active_params_MSGTYPE VentParams
 #define ControllerStatus_sensor_readings_MSGTYPE SensorsProto
+#define ControllerStatus_breath_summaries_MSGTYPE BreathSummary
+#define ControllerStatus_samples_MSGTYPE SampleBatch
+#define ControllerStatus_capabilities_MSGTYPE Capabilities
 
 #define VentParams_FIELDLIST(X, a) \
 X(a, STATIC,   REQUIRED, UENUM,    mode,              1) \
@@ -130,6 +238,31 @@ X(a, STATIC,   REQUIRED, FLOAT,    fio2,             10)
 #define VentParams_CALLBACK NULL
 #define VentParams_DEFAULT NULL
 
+#define BreathSummary_FIELDLIST(X, a) \
+X(a, STATIC,   REQUIRED, UINT64,   breath_id,         1) \
+X(a, STATIC,   REQUIRED, FLOAT,    pip_cm_h2o,        2) \
+X(a, STATIC,   REQUIRED, FLOAT,    peep_cm_h2o,       3) \
+X(a, STATIC,   REQUIRED, FLOAT,    inspired_tidal_volume_ml,   4) \
+X(a, STATIC,   REQUIRED, FLOAT,    expired_tidal_volume_ml,   5) \
+X(a, STATIC,   REQUIRED, UINT32,   inspiratory_time_ms,   6) \
+X(a, STATIC,   REQUIRED, UINT32,   expiratory_time_ms,   7) \
+X(a, STATIC,   REQUIRED, FLOAT,    minute_volume_ml_per_min,   8) \
+X(a, STATIC,   REQUIRED, FLOAT,    leak_ml_per_min,   9) \
+X(a, STATIC,   REQUIRED, UENUM,    trigger,          10)
+#define BreathSummary_CALLBACK NULL
+#define BreathSummary_DEFAULT NULL
+
+#define SampleBatch_FIELDLIST(X, a) \
+X(a, STATIC,   REQUIRED, UINT32,   first_sample,      1) \
+X(a, STATIC,   REQUIRED, UINT32,   sample_period_us,   2) \
+X(a, STATIC,   REPEATED, SINT32,   patient_pressure_cm_h2o_x100,   3) \
+X(a, STATIC,   REPEATED, SINT32,   flow_ml_per_min,   4) \
+X(a, STATIC,   REPEATED, SINT32,   volume_ml_x10,     5) \
+X(a, STATIC,   REPEATED, SINT32,   pressure_setpoint_cm_h2o_x100,   6) \
+X(a, STATIC,   REPEATED, SINT32,   fio2_x1000,        7)
+#define SampleBatch_CALLBACK NULL
+#define SampleBatch_DEFAULT NULL
+
 #define SensorsProto_FIELDLIST(X, a) \
 X(a, STATIC,   REQUIRED, FLOAT,    patient_pressure_cm_h2o,   1) \
 X(a, STATIC,   REQUIRED, FLOAT,    volume_ml,         2) \
@@ -142,22 +275,38 @@ X(a, STATIC,   REQUIRED, FLOAT,    fio2,   8)
 #define SensorsProto_CALLBACK NULL
 #define SensorsProto_DEFAULT NULL
 
+#define Capabilities_FIELDLIST(X, a) \
+X(a, STATIC,   REQUIRED, UINT32,   protocol_version,   1) \
+X(a, STATIC,   REQUIRED, UINT32,   features,          2) \
+X(a, STATIC,   REQUIRED, UINT32,   max_baud_rate,     3)
+#define Capabilities_CALLBACK NULL
+#define Capabilities_DEFAULT NULL
+
 extern const pb_msgdesc_t GuiStatus_msg;
 extern const pb_msgdesc_t ControllerStatus_msg;
 extern const pb_msgdesc_t VentParams_msg;
+extern const pb_msgdesc_t BreathSummary_msg;
+extern const pb_msgdesc_t SampleBatch_msg;
 extern const pb_msgdesc_t SensorsProto_msg;
+extern const pb_msgdesc_t Capabilities_msg;
 
 /* Defines for backwards compatibility with code written before nanopb-0.4.0 */
 #define GuiStatus_fields &GuiStatus_msg
 #define ControllerStatus_fields &ControllerStatus_msg
 #define VentParams_fields &VentParams_msg
+#define BreathSummary_fields &BreathSummary_msg
+#define SampleBatch_fields &SampleBatch_msg
 #define SensorsProto_fields &SensorsProto_msg
+#define Capabilities_fields &Capabilities_msg
 
 /* Maximum encoded size of messages (where known) */
-#define GuiStatus_size                           55
-#define ControllerStatus_size                    108
+#define GuiStatus_size                           81
+#define ControllerStatus_size                    485
 #define VentParams_size                          42
-#define SensorsProto_size                        45
+#define BreathSummary_size                       55
+#define SampleBatch_size                         172
+#define SensorsProto_size                        46
+#define Capabilities_size                        18
 
 #ifdef __cplusplus
 } /* extern "C" */
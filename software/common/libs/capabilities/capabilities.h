@@ -0,0 +1,55 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstdint>
+
+#include "network_protocol.pb.h"
+
+// The hello/capability handshake between the GUI and the controller (see
+// Capabilities in network_protocol.proto).
+//
+// The GUI sends its Capabilities in GuiStatus when it connects, and the
+// controller answers with its own in ControllerStatus.  Both then use what
+// Negotiate() says they have in common, so that the GUI and the controller
+// can be upgraded independently, and still get the faster modes when both
+// have them.  Whoever never hears from the other side in this way assumes it
+// predates the handshake: see LegacyCapabilities().
+
+// Version of network_protocol.proto.  Bump it along with changes to Feature.
+constexpr uint32_t ProtocolVersion{2};
+
+// All the Feature bits this version knows about.
+constexpr uint32_t AllFeatures{Feature_FRAMING | Feature_BATCHED_TELEMETRY |
+                               Feature_BREATH_SUMMARIES | Feature_PARAMS_ON_CHANGE};
+
+// What we assume of a peer that hasn't said: none of the features, at the
+// baud rate the link starts at.
+constexpr Capabilities LegacyCapabilities(uint32_t default_baud_rate) {
+  return {/*protocol_version=*/0, /*features=*/Feature_NO_FEATURES, default_baud_rate};
+}
+
+// What both sides of the link can use.  Both sides come to the same result,
+// whichever of them is `ours`.
+constexpr Capabilities Negotiate(const Capabilities &ours, const Capabilities &theirs) {
+  return {std::min(ours.protocol_version, theirs.protocol_version),
+          ours.features & theirs.features, std::min(ours.max_baud_rate, theirs.max_baud_rate)};
+}
+
+constexpr bool HasFeature(const Capabilities &capabilities, Feature feature) {
+  return (capabilities.features & feature) != 0;
+}
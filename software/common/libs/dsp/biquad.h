@@ -0,0 +1,130 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include "fixed_point.h"
+
+namespace DSP {
+
+namespace BiquadDetail {
+
+inline constexpr double Pi = 3.14159265358979323846;
+
+// std::sin and std::cos are not constexpr, so filter design uses these
+// instead.  Accurate to ~1e-12 on [-pi, pi], which is all we need.
+constexpr double Sin(double x) {
+  double term = x;
+  double sum = x;
+  for (int n = 1; n < 12; ++n) {
+    term *= -x * x / ((2 * n) * (2 * n + 1));
+    sum += term;
+  }
+  return sum;
+}
+
+constexpr double Cos(double x) { return Sin(x + Pi / 2 > Pi ? x - 3 * Pi / 2 : x + Pi / 2); }
+
+}  // namespace BiquadDetail
+
+// Coefficients of a second-order IIR section, normalized so that a0 == 1:
+//
+//   y[n] = b0 x[n] + b1 x[n-1] + b2 x[n-2] - a1 y[n-1] - a2 y[n-2]
+//
+// The factory functions follow the RBJ "Audio EQ Cookbook" designs and are
+// constexpr, so a filter declared with constant parameters carries no
+// floating-point design cost at runtime.  Frequencies are in Hz; q = 0.7071
+// gives a maximally-flat (Butterworth) response.
+struct BiquadCoefficients {
+  double b0{1};
+  double b1{0};
+  double b2{0};
+  double a1{0};
+  double a2{0};
+
+  static constexpr BiquadCoefficients LowPass(double sample_rate, double cutoff, double q) {
+    double w0 = 2 * BiquadDetail::Pi * cutoff / sample_rate;
+    double cos_w0 = BiquadDetail::Cos(w0);
+    double alpha = BiquadDetail::Sin(w0) / (2 * q);
+    return Normalize(1 + alpha, (1 - cos_w0) / 2, 1 - cos_w0, (1 - cos_w0) / 2, -2 * cos_w0,
+                     1 - alpha);
+  }
+
+  static constexpr BiquadCoefficients HighPass(double sample_rate, double cutoff, double q) {
+    double w0 = 2 * BiquadDetail::Pi * cutoff / sample_rate;
+    double cos_w0 = BiquadDetail::Cos(w0);
+    double alpha = BiquadDetail::Sin(w0) / (2 * q);
+    return Normalize(1 + alpha, (1 + cos_w0) / 2, -(1 + cos_w0), (1 + cos_w0) / 2, -2 * cos_w0,
+                     1 - alpha);
+  }
+
+  static constexpr BiquadCoefficients Notch(double sample_rate, double center, double q) {
+    double w0 = 2 * BiquadDetail::Pi * center / sample_rate;
+    double cos_w0 = BiquadDetail::Cos(w0);
+    double alpha = BiquadDetail::Sin(w0) / (2 * q);
+    return Normalize(1 + alpha, 1, -2 * cos_w0, 1, -2 * cos_w0, 1 - alpha);
+  }
+
+ private:
+  static constexpr BiquadCoefficients Normalize(double a0, double b0, double b1, double b2,
+                                                double a1, double a2) {
+    return {b0 / a0, b1 / a0, b2 / a0, a1 / a0, a2 / a0};
+  }
+};
+
+// Second-order IIR filter in direct form I.  Direct form I keeps the input
+// and output history separately, which avoids the internal overflow that the
+// transposed forms are prone to when T is a fixed-point type.
+//
+// T is the sample type, and also the type of the coefficients, so it needs to
+// represent values in (-2, 2): use at least two integer bits for Fixed.
+template <typename T>
+class Biquad {
+ public:
+  constexpr explicit Biquad(const BiquadCoefficients &c)
+      : b0_(FromFloat<T>(static_cast<float>(c.b0))),
+        b1_(FromFloat<T>(static_cast<float>(c.b1))),
+        b2_(FromFloat<T>(static_cast<float>(c.b2))),
+        a1_(FromFloat<T>(static_cast<float>(c.a1))),
+        a2_(FromFloat<T>(static_cast<float>(c.a2))) {}
+
+  constexpr T update(T x) {
+    T y = b0_ * x + b1_ * x1_ + b2_ * x2_ - a1_ * y1_ - a2_ * y2_;
+    x2_ = x1_;
+    x1_ = x;
+    y2_ = y1_;
+    y1_ = y;
+    return y;
+  }
+
+  constexpr T value() const { return y1_; }
+
+  // Clears the filter history.
+  constexpr void reset() { x1_ = x2_ = y1_ = y2_ = T(0); }
+
+  // Sets the filter history as if it had seen a constant input x forever,
+  // which avoids the start-up transient of a filter with unity DC gain
+  // (low-pass or notch).
+  constexpr void reset(T x) {
+    x1_ = x2_ = x;
+    y1_ = y2_ = x;
+  }
+
+ private:
+  T b0_, b1_, b2_, a1_, a2_;
+  T x1_{0}, x2_{0}, y1_{0}, y2_{0};
+};
+
+}  // namespace DSP
@@ -0,0 +1,66 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <optional>
+
+#include "fixed_point.h"
+
+namespace DSP {
+
+// Exponentially-weighted moving average:
+//
+//   avg = alpha * x + (1 - alpha) * avg
+//
+// Larger alpha (in (0, 1]) means the average follows the input more quickly.
+// The first sample initializes the average.
+//
+// T is the sample type and Coeff the type of alpha.  Coeff * T must yield a T,
+// so this works for float, Fixed<N>, and also for physical quantities from
+// units.h with a float alpha, e.g. Ewma<VolumetricFlow>.
+template <typename T, typename Coeff = float>
+class Ewma {
+ public:
+  constexpr explicit Ewma(Coeff alpha) : alpha_(alpha) {}
+
+  // Alpha giving the same smoothing as a first-order low-pass filter with the
+  // given time constant, for samples taken every sample_period (in the same
+  // units).
+  static constexpr float AlphaForTimeConstant(float sample_period, float time_constant) {
+    return sample_period / (time_constant + sample_period);
+  }
+
+  constexpr Coeff alpha() const { return alpha_; }
+  // Alpha may be changed at any time, e.g. when it is tunable via a debug
+  // variable.  The current average is kept.
+  constexpr void set_alpha(Coeff alpha) { alpha_ = alpha; }
+
+  constexpr T update(T x) {
+    avg_ = alpha_ * x + (Coeff(1) - alpha_) * avg_.value_or(x);
+    return *avg_;
+  }
+
+  // Average so far, or nullopt if no sample was given since the last reset.
+  constexpr std::optional<T> value() const { return avg_; }
+
+  constexpr void reset() { avg_.reset(); }
+
+ private:
+  Coeff alpha_;
+  std::optional<T> avg_;
+};
+
+}  // namespace DSP
@@ -0,0 +1,93 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+namespace DSP {
+
+// Signed fixed-point number with FracBits fractional bits, stored in 32 bits.
+//
+// This is what the filters in this library use in place of float when the
+// sample type is an integer quantity (e.g. raw ADC counts) or when the
+// target has no FPU.  E.g. Fixed<16> is Q15.16: range about +/-32768 with a
+// resolution of 1.5e-5.
+//
+// Products are computed in 64 bits and rounded to nearest.  There is no
+// saturation: like int32_t, overflowing the range is the caller's problem.
+template <int FracBits>
+class Fixed {
+  static_assert(FracBits > 0 && FracBits < 31, "Fixed needs at least one integer bit");
+
+ public:
+  static constexpr int FractionalBits = FracBits;
+  static constexpr int32_t One = int32_t{1} << FracBits;
+
+  constexpr Fixed() = default;
+  // Implicit so that filter code can be written as e.g. `T(1) - alpha`
+  // regardless of whether T is float or Fixed.
+  constexpr Fixed(int v) : raw_(static_cast<int32_t>(v) * One) {}  // NOLINT
+  constexpr explicit Fixed(float v)
+      : raw_(static_cast<int32_t>(v * static_cast<float>(One) + (v < 0 ? -0.5f : 0.5f))) {}
+  constexpr explicit Fixed(double v)
+      : raw_(static_cast<int32_t>(v * static_cast<double>(One) + (v < 0 ? -0.5 : 0.5))) {}
+
+  static constexpr Fixed FromRaw(int32_t raw) {
+    Fixed f;
+    f.raw_ = raw;
+    return f;
+  }
+
+  constexpr int32_t raw() const { return raw_; }
+  constexpr float to_float() const { return static_cast<float>(raw_) / static_cast<float>(One); }
+  constexpr explicit operator float() const { return to_float(); }
+
+  constexpr Fixed operator-() const { return FromRaw(-raw_); }
+  constexpr Fixed operator+(Fixed b) const { return FromRaw(raw_ + b.raw_); }
+  constexpr Fixed operator-(Fixed b) const { return FromRaw(raw_ - b.raw_); }
+  constexpr Fixed operator*(Fixed b) const {
+    int64_t p = static_cast<int64_t>(raw_) * b.raw_;
+    return FromRaw(static_cast<int32_t>((p + (int64_t{1} << (FracBits - 1))) >> FracBits));
+  }
+  constexpr Fixed operator/(Fixed b) const {
+    return FromRaw(static_cast<int32_t>((static_cast<int64_t>(raw_) << FracBits) / b.raw_));
+  }
+  // Division by an integer count, e.g. for averages.  Rounds toward zero.
+  constexpr Fixed operator/(int n) const { return FromRaw(raw_ / n); }
+
+  constexpr Fixed &operator+=(Fixed b) { return *this = *this + b; }
+  constexpr Fixed &operator-=(Fixed b) { return *this = *this - b; }
+  constexpr Fixed &operator*=(Fixed b) { return *this = *this * b; }
+
+  constexpr bool operator<(Fixed b) const { return raw_ < b.raw_; }
+  constexpr bool operator<=(Fixed b) const { return raw_ <= b.raw_; }
+  constexpr bool operator>(Fixed b) const { return raw_ > b.raw_; }
+  constexpr bool operator>=(Fixed b) const { return raw_ >= b.raw_; }
+  constexpr bool operator==(Fixed b) const { return raw_ == b.raw_; }
+  constexpr bool operator!=(Fixed b) const { return raw_ != b.raw_; }
+
+ private:
+  int32_t raw_{0};
+};
+
+// Converts a coefficient computed in floating point (ideally at compile time)
+// to the type used by a filter, be it float or Fixed.
+template <typename T>
+constexpr T FromFloat(float v) {
+  return static_cast<T>(v);
+}
+
+}  // namespace DSP
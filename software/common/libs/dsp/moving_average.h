@@ -0,0 +1,77 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <array>
+#include <type_traits>
+
+#include "fixed_point.h"
+
+namespace DSP {
+
+// Mean of the last N samples (or of all samples, before N have been seen).
+//
+// Keeps a running sum, so each update is O(1) regardless of N.  Acc is the
+// type of the running sum: with integer samples use a wider type to avoid
+// overflow; with float samples, consider double to avoid drift over very
+// long runs.
+template <typename T, size_t N, typename Acc = T>
+class MovingAverage {
+  static_assert(N > 0, "MovingAverage needs a window of at least one sample");
+
+ public:
+  constexpr MovingAverage() = default;
+
+  constexpr T update(T x) {
+    if (count_ == N) {
+      sum_ -= static_cast<Acc>(window_[next_]);
+    } else {
+      count_++;
+    }
+    window_[next_] = x;
+    sum_ += static_cast<Acc>(x);
+    next_ = (next_ + 1) % N;
+    return value();
+  }
+
+  constexpr T value() const {
+    if (count_ == 0) return T(0);
+    if constexpr (std::is_arithmetic_v<Acc>) {
+      return static_cast<T>(sum_ / static_cast<Acc>(count_));
+    } else {
+      return static_cast<T>(sum_ / static_cast<int>(count_));
+    }
+  }
+
+  constexpr size_t count() const { return count_; }
+  constexpr bool full() const { return count_ == N; }
+
+  constexpr void reset() {
+    count_ = 0;
+    next_ = 0;
+    sum_ = Acc(0);
+  }
+
+ private:
+  std::array<T, N> window_{};
+  size_t next_{0};
+  size_t count_{0};
+  Acc sum_{0};
+};
+
+}  // namespace DSP
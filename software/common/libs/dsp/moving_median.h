@@ -0,0 +1,94 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stddef.h>
+
+#include <array>
+
+namespace DSP {
+
+// Median of the last N samples (or of all samples, before N have been seen).
+// Good at rejecting isolated spikes, which averaging filters smear out.
+//
+// Alongside the window in arrival order, we keep its slots sorted by value,
+// so each update costs one O(N) removal and one O(N) insertion and no
+// sorting.  The oldest sample is found by its slot rather than its value, so
+// that samples which don't compare equal to themselves (NaN) are removed too.
+// NaN sorts above every number, so it's only output when at least half of the
+// window is NaN.  This is meant for small windows (say N <= 32); with an even
+// number of samples the lower median is returned, so the output is always an
+// actual sample.
+template <typename T, size_t N>
+class MovingMedian {
+  static_assert(N > 0, "MovingMedian needs a window of at least one sample");
+
+ public:
+  constexpr MovingMedian() = default;
+
+  constexpr T update(T x) {
+    if (count_ == N) {
+      Remove(next_);
+    }
+    window_[next_] = x;
+    Insert(next_);
+    next_ = (next_ + 1) % N;
+    return value();
+  }
+
+  constexpr T value() const {
+    if (count_ == 0) return T(0);
+    return window_[sorted_[(count_ - 1) / 2]];
+  }
+
+  constexpr size_t count() const { return count_; }
+  constexpr bool full() const { return count_ == N; }
+
+  constexpr void reset() {
+    count_ = 0;
+    next_ = 0;
+  }
+
+ private:
+  // Ordering of the samples, with NaN above everything else.
+  static constexpr bool Less(const T &a, const T &b) {
+    bool a_nan = !(a == a);
+    bool b_nan = !(b == b);
+    return a_nan || b_nan ? !a_nan && b_nan : a < b;
+  }
+
+  constexpr void Remove(size_t slot) {
+    size_t i = 0;
+    while (i < count_ && sorted_[i] != slot) i++;
+    for (; i + 1 < count_; ++i) sorted_[i] = sorted_[i + 1];
+    count_--;
+  }
+
+  constexpr void Insert(size_t slot) {
+    size_t i = count_;
+    for (; i > 0 && Less(window_[slot], window_[sorted_[i - 1]]); --i) sorted_[i] = sorted_[i - 1];
+    sorted_[i] = slot;
+    count_++;
+  }
+
+  std::array<T, N> window_{};
+  // Slots of window_, in increasing order of their samples.
+  std::array<size_t, N> sorted_{};
+  size_t next_{0};
+  size_t count_{0};
+};
+
+}  // namespace DSP
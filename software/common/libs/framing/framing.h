@@ -0,0 +1,317 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "checksum.h"
+
+// Framing of messages on the serial link between the controller and the GUI.
+//
+// A frame is a message followed by its CRC32 (big-endian, as crc_ok()
+// expects), COBS-encoded so that it contains no zero byte, then a zero byte
+// to end it.  See Cheshire & Baker, "Consistent Overhead Byte Stuffing":
+// encoding adds one byte, plus one per 254 bytes of message.
+//
+// Since zero only ever marks the end of a frame, the receiver can find frame
+// boundaries with UART character match, and gets back in sync at the next
+// zero after any error.  COBS decoding never writes ahead of what it reads,
+// so a frame can be decoded in place, in the buffer the DMA received it in:
+//
+//   void on_character_match() override {
+//     uint32_t length;
+//     if (Framing::DecodeInPlace(rx_buf, sizeof(rx_buf) - uart.rx_bytes_left(), &length) ==
+//         Framing::DecodeStatus::Ok) {
+//       // The message is in rx_buf[0, length).
+//     }
+//   }
+//
+// Nothing here allocates: all of it works on buffers the caller provides.
+namespace Framing {
+
+constexpr uint8_t Delimiter{0};
+constexpr uint32_t CrcSize{4};
+
+// Initial CRC value, as in soft_crc32().
+constexpr uint32_t CrcInit{0xFFFFFFFF};
+
+// Largest frame a message of the given size can encode to, delimiter included.
+constexpr uint32_t MaxEncodedSize(uint32_t message_size) {
+  uint32_t stuffed = message_size + CrcSize;
+  return stuffed + stuffed / 254 + 1 + 1;
+}
+
+// Encodes a frame into buf as its message comes in, one byte or one chunk at
+// a time, so that it doesn't need to be copied together first.
+//
+//   Framing::Encoder encoder(tx_buf, sizeof(tx_buf));
+//   encoder.Put(header, sizeof(header));
+//   encoder.Put(payload, payload_size);
+//   uint32_t frame_size = encoder.Finish();
+class Encoder {
+ public:
+  Encoder(uint8_t *buf, uint32_t size) : buf_(buf), size_(size) { Reset(); }
+
+  // Starts a new frame at the beginning of buf.
+  void Reset() {
+    crc_ = CrcInit;
+    code_index_ = 0;
+    length_ = 1;
+    overflow_ = size_ == 0;
+  }
+
+  void Put(uint8_t byte) {
+    crc_ = crc32_single(crc_, byte);
+    Stuff(byte);
+  }
+
+  void Put(const uint8_t *data, uint32_t length) {
+    for (uint32_t i = 0; i < length; ++i) {
+      Put(data[i]);
+    }
+  }
+
+  // Ends the frame with the message CRC and the delimiter.
+  // @returns the size of the frame, or 0 if it didn't fit in buf
+  [[nodiscard]] uint32_t Finish() {
+    uint32_t crc = crc_;
+    for (int shift = 24; shift >= 0; shift -= 8) {
+      Stuff(static_cast<uint8_t>(crc >> shift));
+    }
+    if (overflow_ || length_ >= size_) {
+      return 0;
+    }
+    buf_[code_index_] = static_cast<uint8_t>(length_ - code_index_);
+    buf_[length_++] = Delimiter;
+    return length_;
+  }
+
+ private:
+  // Adds a byte to the current COBS block.  Each block starts with a code
+  // byte, which says how far the next zero is, and which is only written once
+  // that's known.
+  void Stuff(uint8_t byte) {
+    if (overflow_) return;
+    if (byte != 0) {
+      if (length_ >= size_) {
+        overflow_ = true;
+        return;
+      }
+      buf_[length_++] = byte;
+    }
+    // A block ends at a zero, or after 254 non-zero bytes, where no zero is
+    // implied.
+    if (byte == 0 || length_ - code_index_ == 0xFF) {
+      buf_[code_index_] = static_cast<uint8_t>(length_ - code_index_);
+      code_index_ = length_;
+      if (length_ >= size_) {
+        overflow_ = true;
+        return;
+      }
+      length_++;
+    }
+  }
+
+  uint8_t *buf_;
+  uint32_t size_;
+  uint32_t crc_;
+  // Where the code byte of the current block goes.
+  uint32_t code_index_;
+  // Bytes of buf used so far, including the current block's code byte.
+  uint32_t length_;
+  bool overflow_;
+};
+
+// Encodes a whole message into a frame in buf.
+// @returns the size of the frame, or 0 if it didn't fit in buf
+[[nodiscard]] inline uint32_t EncodeFrame(const uint8_t *message, uint32_t length, uint8_t *buf,
+                                          uint32_t size) {
+  Encoder encoder(buf, size);
+  encoder.Put(message, length);
+  return encoder.Finish();
+}
+
+enum class DecodeStatus : uint8_t {
+  // Message received, CRC checked.
+  Ok,
+  // The frame isn't over yet (Decoder only).
+  Pending,
+  // Not a valid COBS encoding, or too short to hold a CRC: usually a frame
+  // cut short by a lost or corrupt byte.
+  Malformed,
+  // Encoding fine, but the CRC doesn't match the message.
+  BadCrc,
+  // The message doesn't fit in the buffer (Decoder only).
+  Overflow,
+};
+
+namespace internal {
+
+inline uint32_t ReadCrc(const uint8_t *buf) {
+  return static_cast<uint32_t>(buf[0]) << 24 | static_cast<uint32_t>(buf[1]) << 16 |
+         static_cast<uint32_t>(buf[2]) << 8 | static_cast<uint32_t>(buf[3]);
+}
+
+}  // namespace internal
+
+// Decodes a frame in place: on success, the message is at the start of frame,
+// and *message_length says how long it is.  length may include the delimiter
+// at the end or not.  frame is left in an unspecified state on failure.
+[[nodiscard]] inline DecodeStatus DecodeInPlace(uint8_t *frame, uint32_t length,
+                                                uint32_t *message_length) {
+  if (length > 0 && frame[length - 1] == Delimiter) {
+    length--;
+  }
+
+  // out never passes in, since each block's code byte is dropped.
+  uint32_t in = 0;
+  uint32_t out = 0;
+  while (in < length) {
+    uint8_t code = frame[in++];
+    if (code == Delimiter || code - 1u > length - in) {
+      return DecodeStatus::Malformed;
+    }
+    for (uint32_t end = in + code - 1u; in < end; ++in) {
+      if (frame[in] == Delimiter) {
+        return DecodeStatus::Malformed;
+      }
+      frame[out++] = frame[in];
+    }
+    if (code != 0xFF && in < length) {
+      frame[out++] = 0;
+    }
+  }
+
+  if (out < CrcSize) {
+    return DecodeStatus::Malformed;
+  }
+  uint32_t size = out - CrcSize;
+  uint32_t crc = CrcInit;
+  for (uint32_t i = 0; i < size; ++i) {
+    crc = crc32_single(crc, frame[i]);
+  }
+  if (crc != internal::ReadCrc(frame + size)) {
+    return DecodeStatus::BadCrc;
+  }
+  *message_length = size;
+  return DecodeStatus::Ok;
+}
+
+// Decodes frames one byte at a time, as they come in, into buf; for
+// receivers that get bytes one by one or in chunks that don't line up with
+// frames.
+//
+// Put() returns Pending until a delimiter ends a frame, then the status of
+// that frame.  If that's Ok, message() holds it until the next Put().  Empty
+// frames (i.e. repeated delimiters) are skipped, so a sender can send a
+// delimiter first to end whatever the receiver got before.
+class Decoder {
+ public:
+  Decoder(uint8_t *buf, uint32_t size) : buf_(buf), size_(size) {}
+
+  // Drops the frame in progress, e.g. when the bytes received so far are
+  // known to be garbage.
+  void Reset() { in_frame_ = false; }
+
+  DecodeStatus Put(uint8_t byte) {
+    if (byte == Delimiter) {
+      return EndFrame();
+    }
+    if (!in_frame_) {
+      StartFrame();
+    }
+    if (status_ != DecodeStatus::Pending) {
+      // Skip to the end of the frame.
+      return DecodeStatus::Pending;
+    }
+
+    if (block_left_ > 0) {
+      Append(byte);
+      block_left_--;
+    } else {
+      // Code byte.  The zero that ends the previous block goes in only now,
+      // since the last block of the frame isn't followed by one.
+      if (code_ != 0xFF) {
+        Append(0);
+      }
+      code_ = byte;
+      block_left_ = static_cast<uint8_t>(byte - 1);
+    }
+    return DecodeStatus::Pending;
+  }
+
+  const uint8_t *message() const { return buf_; }
+  uint32_t message_length() const { return message_length_; }
+
+ private:
+  void StartFrame() {
+    in_frame_ = true;
+    status_ = DecodeStatus::Pending;
+    length_ = 0;
+    crc_ = CrcInit;
+    // No zero before the first block.
+    code_ = 0xFF;
+    block_left_ = 0;
+    message_length_ = 0;
+  }
+
+  void Append(uint8_t byte) {
+    if (length_ >= size_) {
+      status_ = DecodeStatus::Overflow;
+      return;
+    }
+    buf_[length_] = byte;
+    // The CRC covers everything but the last 4 bytes, which are the CRC.
+    if (length_ >= CrcSize) {
+      crc_ = crc32_single(crc_, buf_[length_ - CrcSize]);
+    }
+    length_++;
+  }
+
+  DecodeStatus EndFrame() {
+    if (!in_frame_) {
+      return DecodeStatus::Pending;
+    }
+    in_frame_ = false;
+    if (status_ != DecodeStatus::Pending) {
+      return status_;
+    }
+    if (block_left_ > 0 || length_ < CrcSize) {
+      return DecodeStatus::Malformed;
+    }
+    if (crc_ != internal::ReadCrc(buf_ + length_ - CrcSize)) {
+      return DecodeStatus::BadCrc;
+    }
+    message_length_ = length_ - CrcSize;
+    return DecodeStatus::Ok;
+  }
+
+  uint8_t *buf_;
+  uint32_t size_;
+
+  bool in_frame_{false};
+  DecodeStatus status_{DecodeStatus::Pending};
+  // Bytes decoded into buf so far.
+  uint32_t length_{0};
+  uint32_t crc_{CrcInit};
+  // Code byte of the current block, and how many of its bytes are still to
+  // come.
+  uint8_t code_{0xFF};
+  uint8_t block_left_{0};
+  uint32_t message_length_{0};
+};
+
+}  // namespace Framing
@@ -0,0 +1,528 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+
+#include "network_protocol.pb.h"
+#include "pb_decode.h"
+#include "proto_traits.h"
+
+// Specialized protobuf encoding and decoding of our messages, as a fast path
+// beside nanopb.
+//
+// pb_encode() and pb_decode() walk a message's field descriptors at runtime,
+// field by field.  Our messages only have a handful of static fields, whose
+// types are known at compile time, so here the field lists nanopb generates
+// in network_protocol.pb.h (Foo_FIELDLIST) are expanded into templates
+// instead, one call per field, which the compiler turns into straight-line
+// code.
+//
+// The bytes are the same as nanopb's: fields in tag order, required fields
+// always, optional ones if their has_ flag is set, repeated scalars packed.
+// The maximum size of each message is computed from its field list, and
+// checked against the one nanopb generated (ProtoTraits<T>::MaxSize).
+//
+// The decoder only takes the encoding above (i.e. what either encoder
+// sends).  Anything else, e.g. fields out of order, unknown fields, or
+// overlong varints, and it hands the input over to pb_decode(), so that
+// results are always nanopb's.
+//
+// Only STATIC fields of the types below are supported; a field list with
+// anything else doesn't compile.
+namespace ProtoCodec {
+
+// nanopb's field kinds: the third and fourth arguments of X(...) in
+// Foo_FIELDLIST.
+enum class HType { REQUIRED, OPTIONAL, REPEATED };
+enum class LType { UINT32, UINT64, SINT32, FLOAT, UENUM, MESSAGE };
+
+enum class WireType : uint32_t { Varint = 0, Fixed32 = 5, LengthDelimited = 2 };
+
+constexpr uint32_t VarintSize(uint64_t value) {
+  uint32_t size = 1;
+  while (value >= 0x80) {
+    value >>= 7;
+    size++;
+  }
+  return size;
+}
+
+constexpr uint32_t Key(uint32_t tag, WireType wire_type) {
+  return tag << 3 | static_cast<uint32_t>(wire_type);
+}
+
+// Largest value of each enum, as nanopb sizes enum fields by it.
+template <typename Enum>
+struct EnumMax;
+template <>
+struct EnumMax<VentMode> {
+  static constexpr uint32_t Value = _VentMode_MAX;
+};
+template <>
+struct EnumMax<BreathTrigger> {
+  static constexpr uint32_t Value = _BreathTrigger_MAX;
+};
+
+// Appends to a buffer known to be large enough, so without bounds checks.
+struct Writer {
+  uint8_t *pos;
+
+  void Varint(uint64_t value) {
+    while (value >= 0x80) {
+      *pos++ = static_cast<uint8_t>(value | 0x80);
+      value >>= 7;
+    }
+    *pos++ = static_cast<uint8_t>(value);
+  }
+
+  void Fixed32(uint32_t value) {
+    *pos++ = static_cast<uint8_t>(value);
+    *pos++ = static_cast<uint8_t>(value >> 8);
+    *pos++ = static_cast<uint8_t>(value >> 16);
+    *pos++ = static_cast<uint8_t>(value >> 24);
+  }
+};
+
+// Reads from [pos, end).  Every method returns false if the input isn't what
+// it expects, in which case the caller gives up.
+struct Reader {
+  const uint8_t *pos;
+  const uint8_t *end;
+
+  bool done() const { return pos == end; }
+
+  // Consumes the key if it's next.
+  template <uint32_t K>
+  bool Key() {
+    if constexpr (K < 0x80) {
+      if (pos == end || *pos != K) return false;
+      pos++;
+      return true;
+    } else {
+      const uint8_t *p = pos;
+      uint32_t key;
+      if (!Varint32(&key) || key != K) {
+        pos = p;
+        return false;
+      }
+      return true;
+    }
+  }
+
+  // Varints longer than their value needs are left to nanopb.
+  bool Varint32(uint32_t *value) {
+    uint32_t result = 0;
+    for (uint32_t shift = 0; shift < 35; shift += 7) {
+      if (pos == end) return false;
+      uint8_t byte = *pos++;
+      if (shift == 28 && byte > 0x0F) return false;
+      result |= static_cast<uint32_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Varint64(uint64_t *value) {
+    uint64_t result = 0;
+    for (uint32_t shift = 0; shift < 70; shift += 7) {
+      if (pos == end) return false;
+      uint8_t byte = *pos++;
+      if (shift == 63 && byte > 0x01) return false;
+      result |= static_cast<uint64_t>(byte & 0x7F) << shift;
+      if (!(byte & 0x80)) {
+        *value = result;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  bool Fixed32(uint32_t *value) {
+    if (end - pos < 4) return false;
+    *value = static_cast<uint32_t>(pos[0]) | static_cast<uint32_t>(pos[1]) << 8 |
+             static_cast<uint32_t>(pos[2]) << 16 | static_cast<uint32_t>(pos[3]) << 24;
+    pos += 4;
+    return true;
+  }
+
+  // Reads a length, and splits the bytes it covers off into *sub.
+  bool Sub(Reader *sub) {
+    uint32_t size;
+    if (!Varint32(&size) || size > static_cast<size_t>(end - pos)) return false;
+    *sub = {pos, pos + size};
+    pos += size;
+    return true;
+  }
+};
+
+// Encoder, decoder and initializer of each message, generated from its field
+// list by PROTO_CODEC_MESSAGE below.
+template <typename T>
+struct Message;
+
+// How each type of value is encoded, regardless of its field's tag.
+template <LType L>
+struct Value;
+
+template <>
+struct Value<LType::UINT32> {
+  static constexpr WireType Wire = WireType::Varint;
+  template <typename T>
+  static constexpr uint32_t MaxSize() {
+    return 5;
+  }
+  static bool Encode(Writer &w, uint32_t value) {
+    w.Varint(value);
+    return true;
+  }
+  static bool Decode(Reader &r, uint32_t *value) { return r.Varint32(value); }
+};
+
+template <>
+struct Value<LType::UINT64> {
+  static constexpr WireType Wire = WireType::Varint;
+  template <typename T>
+  static constexpr uint32_t MaxSize() {
+    return 10;
+  }
+  static bool Encode(Writer &w, uint64_t value) {
+    w.Varint(value);
+    return true;
+  }
+  static bool Decode(Reader &r, uint64_t *value) { return r.Varint64(value); }
+};
+
+template <>
+struct Value<LType::SINT32> {
+  static constexpr WireType Wire = WireType::Varint;
+  template <typename T>
+  static constexpr uint32_t MaxSize() {
+    return 5;
+  }
+  // Zigzag encoding.
+  static bool Encode(Writer &w, int32_t value) {
+    w.Varint(static_cast<uint32_t>(value) << 1 ^ static_cast<uint32_t>(value >> 31));
+    return true;
+  }
+  static bool Decode(Reader &r, int32_t *value) {
+    uint32_t zigzag;
+    if (!r.Varint32(&zigzag)) return false;
+    *value = static_cast<int32_t>(zigzag >> 1 ^ (~(zigzag & 1) + 1));
+    return true;
+  }
+};
+
+template <>
+struct Value<LType::FLOAT> {
+  static constexpr WireType Wire = WireType::Fixed32;
+  template <typename T>
+  static constexpr uint32_t MaxSize() {
+    return 4;
+  }
+  static bool Encode(Writer &w, float value) {
+    uint32_t bits;
+    memcpy(&bits, &value, sizeof(bits));
+    w.Fixed32(bits);
+    return true;
+  }
+  static bool Decode(Reader &r, float *value) {
+    uint32_t bits;
+    if (!r.Fixed32(&bits)) return false;
+    memcpy(value, &bits, sizeof(bits));
+    return true;
+  }
+};
+
+template <>
+struct Value<LType::UENUM> {
+  static constexpr WireType Wire = WireType::Varint;
+  template <typename Enum>
+  static constexpr uint32_t MaxSize() {
+    return VarintSize(EnumMax<Enum>::Value);
+  }
+  // Values out of range could overrun the buffer, so unlike nanopb, we
+  // refuse to encode them.
+  template <typename Enum>
+  static bool Encode(Writer &w, Enum value) {
+    auto raw = static_cast<uint32_t>(value);
+    if (raw > EnumMax<Enum>::Value) return false;
+    w.Varint(raw);
+    return true;
+  }
+  template <typename Enum>
+  static bool Decode(Reader &r, Enum *value) {
+    uint32_t raw;
+    if (!r.Varint32(&raw)) return false;
+    *value = static_cast<Enum>(raw);
+    return true;
+  }
+};
+
+template <>
+struct Value<LType::MESSAGE> {
+  static constexpr WireType Wire = WireType::LengthDelimited;
+  template <typename T>
+  static constexpr uint32_t MaxSize() {
+    return VarintSize(Message<T>::MaxSize) + Message<T>::MaxSize;
+  }
+  // The length comes first, but is only known once the message is encoded.
+  // Encode it one byte further, and move it if its length takes more.
+  template <typename T>
+  static bool Encode(Writer &w, const T &value) {
+    Writer sub{w.pos + 1};
+    if (!Message<T>::Encode(sub, value)) return false;
+    auto size = static_cast<uint32_t>(sub.pos - (w.pos + 1));
+    if constexpr (Message<T>::MaxSize >= 0x80) {
+      if (size >= 0x80) memmove(w.pos + VarintSize(size), w.pos + 1, size);
+    }
+    w.Varint(size);
+    w.pos += size;
+    return true;
+  }
+  template <typename T>
+  static bool Decode(Reader &r, T *value) {
+    Reader sub;
+    return r.Sub(&sub) && Message<T>::Decode(sub, value) && sub.done();
+  }
+};
+
+template <typename T>
+void SetToDefault(T *value) {
+  if constexpr (std::is_class_v<T>) {
+    Message<T>::SetToDefaults(value);
+  } else {
+    *value = T{};
+  }
+}
+
+// A field, i.e. a value with a tag, that's required, optional or repeated.
+template <HType H, LType L, uint32_t Tag>
+struct Field;
+
+template <LType L, uint32_t Tag>
+struct Field<HType::REQUIRED, L, Tag> {
+  static constexpr uint32_t K = Key(Tag, Value<L>::Wire);
+
+  template <typename T>
+  static constexpr uint32_t MaxSize() {
+    return VarintSize(K) + Value<L>::template MaxSize<T>();
+  }
+  template <typename T>
+  static bool Encode(Writer &w, const T &value) {
+    w.Varint(K);
+    return Value<L>::Encode(w, value);
+  }
+  template <typename T>
+  static bool Decode(Reader &r, T *value) {
+    return r.Key<K>() && Value<L>::Decode(r, value);
+  }
+};
+
+template <LType L, uint32_t Tag>
+struct Field<HType::OPTIONAL, L, Tag> : Field<HType::REQUIRED, L, Tag> {
+  using Required = Field<HType::REQUIRED, L, Tag>;
+
+  template <typename T>
+  static bool Encode(Writer &w, bool has, const T &value) {
+    return !has || Required::Encode(w, value);
+  }
+  // Like nanopb, resets the value if the field isn't there.
+  template <typename T>
+  static bool Decode(Reader &r, bool *has, T *value) {
+    *has = r.Key<Required::K>();
+    if (!*has) {
+      SetToDefault(value);
+      return true;
+    }
+    return Value<L>::Decode(r, value);
+  }
+};
+
+// Repeated messages: one key and length per element.
+template <uint32_t Tag>
+struct Field<HType::REPEATED, LType::MESSAGE, Tag> {
+  using Element = Field<HType::REQUIRED, LType::MESSAGE, Tag>;
+
+  template <typename Array>
+  static constexpr uint32_t MaxSize() {
+    using T = std::remove_extent_t<Array>;
+    return std::extent_v<Array> * Element::template MaxSize<T>();
+  }
+  template <typename T, size_t N>
+  static bool Encode(Writer &w, pb_size_t count, const T (&values)[N]) {
+    if (count > N) return false;
+    for (pb_size_t i = 0; i < count; ++i) {
+      if (!Element::Encode(w, values[i])) return false;
+    }
+    return true;
+  }
+  template <typename T, size_t N>
+  static bool Decode(Reader &r, pb_size_t *count, T (&values)[N]) {
+    *count = 0;
+    while (r.Key<Element::K>()) {
+      if (*count == N || !Value<LType::MESSAGE>::Decode(r, &values[*count])) return false;
+      ++*count;
+    }
+    return true;
+  }
+};
+
+// Repeated scalars: packed, i.e. one key and length for all of them, and
+// nothing at all if there are none.
+template <LType L, uint32_t Tag>
+struct Field<HType::REPEATED, L, Tag> {
+  static constexpr uint32_t K = Key(Tag, WireType::LengthDelimited);
+
+  template <typename Array>
+  static constexpr uint32_t MaxSize() {
+    uint32_t values_size =
+        std::extent_v<Array> * Value<L>::template MaxSize<std::remove_extent_t<Array>>();
+    return VarintSize(K) + VarintSize(values_size) + values_size;
+  }
+  template <typename T, size_t N>
+  static bool Encode(Writer &w, pb_size_t count, const T (&values)[N]) {
+    if (count > N) return false;
+    if (count == 0) return true;
+    // Varints are the size of their value, and nanopb doesn't pack floats.
+    static_assert(Value<L>::Wire == WireType::Varint);
+    w.Varint(K);
+    uint8_t *size_pos = w.pos;
+    // Packed values of a repeated field fit in 127 bytes.
+    static_assert(N * Value<L>::template MaxSize<T>() < 0x80);
+    w.pos++;
+    for (pb_size_t i = 0; i < count; ++i) {
+      Value<L>::Encode(w, values[i]);
+    }
+    *size_pos = static_cast<uint8_t>(w.pos - size_pos - 1);
+    return true;
+  }
+  template <typename T, size_t N>
+  static bool Decode(Reader &r, pb_size_t *count, T (&values)[N]) {
+    *count = 0;
+    if (!r.Key<K>()) return true;
+    Reader sub;
+    if (!r.Sub(&sub)) return false;
+    while (!sub.done()) {
+      if (*count == N || !Value<L>::Decode(sub, &values[*count])) return false;
+      ++*count;
+    }
+    return true;
+  }
+};
+
+// Fields other than STATIC ones aren't supported: PROTO_CODEC_ATYPE_POINTER
+// etc. don't exist, so they don't compile.
+#define PROTO_CODEC_ATYPE_STATIC
+
+#define PROTO_CODEC_FIELD(htype, ltype, tag) Field<HType::htype, LType::ltype, tag>
+
+// The X(...) macros given to Foo_FIELDLIST: a is the message type for
+// MAX_SIZE, and the message for the others.
+#define PROTO_CODEC_MAX_SIZE(T, atype, htype, ltype, name, tag) \
+  PROTO_CODEC_ATYPE_##atype +PROTO_CODEC_FIELD(htype, ltype, tag)::MaxSize<decltype(T::name)>()
+
+#define PROTO_CODEC_ENCODE(m, atype, htype, ltype, name, tag) \
+  PROTO_CODEC_ATYPE_##atype                                  \
+  if (!PROTO_CODEC_ENCODE_##htype(htype, ltype, tag, m, name)) return false;
+#define PROTO_CODEC_ENCODE_REQUIRED(htype, ltype, tag, m, name) \
+  PROTO_CODEC_FIELD(htype, ltype, tag)::Encode(w, m.name)
+#define PROTO_CODEC_ENCODE_OPTIONAL(htype, ltype, tag, m, name) \
+  PROTO_CODEC_FIELD(htype, ltype, tag)::Encode(w, m.has_##name, m.name)
+#define PROTO_CODEC_ENCODE_REPEATED(htype, ltype, tag, m, name) \
+  PROTO_CODEC_FIELD(htype, ltype, tag)::Encode(w, m.name##_count, m.name)
+
+#define PROTO_CODEC_DECODE(m, atype, htype, ltype, name, tag) \
+  PROTO_CODEC_ATYPE_##atype                                  \
+  if (!PROTO_CODEC_DECODE_##htype(htype, ltype, tag, m, name)) return false;
+#define PROTO_CODEC_DECODE_REQUIRED(htype, ltype, tag, m, name) \
+  PROTO_CODEC_FIELD(htype, ltype, tag)::Decode(r, &m->name)
+#define PROTO_CODEC_DECODE_OPTIONAL(htype, ltype, tag, m, name) \
+  PROTO_CODEC_FIELD(htype, ltype, tag)::Decode(r, &m->has_##name, &m->name)
+#define PROTO_CODEC_DECODE_REPEATED(htype, ltype, tag, m, name) \
+  PROTO_CODEC_FIELD(htype, ltype, tag)::Decode(r, &m->name##_count, m->name)
+
+// What nanopb initializes fields to: zero, except for repeated fields, whose
+// count is zero but whose contents are left alone.
+#define PROTO_CODEC_DEFAULT(m, atype, htype, ltype, name, tag) \
+  PROTO_CODEC_ATYPE_##atype PROTO_CODEC_DEFAULT_##htype(m, name);
+#define PROTO_CODEC_DEFAULT_REQUIRED(m, name) SetToDefault(&m->name)
+#define PROTO_CODEC_DEFAULT_OPTIONAL(m, name) \
+  m->has_##name = false;                      \
+  SetToDefault(&m->name)
+#define PROTO_CODEC_DEFAULT_REPEATED(m, name) m->name##_count = 0
+
+#define PROTO_CODEC_MESSAGE(T)                                                              \
+  template <>                                                                               \
+  struct Message<T> {                                                                       \
+    static constexpr uint32_t MaxSize = 0 T##_FIELDLIST(PROTO_CODEC_MAX_SIZE, T);           \
+    static_assert(MaxSize == ProtoTraits<T>::MaxSize, #T "_size doesn't match its fields"); \
+    static bool Encode([[maybe_unused]] Writer &w, [[maybe_unused]] const T &m) {           \
+      T##_FIELDLIST(PROTO_CODEC_ENCODE, m) return true;                                     \
+    }                                                                                       \
+    static bool Decode([[maybe_unused]] Reader &r, [[maybe_unused]] T *m) {                 \
+      T##_FIELDLIST(PROTO_CODEC_DECODE, m) return true;                                     \
+    }                                                                                       \
+    static void SetToDefaults([[maybe_unused]] T *m) {                                      \
+      T##_FIELDLIST(PROTO_CODEC_DEFAULT, m)                                                 \
+    }                                                                                       \
+  }
+
+// Submessages first.
+PROTO_CODEC_MESSAGE(VentParams);
+PROTO_CODEC_MESSAGE(SensorsProto);
+PROTO_CODEC_MESSAGE(BreathSummary);
+PROTO_CODEC_MESSAGE(SampleBatch);
+PROTO_CODEC_MESSAGE(Capabilities);
+PROTO_CODEC_MESSAGE(ControllerStatus);
+PROTO_CODEC_MESSAGE(GuiStatus);
+
+// Encodes msg into buf, which must be large enough for any T; sets *size to
+// the number of bytes used.
+// @returns false if a repeated field's count is larger than its array, or an
+// enum is out of range
+template <typename T, size_t N>
+[[nodiscard]] bool Encode(const T &msg, uint8_t (&buf)[N], size_t *size) {
+  static_assert(N >= Message<T>::MaxSize);
+  Writer w{buf};
+  if (!Message<T>::Encode(w, msg)) return false;
+  *size = static_cast<size_t>(w.pos - buf);
+  return true;
+}
+
+// Decodes buf, if it's encoded the way Encode() and nanopb do it.
+// @returns false otherwise, leaving *msg partly written
+template <typename T>
+[[nodiscard]] bool DecodeFastPath(const uint8_t *buf, size_t size, T *msg) {
+  Reader r{buf, buf + size};
+  return Message<T>::Decode(r, msg) && r.done();
+}
+
+// Decodes buf into *msg, with the same results as pb_decode().
+template <typename T>
+[[nodiscard]] bool Decode(const uint8_t *buf, size_t size, T *msg) {
+  if (DecodeFastPath(buf, size, msg)) return true;
+  pb_istream_t stream = pb_istream_from_buffer(buf, size);
+  return pb_decode(&stream, ProtoTraits<T>::MsgDesc, msg);
+}
+
+}  // namespace ProtoCodec
@@ -54,5 +54,10 @@ struct ProtoTraits {
 
 MAKE_TRAITS(ControllerStatus);
 MAKE_TRAITS(GuiStatus);
+MAKE_TRAITS(VentParams);
+MAKE_TRAITS(SensorsProto);
+MAKE_TRAITS(BreathSummary);
+MAKE_TRAITS(SampleBatch);
+MAKE_TRAITS(Capabilities);
 
 #undef MAKE_TRAITS
@@ -16,6 +16,7 @@ limitations under the License.
 #pragma once
 
 #include <cstdint>
+#include <ratio>
 #include <type_traits>
 
 // Wrappers for measurements of different physical quantities [1] (length,
@@ -81,90 +82,278 @@ limitations under the License.
 //   Time + Time           NOT ALLOWED
 //   Duration - Time       NOT ALLOWED
 //
-// [1] https://en.wikipedia.org/wiki/Physical_quantity
-
-namespace UnitsDetail {
-
-// Represents a value of some physical quantity Q, e.g. length, pressure, time.
+// All quantities other than Time are instances of one class template,
+// Quantity<Dimension, Scale, Rep>:
 //
-// The value is stored as type ValTy (e.g. float, int64_t), and standard
-// comparison operators are available.
+//  - Dimension holds the exponents of the base dimensions (length, mass, time,
+//    current), e.g. Dim<3, 0, -1, 0> for a volumetric flow.
+//  - Scale is the std::ratio between the stored value and the SI unit, e.g.
+//    std::kilo for a pressure stored in kPa, std::micro for a duration stored
+//    in μs.
+//  - Rep is the storage type, float for everything except Duration.
 //
-// The motivation for this base class is, if we don't, we have to type out the
-// comparison operators for each type.  I'm afraid of typo'ing them, as those
-// bugs are bad and hard to catch.  The C++20 spaceship operator would obviate
-// the need for all this, but it requires gcc 10, which is newer than we can
-// get.
+// Multiplying or dividing two quantities yields a quantity of the derived
+// dimension, e.g.
 //
-// This is a CRTP [1] class; Q should inherit from Scalar<Q>, e.g.
+//   VolumetricFlow * Duration = Volume
+//   Volume / Duration         = VolumetricFlow
 //
-//   class Length : public Scalar<Length, float> { ... };
+// The result of such a product carries the product of the operands' scales
+// (μm^3 for a flow in m^3/s times a duration in μs).  It converts implicitly
+// to the named type of the same dimension, which rescales it by a constant
+// factor.  All unit conversions, including the ones in the accessors and
+// factory functions above, are a single multiplication or division by a
+// constant computed at compile time.
 //
-// [1] https://en.wikipedia.org/wiki/Curiously_recurring_template_pattern
-template <class Q, class ValTy>
-class Scalar {
- public:
-  Scalar() : val_(0) {}
-
-  constexpr bool operator<(const Scalar &s) const { return val_ < s.val_; }
-  constexpr bool operator<=(const Scalar &s) const { return val_ <= s.val_; }
-  constexpr bool operator==(const Scalar &s) const { return val_ == s.val_; }
-  constexpr bool operator!=(const Scalar &s) const { return val_ != s.val_; }
-  constexpr bool operator>=(const Scalar &s) const { return val_ >= s.val_; }
-  constexpr bool operator>(const Scalar &s) const { return val_ > s.val_; }
-
- protected:
-  constexpr explicit Scalar(ValTy val) : val_(val) {}
-  ValTy val_;
+// [1] https://en.wikipedia.org/wiki/Physical_quantity
+
+namespace UnitsDetail {
+
+// Exponents of the base dimensions a quantity is made of.
+template <int L, int M, int T, int I>
+struct Dim {
+  static constexpr int Length = L;
+  static constexpr int Mass = M;
+  static constexpr int Time = T;
+  static constexpr int Current = I;
 };
 
-// Represents a Scalar where certain arithmetic operations are defined.
+template <class A, class B>
+using DimProduct = Dim<A::Length + B::Length, A::Mass + B::Mass, A::Time + B::Time,
+                       A::Current + B::Current>;
+template <class A, class B>
+using DimQuotient = Dim<A::Length - B::Length, A::Mass - B::Mass, A::Time - B::Time,
+                        A::Current - B::Current>;
+
+using LengthDim = Dim<1, 0, 0, 0>;
+using PressureDim = Dim<-1, 1, -2, 0>;
+using VolumeDim = Dim<3, 0, 0, 0>;
+using VolumetricFlowDim = Dim<3, 0, -1, 0>;
+using VoltageDim = Dim<2, 1, -3, -1>;
+using DurationDim = Dim<0, 0, 1, 0>;
+
+// Value of a std::ratio as a Rep, computed at compile time.
+template <class R, class Rep>
+inline constexpr Rep RatioValue =
+    static_cast<Rep>(static_cast<double>(R::num) / static_cast<double>(R::den));
+
+// Converts v from unit From to unit To, both given as std::ratio relative to
+// the SI unit.
+//
+// When the conversion factor is less than 1, we divide by its reciprocal
+// rather than multiply by it: the reciprocal is usually the "nice" constant
+// (e.g. 1000, or 10.1972 for kPa -> cmH2O), so this is the more exact option.
+template <class From, class To, class Rep>
+constexpr Rep Rescale(Rep v) {
+  using Factor = std::ratio_divide<From, To>;
+  if constexpr (Factor::num == Factor::den) {
+    return v;
+  } else if constexpr (Factor::num > Factor::den) {
+    return v * RatioValue<Factor, Rep>;
+  } else {
+    return v / RatioValue<std::ratio_divide<To, From>, Rep>;
+  }
+}
+
+// Units in which the named accessors and factory functions are expressed,
+// relative to SI.
+using CmH2O = std::ratio<10'000'000, 101'972>;  // Pa; i.e. 10.1972 cmH2O per kPa
+using Atm = std::ratio<101'325>;                 // Pa
+using Milliliters = std::ratio<1, 1'000'000>;    // m^3
+using Liters = std::milli;                       // m^3
+using MlPerMin = std::ratio<1, 60'000'000>;      // m^3/s
+using Minutes = std::ratio<60>;                  // s
+
+// Enables a member of Quantity only for the given dimension.
+template <class D, class Expected>
+using IfDim = std::enable_if_t<std::is_same_v<D, Expected>, int>;
+
+// Represents a value of some physical quantity, e.g. length, pressure, time
+// interval.  See comment at the top of this file.
 //
-// Let x and y be ArithScalars of the same type, and let c be a constant of
-// type ValTy.  Then the following operations are defined.
+// Let x and y be quantities of the same type, and let c be a constant of type
+// Rep.  Then the following operations are defined.
 //
+// - comparisons
 // - x + y and x += y
 // - x - y and x -= y
 // - x / y (ratio of two measurements, yields a float)
 // - c * x, x * c, and x *= c
-// - if ValTy is floating point, x / c and x /= c.  If ValTy is not
+// - if Rep is floating point, x / c and x /= c.  If Rep is not
 //   floating-point, these operators are not defined.
 //
+// In addition, quantities of any dimension can be multiplied and divided, see
+// operator* and operator/ below.
+//
 // Be aware that dividing by 0 yields Inf and needs to be protected.
-template <class Q, class ValTy>
-class ArithScalar : public Scalar<Q, ValTy> {
+template <class Dimension, class Scale, class Rep>
+class Quantity {
  public:
-  constexpr Q operator+(const ArithScalar &a) const { return Q(this->val_ + a.val_); }
-  Q &operator+=(const ArithScalar &a) { return static_cast<Q &>(*this = *this + a); }
+  using Dimensions = Dimension;
+  using Scaling = Scale;
+  using Representation = Rep;
+
+  constexpr Quantity() : val_(0) {}
+
+  // Implicit conversion from a quantity of the same dimension with a different
+  // scale, e.g. from the result of VolumetricFlow * Duration to Volume.  Only
+  // for floating-point storage, where this can't silently truncate.
+  template <class OtherScale, class OtherRep, typename R = Rep,
+            std::enable_if_t<std::is_floating_point_v<R>, int> = 0>
+  constexpr Quantity(const Quantity<Dimension, OtherScale, OtherRep> &q)  // NOLINT
+      : val_(Rescale<OtherScale, Scale>(static_cast<Rep>(q.raw()))) {}
+
+  // Creates a quantity from a value expressed in the given unit, e.g.
+  // Pressure::In<std::kilo>(42) is 42 kPa.
+  template <class Unit>
+  static constexpr Quantity In(Rep v) {
+    return Quantity(Rescale<Unit, Scale>(v));
+  }
 
-  constexpr Q operator-(const ArithScalar &a) const { return Q(this->val_ - a.val_); }
-  Q &operator-=(const ArithScalar &a) { return static_cast<Q &>(*this = *this - a); }
+  // Value in the given unit, e.g. pressure.in<std::kilo>() is the pressure in
+  // kPa.  The named accessors (kPa() etc.) are shorthands for this.
+  template <class Unit>
+  [[nodiscard]] constexpr float in() const {
+    return Rescale<Scale, Unit>(static_cast<float>(val_));
+  }
 
-  constexpr Q operator*(const ValTy &a) const { return Q(this->val_ * a); }
-  constexpr friend Q operator*(const ValTy &a, const Q &b) { return Q(b.val_ * a); }
-  Q &operator*=(const ValTy &a) { return static_cast<Q &>(*this = *this * a); }
+  // Named accessors, each defined only for quantities of the matching
+  // dimension, regardless of scale.  So for example the product of a flow and
+  // a duration has ml() even before being converted to a Volume.
+  template <class D = Dimension, IfDim<D, PressureDim> = 0>
+  [[nodiscard]] constexpr float kPa() const {
+    return in<std::kilo>();
+  }
+  template <class D = Dimension, IfDim<D, PressureDim> = 0>
+  [[nodiscard]] constexpr float cmH2O() const {
+    return in<CmH2O>();
+  }
+  template <class D = Dimension, IfDim<D, PressureDim> = 0>
+  [[nodiscard]] constexpr float atm() const {
+    return in<Atm>();
+  }
 
-  // Division by a unitless scalar, defined only if ValTy is floating-point.
-  template <typename VT = ValTy, std::enable_if_t<std::is_floating_point_v<VT>, int> = 0>
-  constexpr Q operator/(const ValTy &a) const {
-    return Q(this->val_ / a);
+  template <class D = Dimension, IfDim<D, LengthDim> = 0>
+  [[nodiscard]] constexpr float meters() const {
+    return in<std::ratio<1>>();
   }
-  template <typename VT = ValTy, std::enable_if_t<std::is_floating_point_v<VT>, int> = 0>
-  Q &operator/=(const ValTy &a) {
-    return static_cast<Q &>(*this = *this / a);
+  template <class D = Dimension, IfDim<D, LengthDim> = 0>
+  [[nodiscard]] constexpr float millimeters() const {
+    return in<std::milli>();
+  }
+
+  template <class D = Dimension, IfDim<D, VolumetricFlowDim> = 0>
+  [[nodiscard]] constexpr float cubic_m_per_sec() const {
+    return in<std::ratio<1>>();
+  }
+  template <class D = Dimension, IfDim<D, VolumetricFlowDim> = 0>
+  [[nodiscard]] constexpr float ml_per_min() const {
+    return in<MlPerMin>();
+  }
+  template <class D = Dimension, IfDim<D, VolumetricFlowDim> = 0>
+  [[nodiscard]] constexpr float liters_per_sec() const {
+    return in<Liters>();
+  }
+  template <class D = Dimension, IfDim<D, VolumetricFlowDim> = 0>
+  [[nodiscard]] constexpr float ml_per_sec() const {
+    return in<Milliliters>();
+  }
+
+  template <class D = Dimension, IfDim<D, VolumeDim> = 0>
+  [[nodiscard]] constexpr float cubic_m() const {
+    return in<std::ratio<1>>();
+  }
+  template <class D = Dimension, IfDim<D, VolumeDim> = 0>
+  [[nodiscard]] constexpr float ml() const {
+    return in<Milliliters>();
+  }
+
+  template <class D = Dimension, IfDim<D, VoltageDim> = 0>
+  [[nodiscard]] constexpr float volts() const {
+    return in<std::ratio<1>>();
+  }
+
+  template <class D = Dimension, IfDim<D, DurationDim> = 0>
+  [[nodiscard]] constexpr Rep microseconds() const {
+    return Rescale<Scale, std::micro>(val_);
+  }
+  template <class D = Dimension, IfDim<D, DurationDim> = 0>
+  [[nodiscard]] constexpr float milliseconds() const {
+    return in<std::milli>();
+  }
+  template <class D = Dimension, IfDim<D, DurationDim> = 0>
+  [[nodiscard]] constexpr float seconds() const {
+    return in<std::ratio<1>>();
+  }
+  template <class D = Dimension, IfDim<D, DurationDim> = 0>
+  [[nodiscard]] constexpr float minutes() const {
+    return in<Minutes>();
+  }
+
+  // Stored value, in units of Scale.
+  [[nodiscard]] constexpr Rep raw() const { return val_; }
+  static constexpr Quantity FromRaw(Rep v) { return Quantity(v); }
+
+  constexpr bool operator<(const Quantity &q) const { return val_ < q.val_; }
+  constexpr bool operator<=(const Quantity &q) const { return val_ <= q.val_; }
+  constexpr bool operator==(const Quantity &q) const { return val_ == q.val_; }
+  constexpr bool operator!=(const Quantity &q) const { return val_ != q.val_; }
+  constexpr bool operator>=(const Quantity &q) const { return val_ >= q.val_; }
+  constexpr bool operator>(const Quantity &q) const { return val_ > q.val_; }
+
+  constexpr Quantity operator+(const Quantity &q) const { return Quantity(val_ + q.val_); }
+  constexpr Quantity &operator+=(const Quantity &q) { return *this = *this + q; }
+
+  constexpr Quantity operator-(const Quantity &q) const { return Quantity(val_ - q.val_); }
+  constexpr Quantity &operator-=(const Quantity &q) { return *this = *this - q; }
+
+  constexpr Quantity operator*(const Rep &a) const { return Quantity(val_ * a); }
+  constexpr friend Quantity operator*(const Rep &a, const Quantity &q) {
+    return Quantity(q.val_ * a);
+  }
+  constexpr Quantity &operator*=(const Rep &a) { return *this = *this * a; }
+
+  // Division by a unitless scalar, defined only if Rep is floating-point.
+  template <typename R = Rep, std::enable_if_t<std::is_floating_point_v<R>, int> = 0>
+  constexpr Quantity operator/(const Rep &a) const {
+    return Quantity(val_ / a);
+  }
+  template <typename R = Rep, std::enable_if_t<std::is_floating_point_v<R>, int> = 0>
+  constexpr Quantity &operator/=(const Rep &a) {
+    return *this = *this / a;
   }
 
   // Ratio of two measurements.  Always defined, and always returns a float,
-  // irrespective of ValTy.
-  constexpr float operator/(const ArithScalar &a) const {
-    return static_cast<float>(this->val_) / static_cast<float>(a.val_);
+  // irrespective of Rep.
+  constexpr float operator/(const Quantity &q) const {
+    return static_cast<float>(val_) / static_cast<float>(q.val_);
   }
 
- protected:
-  // Pull in base class's constructor.
-  using Scalar<Q, ValTy>::Scalar;
+ private:
+  constexpr explicit Quantity(Rep val) : val_(val) {}
+
+  Rep val_;
 };
 
+// Product of two quantities, e.g. VolumetricFlow * Duration, which converts
+// implicitly to a Volume.
+template <class D1, class S1, class R1, class D2, class S2, class R2>
+constexpr auto operator*(const Quantity<D1, S1, R1> &a, const Quantity<D2, S2, R2> &b) {
+  using Rep = std::common_type_t<R1, R2>;
+  return Quantity<DimProduct<D1, D2>, typename std::ratio_multiply<S1, S2>::type,
+                  Rep>::FromRaw(static_cast<Rep>(a.raw()) * static_cast<Rep>(b.raw()));
+}
+
+// Quotient of two quantities of different dimensions, e.g. Volume / Duration,
+// which converts implicitly to a VolumetricFlow.
+template <class D1, class S1, class R1, class D2, class S2, class R2,
+          std::enable_if_t<!std::is_same_v<D1, D2>, int> = 0>
+constexpr auto operator/(const Quantity<D1, S1, R1> &a, const Quantity<D2, S2, R2> &b) {
+  using Rep = std::common_type_t<R1, R2>;
+  return Quantity<DimQuotient<D1, D2>, typename std::ratio_divide<S1, S2>::type,
+                  Rep>::FromRaw(static_cast<Rep>(a.raw()) / static_cast<Rep>(b.raw()));
+}
+
 }  // namespace UnitsDetail
 
 // Represents pressure, e.g. air pressure.
@@ -177,28 +366,11 @@ class ArithScalar : public Scalar<Q, ValTy> {
 //  - atm (atmospheres)
 //
 // Native unit (implementation detail): kPa
-class Pressure : public UnitsDetail::ArithScalar<Pressure, float> {
- public:
-  [[nodiscard]] constexpr float kPa() const { return val_; }
-  [[nodiscard]] constexpr float cmH2O() const { return val_ * KPaToCmH2O; }
-  [[nodiscard]] constexpr float atm() const { return val_ / AtmToKPa; }
+using Pressure = UnitsDetail::Quantity<UnitsDetail::PressureDim, std::kilo, float>;
 
- private:
-  // https://www.google.com/search?q=kpa+to+cmh2o
-  static constexpr float KPaToCmH2O{10.1972f};
-  // https://www.google.com/search?q=atm+to+kPa
-  static constexpr float AtmToKPa{101.325f};
-
-  constexpr friend Pressure kPa(float kpa);
-  constexpr friend Pressure cmH2O(float cm_h2o);
-  constexpr friend Pressure atm(float atm);
-
-  using UnitsDetail::ArithScalar<Pressure, float>::ArithScalar;
-};
-
-constexpr Pressure kPa(float kpa) { return Pressure(kpa); }
-constexpr Pressure cmH2O(float cm_h2o) { return Pressure(cm_h2o / Pressure::KPaToCmH2O); }
-constexpr Pressure atm(float atm) { return Pressure(atm * Pressure::AtmToKPa); }
+constexpr Pressure kPa(float kpa) { return Pressure::FromRaw(kpa); }
+constexpr Pressure cmH2O(float cm_h2o) { return Pressure::In<UnitsDetail::CmH2O>(cm_h2o); }
+constexpr Pressure atm(float atm) { return Pressure::In<UnitsDetail::Atm>(atm); }
 
 // Represents a length.
 //
@@ -209,20 +381,10 @@ constexpr Pressure atm(float atm) { return Pressure(atm * Pressure::AtmToKPa); }
 //   - millimeters
 //
 // Native unit (implementation detail): meters
-class Length : public UnitsDetail::ArithScalar<Length, float> {
- public:
-  [[nodiscard]] constexpr float meters() const { return val_; }
-  [[nodiscard]] constexpr float millimeters() const { return val_ * 1000; }
+using Length = UnitsDetail::Quantity<UnitsDetail::LengthDim, std::ratio<1>, float>;
 
- private:
-  constexpr friend Length meters(float meters);
-  constexpr friend Length millimeters(float mm);
-
-  using UnitsDetail::ArithScalar<Length, float>::ArithScalar;
-};
-
-constexpr Length meters(float meters) { return Length(meters); }
-constexpr Length millimeters(float mm) { return Length(mm / 1000); }
+constexpr Length meters(float meters) { return Length::FromRaw(meters); }
+constexpr Length millimeters(float mm) { return Length::In<std::milli>(mm); }
 
 // Represents flow over time, the rate of air passing through a tube.
 //
@@ -239,28 +401,19 @@ constexpr Length millimeters(float mm) { return Length(mm / 1000); }
 //
 // Dividing a Volume by a Duration (see below) gives you a VolumetricFlow.
 // Multiplying a VolumetricFlow by a Duration (see below) gives you a Volume.
-class VolumetricFlow : public UnitsDetail::ArithScalar<VolumetricFlow, float> {
- public:
-  [[nodiscard]] constexpr float cubic_m_per_sec() const { return val_; }
-  [[nodiscard]] constexpr float ml_per_min() const { return val_ * 1000.0f * 1000.0f * 60.0f; }
-  [[nodiscard]] constexpr float liters_per_sec() const { return val_ * 1000.0f; }
-  [[nodiscard]] constexpr float ml_per_sec() const { return val_ * 1.0e6f; }
-
- private:
-  constexpr friend VolumetricFlow cubic_m_per_sec(float m3ps);
-  constexpr friend VolumetricFlow ml_per_min(float ml_per_min);
-  constexpr friend VolumetricFlow liters_per_sec(float lps);
-  constexpr friend VolumetricFlow ml_per_sec(float mlps);
+using VolumetricFlow =
+    UnitsDetail::Quantity<UnitsDetail::VolumetricFlowDim, std::ratio<1>, float>;
 
-  using UnitsDetail::ArithScalar<VolumetricFlow, float>::ArithScalar;
-};
-
-constexpr VolumetricFlow cubic_m_per_sec(float m3ps) { return VolumetricFlow(m3ps); }
+constexpr VolumetricFlow cubic_m_per_sec(float m3ps) { return VolumetricFlow::FromRaw(m3ps); }
 constexpr VolumetricFlow ml_per_min(float ml_per_min) {
-  return VolumetricFlow(ml_per_min / (1000.0f * 1000.0f * 60.0f));
+  return VolumetricFlow::In<UnitsDetail::MlPerMin>(ml_per_min);
+}
+constexpr VolumetricFlow liters_per_sec(float lps) {
+  return VolumetricFlow::In<UnitsDetail::Liters>(lps);
+}
+constexpr VolumetricFlow ml_per_sec(float mlps) {
+  return VolumetricFlow::In<UnitsDetail::Milliliters>(mlps);
 }
-constexpr VolumetricFlow liters_per_sec(float lps) { return VolumetricFlow(lps / (1000.0f)); }
-constexpr VolumetricFlow ml_per_sec(float mlps) { return VolumetricFlow(mlps / (1.0e6f)); }
 
 // Represents volume.
 //
@@ -275,37 +428,19 @@ constexpr VolumetricFlow ml_per_sec(float mlps) { return VolumetricFlow(mlps / (
 //
 // Multiplying a VolumetricFlow by a Duration (see below) gives you a Volume.
 // Dividing a Volume by a Duration gives you a VolumetricFlow.
-class Volume : public UnitsDetail::ArithScalar<Volume, float> {
- public:
-  [[nodiscard]] constexpr float cubic_m() const { return val_; }
-  [[nodiscard]] constexpr float ml() const { return val_ * 1000.0f * 1000.0f; }
+using Volume = UnitsDetail::Quantity<UnitsDetail::VolumeDim, std::ratio<1>, float>;
 
- private:
-  constexpr friend Volume cubic_m(float m3);
-  constexpr friend Volume ml(float ml);
-
-  using UnitsDetail::ArithScalar<Volume, float>::ArithScalar;
-};
-
-constexpr Volume cubic_m(float m3) { return Volume(m3); }
-constexpr Volume ml(float ml) { return Volume(ml / (1000.0f * 1000.0f)); }
+constexpr Volume cubic_m(float m3) { return Volume::FromRaw(m3); }
+constexpr Volume ml(float ml) { return Volume::In<UnitsDetail::Milliliters>(ml); }
 
 // Represents voltage.
 //
 // Precision: float.
 //
 // Units: Volts
-class Voltage : public UnitsDetail::ArithScalar<Voltage, float> {
- public:
-  [[nodiscard]] constexpr float volts() const { return val_; }
+using Voltage = UnitsDetail::Quantity<UnitsDetail::VoltageDim, std::ratio<1>, float>;
 
- private:
-  constexpr friend Voltage volts(float v);
-
-  using UnitsDetail::ArithScalar<Voltage, float>::ArithScalar;
-};
-
-constexpr Voltage volts(float v) { return Voltage(v); }
+constexpr Voltage volts(float v) { return Voltage::FromRaw(v); }
 
 // Time and Duration classes.
 //
@@ -324,11 +459,10 @@ constexpr Voltage volts(float v) { return Voltage(v); }
 //   Time +/- Duration = Time
 //   Time - Time = Duration
 //
-class Time;
 
 // Represents a length of time.
 //
-// Precision: 1ms
+// Precision: 1μs
 //
 // Units:
 //  - seconds
@@ -349,25 +483,9 @@ class Time;
 // This is unfortunate, but the alternative (not offering a
 // milliseconds(int64_t) factory) is worse, because converting an int64
 // milliseconds to float may lose useful precision.
-class Duration : public UnitsDetail::ArithScalar<Duration, int64_t> {
- public:
-  [[nodiscard]] constexpr int64_t microseconds() const { return val_; }
-  [[nodiscard]] constexpr float milliseconds() const { return static_cast<float>(val_) / 1000; }
-  [[nodiscard]] constexpr float seconds() const { return milliseconds() / 1000; }
-  [[nodiscard]] constexpr float minutes() const { return seconds() / 60; }
-
-  constexpr friend Time operator+(const Time &t, const Duration &dt);
-  constexpr friend Time operator+(const Duration &dt, const Time &t);
-  constexpr friend Time operator-(const Time &t, const Duration &dt);
-  constexpr friend Duration operator-(const Time &a, const Time &b);
+using Duration = UnitsDetail::Quantity<UnitsDetail::DurationDim, std::micro, int64_t>;
 
- private:
-  constexpr friend Duration microseconds(int64_t micros);
-
-  using UnitsDetail::ArithScalar<Duration, int64_t>::ArithScalar;
-};
-
-constexpr Duration microseconds(int64_t micros) { return Duration(micros); }
+constexpr Duration microseconds(int64_t micros) { return Duration::FromRaw(micros); }
 constexpr Duration milliseconds(int64_t millis) { return microseconds(millis * 1000); }
 
 // Add a dummy template to make these overloads have lower priority than the
@@ -388,6 +506,8 @@ constexpr Duration minutes(float mins) { return seconds(mins * 60); }
 // Represents a point in time, relative to when the device started up.  See
 // details above.
 //
+// This is not a Quantity: a point in time has no meaningful sum or scaling.
+//
 // Precision: 1μs
 //
 // Units:
@@ -395,47 +515,37 @@ constexpr Duration minutes(float mins) { return seconds(mins * 60); }
 //  - microseconds
 //
 // Native unit (implementation detail): uint64_t microseconds
-class Time : public UnitsDetail::Scalar<Time, uint64_t> {
+class Time {
  public:
-  [[nodiscard]] uint64_t microsSinceStartup() const { return val_; }
+  Time() = default;
+
+  [[nodiscard]] constexpr uint64_t microsSinceStartup() const { return val_; }
 
-  constexpr friend Time operator+(const Time &t, const Duration &dt);
-  constexpr friend Time operator+(const Duration &dt, const Time &t);
-  constexpr friend Time operator-(const Time &t, const Duration &dt);
-  constexpr friend Duration operator-(const Time &a, const Time &b);
+  constexpr bool operator<(const Time &t) const { return val_ < t.val_; }
+  constexpr bool operator<=(const Time &t) const { return val_ <= t.val_; }
+  constexpr bool operator==(const Time &t) const { return val_ == t.val_; }
+  constexpr bool operator!=(const Time &t) const { return val_ != t.val_; }
+  constexpr bool operator>=(const Time &t) const { return val_ >= t.val_; }
+  constexpr bool operator>(const Time &t) const { return val_ > t.val_; }
+
+  constexpr Time operator+(const Duration &dt) const {
+    return Time(val_ + static_cast<uint64_t>(dt.raw()));
+  }
+  constexpr friend Time operator+(const Duration &dt, const Time &t) { return t + dt; }
+  constexpr Time operator-(const Duration &dt) const {
+    return Time(val_ - static_cast<uint64_t>(dt.raw()));
+  }
+  constexpr Duration operator-(const Time &t) const {
+    return microseconds(static_cast<int64_t>(val_ - t.val_));
+  }
   Time &operator+=(const Duration &dt) { return *this = *this + dt; }
   Time &operator-=(const Duration &dt) { return *this = *this - dt; }
 
  private:
   constexpr friend Time microsSinceStartup(uint64_t micros);
+  constexpr explicit Time(uint64_t val) : val_(val) {}
 
-  using UnitsDetail::Scalar<Time, uint64_t>::Scalar;
+  uint64_t val_{0};
 };
 
 constexpr Time microsSinceStartup(uint64_t micros) { return Time(micros); }
-
-constexpr inline Time operator+(const Time &t, const Duration &dt) {
-  return Time(t.val_ + static_cast<uint64_t>(dt.val_));
-}
-constexpr inline Time operator+(const Duration &dt, const Time &t) {
-  return Time(t.val_ + static_cast<uint64_t>(dt.val_));
-}
-constexpr inline Time operator-(const Time &t, const Duration &dt) {
-  return Time(t.val_ - static_cast<uint64_t>(dt.val_));
-}
-constexpr inline Duration operator-(const Time &a, const Time &b) {
-  return Duration(static_cast<int64_t>(a.val_ - b.val_));
-}
-
-constexpr inline Volume operator*(VolumetricFlow a, Duration b) {
-  return ml(a.ml_per_min() * b.minutes());
-}
-
-constexpr inline Volume operator*(Duration b, VolumetricFlow a) {
-  return ml(a.ml_per_min() * b.minutes());
-}
-
-// Be aware that dividing by zero leads to Inf and needs to be protected.
-constexpr inline VolumetricFlow operator/(Volume a, Duration b) {
-  return ml_per_min(a.ml() / b.minutes());
-}
@@ -0,0 +1,48 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "capabilities.h"
+
+#include "gtest/gtest.h"
+
+TEST(Capabilities, NegotiateKeepsWhatBothHave) {
+  Capabilities gui = {ProtocolVersion, AllFeatures, 1'000'000};
+  // An older controller, without framing, on a slower port.
+  Capabilities controller = {ProtocolVersion - 1,
+                             Feature_BATCHED_TELEMETRY | Feature_BREATH_SUMMARIES, 460'800};
+
+  for (const Capabilities &link : {Negotiate(gui, controller), Negotiate(controller, gui)}) {
+    EXPECT_EQ(link.protocol_version, ProtocolVersion - 1);
+    EXPECT_FALSE(HasFeature(link, Feature_FRAMING));
+    EXPECT_TRUE(HasFeature(link, Feature_BATCHED_TELEMETRY));
+    EXPECT_TRUE(HasFeature(link, Feature_BREATH_SUMMARIES));
+    EXPECT_EQ(link.max_baud_rate, 460'800u);
+  }
+}
+
+TEST(Capabilities, UnknownFeaturesAreDropped) {
+  // A newer peer, with a feature we don't know about yet.
+  Capabilities newer = {ProtocolVersion + 1, AllFeatures | 1u << 31, 1'000'000};
+  Capabilities ours = {ProtocolVersion, AllFeatures, 1'000'000};
+  EXPECT_EQ(Negotiate(ours, newer).features, AllFeatures);
+  EXPECT_EQ(Negotiate(ours, newer).protocol_version, ProtocolVersion);
+}
+
+TEST(Capabilities, LegacyPeerGetsNoFeatures) {
+  Capabilities link =
+      Negotiate({ProtocolVersion, AllFeatures, 1'000'000}, LegacyCapabilities(115200));
+  EXPECT_EQ(link.features, uint32_t{Feature_NO_FEATURES});
+  EXPECT_EQ(link.max_baud_rate, 115200u);
+}
@@ -0,0 +1,279 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <vector>
+
+#include "biquad.h"
+#include "ewma.h"
+#include "fixed_point.h"
+#include "gtest/gtest.h"
+#include "microbench.h"
+#include "moving_average.h"
+#include "moving_median.h"
+#include "units.h"
+
+using DSP::Biquad;
+using DSP::BiquadCoefficients;
+using DSP::Ewma;
+using DSP::MovingAverage;
+using DSP::MovingMedian;
+using Q16 = DSP::Fixed<16>;
+using Q28 = DSP::Fixed<28>;
+
+static constexpr double SampleRate = 100;  // Hz, i.e. the controller loop rate
+
+// Amplitude of a sine of the given frequency after going through the filter,
+// measured once the start-up transient has died out.
+template <typename Filter>
+static float SineGain(Filter filter, double frequency) {
+  constexpr int Samples = 2000;
+  float peak = 0;
+  for (int i = 0; i < Samples; ++i) {
+    auto x = static_cast<float>(std::sin(2 * M_PI * frequency * i / SampleRate));
+    float y = filter.update(x);
+    if (i > Samples / 2) peak = std::max(peak, std::abs(y));
+  }
+  return peak;
+}
+
+TEST(FixedPoint, Arithmetic) {
+  constexpr Q16 a(1.5f);
+  constexpr Q16 b(-0.25f);
+  static_assert((a + b).raw() == Q16(1.25f).raw());
+  static_assert((a * b).raw() == Q16(-0.375f).raw());
+  static_assert((a / b).raw() == Q16(-6).raw());
+  static_assert(Q16(3) / 2 == a);
+  static_assert(b < a && -a < b);
+
+  EXPECT_FLOAT_EQ(Q16(3.14159f).to_float(), 205887.f / 65536);
+  EXPECT_EQ(Q16::FromRaw(1).raw(), 1);
+  EXPECT_FLOAT_EQ(static_cast<float>(Q28(-1.75)), -1.75f);
+}
+
+TEST(Ewma, FirstSampleInitializes) {
+  Ewma<float> avg(0.1f);
+  EXPECT_FALSE(avg.value().has_value());
+  EXPECT_FLOAT_EQ(avg.update(42), 42);
+  EXPECT_FLOAT_EQ(*avg.value(), 42);
+  avg.reset();
+  EXPECT_FALSE(avg.value().has_value());
+}
+
+TEST(Ewma, MatchesDefinition) {
+  Ewma<float> avg(0.2f);
+  float expected = 0;
+  std::vector<float> inputs = {1, 5, -3, 8, 8, 8, 0, 2};
+  for (size_t i = 0; i < inputs.size(); ++i) {
+    expected = i == 0 ? inputs[i] : 0.2f * inputs[i] + (1 - 0.2f) * expected;
+    EXPECT_FLOAT_EQ(avg.update(inputs[i]), expected);
+  }
+
+  // Changing alpha keeps the current average.
+  avg.set_alpha(1);
+  EXPECT_FLOAT_EQ(avg.alpha(), 1);
+  EXPECT_FLOAT_EQ(avg.update(7), 7);
+}
+
+TEST(Ewma, WorksWithUnits) {
+  Ewma<VolumetricFlow> avg(0.5f);
+  avg.update(ml_per_sec(10));
+  EXPECT_FLOAT_EQ(avg.update(ml_per_sec(20)).ml_per_sec(), 15);
+}
+
+TEST(Ewma, FixedPointTracksFloat) {
+  Ewma<float> f(0.05f);
+  Ewma<Q16, Q16> q(Q16(0.05f));
+  for (int i = 0; i < 500; ++i) {
+    float x = static_cast<float>(i % 37) - 10;
+    f.update(x);
+    q.update(Q16(x));
+    EXPECT_NEAR(q.value()->to_float(), *f.value(), 0.01f);
+  }
+}
+
+TEST(Ewma, Constexpr) {
+  constexpr float alpha = Ewma<float>::AlphaForTimeConstant(0.01f, 0.09f);
+  static_assert(alpha > 0.0999f && alpha < 0.1001f);
+  constexpr float settled = [] {
+    Ewma<float> avg(0.5f);
+    avg.update(0);
+    for (int i = 0; i < 30; ++i) avg.update(1);
+    return *avg.value();
+  }();
+  static_assert(settled > 0.999f);
+}
+
+TEST(Biquad, LowPass) {
+  constexpr auto coeffs = BiquadCoefficients::LowPass(SampleRate, 5, M_SQRT1_2);
+  Biquad<float> filter(coeffs);
+
+  // Unity gain at DC, -3dB at cutoff, strong attenuation well above it.
+  filter.reset(3);
+  EXPECT_FLOAT_EQ(filter.update(3), 3);
+  EXPECT_NEAR(SineGain(Biquad<float>(coeffs), 0.1), 1, 0.01);
+  EXPECT_NEAR(SineGain(Biquad<float>(coeffs), 5), M_SQRT1_2, 0.01);
+  EXPECT_LT(SineGain(Biquad<float>(coeffs), 40), 0.02);
+}
+
+TEST(Biquad, HighPass) {
+  constexpr auto coeffs = BiquadCoefficients::HighPass(SampleRate, 5, M_SQRT1_2);
+  EXPECT_LT(SineGain(Biquad<float>(coeffs), 0.1), 0.01);
+  EXPECT_NEAR(SineGain(Biquad<float>(coeffs), 5), M_SQRT1_2, 0.01);
+  EXPECT_NEAR(SineGain(Biquad<float>(coeffs), 25), 1, 0.05);
+}
+
+TEST(Biquad, Notch) {
+  constexpr auto coeffs = BiquadCoefficients::Notch(SampleRate, 25, 2);
+  EXPECT_LT(SineGain(Biquad<float>(coeffs), 25), 0.01);
+  EXPECT_NEAR(SineGain(Biquad<float>(coeffs), 1), 1, 0.01);
+  EXPECT_NEAR(SineGain(Biquad<float>(coeffs), 49), 1, 0.02);
+}
+
+TEST(Biquad, ConstexprDesignMatchesLibm) {
+  constexpr auto c = BiquadCoefficients::LowPass(SampleRate, 10, M_SQRT1_2);
+  double w0 = 2 * M_PI * 10 / SampleRate;
+  double alpha = std::sin(w0) / (2 * M_SQRT1_2);
+  EXPECT_NEAR(c.b0, (1 - std::cos(w0)) / 2 / (1 + alpha), 1e-9);
+  EXPECT_NEAR(c.a1, -2 * std::cos(w0) / (1 + alpha), 1e-9);
+  EXPECT_NEAR(c.a2, (1 - alpha) / (1 + alpha), 1e-9);
+}
+
+TEST(Biquad, FixedPointTracksFloat) {
+  constexpr auto coeffs = BiquadCoefficients::LowPass(SampleRate, 5, M_SQRT1_2);
+  Biquad<float> f(coeffs);
+  Biquad<Q28> q(coeffs);
+  for (int i = 0; i < 1000; ++i) {
+    auto x = static_cast<float>(std::sin(i * 0.05) + 0.3 * std::sin(i * 2.1));
+    EXPECT_NEAR(q.update(Q28(x)).to_float(), f.update(x), 1e-3f);
+  }
+}
+
+TEST(MovingAverage, Window) {
+  MovingAverage<float, 4> avg;
+  EXPECT_FLOAT_EQ(avg.value(), 0);
+  EXPECT_FLOAT_EQ(avg.update(4), 4);
+  EXPECT_FLOAT_EQ(avg.update(8), 6);
+  EXPECT_FALSE(avg.full());
+  avg.update(0);
+  EXPECT_FLOAT_EQ(avg.update(0), 3);
+  EXPECT_TRUE(avg.full());
+  // 4 drops out of the window.
+  EXPECT_FLOAT_EQ(avg.update(12), 5);
+  avg.reset();
+  EXPECT_EQ(avg.count(), 0);
+}
+
+TEST(MovingAverage, IntegerSamplesWithWideAccumulator) {
+  MovingAverage<uint16_t, 16, uint32_t> avg;
+  for (int i = 0; i < 100; ++i) avg.update(60000);
+  EXPECT_EQ(avg.value(), 60000);
+}
+
+TEST(MovingAverage, FixedPoint) {
+  MovingAverage<Q16, 3> avg;
+  avg.update(Q16(1));
+  avg.update(Q16(2));
+  EXPECT_EQ(avg.update(Q16(6)), Q16(3));
+}
+
+TEST(MovingMedian, RejectsSpikes) {
+  MovingMedian<float, 5> med;
+  EXPECT_FLOAT_EQ(med.update(1), 1);
+  EXPECT_FLOAT_EQ(med.update(100), 1);  // lower median of {1, 100}
+  EXPECT_FLOAT_EQ(med.update(2), 2);
+  EXPECT_FLOAT_EQ(med.update(3), 2);
+  EXPECT_FLOAT_EQ(med.update(-50), 2);
+  EXPECT_TRUE(med.full());
+  // 1 and then 100 drop out of the window.
+  EXPECT_FLOAT_EQ(med.update(4), 3);
+  EXPECT_FLOAT_EQ(med.update(5), 3);
+}
+
+TEST(MovingMedian, SurvivesNaN) {
+  constexpr float NaN = std::numeric_limits<float>::quiet_NaN();
+  MovingMedian<float, 3> med;
+  med.update(1);
+  med.update(2);
+  // NaN sorts last, so it doesn't become the median...
+  EXPECT_FLOAT_EQ(med.update(NaN), 2);
+  EXPECT_FLOAT_EQ(med.update(5), 5);
+  EXPECT_FLOAT_EQ(med.update(3), 5);
+  // ...and once it's out of the window, the window is as if it never was.
+  EXPECT_FLOAT_EQ(med.update(0), 3);
+  EXPECT_FLOAT_EQ(med.update(4), 3);
+  EXPECT_FLOAT_EQ(med.update(6), 4);
+
+  // Unless at least half the window is NaN.
+  EXPECT_FLOAT_EQ(med.update(NaN), 6);
+  EXPECT_TRUE(std::isnan(med.update(NaN)));
+  EXPECT_TRUE(std::isnan(med.update(7)));
+  EXPECT_FLOAT_EQ(med.update(8), 8);
+}
+
+TEST(MovingMedian, MatchesSortedWindow) {
+  constexpr size_t N = 7;
+  MovingMedian<int, N> med;
+  std::vector<int> history;
+  uint32_t seed = 12345;
+  for (int i = 0; i < 500; ++i) {
+    seed = seed * 1103515245 + 12345;
+    int x = static_cast<int>((seed >> 16) % 50);
+    history.push_back(x);
+    std::vector<int> window(history.end() - std::min(history.size(), N), history.end());
+    std::sort(window.begin(), window.end());
+    EXPECT_EQ(med.update(x), window[(window.size() - 1) / 2]);
+  }
+}
+
+// Microbenchmarks: per-sample cost of each filter, for float and fixed point.
+TEST(DspBenchmark, PerSampleCost) {
+  constexpr uint32_t Iterations = 1'000'000;
+  float xf = 0;
+  Q16 xq(0);
+  Q28 xq28(0);  // Q28 only has 3 integer bits
+  auto next = [&] {
+    xf = xf > 100 ? 0 : xf + 0.37f;
+    xq = Q16(xf);
+    xq28 = Q28(xf * 0.01f);
+  };
+
+  Ewma<float> ewma_f(0.1f);
+  Ewma<Q16, Q16> ewma_q(Q16(0.1f));
+  Biquad<float> biquad_f(BiquadCoefficients::LowPass(SampleRate, 5, M_SQRT1_2));
+  Biquad<Q28> biquad_q(BiquadCoefficients::LowPass(SampleRate, 5, M_SQRT1_2));
+  MovingAverage<float, 16> avg_f;
+  MovingAverage<Q16, 16> avg_q;
+  MovingMedian<float, 9> med_f;
+  MovingMedian<Q16, 9> med_q;
+
+  auto report = [&](const char *name, auto &filter, auto &x) {
+    double ns = Microbench::NanosPerCall(Iterations, [&] {
+      next();
+      Microbench::DoNotOptimize(filter.update(x));
+    });
+    Microbench::Report(name, ns);
+  };
+  report("Ewma<float>", ewma_f, xf);
+  report("Ewma<Q16>", ewma_q, xq);
+  report("Biquad<float>", biquad_f, xf);
+  report("Biquad<Q28>", biquad_q, xq28);
+  report("MovingAverage<float,16>", avg_f, xf);
+  report("MovingAverage<Q16,16>", avg_q, xq);
+  report("MovingMedian<float,9>", med_f, xf);
+  report("MovingMedian<Q16,9>", med_q, xq);
+}
@@ -0,0 +1,315 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "framing.h"
+
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "checksum.h"
+#include "gtest/gtest.h"
+#include "microbench.h"
+#include "serial_listeners.h"
+
+using Framing::DecodeInPlace;
+using Framing::Decoder;
+using Framing::DecodeStatus;
+using Framing::Delimiter;
+using Framing::EncodeFrame;
+using Framing::Encoder;
+using Framing::MaxEncodedSize;
+using Bytes = std::vector<uint8_t>;
+
+// Straightforward COBS encoding of message + CRC, to check the encoder against.
+static Bytes ReferenceFrame(const Bytes &message) {
+  Bytes data = message;
+  uint32_t crc = Framing::CrcInit;
+  for (uint8_t b : message) crc = crc32_single(crc, b);
+  for (int shift = 24; shift >= 0; shift -= 8) data.push_back(static_cast<uint8_t>(crc >> shift));
+
+  Bytes frame;
+  Bytes block;
+  for (uint8_t b : data) {
+    if (b == 0) {
+      frame.push_back(static_cast<uint8_t>(block.size() + 1));
+      frame.insert(frame.end(), block.begin(), block.end());
+      block.clear();
+      continue;
+    }
+    block.push_back(b);
+    if (block.size() == 254) {
+      frame.push_back(0xFF);
+      frame.insert(frame.end(), block.begin(), block.end());
+      block.clear();
+    }
+  }
+  frame.push_back(static_cast<uint8_t>(block.size() + 1));
+  frame.insert(frame.end(), block.begin(), block.end());
+  frame.push_back(Delimiter);
+  return frame;
+}
+
+// Messages of random length, with plenty of zeros, and of long runs without
+// any, so that COBS blocks of all sizes come up.
+static Bytes RandomMessage(std::mt19937 &rng) {
+  std::uniform_int_distribution<uint32_t> length(0, 600);
+  std::uniform_int_distribution<uint32_t> byte(0, 255);
+  std::uniform_int_distribution<uint32_t> zero_odds(0, 300);
+  uint32_t one_in = zero_odds(rng);
+  Bytes message(length(rng));
+  for (uint8_t &b : message) {
+    b = (one_in > 0 && byte(rng) % (one_in + 1) == 0) ? 0 : static_cast<uint8_t>(byte(rng) | 1);
+  }
+  return message;
+}
+
+static Bytes Encode(const Bytes &message) {
+  Bytes frame(MaxEncodedSize(static_cast<uint32_t>(message.size())));
+  uint32_t size = EncodeFrame(message.data(), static_cast<uint32_t>(message.size()), frame.data(),
+                              static_cast<uint32_t>(frame.size()));
+  EXPECT_GT(size, 0u);
+  frame.resize(size);
+  return frame;
+}
+
+TEST(Framing, KnownFrames) {
+  // Empty message: only the CRC, which has no zero bytes.
+  EXPECT_EQ(Encode({}), (Bytes{0x05, 0xFF, 0xFF, 0xFF, 0xFF, 0x00}));
+
+  // soft_crc32("a") is 0xC808931C.
+  EXPECT_EQ(Encode({'a'}), (Bytes{0x06, 'a', 0xC8, 0x08, 0x93, 0x1C, 0x00}));
+
+  Bytes message{0x11, 0x00, 0x00, 0x22};
+  EXPECT_EQ(Encode(message), ReferenceFrame(message));
+}
+
+TEST(Framing, BlockBoundaries) {
+  for (uint32_t length = 240; length < 520; ++length) {
+    Bytes message(length, 0x42);
+    EXPECT_EQ(Encode(message), ReferenceFrame(message)) << length;
+  }
+}
+
+TEST(Framing, RandomRoundTrips) {
+  std::mt19937 rng(0);
+  for (int i = 0; i < 5000; ++i) {
+    Bytes message = RandomMessage(rng);
+    auto length = static_cast<uint32_t>(message.size());
+
+    // Encode in chunks of random size.
+    Bytes frame(MaxEncodedSize(length));
+    Encoder encoder(frame.data(), static_cast<uint32_t>(frame.size()));
+    for (uint32_t pos = 0; pos < length;) {
+      uint32_t chunk = std::min(length - pos, std::uniform_int_distribution<uint32_t>(0, 40)(rng));
+      encoder.Put(message.data() + pos, chunk);
+      pos += chunk;
+    }
+    uint32_t size = encoder.Finish();
+    ASSERT_GT(size, 0u);
+    frame.resize(size);
+    ASSERT_EQ(frame, ReferenceFrame(message));
+    EXPECT_EQ(std::count(frame.begin(), frame.end(), Delimiter), 1);
+    EXPECT_EQ(frame.back(), Delimiter);
+
+    // The streaming decoder.
+    Bytes decoded(length + Framing::CrcSize);
+    Decoder decoder(decoded.data(), static_cast<uint32_t>(decoded.size()));
+    for (size_t j = 0; j + 1 < frame.size(); ++j) {
+      ASSERT_EQ(decoder.Put(frame[j]), DecodeStatus::Pending);
+    }
+    ASSERT_EQ(decoder.Put(frame.back()), DecodeStatus::Ok);
+    ASSERT_EQ(Bytes(decoder.message(), decoder.message() + decoder.message_length()), message);
+
+    // In place, with or without the delimiter.
+    Bytes in_place = frame;
+    uint32_t message_length = 0;
+    uint32_t frame_length = static_cast<uint32_t>(in_place.size()) - (i % 2);
+    ASSERT_EQ(DecodeInPlace(in_place.data(), frame_length, &message_length), DecodeStatus::Ok);
+    ASSERT_EQ(Bytes(in_place.begin(), in_place.begin() + message_length), message);
+    // The decoded CRC is where crc_ok() expects it.
+    if (length > 0) {
+      EXPECT_TRUE(crc_ok(in_place.data(), length + Framing::CrcSize));
+    }
+  }
+}
+
+TEST(Framing, RandomCorruption) {
+  std::mt19937 rng(1);
+  std::uniform_int_distribution<uint32_t> byte(0, 255);
+  for (int i = 0; i < 5000; ++i) {
+    Bytes message = RandomMessage(rng);
+    Bytes frame = Encode(message);
+
+    // Change one byte of the frame, delimiter excepted.
+    size_t pos = std::uniform_int_distribution<size_t>(0, frame.size() - 2)(rng);
+    auto value = static_cast<uint8_t>(byte(rng));
+    if (value == frame[pos]) value ^= 0x80;
+    frame[pos] = value;
+
+    uint32_t message_length = 0;
+    Bytes in_place = frame;
+    EXPECT_NE(DecodeInPlace(in_place.data(), static_cast<uint32_t>(in_place.size()),
+                            &message_length),
+              DecodeStatus::Ok);
+
+    // A zero splits the frame in two, neither of which should pass.
+    Bytes buf(message.size() + Framing::CrcSize);
+    Decoder decoder(buf.data(), static_cast<uint32_t>(buf.size()));
+    for (uint8_t b : frame) {
+      EXPECT_NE(decoder.Put(b), DecodeStatus::Ok);
+    }
+  }
+}
+
+TEST(Framing, DecoderResynchronizes) {
+  std::mt19937 rng(2);
+  Bytes buf(700);
+  Decoder decoder(buf.data(), static_cast<uint32_t>(buf.size()));
+
+  for (int i = 0; i < 500; ++i) {
+    // Garbage, as if we started listening halfway through a frame.
+    Bytes garbage = RandomMessage(rng);
+    for (uint8_t b : garbage) decoder.Put(b);
+
+    Bytes message = RandomMessage(rng);
+    Bytes frame = Encode(message);
+    // Senders can start with a delimiter to end the garbage.
+    decoder.Put(Delimiter);
+    for (size_t j = 0; j + 1 < frame.size(); ++j) {
+      ASSERT_EQ(decoder.Put(frame[j]), DecodeStatus::Pending);
+    }
+    ASSERT_EQ(decoder.Put(frame.back()), DecodeStatus::Ok);
+    EXPECT_EQ(Bytes(decoder.message(), decoder.message() + decoder.message_length()), message);
+  }
+}
+
+TEST(Framing, Overflow) {
+  Bytes message(300, 0x42);
+  message[100] = 0;
+  Bytes frame = ReferenceFrame(message);
+  auto message_length = static_cast<uint32_t>(message.size());
+  EXPECT_LE(frame.size(), MaxEncodedSize(message_length));
+
+  Bytes buf(frame.size());
+  for (uint32_t size = 0; size < frame.size(); ++size) {
+    EXPECT_EQ(EncodeFrame(message.data(), message_length, buf.data(), size), 0u) << size;
+  }
+  EXPECT_EQ(EncodeFrame(message.data(), message_length, buf.data(),
+                        static_cast<uint32_t>(frame.size())),
+            frame.size());
+
+  // Too short a buffer only loses that frame.
+  Bytes decoded(message_length + Framing::CrcSize - 1);
+  Decoder decoder(decoded.data(), static_cast<uint32_t>(decoded.size()));
+  DecodeStatus status = DecodeStatus::Pending;
+  for (uint8_t b : frame) status = decoder.Put(b);
+  EXPECT_EQ(status, DecodeStatus::Overflow);
+
+  Bytes short_message(10, 0x42);
+  for (uint8_t b : Encode(short_message)) status = decoder.Put(b);
+  EXPECT_EQ(status, DecodeStatus::Ok);
+}
+
+// Receives frames the way the controller does: the DMA writes bytes into the
+// buffer, and character match on the delimiter calls on_character_match(),
+// which decodes the frame where it is.
+class InPlaceReceiver : public RxListener {
+ public:
+  void Receive(uint8_t byte) {
+    ASSERT_LT(received_, sizeof(buf_));
+    buf_[received_++] = byte;
+    if (byte == Delimiter) on_character_match();
+  }
+
+  void on_rx_complete() override {}
+  void on_character_match() override {
+    uint32_t length = 0;
+    if (DecodeInPlace(buf_, received_, &length) == DecodeStatus::Ok) {
+      messages.emplace_back(buf_, buf_ + length);
+    } else {
+      errors++;
+    }
+    // Restart reception at the start of the buffer.
+    received_ = 0;
+  }
+  void on_rx_error(RxError) override {}
+
+  std::vector<Bytes> messages;
+  int errors{0};
+
+ private:
+  uint8_t buf_[1024];
+  uint32_t received_{0};
+};
+
+TEST(Framing, DecodesInPlaceOnCharacterMatch) {
+  std::mt19937 rng(3);
+  std::vector<Bytes> sent;
+  InPlaceReceiver receiver;
+  for (int i = 0; i < 200; ++i) {
+    sent.push_back(RandomMessage(rng));
+    for (uint8_t b : Encode(sent.back())) receiver.Receive(b);
+  }
+  EXPECT_EQ(receiver.errors, 0);
+  EXPECT_EQ(receiver.messages, sent);
+}
+
+// Microbenchmarks: cost of framing a message, for a few message sizes.
+TEST(FramingBenchmark, PerFrameCost) {
+  constexpr uint32_t Iterations = 20'000;
+  std::mt19937 rng(4);
+  std::uniform_int_distribution<uint32_t> byte(0, 255);
+
+  for (uint32_t length : {16u, 128u, 512u}) {
+    Bytes message(length);
+    for (uint8_t &b : message) b = static_cast<uint8_t>(byte(rng));
+    Bytes frame(MaxEncodedSize(length));
+    Bytes work(frame.size());
+    Bytes decoded(length + Framing::CrcSize);
+    uint32_t frame_size = EncodeFrame(message.data(), length, frame.data(),
+                                      static_cast<uint32_t>(frame.size()));
+    ASSERT_GT(frame_size, 0u);
+    char name[64];
+
+    snprintf(name, sizeof(name), "soft_crc32 %u bytes", length);
+    Microbench::Report(name, Microbench::NanosPerCall(Iterations, [&] {
+                         Microbench::DoNotOptimize(soft_crc32(message.data(), length));
+                       }));
+
+    snprintf(name, sizeof(name), "EncodeFrame %u bytes", length);
+    Microbench::Report(name, Microbench::NanosPerCall(Iterations, [&] {
+                         Microbench::DoNotOptimize(
+                             EncodeFrame(message.data(), length, work.data(),
+                                         static_cast<uint32_t>(work.size())));
+                       }));
+
+    snprintf(name, sizeof(name), "DecodeInPlace %u bytes", length);
+    Microbench::Report(name, Microbench::NanosPerCall(Iterations, [&] {
+                         std::copy(frame.begin(), frame.begin() + frame_size, work.begin());
+                         uint32_t message_length;
+                         Microbench::DoNotOptimize(
+                             DecodeInPlace(work.data(), frame_size, &message_length));
+                       }));
+
+    snprintf(name, sizeof(name), "Decoder::Put %u bytes", length);
+    Decoder decoder(decoded.data(), static_cast<uint32_t>(decoded.size()));
+    Microbench::Report(name, Microbench::NanosPerCall(Iterations, [&] {
+                         for (uint32_t i = 0; i < frame_size; ++i) {
+                           Microbench::DoNotOptimize(decoder.Put(frame[i]));
+                         }
+                       }));
+  }
+}
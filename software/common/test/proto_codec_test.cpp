@@ -0,0 +1,291 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "proto_codec.h"
+
+#include <cstring>
+#include <limits>
+#include <random>
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "microbench.h"
+#include "network_protocol.pb.h"
+#include "pb_decode.h"
+#include "pb_encode.h"
+#include "proto_traits.h"
+
+using Bytes = std::vector<uint8_t>;
+
+// Random values of all magnitudes, so that varints of every length come up.
+class RandomValues {
+ public:
+  explicit RandomValues(uint32_t seed) : rng_(seed) {}
+
+  uint64_t U64() { return rng_() >> Below(64); }
+  uint32_t U32() { return static_cast<uint32_t>(U64()); }
+  int32_t I32() { return static_cast<int32_t>(U32()) >> Below(32); }
+  float Float() {
+    auto bits = static_cast<uint32_t>(rng_());
+    float f;
+    memcpy(&f, &bits, sizeof(f));
+    return f;
+  }
+  bool Bool() { return rng_() & 1; }
+  uint32_t Below(uint32_t n) { return static_cast<uint32_t>(rng_() % n); }
+
+ private:
+  std::mt19937_64 rng_;
+};
+
+static VentParams RandomParams(RandomValues &r) {
+  return {static_cast<VentMode>(r.Below(_VentMode_MAX + 1)),
+          r.U32(),
+          r.U32(),
+          r.U32(),
+          r.Float(),
+          r.U32(),
+          r.U32(),
+          r.Float()};
+}
+
+static ControllerStatus RandomStatus(RandomValues &r) {
+  ControllerStatus status = ControllerStatus_init_zero;
+  status.uptime_ms = r.U64();
+  status.has_active_params = r.Bool();
+  status.active_params = RandomParams(r);
+  status.sensor_readings = {r.Float(), r.Float(), r.Float(), r.Float(),
+                            r.Float(), r.U64(),   r.Float(), r.Float()};
+  status.pressure_setpoint_cm_h2o = r.Float();
+  status.fan_power = r.Float();
+  status.breath_summaries_count = static_cast<pb_size_t>(r.Below(4));
+  for (BreathSummary &summary : status.breath_summaries) {
+    summary = {r.U64(),   r.Float(), r.Float(), r.Float(),
+               r.Float(), r.U32(),   r.U32(),   r.Float(),
+               r.Float(), static_cast<BreathTrigger>(r.Below(_BreathTrigger_MAX + 1))};
+  }
+  status.has_samples = r.Bool();
+  SampleBatch &samples = status.samples;
+  samples.first_sample = r.U32();
+  samples.sample_period_us = r.U32();
+  auto fill = [&](pb_size_t *count, int32_t(&values)[6]) {
+    *count = static_cast<pb_size_t>(r.Below(7));
+    for (int32_t &v : values) v = r.I32();
+  };
+  fill(&samples.patient_pressure_cm_h2o_x100_count, samples.patient_pressure_cm_h2o_x100);
+  fill(&samples.flow_ml_per_min_count, samples.flow_ml_per_min);
+  fill(&samples.volume_ml_x10_count, samples.volume_ml_x10);
+  fill(&samples.pressure_setpoint_cm_h2o_x100_count, samples.pressure_setpoint_cm_h2o_x100);
+  fill(&samples.fio2_x1000_count, samples.fio2_x1000);
+  status.has_baud_rate = r.Bool();
+  status.baud_rate = r.U32();
+  status.has_capabilities = r.Bool();
+  status.capabilities = {r.U32(), r.U32(), r.U32()};
+  return status;
+}
+
+template <typename T>
+static bool NanopbEncode(const T &msg, Bytes *out) {
+  out->resize(ProtoTraits<T>::MaxSize);
+  pb_ostream_t stream = pb_ostream_from_buffer(out->data(), out->size());
+  if (!pb_encode(&stream, ProtoTraits<T>::MsgDesc, &msg)) return false;
+  out->resize(stream.bytes_written);
+  return true;
+}
+
+template <typename T>
+static bool CodecEncode(const T &msg, Bytes *out) {
+  uint8_t buf[ProtoTraits<T>::MaxSize];
+  size_t size;
+  if (!ProtoCodec::Encode(msg, buf, &size)) return false;
+  out->assign(buf, buf + size);
+  return true;
+}
+
+TEST(ProtoCodec, EncodesLikeNanopb) {
+  RandomValues r(0);
+  for (int i = 0; i < 5000; ++i) {
+    ControllerStatus status = RandomStatus(r);
+    Bytes expected, actual;
+    ASSERT_TRUE(NanopbEncode(status, &expected));
+    ASSERT_TRUE(CodecEncode(status, &actual));
+    ASSERT_EQ(actual, expected);
+
+    GuiStatus gui_status = {
+        r.U64(), RandomParams(r), r.Bool(), r.U32(), r.Bool(), {r.U32(), r.U32(), r.U32()}};
+    ASSERT_TRUE(NanopbEncode(gui_status, &expected));
+    ASSERT_TRUE(CodecEncode(gui_status, &actual));
+    ASSERT_EQ(actual, expected);
+  }
+}
+
+TEST(ProtoCodec, LargestStatusFitsMaxSize) {
+  ControllerStatus status = ControllerStatus_init_zero;
+  status.uptime_ms = std::numeric_limits<uint64_t>::max();
+  status.has_active_params = true;
+  status.active_params = {_VentMode_MAX, UINT32_MAX, UINT32_MAX, UINT32_MAX,
+                          0,             UINT32_MAX, UINT32_MAX, 0};
+  status.sensor_readings.breath_id = std::numeric_limits<uint64_t>::max();
+  status.breath_summaries_count = 3;
+  for (BreathSummary &summary : status.breath_summaries) {
+    summary.breath_id = std::numeric_limits<uint64_t>::max();
+    summary.inspiratory_time_ms = summary.expiratory_time_ms = UINT32_MAX;
+    summary.trigger = _BreathTrigger_MAX;
+  }
+  status.has_samples = true;
+  SampleBatch &samples = status.samples;
+  samples.first_sample = samples.sample_period_us = UINT32_MAX;
+  samples.patient_pressure_cm_h2o_x100_count = samples.flow_ml_per_min_count =
+      samples.volume_ml_x10_count = samples.pressure_setpoint_cm_h2o_x100_count =
+          samples.fio2_x1000_count = 6;
+  for (int32_t *values : {samples.patient_pressure_cm_h2o_x100, samples.flow_ml_per_min,
+                          samples.volume_ml_x10, samples.pressure_setpoint_cm_h2o_x100,
+                          samples.fio2_x1000}) {
+    std::fill(values, values + 6, std::numeric_limits<int32_t>::min());
+  }
+  status.has_baud_rate = true;
+  status.baud_rate = UINT32_MAX;
+  status.has_capabilities = true;
+  status.capabilities = {UINT32_MAX, UINT32_MAX, UINT32_MAX};
+
+  Bytes expected, actual;
+  ASSERT_TRUE(NanopbEncode(status, &expected));
+  ASSERT_TRUE(CodecEncode(status, &actual));
+  EXPECT_EQ(actual, expected);
+  EXPECT_EQ(actual.size(), size_t{ControllerStatus_size});
+}
+
+TEST(ProtoCodec, RejectsTooManyElements) {
+  RandomValues r(1);
+  ControllerStatus status = RandomStatus(r);
+  status.has_samples = true;
+  status.samples.fio2_x1000_count = 7;
+  Bytes out;
+  EXPECT_FALSE(NanopbEncode(status, &out));
+  EXPECT_FALSE(CodecEncode(status, &out));
+
+  status = RandomStatus(r);
+  status.breath_summaries_count = 4;
+  EXPECT_FALSE(NanopbEncode(status, &out));
+  EXPECT_FALSE(CodecEncode(status, &out));
+}
+
+// Decoding must leave the message exactly as pb_decode() does, down to
+// repeated field elements past their count, which neither of them touches.
+TEST(ProtoCodec, DecodesLikeNanopb) {
+  RandomValues r(2);
+  for (int i = 0; i < 5000; ++i) {
+    Bytes encoded;
+    ASSERT_TRUE(NanopbEncode(RandomStatus(r), &encoded));
+
+    ControllerStatus expected, actual;
+    memset(&expected, 0xA5, sizeof(expected));
+    memset(&actual, 0xA5, sizeof(actual));
+    pb_istream_t stream = pb_istream_from_buffer(encoded.data(), encoded.size());
+    ASSERT_TRUE(pb_decode(&stream, ControllerStatus_fields, &expected));
+    ASSERT_TRUE(ProtoCodec::DecodeFastPath(encoded.data(), encoded.size(), &actual));
+    ASSERT_EQ(memcmp(&actual, &expected, sizeof(actual)), 0);
+  }
+}
+
+// Anything else goes to nanopb; results are compared by encoding them again.
+TEST(ProtoCodec, FallsBackToNanopb) {
+  RandomValues r(3);
+  auto check = [](const Bytes &encoded) {
+    ControllerStatus expected = ControllerStatus_init_zero;
+    ControllerStatus actual = ControllerStatus_init_zero;
+    pb_istream_t stream = pb_istream_from_buffer(encoded.data(), encoded.size());
+    bool ok = pb_decode(&stream, ControllerStatus_fields, &expected);
+    ASSERT_EQ(ProtoCodec::Decode(encoded.data(), encoded.size(), &actual), ok);
+    if (ok) {
+      Bytes expected_bytes, actual_bytes;
+      ASSERT_TRUE(NanopbEncode(expected, &expected_bytes));
+      ASSERT_TRUE(NanopbEncode(actual, &actual_bytes));
+      EXPECT_EQ(actual_bytes, expected_bytes);
+    }
+  };
+
+  for (int i = 0; i < 2000; ++i) {
+    ControllerStatus status = RandomStatus(r);
+    status.has_baud_rate = true;
+    status.has_capabilities = false;
+    Bytes encoded;
+    ASSERT_TRUE(NanopbEncode(status, &encoded));
+
+    // Baud rate (tag 9, last) moved to the front: valid, but out of order.
+    Bytes baud_rate(encoded.end() - 1 - ProtoCodec::VarintSize(status.baud_rate), encoded.end());
+    Bytes reordered = baud_rate;
+    reordered.insert(reordered.end(), encoded.begin(), encoded.end() - baud_rate.size());
+    ControllerStatus dummy;
+    EXPECT_FALSE(ProtoCodec::DecodeFastPath(reordered.data(), reordered.size(), &dummy));
+    check(reordered);
+
+    // An unknown field at the end.
+    Bytes unknown = encoded;
+    unknown.insert(unknown.end(), {ProtoCodec::Key(15, ProtoCodec::WireType::Varint), 42});
+    EXPECT_FALSE(ProtoCodec::DecodeFastPath(unknown.data(), unknown.size(), &dummy));
+    check(unknown);
+
+    // Random corruption, and truncation.
+    Bytes corrupt = encoded;
+    corrupt[r.Below(static_cast<uint32_t>(corrupt.size()))] = static_cast<uint8_t>(r.U32());
+    check(corrupt);
+    check(Bytes(encoded.begin(), encoded.begin() + r.Below(static_cast<uint32_t>(encoded.size()))));
+  }
+}
+
+// Microbenchmarks: cost of a typical ControllerStatus, on each end.
+TEST(ProtoCodecBenchmark, PerMessageCost) {
+  constexpr uint32_t Iterations = 20'000;
+  ControllerStatus status = ControllerStatus_init_zero;
+  status.uptime_ms = 123'456'789;
+  status.sensor_readings = {12.3f, 456.f, 7890.f, 1.2f, 0.8f, 4321, 12.f, 0.21f};
+  status.pressure_setpoint_cm_h2o = 15;
+  status.fan_power = 0.4f;
+  status.breath_summaries_count = 1;
+  status.breath_summaries[0] = {4321, 25.f, 5.f, 480.f, 470.f, 1000, 2000, 7200.f, 150.f,
+                                BreathTrigger_MACHINE};
+  status.has_samples = true;
+  status.samples.first_sample = 987'654;
+  status.samples.sample_period_us = 10'000;
+  status.samples.patient_pressure_cm_h2o_x100_count = 3;
+  status.samples.flow_ml_per_min_count = 3;
+  status.samples.volume_ml_x10_count = 3;
+  status.samples.pressure_setpoint_cm_h2o_x100_count = 3;
+  status.samples.fio2_x1000_count = 3;
+
+  uint8_t buf[ControllerStatus_size];
+  size_t size = 0;
+  Microbench::Report("pb_encode ControllerStatus", Microbench::NanosPerCall(Iterations, [&] {
+                       pb_ostream_t stream = pb_ostream_from_buffer(buf, sizeof(buf));
+                       Microbench::DoNotOptimize(
+                           pb_encode(&stream, ControllerStatus_fields, &status));
+                     }));
+  Microbench::Report("ProtoCodec::Encode ControllerStatus",
+                     Microbench::NanosPerCall(Iterations, [&] {
+                       Microbench::DoNotOptimize(ProtoCodec::Encode(status, buf, &size));
+                     }));
+
+  ControllerStatus decoded;
+  Microbench::Report("pb_decode ControllerStatus", Microbench::NanosPerCall(Iterations, [&] {
+                       pb_istream_t stream = pb_istream_from_buffer(buf, size);
+                       Microbench::DoNotOptimize(
+                           pb_decode(&stream, ControllerStatus_fields, &decoded));
+                     }));
+  Microbench::Report("ProtoCodec::Decode ControllerStatus",
+                     Microbench::NanosPerCall(Iterations, [&] {
+                       Microbench::DoNotOptimize(ProtoCodec::Decode(buf, size, &decoded));
+                     }));
+}
@@ -15,6 +15,9 @@ limitations under the License.
 
 #include "units.h"
 
+#include <algorithm>
+#include <cmath>
+#include <functional>
 #include <type_traits>
 
 #include "gtest/gtest.h"
@@ -48,7 +51,7 @@ template <typename T, typename NumTy>
 void checkArithmeticOperators(T (*unit)(NumTy), NumTy (T::*get)() const) {
   // x / y is defined only for Ts backed by floats (in practice, everything
   // other than Duration).
-  constexpr bool is_fp_based = std::is_base_of_v<UnitsDetail::ArithScalar<T, float>, T>;
+  constexpr bool is_fp_based = std::is_floating_point_v<typename T::Representation>;
 
   // Make t const to check that these operators work with const operands.
   const T t = unit(2.1f);
@@ -238,3 +241,81 @@ TEST(Units, Time) {
 
   checkRelationalOperators(microsSinceStartup);
 }
+
+// Detects whether q.ml() compiles, i.e. whether Q has the dimension of a volume.
+template <class Q, class = void>
+struct HasMl : std::false_type {};
+template <class Q>
+struct HasMl<Q, std::void_t<decltype(std::declval<Q>().ml())>> : std::true_type {};
+
+TEST(Units, DimensionMismatchesDoNotCompile) {
+  // Quantities of different dimensions can't be added, subtracted, compared
+  // or assigned to each other.
+  static_assert(std::is_invocable_v<std::plus<>, Pressure, Pressure>);
+  static_assert(!std::is_invocable_v<std::plus<>, Pressure, Volume>);
+  static_assert(!std::is_invocable_v<std::minus<>, VolumetricFlow, Volume>);
+  static_assert(!std::is_invocable_v<std::plus<>, Duration, Length>);
+  static_assert(!std::is_invocable_v<std::less<>, Pressure, Voltage>);
+  static_assert(!std::is_invocable_v<std::equal_to<>, Volume, Length>);
+  static_assert(!std::is_assignable_v<Pressure &, Volume>);
+  static_assert(!std::is_constructible_v<VolumetricFlow, Volume>);
+
+  // Time only combines with Duration, in the ways listed in units.h.
+  static_assert(std::is_invocable_v<std::minus<>, Time, Time>);
+  static_assert(!std::is_invocable_v<std::plus<>, Time, Time>);
+  static_assert(!std::is_invocable_v<std::minus<>, Duration, Time>);
+  static_assert(!std::is_invocable_v<std::plus<>, Time, Pressure>);
+
+  // Integer-backed Durations can't be divided by a scalar, nor silently take
+  // a float-backed duration.
+  static_assert(std::is_invocable_v<std::divides<>, Duration, Duration>);
+  static_assert(!std::is_invocable_v<std::divides<>, Duration, int64_t>);
+  static_assert(!std::is_convertible_v<decltype(Volume() / VolumetricFlow()), Duration>);
+
+  // Products and quotients have the derived dimension, and only convert to
+  // the named type of that dimension.
+  using FlowTimesDuration = decltype(VolumetricFlow() * Duration());
+  static_assert(std::is_convertible_v<FlowTimesDuration, Volume>);
+  static_assert(!std::is_convertible_v<FlowTimesDuration, VolumetricFlow>);
+  static_assert(!std::is_convertible_v<FlowTimesDuration, Pressure>);
+  using VolumeOverDuration = decltype(Volume() / Duration());
+  static_assert(std::is_convertible_v<VolumeOverDuration, VolumetricFlow>);
+  static_assert(!std::is_convertible_v<VolumeOverDuration, Volume>);
+  static_assert(std::is_convertible_v<decltype(Duration() * VolumetricFlow()), Volume>);
+
+  // Accessors exist only for their own dimension.
+  static_assert(HasMl<Volume>::value);
+  static_assert(HasMl<FlowTimesDuration>::value);
+  static_assert(!HasMl<Pressure>::value);
+  static_assert(!HasMl<VolumetricFlow>::value);
+}
+
+// Conversions are constant factors, so they can be checked at compile time.
+constexpr bool Near(float a, float b, float tolerance) {
+  return a - b < tolerance && b - a < tolerance;
+}
+static_assert(Near(cmH2O(10.1972f).kPa(), 1.0f, 1e-5f));
+static_assert(Near(kPa(1).cmH2O(), 10.1972f, 1e-4f));
+static_assert(Near(ml_per_sec(1).ml_per_min(), 60.0f, 1e-4f));
+static_assert(Near(Volume(ml_per_sec(250) * milliseconds(int64_t{10})).ml(), 2.5f, 1e-6f));
+
+TEST(Units, ConversionRoundTrips) {
+  for (float v : {-123.4f, -1.0f, 0.0f, 0.001f, 1.0f, 42.0f, 5678.9f}) {
+    float tolerance = std::max(std::abs(v) * 1e-6f, 1e-9f);
+    EXPECT_NEAR(kPa(cmH2O(v).kPa()).cmH2O(), v, tolerance);
+    EXPECT_NEAR(cmH2O(atm(v).cmH2O()).atm(), v, tolerance);
+    EXPECT_NEAR(millimeters(meters(v).millimeters()).meters(), v, tolerance);
+    EXPECT_NEAR(ml_per_sec(ml_per_min(v).ml_per_sec()).ml_per_min(), v, tolerance);
+    EXPECT_NEAR(liters_per_sec(cubic_m_per_sec(v).liters_per_sec()).cubic_m_per_sec(), v,
+                tolerance);
+    EXPECT_NEAR(ml(cubic_m(v).ml()).cubic_m(), v, tolerance);
+  }
+
+  // Through products and quotients: 30 L/min for 2 s is 1 L, and back.
+  Volume volume = ml_per_min(30'000) * seconds(2);
+  EXPECT_FLOAT_EQ(volume.ml(), 1000);
+  VolumetricFlow flow = volume / seconds(2);
+  EXPECT_FLOAT_EQ(flow.ml_per_min(), 30'000);
+  EXPECT_FLOAT_EQ((volume / flow).seconds(), 2);
+  EXPECT_FLOAT_EQ((flow * milliseconds(int64_t{10})).ml(), 5);
+}
@@ -0,0 +1,54 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+
+// Minimal timing helpers for microbenchmarks that run as part of the native
+// unit tests.  Results are printed, never asserted on: native test builds are
+// unoptimized and instrumented for coverage, so the numbers are only
+// meaningful relative to each other, on the same machine.
+namespace Microbench {
+
+// Keeps the compiler from discarding a computation whose result is unused.
+template <typename T>
+inline void DoNotOptimize(const T &value) {
+  asm volatile("" : : "r,m"(value) : "memory");
+}
+
+// Calls fn() `iterations` times and returns the mean time per call, in
+// nanoseconds.
+template <typename Fn>
+double NanosPerCall(uint32_t iterations, Fn fn) {
+  auto start = std::chrono::steady_clock::now();
+  for (uint32_t i = 0; i < iterations; ++i) {
+    fn();
+  }
+  auto end = std::chrono::steady_clock::now();
+  return static_cast<double>(
+             std::chrono::duration_cast<std::chrono::nanoseconds>(end - start).count()) /
+         iterations;
+}
+
+// Prints one result line.  The fixed "[ BENCHMARK ]" prefix and layout make
+// it easy to grep the results out of the test log.
+inline void Report(const char *name, double nanos_per_call) {
+  printf("[ BENCHMARK ] %-40s %10.2f ns/call\n", name, nanos_per_call);
+}
+
+}  // namespace Microbench
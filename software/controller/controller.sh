@@ -80,6 +80,7 @@ The following options are available:
   unit      Builds and runs unit tests only (and generates coverage reports)
                 <name>  - run specific unit test, may include wildcards, i.e. 'debug*'
                 [-o]    - open coverage report in browser when done
+  ram       Builds firmware and reports static RAM use per module, from the linker map
   cov_upload   Upload coverage reports to Codecov server
   help/-h   Display this help info
 EOF
@@ -309,6 +310,15 @@ elif [ "$1" == "test" ]; then
 
   exit $EXIT_SUCCESS
 
+#######
+# RAM #
+#######
+elif [ "$1" == "ram" ]; then
+  pio run -e stm32
+  platformio/build_config/ram_report.py platformio/build_config/stm32.map
+
+  exit $EXIT_SUCCESS
+
 ###################
 # UPLOAD COVERAGE #
 ###################
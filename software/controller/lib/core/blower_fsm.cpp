@@ -119,7 +119,9 @@ PressureAssistFsm::PressureAssistFsm(Time now, const VentParams &params)
       expire_pressure_(cmH2O(static_cast<float>(params.peep_cm_h2o))),
       start_time_(now),
       inspire_end_(start_time_ + InspireDuration(params)),
-      expire_deadline_(inspire_end_ + ExpireDuration(params)) {
+      expire_deadline_(inspire_end_ + ExpireDuration(params)),
+      fast_flow_avg_(dbg_fast_flow_avg_alpha.get()),
+      slow_flow_avg_(dbg_slow_flow_avg_alpha.get()) {
   dbg_slow_flow_avg.set(0.f);
   dbg_fast_flow_avg.set(0.f);
 }
@@ -139,12 +141,15 @@ BlowerSystemState PressureAssistFsm::DesiredState(Time now, const BlowerFsmInput
         .is_end_of_breath = false,
     };
   } else {  // expiratory part of the cycle
+    bool timed_out = now >= expire_deadline_;
+    bool patient_inspiring = !timed_out && PatientInspiring(now, inputs);
     return {
         .pressure_setpoint = expire_pressure_,
         .flow_direction = FlowDirection::Expiratory,
         .pip = inspire_pressure_,
         .peep = expire_pressure_,
-        .is_end_of_breath = (now >= expire_deadline_ || PatientInspiring(now, inputs)),
+        .is_end_of_breath = timed_out || patient_inspiring,
+        .patient_triggered = patient_inspiring,
     };
   }
 }
@@ -165,20 +170,18 @@ bool PressureAssistFsm::PatientInspiring(Time now, const BlowerFsmInputs &inputs
   //
   // If the fast average exceeds the slow average by a threshold, we trigger a
   // breath.
-  float slow_alpha = dbg_slow_flow_avg_alpha.get();
-  float fast_alpha = dbg_fast_flow_avg_alpha.get();
-
-  // TODO: This could be encapsulated in an exponentially-weighted-average
-  // class.
-  slow_flow_avg_ =
-      slow_alpha * inputs.net_flow + (1 - slow_alpha) * slow_flow_avg_.value_or(inputs.net_flow);
-  dbg_slow_flow_avg.set(slow_flow_avg_->ml_per_sec());
-  fast_flow_avg_ =
-      fast_alpha * inputs.net_flow + (1 - fast_alpha) * fast_flow_avg_.value_or(inputs.net_flow);
-  dbg_fast_flow_avg.set(fast_flow_avg_->ml_per_sec());
+  //
+  // The alpha terms are debug variables, so pick up any change before updating.
+  slow_flow_avg_.set_alpha(dbg_slow_flow_avg_alpha.get());
+  fast_flow_avg_.set_alpha(dbg_fast_flow_avg_alpha.get());
+
+  VolumetricFlow slow_avg = slow_flow_avg_.update(inputs.net_flow);
+  dbg_slow_flow_avg.set(slow_avg.ml_per_sec());
+  VolumetricFlow fast_avg = fast_flow_avg_.update(inputs.net_flow);
+  dbg_fast_flow_avg.set(fast_avg.ml_per_sec());
 
   return now >= inspire_end_ + milliseconds(dbg_pa_min_expire_ms.get()) &&
-         *fast_flow_avg_ > *slow_flow_avg_ + ml_per_sec(dbg_pa_flow_trigger.get());
+         fast_avg > slow_avg + ml_per_sec(dbg_pa_flow_trigger.get());
 }
 
 BlowerSystemState BlowerFsm::DesiredState(Time now, const VentParams &params,
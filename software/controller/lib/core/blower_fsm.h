@@ -18,6 +18,7 @@ limitations under the License.
 #include <optional>
 #include <variant>
 
+#include "ewma.h"
 #include "network_protocol.pb.h"
 #include "units.h"
 
@@ -85,6 +86,11 @@ struct BlowerSystemState {
 
   // Is this the last BlowerSystemState returned at the end of the breath cycle?
   bool is_end_of_breath = false;
+
+  // Only meaningful when is_end_of_breath is true: is the breath ending early
+  // because the patient started to inhale?  If so, the next breath is
+  // patient-triggered; otherwise it's started by the ventilator's timer.
+  bool patient_triggered = false;
 };
 
 // Transition from PEEP to PIP pressure over this length of time.  Citation:
@@ -173,8 +179,8 @@ class PressureAssistFsm {
   //
   // More discussion of this algorithm:
   // https://respiraworks.slack.com/archives/C011CJQV4Q7/p1592417313120400
-  std::optional<VolumetricFlow> fast_flow_avg_;
-  std::optional<VolumetricFlow> slow_flow_avg_;
+  DSP::Ewma<VolumetricFlow> fast_flow_avg_;
+  DSP::Ewma<VolumetricFlow> slow_flow_avg_;
 };
 
 class BlowerFsm {
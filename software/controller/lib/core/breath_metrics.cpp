@@ -0,0 +1,98 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "breath_metrics.h"
+
+#include <algorithm>
+#include <iterator>
+
+void BreathMetrics::StartBreath(Time start) {
+  breath_start_ = start;
+  expire_start_ = std::nullopt;
+  has_samples_ = false;
+  pip_ = kPa(0);
+  inspired_volume_ = ml(0);
+  expired_volume_ = ml(0);
+  uncorrected_volume_ = ml(0);
+}
+
+void BreathMetrics::AddSample(Time now, FlowDirection direction, Pressure patient_pressure,
+                              VolumetricFlow net_flow, VolumetricFlow uncorrected_net_flow) {
+  // Flow is integrated over the interval since the previous sample.  The very
+  // first sample only marks the start of the breath.
+  if (last_sample_time_ == std::nullopt) {
+    StartBreath(now);
+    last_sample_time_ = now;
+  }
+  Duration dt = now - *last_sample_time_;
+  if (direction == FlowDirection::Inspiratory) {
+    inspired_volume_ += net_flow * dt;
+  } else {
+    expired_volume_ -= net_flow * dt;
+    // Like the breath FSMs, consider that expiration starts with the first
+    // expiratory state.
+    if (expire_start_ == std::nullopt) {
+      expire_start_ = now;
+    }
+  }
+  uncorrected_volume_ += uncorrected_net_flow * dt;
+  last_sample_time_ = now;
+  pip_ = has_samples_ ? std::max(pip_, patient_pressure) : patient_pressure;
+  last_pressure_ = patient_pressure;
+  has_samples_ = true;
+}
+
+std::optional<BreathSummary> BreathMetrics::EndBreath(uint64_t breath_id, BreathTrigger trigger) {
+  if (!has_samples_) {
+    return std::nullopt;
+  }
+  Time end = *last_sample_time_;
+  Time expire_start = expire_start_.value_or(end);
+  Duration breath_duration = end - breath_start_;
+
+  BreathSummary summary = BreathSummary_init_zero;
+  summary.breath_id = breath_id;
+  summary.pip_cm_h2o = pip_.cmH2O();
+  // PEEP is by definition the pressure at the end of expiration.
+  summary.peep_cm_h2o = last_pressure_.cmH2O();
+  summary.inspired_tidal_volume_ml = inspired_volume_.ml();
+  summary.expired_tidal_volume_ml = expired_volume_.ml();
+  summary.inspiratory_time_ms =
+      static_cast<uint32_t>((expire_start - breath_start_).microseconds() / 1000);
+  summary.expiratory_time_ms = static_cast<uint32_t>((end - expire_start).microseconds() / 1000);
+  if (breath_duration > microseconds(0)) {
+    summary.minute_volume_ml_per_min =
+        expired_volume_.ml() * (minutes(1.0f) / breath_duration);
+    summary.leak_ml_per_min = (uncorrected_volume_ / breath_duration).ml_per_min();
+  }
+  summary.trigger = trigger;
+
+  StartBreath(end);
+  return summary;
+}
+
+void BreathMetrics::Reset() {
+  last_sample_time_ = std::nullopt;
+  StartBreath(microsSinceStartup(0));
+}
+
+void AppendBreathSummary(const BreathSummary &summary, ControllerStatus *status) {
+  if (status->breath_summaries_count == std::size(status->breath_summaries)) {
+    std::copy(std::begin(status->breath_summaries) + 1, std::end(status->breath_summaries),
+              std::begin(status->breath_summaries));
+    status->breath_summaries_count--;
+  }
+  status->breath_summaries[status->breath_summaries_count++] = summary;
+}
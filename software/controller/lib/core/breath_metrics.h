@@ -0,0 +1,66 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <optional>
+
+#include "blower_fsm.h"
+#include "network_protocol.pb.h"
+#include "units.h"
+
+// Computes the statistics in a BreathSummary proto for one breath at a time,
+// from the samples the controller works with on every loop cycle.
+//
+// The GUI used to derive these from ControllerStatus messages, which it only
+// receives every few tens of milliseconds and which may be dropped, so it
+// could miss the actual pressure peak or a breath boundary.
+class BreathMetrics {
+ public:
+  // Records one control loop cycle of the current breath.  `net_flow` is the
+  // corrected flow (see FlowIntegrator), `uncorrected_net_flow` the measured
+  // one.
+  void AddSample(Time now, FlowDirection direction, Pressure patient_pressure,
+                 VolumetricFlow net_flow, VolumetricFlow uncorrected_net_flow);
+
+  // Ends the current breath as of the last sample added, and returns its
+  // summary.  The next breath starts where this one ended.
+  //
+  // Returns nullopt if there was no sample since the previous breath ended.
+  std::optional<BreathSummary> EndBreath(uint64_t breath_id, BreathTrigger trigger);
+
+  // Drops the breath in progress, e.g. because the ventilator was turned off.
+  // The next sample starts a new breath.
+  void Reset();
+
+ private:
+  void StartBreath(Time start);
+
+  std::optional<Time> last_sample_time_;
+  // Start of the current breath, and start of its expiratory phase.
+  Time breath_start_ = microsSinceStartup(0);
+  std::optional<Time> expire_start_;
+  bool has_samples_ = false;
+
+  Pressure pip_ = kPa(0);
+  Pressure last_pressure_ = kPa(0);
+  Volume inspired_volume_ = ml(0);
+  Volume expired_volume_ = ml(0);
+  Volume uncorrected_volume_ = ml(0);
+};
+
+// Appends `summary` to the summaries sent in `status`, dropping the oldest one
+// if they don't all fit.
+void AppendBreathSummary(const BreathSummary &summary, ControllerStatus *status);
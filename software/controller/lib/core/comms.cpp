@@ -2,102 +2,285 @@
 
 #include <pb_common.h>
 #include <pb_decode.h>
-#include <pb_encode.h>
 
 #include <algorithm>
 #include <optional>
 
+#include "capabilities.h"
+#include "framing.h"
 #include "hal.h"
+#include "proto_codec.h"
+#include "vars.h"
 
-// Our outgoing (serialized) ControllerStatus proto is stored in tx_buffer.  We
-// then transmit it a few bytes at a time, as the serial port becomes
-// available.
-//
-// This isn't a circular buffer; the beginning of the proto is always at the
-// beginning of the buffer.
-static uint8_t tx_buffer[ControllerStatus_size];
-// Index of the next byte to transmit.
-static uint16_t tx_idx = 0;
-// Number of bytes remaining to transmit. tx_idx + tx_bytes_remaining equals
-// the size of the serialized ControllerStatus proto.
-static uint16_t tx_bytes_remaining = 0;
+// Our outgoing ControllerStatus proto is serialized into status_buffer, framed
+// into tx_buffer if the GUI supports framing, and sent from there by DMA.
+// Neither buffer may be touched while tx_in_progress is set.
+static uint8_t status_buffer[ControllerStatus_size];
+static uint8_t tx_buffer[Framing::MaxEncodedSize(ControllerStatus_size)];
+static volatile bool tx_in_progress = false;
+
+// Number of ControllerStatus transmissions the UART DMA gave up on.  A failed
+// send loses just that one status, and the next one goes out a few ms later.
+// If they keep failing, the GUI stops hearing from us and falls back to the
+// default baud rate, as we do when we stop hearing from it.  So we only count
+// them, for dbg_tx_errors.
+static volatile uint32_t tx_errors = 0;
+
+static Debug::Variable::UInt32 dbg_tx_errors("comms_tx_errors", Debug::Variable::Access::ReadOnly,
+                                             0, "", "Number of failed transmissions to the GUI");
+
+// Called from interrupt context when DMA is done with tx_buffer.
+class TxDoneListener : public TxListener {
+ public:
+  void on_tx_complete() override { tx_in_progress = false; }
+  void on_tx_error() override {
+    tx_errors = tx_errors + 1;
+    tx_in_progress = false;
+  }
+};
+static TxDoneListener tx_done_listener;
 
 // Time when we started sending the last ControllerStatus.
 static std::optional<Time> last_tx;
 
+// If the GUI has agreed to Feature_PARAMS_ON_CHANGE, active_params are only
+// sent when they change, and at least this often.  Otherwise they go out in
+// every ControllerStatus.
+static constexpr Duration ParamsRefreshInterval = seconds(1);
+static VentParams last_tx_params;
+static std::optional<Time> last_params_tx;
+
 // Our incoming (serialized) GuiStatus proto is incrementally buffered in
 // rx_buffer until it's complete and we can deserialize it to a proto.
 //
 // Like tx_buffer, this isn't a circular buffer; the beginning of the proto is
 // always at the beginning of the buffer.
-static uint8_t rx_buffer[GuiStatus_size];
+//
+// The GUI may send it framed (see Feature_FRAMING), so it also goes through
+// rx_decoder, which tells us as soon as a frame is complete.  A GUI that has
+// agreed to framing may still send a few raw messages before it knows that
+// we have too, so we take both.
+static uint8_t rx_buffer[Framing::MaxEncodedSize(GuiStatus_size)];
+static uint8_t rx_frame_buffer[GuiStatus_size + Framing::CrcSize];
+static Framing::Decoder rx_decoder(rx_frame_buffer, sizeof(rx_frame_buffer));
 static uint16_t rx_idx = 0;
 static Time last_rx = hal.Now();
 static bool rx_in_progress = false;
 
-// We currently lack proper message framing, so we use a timeout to determine
-// when the GUI is done sending us its message.
+// Unless the GUI frames its messages, we use a timeout to determine when it's
+// done sending us one.
 static constexpr Duration RxTimeout = milliseconds(1);
 
 // We send a ControllerStatus every TX_INTERVAL_MS.
 
 // In Alpha build we use synchronized communication initiated by GUI cycle
 // controller. Since both ControllerStatus and GuiStatus take roughly 300+
-// bytes, we need at least 1/115200.*10*300=26ms to transmit.
+// bytes, we need at least 1/115200.*10*300=26ms to transmit at the default
+// baud rate.  At 921600 baud, that's down to about 3ms.
 static constexpr Duration TxInterval = milliseconds(30);
 
+// Baud rates we're willing to switch the GUI link to, fastest first.  All of
+// them can be generated from our 80MHz UART clock with less than 0.5% error.
+static constexpr uint32_t SupportedBaudRates[] = {1'000'000, 921'600, 460'800, 230'400,
+                                                  SerialDefaultBaudRate};
+
+// If we don't receive a valid GuiStatus for this long after switching to a
+// faster baud rate, we assume that the GUI didn't follow, or that the link
+// can't cope, and go back to SerialDefaultBaudRate.
+static constexpr Duration BaudRateFallbackTimeout = seconds(1);
+
+// After falling back, we don't try that rate or anything faster for this
+// long.  The problem may have been temporary, or the GUI may have been
+// replaced, so we don't rule it out for good.
+static constexpr Duration BaudRateRetryInterval = seconds(30);
+
+static uint32_t baud_rate = SerialDefaultBaudRate;
+// Rate picked from what the GUI asked for in its last GuiStatus.
+static uint32_t requested_baud_rate = SerialDefaultBaudRate;
+// Rate announced in the ControllerStatus being sent; we switch to it once
+// that's done.
+static std::optional<uint32_t> announced_baud_rate;
+// Fastest rate we'll try until baud_limit_expiry.  Lowered each time we have
+// to fall back, so that a rate which doesn't work isn't retried over and over.
+static uint32_t baud_limit = SupportedBaudRates[0];
+static Time baud_limit_expiry = hal.Now();
+static Time last_valid_rx = hal.Now();
+
+// What the GUI and we both support, as of its last hello.  GUIs from before
+// the handshake don't send one, but may still ask for a faster baud rate in
+// GuiStatus.max_baud_rate, so we don't limit that here.
+static Capabilities link = LegacyCapabilities(SupportedBaudRates[0]);
+// Whether the next ControllerStatus should answer a hello.
+static bool answer_hello = false;
+
+// If we don't hear from the GUI for this long, it may have been restarted or
+// replaced by one that doesn't know about the handshake, so we stop using
+// what we agreed on until the next hello.
+static constexpr Duration LinkTimeout = seconds(1);
+
 void CommsInit() {}
 
 static bool IsTimeToProcessPacket() { return hal.Now() - last_rx > RxTimeout; }
 
-// NOTE this is work in progress.
-// Proper framing incomming. Afproto will be used to encode data to form that
-// can be safely sent over wire - with packet start/end markers and CRC
-
-// TODO add frame markers
-// TODO add marker escaping in contents
-// TODO add CRC to whole packet
-
-// TODO run this via DMA to free up resources for control loops
-static void ProcessTx(const ControllerStatus &controller_status) {
-  auto bytes_avail = hal.SerialBytesAvailableForWrite();
-  if (bytes_avail == 0) {
-    return;
-  }
-
-  // Serialize our current state into the buffer if
-  //  - we're not currently transmitting,
-  //  - we can transmit at least one byte now, and
-  //  - it's been a while since we last transmitted.
-  if (tx_bytes_remaining == 0 && (last_tx == std::nullopt || hal.Now() - *last_tx > TxInterval)) {
-    // Serialize current status into output buffer.
-    //
-    // TODO: Frame the message bytes.
-    // TODO: Add a checksum to the message.
-    pb_ostream_t stream = pb_ostream_from_buffer(tx_buffer, sizeof(tx_buffer));
-    if (!pb_encode(&stream, ControllerStatus_fields, &controller_status)) {
-      // TODO: Serialization failure; log an error or raise an alert.
-      return;
+static bool SameParams(const VentParams &a, const VentParams &b) {
+  return a.mode == b.mode && a.peep_cm_h2o == b.peep_cm_h2o &&
+         a.breaths_per_min == b.breaths_per_min && a.pip_cm_h2o == b.pip_cm_h2o &&
+         a.inspiratory_expiratory_ratio == b.inspiratory_expiratory_ratio &&
+         a.inspiratory_trigger_cm_h2o == b.inspiratory_trigger_cm_h2o &&
+         a.expiratory_trigger_ml_per_min == b.expiratory_trigger_ml_per_min && a.fio2 == b.fio2;
+}
+
+// Decides whether the next ControllerStatus needs to carry active_params.
+static bool ShouldSendParams(const ControllerStatus &controller_status) {
+  if (!controller_status.has_active_params) {
+    return false;
+  }
+  if (!HasFeature(link, Feature_PARAMS_ON_CHANGE)) {
+    return true;
+  }
+  return last_params_tx == std::nullopt ||
+         hal.Now() - *last_params_tx >= ParamsRefreshInterval ||
+         !SameParams(controller_status.active_params, last_tx_params);
+}
+
+// Fastest supported baud rate no faster than `limit`.
+static uint32_t PickBaudRate(uint32_t limit) {
+  if (hal.Now() < baud_limit_expiry) {
+    limit = std::min(limit, baud_limit);
+  }
+  for (uint32_t rate : SupportedBaudRates) {
+    if (rate <= limit) {
+      return rate;
+    }
+  }
+  return SerialDefaultBaudRate;
+}
+
+// Returns false if the UART is still sending, in which case nothing changes.
+static bool SetBaudRate(uint32_t rate) {
+  if (!hal.SerialSetBaudRate(rate)) {
+    return false;
+  }
+  baud_rate = rate;
+  // Whatever we were in the middle of receiving is garbage now.
+  rx_idx = 0;
+  rx_in_progress = false;
+  rx_decoder.Reset();
+  // Give the GUI a chance to talk to us at the new rate before giving up on
+  // it.
+  last_valid_rx = hal.Now();
+  return true;
+}
+
+// Switches baud rates, if we've told the GUI we would or if the current rate
+// isn't working.  Only call this when we aren't transmitting.
+//
+// Returns false while a switch has to wait for the UART to finish sending the
+// last message.  Nothing new may be sent until it's done, or it would go out
+// at the wrong rate.
+static bool UpdateBaudRate() {
+  if (announced_baud_rate != std::nullopt) {
+    if (!SetBaudRate(*announced_baud_rate)) {
+      return false;
+    }
+    announced_baud_rate = std::nullopt;
+  }
+  if (baud_rate != SerialDefaultBaudRate &&
+      hal.Now() - last_valid_rx > BaudRateFallbackTimeout) {
+    uint32_t failed_baud_rate = baud_rate;
+    if (!SetBaudRate(SerialDefaultBaudRate)) {
+      return false;
     }
-    tx_idx = 0;
-    tx_bytes_remaining = static_cast<uint16_t>(stream.bytes_written);
-    last_tx = hal.Now();
+    baud_limit = failed_baud_rate - 1;
+    baud_limit_expiry = hal.Now() + BaudRateRetryInterval;
+    requested_baud_rate = SerialDefaultBaudRate;
+  }
+  return true;
+}
+
+static Capabilities OurCapabilities() {
+  return {ProtocolVersion, AllFeatures, SupportedBaudRates[0]};
+}
+
+static void UpdateLink() {
+  if (hal.Now() - last_valid_rx > LinkTimeout) {
+    link = LegacyCapabilities(SupportedBaudRates[0]);
+  }
+}
+
+static bool ProcessTx(const ControllerStatus &controller_status) {
+  if (tx_in_progress || !UpdateBaudRate()) {
+    return false;
   }
 
   // TODO: Alarm if we haven't been able to send a status in a certain amount
   // of time.
+  if (last_tx != std::nullopt && hal.Now() - *last_tx <= TxInterval) {
+    return false;
+  }
 
-  // Send bytes over the wire if any are in our buffer.
-  if (tx_bytes_remaining > 0) {
-    // TODO(jlebar): Change SerialWrite to take a uint8* instead of a char*, so
-    // it matches nanopb.
-    uint16_t bytes_written = hal.SerialWrite(reinterpret_cast<char *>(tx_buffer) + tx_idx,
-                                             std::min(bytes_avail, tx_bytes_remaining));
-    // TODO: How paranoid should we be about this underflowing?  Perhaps we
-    // should reset the device if this or other invariants are violated?
-    tx_bytes_remaining = static_cast<uint16_t>(tx_bytes_remaining - bytes_written);
-    tx_idx = static_cast<uint16_t>(tx_idx + bytes_written);
+  // Serialize current status into output buffer, and hand it to DMA.
+  ControllerStatus status = controller_status;
+  status.has_active_params = ShouldSendParams(controller_status);
+  status.has_baud_rate = requested_baud_rate != baud_rate;
+  status.baud_rate = requested_baud_rate;
+  status.has_capabilities = answer_hello;
+  status.capabilities = OurCapabilities();
+  // Leave out what the GUI hasn't said it can use.
+  if (!HasFeature(link, Feature_BREATH_SUMMARIES)) {
+    status.breath_summaries_count = 0;
+  }
+  if (!HasFeature(link, Feature_BATCHED_TELEMETRY)) {
+    status.has_samples = false;
+  }
+  // Same bytes as pb_encode(), in a fraction of the time.
+  size_t size;
+  if (!ProtoCodec::Encode(status, status_buffer, &size)) {
+    // TODO: Serialization failure; log an error or raise an alert.
+    return false;
   }
+  const uint8_t *tx = status_buffer;
+  if (HasFeature(link, Feature_FRAMING)) {
+    // tx_buffer is large enough for any ControllerStatus.
+    size = Framing::EncodeFrame(status_buffer, static_cast<uint32_t>(size), tx_buffer,
+                                sizeof(tx_buffer));
+    tx = tx_buffer;
+  }
+  tx_in_progress = true;
+  if (!hal.SerialStartTx(tx, static_cast<uint16_t>(size), &tx_done_listener)) {
+    // Only possible if something else is using the DMA channel.
+    tx_in_progress = false;
+    return false;
+  }
+
+  last_tx = hal.Now();
+  if (status.has_active_params) {
+    last_tx_params = status.active_params;
+    last_params_tx = last_tx;
+  }
+  if (status.has_baud_rate) {
+    announced_baud_rate = status.baud_rate;
+  }
+  answer_hello = false;
+  return true;
+}
+
+// Takes in a GuiStatus, raw or from a frame.
+static bool HandleGuiStatus(const uint8_t *buf, size_t size, GuiStatus *gui_status) {
+  GuiStatus new_gui_status = GuiStatus_init_zero;
+  if (!ProtoCodec::Decode(buf, size, &new_gui_status)) {
+    return false;
+  }
+  *gui_status = new_gui_status;
+  last_valid_rx = hal.Now();
+  if (new_gui_status.has_capabilities) {
+    link = Negotiate(OurCapabilities(), new_gui_status.capabilities);
+    answer_hello = true;
+  }
+  uint32_t offered_baud_rate =
+      new_gui_status.has_max_baud_rate ? new_gui_status.max_baud_rate : SerialDefaultBaudRate;
+  requested_baud_rate = PickBaudRate(std::min(offered_baud_rate, link.max_baud_rate));
+  return true;
 }
 
 static void ProcessRx(GuiStatus *gui_status) {
@@ -106,31 +289,38 @@ static void ProcessRx(GuiStatus *gui_status) {
     char b;
     uint16_t bytes_read = hal.SerialRead(&b, 1);
     if (bytes_read == 1) {
+      last_rx = hal.Now();
+      if (rx_decoder.Put(static_cast<uint8_t>(b)) == Framing::DecodeStatus::Ok) {
+        // A frame is complete as soon as its delimiter comes in.
+        HandleGuiStatus(rx_decoder.message(), rx_decoder.message_length(), gui_status);
+        rx_idx = 0;
+        rx_in_progress = false;
+        continue;
+      }
       rx_buffer[rx_idx++] = (uint8_t)b;
       if (rx_idx >= sizeof(rx_buffer)) {
         rx_idx = 0;
         break;
       }
-      last_rx = hal.Now();
     }
   }
 
-  // TODO do away with timeout-based reception once we have framing in place,
-  // but it will work for Alpha build for now
+  // Raw GuiStatus, from a GUI that doesn't frame its messages (or not yet).
   if (rx_in_progress && IsTimeToProcessPacket()) {
-    pb_istream_t stream = pb_istream_from_buffer(rx_buffer, rx_idx);
-    GuiStatus new_gui_status = GuiStatus_init_zero;
-    if (pb_decode(&stream, GuiStatus_fields, &new_gui_status)) {
-      *gui_status = new_gui_status;
-    } else {
+    if (!HandleGuiStatus(rx_buffer, rx_idx, gui_status)) {
       // TODO: Log an error.
     }
+    // The decoder took these bytes for the start of a frame.
+    rx_decoder.Reset();
     rx_idx = 0;
     rx_in_progress = false;
   }
 }
 
-void CommsHandler(const ControllerStatus &controller_status, GuiStatus *gui_status) {
-  ProcessTx(controller_status);
+bool CommsHandler(const ControllerStatus &controller_status, GuiStatus *gui_status) {
+  UpdateLink();
+  dbg_tx_errors.set(tx_errors);
+  bool started_tx = ProcessTx(controller_status);
   ProcessRx(gui_status);
+  return started_tx;
 }
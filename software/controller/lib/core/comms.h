@@ -28,4 +28,7 @@ void CommsInit();
 // `controller_status` should be the controller's current status.  It's sent
 // periodically to the GUI.  When we receive a message from the GUI, we update
 // gui_status accordingly.
-void CommsHandler(const ControllerStatus &controller_status, GuiStatus *gui_status);
+//
+// Returns true if this call started sending `controller_status`, so that the
+// caller can tell which samples (see SampleBatch) have gone out.
+bool CommsHandler(const ControllerStatus &controller_status, GuiStatus *gui_status);
@@ -18,11 +18,36 @@ limitations under the License.
 #include <math.h>
 
 static constexpr Duration LoopPeriod = milliseconds(10);
+static constexpr Duration PressureLoopPeriod = milliseconds(1);
+static constexpr Duration Fio2LoopPeriod = milliseconds(100);
+
+SensorsProto AsSensorsProto(const SensorReadings &r, const ControllerState &c) {
+  SensorsProto proto = SensorsProto_init_zero;
+  proto.patient_pressure_cm_h2o = r.patient_pressure.cmH2O();
+  proto.inflow_pressure_diff_cm_h2o = 0;   // \TODO field unused and obsolete, should change proto
+  proto.outflow_pressure_diff_cm_h2o = 0;  // \TODO field unused and obsolete, should change proto
+  proto.flow_ml_per_min = c.net_flow.ml_per_min();
+  proto.volume_ml = c.patient_volume.ml();
+  proto.breath_id = c.breath_id;
+  proto.flow_correction_ml_per_min = c.flow_correction.ml_per_min();
+  proto.fio2 = r.fio2;
+  return proto;
+}
 
 /*static*/ Duration Controller::GetLoopPeriod() { return LoopPeriod; }
 
+/*static*/ Duration Controller::GetPressureLoopPeriod() { return PressureLoopPeriod; }
+
+/*static*/ Duration Controller::GetFio2LoopPeriod() { return Fio2LoopPeriod; }
+
 std::pair<ActuatorsState, ControllerState> Controller::Run(Time now, const VentParams &params,
                                                            const SensorReadings &sensor_readings) {
+  ControllerState controller_state = RunBreathFsm(now, params, sensor_readings);
+  return {RunPressureLoop(now, sensor_readings), controller_state};
+}
+
+ControllerState Controller::RunBreathFsm(Time now, const VentParams &params,
+                                         const SensorReadings &sensor_readings) {
   VolumetricFlow uncorrected_net_flow =
       sensor_readings.air_inflow
       // + sensor_readings.oxygen_inflow \todo add this once it is well tested
@@ -36,10 +61,23 @@ std::pair<ActuatorsState, ControllerState> Controller::Run(Time now, const VentP
   BlowerSystemState desired_state =
       fsm_.DesiredState(now, params, {.patient_volume = patient_volume, .net_flow = net_flow});
 
+  std::optional<BreathSummary> breath_summary;
+  if (desired_state.pressure_setpoint == std::nullopt) {
+    breath_metrics_.Reset();
+    breath_trigger_ = BreathTrigger_MACHINE;
+  } else {
+    breath_metrics_.AddSample(now, desired_state.flow_direction, sensor_readings.patient_pressure,
+                              net_flow, uncorrected_net_flow);
+  }
+
   if (desired_state.is_end_of_breath) {
     // The "correct" volume at the breath boundary is 0.
     flow_integrator_->NoteExpectedVolume(ml(0));
 
+    breath_summary = breath_metrics_.EndBreath(breath_id_, breath_trigger_);
+    breath_trigger_ =
+        desired_state.patient_triggered ? BreathTrigger_PATIENT : BreathTrigger_MACHINE;
+
     // Precision loss 64->32 bits ok: we only care about equality of these
     // values, not their absolute value, and the top 32 bits will change with
     // each new breath.
@@ -49,25 +87,14 @@ std::pair<ActuatorsState, ControllerState> Controller::Run(Time now, const VentP
   dbg_breath_id_.set(breath_id_);
   dbg_fio2_setpoint_.set(params.fio2);
 
-  ActuatorsState actuators_state;
+  pressure_setpoint_ = desired_state.pressure_setpoint;
+  // At the moment we don't support oxygen mixing -- we deliver either pure
+  // air or pure oxygen.  For any fio2 < 1, deliver air.
+  deliver_oxygen_ = params.fio2 >= 1;
+
   if (desired_state.pressure_setpoint == std::nullopt) {
-    // System disabled.  Disable blower, close inspiratory pinch valve, and
-    // open expiratory pinch valve.  This way if someone is hooked up, they can
-    // breathe through the expiratory branch, and they can't contaminate the
-    // inspiratory branch.
-    //
-    // If the pinch valves are not yet homed, this will home them and then move
-    // them to the desired positions.
-    blower_valve_pid_.reset();
-    psol_pid_.reset();
     fio2_pid_.reset();
-
-    actuators_state = {
-        .fio2_valve = 0,
-        .blower_power = 0,
-        .blower_valve = 0,
-        .exhale_valve = 1,
-    };
+    fio2_coupling_value_ = 0;
     ventilator_was_on_ = false;
   } else {
     if (!ventilator_was_on_) {
@@ -75,45 +102,6 @@ std::pair<ActuatorsState, ControllerState> Controller::Run(Time now, const VentP
       flow_integrator_.emplace();
       uncorrected_flow_integrator_.emplace();
     }
-
-    // At the moment we don't support oxygen mixing -- we deliver either pure
-    // air or pure oxygen.  For any fio2 < 1, deliver air.
-    if (params.fio2 < 1) {
-      // Delivering pure air.
-      psol_pid_.reset();
-
-      // Calculate blower valve command using calculated gains
-      float blower_valve = blower_valve_pid_.compute(now, sensor_readings.patient_pressure.kPa(),
-                                                     desired_state.pressure_setpoint->kPa());
-      float fio2_coupling_value = fio2_pid_.compute(now, sensor_readings.fio2, params.fio2);
-
-      actuators_state = {
-          .fio2_valve = blower_valve * fio2_coupling_value,
-          // In normal mode, blower is always full power; pid controls pressure
-          // by actuating the blower pinch valve.
-          .blower_power = 1,
-          .blower_valve = std::clamp(blower_valve + 0.05f, 0.0f, 1.0f),
-          // coupled control: exhale valve tracks inhale valve command
-          .exhale_valve = 1.0f - 0.55f * blower_valve - 0.4f,
-      };
-    } else {
-      // Delivering pure oxygen.
-      blower_valve_pid_.reset();
-
-      float psol_valve = psol_pid_.compute(now, sensor_readings.patient_pressure.kPa(),
-                                           desired_state.pressure_setpoint->kPa());
-      actuators_state = {
-          // Force psol to stay very slightly open to avoid the discontinuity
-          // caused by valve hysteresis at very low command.  The exhale valve
-          // compensates for this intentional leakage by staying open when the
-          // psol valve is closed.
-          .fio2_valve = std::clamp(psol_valve + 0.05f, 0.0f, 1.0f),
-          .blower_power = 0,
-          .blower_valve = 0,
-          .exhale_valve = 1.0f - 0.6f * psol_valve - 0.4f,
-      };
-    }
-
     // Start controlling pressure.
     ventilator_was_on_ = true;
   }
@@ -124,6 +112,8 @@ std::pair<ActuatorsState, ControllerState> Controller::Run(Time now, const VentP
       .net_flow = net_flow,
       .flow_correction = flow_integrator_->FlowCorrection(),
       .breath_id = breath_id_,
+      .breath_summary = breath_summary,
+      .ventilator_on = ventilator_was_on_,
   };
 
   dbg_pc_setpoint_.set(desired_state.pressure_setpoint.value_or(kPa(0)).cmH2O());
@@ -133,6 +123,62 @@ std::pair<ActuatorsState, ControllerState> Controller::Run(Time now, const VentP
   dbg_volume_uncorrected_.set(uncorrected_flow_integrator_->GetVolume().ml());
   dbg_flow_correction_.set(flow_integrator_->FlowCorrection().ml_per_sec());
 
+  return controller_state;
+}
+
+ActuatorsState Controller::RunPressureLoop(Time now, const SensorReadings &sensor_readings) {
+  ActuatorsState actuators_state;
+  if (pressure_setpoint_ == std::nullopt) {
+    // System disabled.  Disable blower, close inspiratory pinch valve, and
+    // open expiratory pinch valve.  This way if someone is hooked up, they can
+    // breathe through the expiratory branch, and they can't contaminate the
+    // inspiratory branch.
+    //
+    // If the pinch valves are not yet homed, this will home them and then move
+    // them to the desired positions.
+    blower_valve_pid_.reset();
+    psol_pid_.reset();
+
+    actuators_state = {
+        .fio2_valve = 0,
+        .blower_power = 0,
+        .blower_valve = 0,
+        .exhale_valve = 1,
+    };
+  } else if (!deliver_oxygen_) {
+    // Delivering pure air.
+    psol_pid_.reset();
+
+    // Calculate blower valve command using calculated gains
+    float blower_valve = blower_valve_pid_.compute(now, sensor_readings.patient_pressure.kPa(),
+                                                   pressure_setpoint_->kPa());
+    actuators_state = {
+        .fio2_valve = blower_valve * fio2_coupling_value_,
+        // In normal mode, blower is always full power; pid controls pressure
+        // by actuating the blower pinch valve.
+        .blower_power = 1,
+        .blower_valve = std::clamp(blower_valve + 0.05f, 0.0f, 1.0f),
+        // coupled control: exhale valve tracks inhale valve command
+        .exhale_valve = 1.0f - 0.55f * blower_valve - 0.4f,
+    };
+  } else {
+    // Delivering pure oxygen.
+    blower_valve_pid_.reset();
+
+    float psol_valve = psol_pid_.compute(now, sensor_readings.patient_pressure.kPa(),
+                                         pressure_setpoint_->kPa());
+    actuators_state = {
+        // Force psol to stay very slightly open to avoid the discontinuity
+        // caused by valve hysteresis at very low command.  The exhale valve
+        // compensates for this intentional leakage by staying open when the
+        // psol valve is closed.
+        .fio2_valve = std::clamp(psol_valve + 0.05f, 0.0f, 1.0f),
+        .blower_power = 0,
+        .blower_valve = 0,
+        .exhale_valve = 1.0f - 0.6f * psol_valve - 0.4f,
+    };
+  }
+
   // Handle DebugVars that force the actuators.
   auto set_force = [](const Debug::Variable::Float &var, auto &state) {
     float v = var.get();
@@ -145,5 +191,16 @@ std::pair<ActuatorsState, ControllerState> Controller::Run(Time now, const VentP
   set_force(forced_exhale_valve_pos_, actuators_state.exhale_valve);
   set_force(forced_psol_pos_, actuators_state.fio2_valve);
 
-  return {actuators_state, controller_state};
+  return actuators_state;
+}
+
+void Controller::RunFio2(Time now, const VentParams &params,
+                         const SensorReadings &sensor_readings) {
+  // The FiO2 loop only couples O2 into the air stream, see RunPressureLoop().
+  // When the ventilator is off (RunBreathFsm() then resets it) or delivering
+  // pure oxygen, there's nothing to control.
+  if (!ventilator_was_on_ || params.fio2 >= 1) {
+    return;
+  }
+  fio2_coupling_value_ = fio2_pid_.compute(now, sensor_readings.fio2, params.fio2);
 }
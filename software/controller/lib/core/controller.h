@@ -20,6 +20,7 @@ limitations under the License.
 
 #include "actuators.h"
 #include "blower_fsm.h"
+#include "breath_metrics.h"
 #include "flow_integrator.h"
 #include "network_protocol.pb.h"
 #include "pid.h"
@@ -49,23 +50,61 @@ struct ControllerState {
   // Identifies the current breath among all breaths handled since controller
   // startup.
   uint64_t breath_id{0};
+
+  // Summary of the breath that just ended, if a breath ended on this cycle.
+  std::optional<BreathSummary> breath_summary{std::nullopt};
+
+  // Whether the breath FSM is ventilating, rather than off.
+  bool ventilator_on{false};
 };
 
+// Packs sensor readings and controller state into the proto sent to the GUI.
+SensorsProto AsSensorsProto(const SensorReadings &r, const ControllerState &c);
+
 // This class is here to allow integration of our controller into Modelica
 // software and run closed-loop tests in a simulated physical environment
 class Controller {
  public:
   Controller() = default;
 
+  // Period of the breath FSM, which also integrates flow into volume.
   static Duration GetLoopPeriod();
 
+  // Period of the pressure loop, which runs faster than the breath FSM so that
+  // it reacts quickly to pressure changes.  GetLoopPeriod() is a multiple of it.
+  static Duration GetPressureLoopPeriod();
+
+  // Period of the FiO2 loop, which runs slower than the pressure loop: oxygen
+  // concentration changes on a time scale of seconds, and the oxygen sensor
+  // responds even more slowly than that.  A multiple of GetLoopPeriod().
+  static Duration GetFio2LoopPeriod();
+
+  // Runs the breath FSM and then the pressure loop, for callers that run both
+  // at the same rate, e.g. simulations.
   std::pair<ActuatorsState, ControllerState> Run(Time now, const VentParams &params,
                                                  const SensorReadings &sensor_readings);
 
+  // Runs the breath FSM, which decides the pressure setpoint that the pressure
+  // loop follows until the next run.  Call every GetLoopPeriod().
+  ControllerState RunBreathFsm(Time now, const VentParams &params,
+                               const SensorReadings &sensor_readings);
+
+  // Runs the pressure loop towards the setpoint given by the last run of the
+  // breath FSM.  Call every GetPressureLoopPeriod().
+  ActuatorsState RunPressureLoop(Time now, const SensorReadings &sensor_readings);
+
+  // Runs the FiO2 loop, which scales the O2 valve command computed by the
+  // pressure loop when delivering air.  Call every GetFio2LoopPeriod().
+  void RunFio2(Time now, const VentParams &params, const SensorReadings &sensor_readings);
+
  private:
   uint32_t breath_id_{0};
   BlowerFsm fsm_;
 
+  BreathMetrics breath_metrics_;
+  // How the breath in progress was started.
+  BreathTrigger breath_trigger_{BreathTrigger_MACHINE};
+
   // TODO: These params need to be tuned.
   PID blower_valve_pid_{"blower_valve_",
                         " for blower valve PID",
@@ -97,6 +136,15 @@ class Controller {
                 /*output_min=*/0.f,
                 /*output_max=*/1.0f};
 
+  // Latest output of fio2_pid_, held between runs of the FiO2 loop.
+  float fio2_coupling_value_{0};
+
+  // What the breath FSM last asked of the pressure loop: the pressure to
+  // achieve (nullopt when the ventilator is off), and whether to deliver pure
+  // oxygen rather than air.
+  std::optional<Pressure> pressure_setpoint_{std::nullopt};
+  bool deliver_oxygen_{false};
+
   // These objects accumulate flow to calculate volume.
   //
   // For debugging, we accumulate flow with and without error correction.  See
@@ -107,8 +155,8 @@ class Controller {
   std::optional<FlowIntegrator> flow_integrator_ = FlowIntegrator();
   std::optional<FlowIntegrator> uncorrected_flow_integrator_ = FlowIntegrator();
 
-  // This state tells the controller whether the vent was already On when Run()
-  // was last called, and allows resetting integrators when transitioning from
+  // This state tells the controller whether the vent was already On when
+  // RunBreathFsm() was last called, and allows resetting integrators when transitioning from
   // Off state to On state.
   bool ventilator_was_on_{false};
 
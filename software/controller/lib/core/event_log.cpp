@@ -0,0 +1,124 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "event_log.h"
+
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+#include "vars.h"
+
+static Debug::Variable::UInt32 dbg_log_dropped("event_log_dropped",
+                                               Debug::Variable::Access::ReadOnly, 0, "",
+                                               "Number of records the event log had to drop");
+
+// "LOGB" and "LOGH"
+static constexpr uint32_t BreathLogMagic{0x42474F4C};
+static constexpr uint32_t HistoryLogMagic{0x48474F4C};
+
+// Allow for the breath boundary falling between two loop cycles.
+static constexpr Duration BreathTimeTolerance{milliseconds(50)};
+
+static constexpr Duration Minute{seconds(60)};
+
+// Rounds value / resolution to the nearest integer that fits in T.
+template <typename T>
+static T Quantize(float value, float resolution) {
+  float q = std::round(value / resolution);
+  return static_cast<T>(std::clamp(q, 0.f, static_cast<float>(std::numeric_limits<T>::max())));
+}
+
+static uint32_t UptimeMs(Time now) {
+  return static_cast<uint32_t>(now.microsSinceStartup() / 1000);
+}
+
+EventLog::EventLog(uint32_t address, size_t size)
+    : breath_log_(BreathLogMagic, address, size - HistoryPages * FlashPageSize),
+      history_log_(HistoryLogMagic,
+                   address + static_cast<uint32_t>(size - HistoryPages * FlashPageSize),
+                   HistoryPages * FlashPageSize) {}
+
+void EventLog::Init(Time now) {
+  breath_log_.Init();
+  history_log_.Init();
+  last_breath_end_ = std::nullopt;
+  AddEvent(now, Event::Reset, static_cast<uint16_t>(hal.ResetFlags() >> 24));
+}
+
+void EventLog::AddBreath(Time now, const BreathSummary &summary) {
+  uint32_t duration_ms = summary.inspiratory_time_ms + summary.expiratory_time_ms;
+
+  bool timed = last_breath_end_ && breaths_since_time_ < BreathsPerTimeRecord &&
+               now - *last_breath_end_ <=
+                   milliseconds(static_cast<int64_t>(duration_ms)) + BreathTimeTolerance;
+  if (!timed) {
+    TimeRecord time{.uptime_ms = UptimeMs(now)};
+    breaths_since_time_ = 0;
+    last_breath_end_ = std::nullopt;
+    if (!breath_log_.Append(Encode(time))) return;
+  }
+
+  BreathRecord breath{
+      .trigger = static_cast<uint8_t>(summary.trigger),
+      .pip = Quantize<uint8_t>(summary.pip_cm_h2o, 0.5f),
+      .peep = Quantize<uint8_t>(summary.peep_cm_h2o, 0.5f),
+      .volume_ml = Quantize<uint16_t>(summary.inspired_tidal_volume_ml, 1),
+      .duration_cs = static_cast<uint16_t>(std::min<uint32_t>(duration_ms / 10, UINT16_MAX)),
+  };
+  if (breath_log_.Append(Encode(breath))) {
+    // If it was dropped, the next breath needs a time record.
+    last_breath_end_ = now;
+    breaths_since_time_++;
+  }
+
+  uint32_t minute = static_cast<uint32_t>(now.microsSinceStartup() / Minute.microseconds());
+  if (minute_ && *minute_ != minute) AppendMinute();
+  minute_ = minute;
+  minute_breaths_++;
+  pip_sum_ += summary.pip_cm_h2o;
+  peep_sum_ += summary.peep_cm_h2o;
+  volume_sum_ += summary.inspired_tidal_volume_ml;
+}
+
+void EventLog::AppendMinute() {
+  auto n = static_cast<float>(minute_breaths_);
+  MinuteRecord record{
+      .breaths = static_cast<uint8_t>(std::min<uint32_t>(minute_breaths_, UINT8_MAX)),
+      .pip = Quantize<uint8_t>(pip_sum_ / n, 0.5f),
+      .peep = Quantize<uint8_t>(peep_sum_ / n, 0.5f),
+      .volume_ml = Quantize<uint16_t>(volume_sum_ / n, 1),
+      .uptime_min = static_cast<uint16_t>(*minute_),
+  };
+  (void)history_log_.Append(Encode(record));
+  minute_breaths_ = 0;
+  pip_sum_ = peep_sum_ = volume_sum_ = 0;
+}
+
+void EventLog::AddEvent(Time now, Event event, uint16_t arg) {
+  EventRecord record{.event = event, .arg = arg, .uptime_ms = UptimeMs(now)};
+  (void)history_log_.Append(Encode(record));
+}
+
+bool EventLog::Step() {
+  bool busy = breath_log_.Step() || history_log_.Step();
+  dbg_log_dropped.set(breath_log_.dropped() + history_log_.dropped());
+  return busy;
+}
+
+void EventLog::Flush() {
+  while (Step()) {
+  }
+}
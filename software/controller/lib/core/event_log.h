@@ -0,0 +1,158 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <type_traits>
+
+#include "flash_log.h"
+#include "network_protocol.pb.h"
+#include "units.h"
+
+// History of what the ventilator did, kept in flash across resets, for the
+// debug interface to read.
+//
+// A week of breaths at a record per breath would take more flash than we have,
+// so there are two logs:
+//  - the breath log, with a record per breath, covers the last day or so;
+//  - the history log, with a record per minute summarizing its breaths, and a
+//    record per event (reset, mode change), covers the last week or so.
+//
+// Records are 8 bytes, the first of which is their RecordType.  The debug
+// interface reads the log's flash as is; see utils/debug for the decoder.
+class EventLog {
+ public:
+  enum class RecordType : uint8_t {
+    Time = 1,
+    Breath = 2,
+    Minute = 3,
+    Event = 4,
+  };
+
+  enum class Event : uint8_t {
+    // arg is HalApi::ResetFlags() >> 24
+    Reset = 1,
+    // arg is the new VentMode
+    ModeChange = 2,
+  };
+
+  // In the breath log.  Breaths are timed from the durations of the breaths
+  // before them, so a time record gives the uptime at the end of the breath
+  // that follows it.  There's one wherever that can't be worked out otherwise:
+  // after a reset, after a pause in ventilation, and every so often in case a
+  // breath record was dropped.
+  struct TimeRecord {
+    RecordType type{RecordType::Time};
+    uint8_t reserved[3]{};
+    uint32_t uptime_ms;
+  };
+
+  struct BreathRecord {
+    RecordType type{RecordType::Breath};
+    uint8_t trigger;       // BreathTrigger
+    uint8_t pip;           // In 0.5 cmH2O
+    uint8_t peep;          // In 0.5 cmH2O
+    uint16_t volume_ml;    // Inspired tidal volume
+    uint16_t duration_cs;  // Inspiratory + expiratory time, in 10 ms
+  };
+
+  // In the history log, averages of the breaths that ended during one minute
+  // of uptime.  It's logged when the first breath of a later minute ends.
+  struct MinuteRecord {
+    RecordType type{RecordType::Minute};
+    uint8_t breaths;
+    uint8_t pip;  // In 0.5 cmH2O
+    uint8_t peep;
+    uint16_t volume_ml;
+    uint16_t uptime_min;  // Wraps around after 45 days
+  };
+
+  struct EventRecord {
+    RecordType type{RecordType::Event};
+    Event event;
+    uint16_t arg;
+    uint32_t uptime_ms;
+  };
+
+  // Pages of the log flash given to the history log; the rest go to the
+  // breath log.
+  static constexpr size_t HistoryPages{48};
+  // Most breaths in a row without a time record.
+  static constexpr uint32_t BreathsPerTimeRecord{64};
+
+  // The log takes `size` bytes of flash at `address`, both multiples of the
+  // page size.
+  EventLog(uint32_t address, size_t size);
+
+  // Finds where the logs end in flash, and logs the reset.
+  void Init(Time now);
+
+  // Logs a breath.  Called by the control loop.
+  void AddBreath(Time now, const BreathSummary &summary);
+
+  void AddEvent(Time now, Event event, uint16_t arg = 0);
+
+  // Does one flash operation for one of the logs, see FlashLog::Step().  The
+  // control loop calls it in a slot of its own.  Returns false if there was
+  // nothing to do.
+  bool Step();
+
+  // Writes everything that was logged to flash, erasing ahead as needed.  Only
+  // for when the control loop isn't running.
+  void Flush();
+
+  const FlashLog &breath_log() const { return breath_log_; }
+  const FlashLog &history_log() const { return history_log_; }
+
+  template <typename T>
+  static FlashLog::Record Encode(const T &record) {
+    static_assert(sizeof(T) == sizeof(FlashLog::Record));
+    FlashLog::Record encoded;
+    memcpy(&encoded, &record, sizeof(encoded));
+    return encoded;
+  }
+
+  template <typename T>
+  static T Decode(FlashLog::Record record) {
+    static_assert(sizeof(T) == sizeof(FlashLog::Record) && std::is_trivially_copyable_v<T>);
+    T decoded;
+    memcpy(static_cast<void *>(&decoded), &record, sizeof(decoded));
+    return decoded;
+  }
+
+  static RecordType TypeOf(FlashLog::Record record) {
+    return static_cast<RecordType>(record & 0xFF);
+  }
+
+ private:
+  void AppendMinute();
+
+  FlashLog breath_log_;
+  FlashLog history_log_;
+
+  // Breath log timing, see TimeRecord.
+  std::optional<Time> last_breath_end_;
+  uint32_t breaths_since_time_{0};
+
+  // Minute being summarized, and its sums so far.
+  std::optional<uint32_t> minute_;
+  uint32_t minute_breaths_{0};
+  float pip_sum_{0};
+  float peep_sum_{0};
+  float volume_sum_{0};
+};
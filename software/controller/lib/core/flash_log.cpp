@@ -0,0 +1,129 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "flash_log.h"
+
+void FlashLog::Init() {
+  // The newest page is the one with the highest sequence number.  All pages
+  // are within pages_ of each other, so comparing the difference handles
+  // wrapping around.
+  bool found = false;
+  for (size_t page = 0; page < pages_; ++page) {
+    uint32_t sequence;
+    if (!IsLogPage(page, &sequence)) continue;
+    if (!found || static_cast<int32_t>(sequence - sequence_) > 0) {
+      found = true;
+      page_ = page;
+      sequence_ = sequence;
+    }
+  }
+
+  next_page_erased_ = false;
+  if (!found) {
+    // Empty log, start on the first page.
+    page_ = pages_ - 1;
+    sequence_ = 0;
+    next_record_ = RecordsPerPage;
+    return;
+  }
+
+  // Records are written in order, so the first erased one is the end.
+  next_record_ = 0;
+  while (next_record_ < RecordsPerPage && ReadRecord(page_, next_record_) != Erased) {
+    next_record_++;
+  }
+}
+
+bool FlashLog::Append(Record record) {
+  if (!queue_.Put(record)) {
+    dropped_ = dropped_ + 1;
+    return false;
+  }
+  return true;
+}
+
+bool FlashLog::Step() {
+  if (queue_.FullCount() == 0) {
+    // Erase ahead, so that starting the next page doesn't have to wait for it.
+    if (next_page_erased_) return false;
+    next_page_erased_ = ErasePage((page_ + 1) % pages_);
+    return next_page_erased_;
+  }
+
+  if (next_record_ == RecordsPerPage) {
+    bool ok;
+    if (next_page_erased_) {
+      ok = StartNextPage();
+    } else {
+      // The records came in before we got to erase ahead.
+      next_page_erased_ = ErasePage((page_ + 1) % pages_);
+      ok = next_page_erased_;
+    }
+    if (!ok) {
+      // Flash can't take the oldest record, drop it rather than retry forever.
+      (void)queue_.Get();
+      dropped_ = dropped_ + 1;
+    }
+    return true;
+  }
+
+  Record record = *queue_.Get();
+  if (!hal.FlashWrite(record_address(page_, next_record_), &record, sizeof(Record))) {
+    dropped_ = dropped_ + 1;
+  }
+  // Even if the write failed, that record may not read as erased anymore.
+  next_record_++;
+  return true;
+}
+
+void FlashLog::Flush() {
+  while (Step()) {
+  }
+}
+
+bool FlashLog::IsLogPage(size_t page, uint32_t *sequence) const {
+  PageHeader header;
+  hal.FlashRead(page_address(page), &header, sizeof(header));
+  if (sequence) *sequence = header.sequence;
+  return header.magic == magic_;
+}
+
+FlashLog::Record FlashLog::ReadRecord(size_t page, size_t index) const {
+  Record record;
+  hal.FlashRead(record_address(page, index), &record, sizeof(record));
+  return record;
+}
+
+bool FlashLog::ErasePage(size_t page) {
+  // Don't wear flash out (or hold up the CPU) erasing a page for nothing.
+  for (size_t offset = 0; offset < FlashPageSize; offset += sizeof(Record)) {
+    Record word;
+    hal.FlashRead(page_address(page) + static_cast<uint32_t>(offset), &word, sizeof(word));
+    if (word != Erased) return hal.FlashErasePage(page_address(page));
+  }
+  return true;
+}
+
+bool FlashLog::StartNextPage() {
+  size_t page = (page_ + 1) % pages_;
+  next_page_erased_ = false;
+
+  PageHeader header{.magic = magic_, .sequence = sequence_ + 1};
+  if (!hal.FlashWrite(page_address(page), &header, sizeof(header))) return false;
+  page_ = page;
+  sequence_ = header.sequence;
+  next_record_ = 0;
+  return true;
+}
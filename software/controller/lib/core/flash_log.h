@@ -0,0 +1,139 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "circular_buffer.h"
+#include "flash.h"
+#include "hal.h"
+
+// Append-only log of 8-byte records in a ring of flash pages.
+//
+// Each page starts with a PageHeader, followed by records in the order they
+// were appended.  Erased flash (all ones) marks the end of the log.  The page
+// after the one being written is erased ahead of time, so that's where the
+// oldest records are lost, a page at a time.
+//
+// Append() only queues records in RAM, so that the control loop can log
+// without waiting for flash; Step() writes them, one flash operation per call.
+// This part has a single flash bank, and the CPU can't fetch code from it
+// while it's being written, so each step holds up everything, interrupts
+// included: for ~90 us when it writes a record or a page header, and for
+// ~22 ms when it erases a page.  The control loop calls Step() in a slot of
+// its own, right after its tick.  Pages are erased a page ahead of need, in a
+// step of their own, so records don't normally wait for an erase.
+class FlashLog {
+ public:
+  // A record is a double word, the unit in which flash is written.  It must
+  // not be all ones, which is how an erased record reads.
+  using Record = uint64_t;
+  static constexpr Record Erased{~Record{0}};
+
+  struct PageHeader {
+    // Tells pages of this log from pages of other logs, or from whatever was
+    // in flash before.
+    uint32_t magic;
+    // Incremented on each page, so that the highest is the newest page.
+    uint32_t sequence;
+  };
+  static constexpr size_t RecordsPerPage{(FlashPageSize - sizeof(PageHeader)) / sizeof(Record)};
+
+  // Records queued for Step() to write.  Step() runs far more often than
+  // records come in, so the queue only has to absorb bursts: the few records
+  // logged at the end of a breath, plus the steps taken by a page header or
+  // an erase.  Records are dropped if it's full.
+  static constexpr size_t QueueSize{32};
+
+  // The log takes `size` bytes of flash at `address`, both multiples of the
+  // page size.  `magic` must not be all ones either.
+  FlashLog(uint32_t magic, uint32_t address, size_t size)
+      : magic_(magic), address_(address), pages_(size / FlashPageSize) {}
+
+  // Finds the end of the log in flash, for new records to go after it.
+  void Init();
+
+  // Queues a record for Step() to write.  Returns false, dropping the record,
+  // if the queue is full.
+  //
+  // Safe to call from an interrupt handler.
+  bool Append(Record record);
+
+  // Does one flash operation: writes the oldest queued record, or the header
+  // of the next page when the current one is full, or, with nothing queued,
+  // erases the next page if needed.  Returns false if there was nothing to do.
+  bool Step();
+
+  // Steps until there's nothing left to do.  Only for when the control loop
+  // isn't running, as it may erase a page.
+  void Flush();
+
+  // Calls fn(record) for each record in flash, oldest first.
+  template <typename Fn>
+  void ForEach(Fn fn) const;
+
+  // Number of records lost, because the queue was full or flash couldn't be
+  // written.
+  uint32_t dropped() const { return dropped_; }
+
+ private:
+  uint32_t page_address(size_t page) const {
+    return address_ + static_cast<uint32_t>(page * FlashPageSize);
+  }
+  uint32_t record_address(size_t page, size_t index) const {
+    return page_address(page) + static_cast<uint32_t>(sizeof(PageHeader) + index * sizeof(Record));
+  }
+  bool IsLogPage(size_t page, uint32_t *sequence = nullptr) const;
+  Record ReadRecord(size_t page, size_t index) const;
+
+  // Erases a page, unless it's erased already.
+  bool ErasePage(size_t page);
+  // Moves on to writing the next page, which must be erased.
+  bool StartNextPage();
+
+  uint32_t magic_;
+  uint32_t address_;
+  size_t pages_;
+
+  CircularBuffer<Record, QueueSize> queue_;
+
+  // Page being written, sequence number in its header, and index of the next
+  // record to write in it.  next_record_ is RecordsPerPage when the page is
+  // full, or when there's no page yet.
+  size_t page_{0};
+  uint32_t sequence_{0};
+  size_t next_record_{RecordsPerPage};
+  // Whether the page after page_ is known to be erased.
+  bool next_page_erased_{false};
+
+  volatile uint32_t dropped_{0};
+};
+
+template <typename Fn>
+void FlashLog::ForEach(Fn fn) const {
+  // Going around the ring from the page after the newest one, pages are from
+  // oldest to newest.
+  for (size_t i = 1; i <= pages_; ++i) {
+    size_t page = (page_ + i) % pages_;
+    if (!IsLogPage(page)) continue;
+    for (size_t index = 0; index < RecordsPerPage; ++index) {
+      Record record = ReadRecord(page, index);
+      if (record == Erased) break;
+      fn(record);
+    }
+  }
+}
@@ -0,0 +1,102 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "sample_batcher.h"
+
+#include <math.h>
+
+#include <algorithm>
+#include <iterator>
+
+namespace {
+
+// The repeated fields of a SampleBatch, in the same order as the values
+// returned by FixedPointValues().
+struct Field {
+  int32_t *values;
+  pb_size_t *count;
+};
+
+std::array<Field, 5> Fields(SampleBatch *b) {
+  return {{
+      {b->patient_pressure_cm_h2o_x100, &b->patient_pressure_cm_h2o_x100_count},
+      {b->flow_ml_per_min, &b->flow_ml_per_min_count},
+      {b->volume_ml_x10, &b->volume_ml_x10_count},
+      {b->pressure_setpoint_cm_h2o_x100, &b->pressure_setpoint_cm_h2o_x100_count},
+      {b->fio2_x1000, &b->fio2_x1000_count},
+  }};
+}
+
+int32_t ToFixed(float value, float scale) { return static_cast<int32_t>(lroundf(value * scale)); }
+
+std::array<int32_t, 5> FixedPointValues(const SensorReadings &r, const ControllerState &c) {
+  return {
+      ToFixed(r.patient_pressure.cmH2O(), 100),
+      ToFixed(c.net_flow.ml_per_min(), 1),
+      ToFixed(c.patient_volume.ml(), 10),
+      ToFixed(c.pressure_setpoint.cmH2O(), 100),
+      ToFixed(r.fio2, 1000),
+  };
+}
+
+constexpr pb_size_t Capacity = std::size(SampleBatch{}.patient_pressure_cm_h2o_x100);
+
+}  // namespace
+
+SampleBatcher::SampleBatcher(Duration sample_period) {
+  batch_.sample_period_us = static_cast<uint32_t>(sample_period.microseconds());
+}
+
+void SampleBatcher::AddSample(const SensorReadings &readings, const ControllerState &state) {
+  if (batch_.patient_pressure_cm_h2o_x100_count == Capacity) {
+    DropOldest();
+  }
+  if (batch_.patient_pressure_cm_h2o_x100_count == 0) {
+    batch_.first_sample = next_sample_;
+  }
+  next_sample_++;
+
+  std::array<int32_t, FieldCount> values = FixedPointValues(readings, state);
+  auto fields = Fields(&batch_);
+  for (size_t i = 0; i < FieldCount; ++i) {
+    pb_size_t &count = *fields[i].count;
+    fields[i].values[count] = count == 0 ? values[i] : values[i] - last_values_[i];
+    count++;
+  }
+  last_values_ = values;
+}
+
+void SampleBatcher::DropOldest() {
+  for (Field &field : Fields(&batch_)) {
+    pb_size_t &count = *field.count;
+    if (count == 0) continue;
+    // The second value becomes the first, so it has to be made absolute.
+    if (count > 1) {
+      field.values[1] += field.values[0];
+    }
+    std::copy(field.values + 1, field.values + count, field.values);
+    count--;
+  }
+  batch_.first_sample++;
+}
+
+void SampleBatcher::DropBefore(uint32_t end) {
+  // Samples may also have been dropped because the batch overflowed since
+  // `end` was worked out, so go by the indices.
+  while (batch_.patient_pressure_cm_h2o_x100_count > 0 &&
+         static_cast<int32_t>(end - batch_.first_sample) > 0) {
+    DropOldest();
+  }
+}
@@ -0,0 +1,69 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+
+#include "controller.h"
+#include "network_protocol.pb.h"
+#include "sensors.h"
+
+// Collects control loop samples into a SampleBatch proto, so that the GUI gets
+// every sample and not just the one that happens to be current when a
+// ControllerStatus goes out.  See SampleBatch in network_protocol.proto for
+// the encoding.
+//
+// The batcher belongs to the control loop, i.e. the loop timer interrupt.
+// The background loop gets copies of batch() to send, and reports back how
+// far it got using EndOf(), so that the control loop can DropBefore() what's
+// been sent.
+class SampleBatcher {
+ public:
+  explicit SampleBatcher(Duration sample_period);
+
+  // Appends a sample to the batch.  If the batch is full because nothing was
+  // sent for a while, the oldest sample is dropped.
+  void AddSample(const SensorReadings &readings, const ControllerState &state);
+
+  // Samples that haven't been sent yet.
+  const SampleBatch &batch() const { return batch_; }
+
+  // Drops the samples in `sent`, an earlier copy of batch() which has now
+  // been sent.  Samples added since that copy was made are kept.
+  void DropSent(const SampleBatch &sent) { DropBefore(EndOf(sent)); }
+
+  // Drops the samples before `end`, as returned by EndOf().
+  void DropBefore(uint32_t end);
+
+  // Index of the sample following the ones in `batch`.
+  static uint32_t EndOf(const SampleBatch &batch) {
+    return batch.first_sample + batch.patient_pressure_cm_h2o_x100_count;
+  }
+
+ private:
+  static constexpr size_t FieldCount = 5;
+
+  void DropOldest();
+
+  SampleBatch batch_ = SampleBatch_init_zero;
+  uint32_t next_sample_{0};
+
+  // Fixed-point values of the last sample added, which the next one is
+  // encoded relative to.
+  std::array<int32_t, FieldCount> last_values_{};
+};
@@ -80,11 +80,14 @@ SensorReadings Sensors::get_readings() const {
   //  and/or estimate from user input (from altitude?)
   static constexpr Pressure AmbientPressure = kPa(101.3f);
 
+  AnalogSnapshot snapshot = hal.AnalogReadAll();
   return {
-      .patient_pressure = patient_pressure_sensor_.read(hal),
-      .fio2 = fio2_sensor_.read(hal, AmbientPressure),
-      .air_inflow = air_influx_sensor_.read(hal, AirDensity),
-      .oxygen_inflow = oxygen_influx_sensor_.read(hal, AirDensity),
-      .outflow = outflow_sensor_.read(hal, AirDensity),
+      .patient_pressure = patient_pressure_sensor_.read(snapshot),
+      .fio2 = fio2_sensor_.read(snapshot, AmbientPressure),
+      .air_inflow = air_influx_sensor_.read(air_influx_sensor_dp_.read(snapshot), AirDensity),
+      .oxygen_inflow =
+          oxygen_influx_sensor_.read(oxygen_influx_sensor_dp_.read(snapshot), AirDensity),
+      .outflow = outflow_sensor_.read(outflow_sensor_dp_.read(snapshot), AirDensity),
+      .time = snapshot.time,
   };
 }
@@ -48,6 +48,9 @@ struct SensorReadings {
   VolumetricFlow air_inflow;
   VolumetricFlow oxygen_inflow;
   VolumetricFlow outflow;
+
+  // When the analog sensors were sampled, all at once.
+  Time time;
 };
 
 // Provides calibrated sensor readings, including tidal volume (TV)
@@ -61,7 +64,7 @@ class Sensors {
   // are called.
   void calibrate();
 
-  // Read the sensors.
+  // Read the sensors, from a single snapshot of the analog inputs.
   SensorReadings get_readings() const;
 
  private:
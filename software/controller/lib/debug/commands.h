@@ -16,6 +16,7 @@ limitations under the License.
 #pragma once
 
 #include "binary_utils.h"
+#include "crash_dump.h"
 #include "eeprom.h"
 #include "hal.h"
 #include "interface.h"
@@ -196,4 +197,59 @@ class EepromHandler : public Handler {
   I2Ceeprom *eeprom_;
 };
 
+// Crash dump command.
+// Gives access to the dump saved in flash by the last crash, see CrashDump.
+// The first byte of data passed to the command gives a sub-command:
+//
+//  GetSize - Returns the size of the dump in bytes (32 bits), 0 if there is
+//            none.
+//
+//  Read, followed by a 32 bits offset and a 16 bits length :
+//          Used to read length bytes of the dump, starting at offset
+//
+//  Erase - Erases the dump
+class CrashDumpHandler : public Handler {
+ public:
+  explicit CrashDumpHandler(CrashDump *dump) : dump_(dump){};
+  ErrorCode Process(Context *context) override;
+
+  enum class Subcommand : uint8_t {
+    GetSize = 0x00,
+    Read = 0x01,
+    Erase = 0x02,
+  };
+
+ private:
+  ErrorCode Read(Context *context);
+
+  CrashDump *dump_;
+};
+
+// Event log command.
+// Reads the flash the event log (see EventLog) is kept in, as is: decoding it
+// is up to the debug tools.
+// The first byte of data passed to the command gives a sub-command:
+//
+//  GetSize - Returns the size of the log flash in bytes (32 bits)
+//
+//  Read, followed by a 32 bits offset and a 16 bits length :
+//          Used to read length bytes of the log flash, starting at offset
+class EventLogHandler : public Handler {
+ public:
+  EventLogHandler(uint32_t flash_address, uint32_t flash_size)
+      : flash_address_(flash_address), flash_size_(flash_size){};
+  ErrorCode Process(Context *context) override;
+
+  enum class Subcommand : uint8_t {
+    GetSize = 0x00,
+    Read = 0x01,
+  };
+
+ private:
+  ErrorCode Read(Context *context);
+
+  uint32_t flash_address_;
+  uint32_t flash_size_;
+};
+
 }  // namespace Debug::Command
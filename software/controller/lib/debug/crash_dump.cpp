@@ -0,0 +1,96 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "crash_dump.h"
+
+#include <algorithm>
+#include <array>
+
+namespace Debug {
+
+bool CrashDump::save(const CrashInfo &info) {
+  Header header{};
+  header.magic = Magic;
+  header.info = info;
+  header.trace_variables = trace_->active_variable_count();
+  for (uint8_t i = 0; i < Trace::MaxVars; ++i) {
+    header.trace_variable_ids[i] = trace_->traced_variable(i);
+  }
+  // Keep as many of the newest samples as fit.
+  size_t available = trace_->sample_count();
+  if (header.trace_variables > 0) {
+    size_t fit = (flash_size_ - sizeof(Header)) / (header.trace_variables * sizeof(uint32_t));
+    header.trace_samples = static_cast<uint32_t>(std::min(available, fit));
+  }
+  header.size = static_cast<uint32_t>(
+      sizeof(Header) + header.trace_samples * header.trace_variables * sizeof(uint32_t));
+
+  for (uint32_t page = flash_address_; page < flash_address_ + flash_size_; page += FlashPageSize) {
+    if (!hal.FlashErasePage(page)) return false;
+    hal.WatchdogHandler();
+  }
+
+  // Write the samples first, and the header last, so that an interrupted save doesn't look like a
+  // valid dump.
+  uint32_t address = flash_address_ + static_cast<uint32_t>(sizeof(Header));
+  std::array<uint32_t, 16> chunk;
+  size_t chunk_size = 0;
+  for (size_t i = available - header.trace_samples; i < available; ++i) {
+    std::array<uint32_t, Trace::MaxVars> record;
+    size_t count;
+    if (!trace_->peek_record(i, &record, &count)) break;
+    for (size_t j = 0; j < count; ++j) {
+      chunk[chunk_size++] = record[j];
+      if (chunk_size == chunk.size()) {
+        if (!write_chunk(&address, chunk.data(), chunk_size)) return false;
+        chunk_size = 0;
+      }
+    }
+  }
+  if (chunk_size % 2) chunk[chunk_size++] = 0xFFFFFFFF;
+  if (chunk_size > 0 && !write_chunk(&address, chunk.data(), chunk_size)) return false;
+
+  return hal.FlashWrite(flash_address_, &header, sizeof(Header));
+}
+
+bool CrashDump::write_chunk(uint32_t *address, uint32_t *words, size_t count) {
+  size_t bytes = count * sizeof(uint32_t);
+  bool ok = hal.FlashWrite(*address, words, bytes);
+  *address += static_cast<uint32_t>(bytes);
+  hal.WatchdogHandler();
+  return ok;
+}
+
+size_t CrashDump::size() const {
+  Header header;
+  hal.FlashRead(flash_address_, &header, sizeof(Header));
+  if (header.magic != Magic || header.size < sizeof(Header) || header.size > flash_size_) {
+    return 0;
+  }
+  return header.size;
+}
+
+bool CrashDump::read(size_t offset, void *dest, size_t length) const {
+  if (offset + length > size()) return false;
+  hal.FlashRead(flash_address_ + static_cast<uint32_t>(offset), dest, length);
+  return true;
+}
+
+bool CrashDump::erase() {
+  // Only the header needs to go for the dump to be gone.
+  return hal.FlashErasePage(flash_address_);
+}
+
+}  // namespace Debug
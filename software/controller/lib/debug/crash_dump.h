@@ -0,0 +1,79 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "hal.h"
+#include "trace.h"
+
+namespace Debug {
+
+/*
+ * Post-mortem record of a crash.
+ *
+ * The HAL's crash handler (see HalApi::SetCrashHandler) calls save(), which writes the state of the
+ * processor and the newest samples of the trace buffer to a reserved region of flash. After the
+ * reset, the dump can be read with the debug interface (see Command::CrashDumpHandler), until it
+ * is erased or replaced by the next crash.
+ *
+ * In flash, the dump is a Header, followed by the trace samples: trace_samples samples of
+ * trace_variables words each, oldest first.
+ */
+class CrashDump {
+ public:
+  struct Header {
+    uint32_t magic;
+    uint32_t size;  // Of the whole dump, header included, in bytes
+    CrashInfo info;
+    uint32_t trace_variables;
+    uint32_t trace_samples;
+    uint16_t trace_variable_ids[Trace::MaxVars];
+  };
+  // Flash is written 8 bytes at a time
+  static_assert(sizeof(Header) % 8 == 0);
+
+  CrashDump(uint32_t flash_address, size_t flash_size, Trace *trace)
+      : flash_address_(flash_address), flash_size_(flash_size), trace_(trace) {}
+
+  /// \brief saves a dump of the crash to flash, replacing any previous one
+  /// \returns false if flash could not be written
+  bool save(const CrashInfo &info);
+
+  /// \returns size of the saved dump in bytes, 0 if there is none
+  size_t size() const;
+
+  /// \brief copies `length` bytes of the saved dump, starting at `offset`
+  /// \returns false if that goes beyond the end of the dump
+  bool read(size_t offset, void *dest, size_t length) const;
+
+  /// \brief erases the saved dump
+  bool erase();
+
+ private:
+  static constexpr uint32_t Magic{0x504D5544};  // "DUMP"
+
+  // Writes one chunk of trace samples to flash, and pets the watchdog, which keeps running while we
+  // save the dump.
+  bool write_chunk(uint32_t *address, uint32_t *words, size_t count);
+
+  uint32_t flash_address_;
+  size_t flash_size_;
+  Trace *trace_;
+};
+
+}  // namespace Debug
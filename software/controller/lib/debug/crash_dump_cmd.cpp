@@ -0,0 +1,60 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "commands.h"
+
+namespace Debug::Command {
+
+ErrorCode CrashDumpHandler::Process(Context *context) {
+  if (context->request_length < 1) return ErrorCode::MissingData;
+
+  Subcommand subcommand{context->request[0]};
+
+  switch (subcommand) {
+    case Subcommand::GetSize:
+      if (context->max_response_length < 4) return ErrorCode::NoMemory;
+      u32_to_u8(static_cast<uint32_t>(dump_->size()), context->response);
+      context->response_length = 4;
+      *(context->processed) = true;
+      return ErrorCode::None;
+
+    case Subcommand::Read:
+      return Read(context);
+
+    case Subcommand::Erase:
+      if (!dump_->erase()) return ErrorCode::InternalError;
+      context->response_length = 0;
+      *(context->processed) = true;
+      return ErrorCode::None;
+
+    default:
+      return ErrorCode::InvalidData;
+  }
+}
+
+ErrorCode CrashDumpHandler::Read(Context *context) {
+  // Read command requires offset (bytes 1 to 4) and length (bytes 5 and 6)
+  if (context->request_length < 7) return ErrorCode::MissingData;
+  uint32_t offset = u8_to_u32(&context->request[1]);
+  uint16_t length = u8_to_u16(&context->request[5]);
+  if (length > context->max_response_length) return ErrorCode::NoMemory;
+
+  if (!dump_->read(offset, context->response, length)) return ErrorCode::InvalidData;
+  context->response_length = length;
+  *(context->processed) = true;
+  return ErrorCode::None;
+}
+
+}  // namespace Debug::Command
@@ -49,6 +49,8 @@ enum class Code : uint8_t {
   Variable = 0x04,      // Variable access
   Trace = 0x05,         // Data trace commands
   EepromAccess = 0x06,  // Read/Write in I2C EEPROM
+  CrashDump = 0x07,     // Read/Erase the crash dump saved in flash
+  EventLog = 0x08,      // Read the event log flash
 };
 
 // Structure that represents a command's parameters
@@ -99,6 +99,20 @@ uint16_t Trace::traced_variable(uint8_t index) {
   return true;
 }
 
+[[nodiscard]] bool Trace::peek_record(size_t index, std::array<uint32_t, MaxVars> *record,
+                                     size_t *count) {
+  *count = 0;
+  BlockInterrupts block;
+  size_t position = index * active_variable_count();
+  for (auto *var : traced_vars_) {
+    if (!var) continue;
+    std::optional<uint32_t> dat = trace_buffer_.Peek(position++);
+    if (!dat) return false;
+    (*record)[(*count)++] = *dat;
+  }
+  return true;
+}
+
 bool Trace::sample_all_variables() {
   // If there are no enabled trace variables, or if there isn't enough space
   // in the buffer for a full sample, then signal to stop the trace.
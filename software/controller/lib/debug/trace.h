@@ -90,6 +90,12 @@ class Trace {
    * */
   [[nodiscard]] bool get_next_record(std::array<uint32_t, MaxVars> *record, size_t *count);
 
+  /* Like get_next_record, but reads the sample at `index` (0 is the oldest) and leaves it in the
+   * buffer. Returns false if there is no such sample.
+   * */
+  [[nodiscard]] bool peek_record(size_t index, std::array<uint32_t, MaxVars> *record,
+                                 size_t *count);
+
  private:
   // This function is called at the end of the high priority loop function.
   // It captures any enabled data variables to the trace buffer.
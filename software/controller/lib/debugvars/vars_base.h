@@ -36,7 +36,7 @@ enum class Access {
   ReadWrite = 1,
 };
 
-static constexpr uint16_t MaxVariableCount{100};
+static constexpr uint16_t MaxVariableCount{128};
 
 static constexpr uint16_t InvalidID{MaxVariableCount};
 
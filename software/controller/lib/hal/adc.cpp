@@ -48,8 +48,17 @@ limitations under the License.
 // This allows us to efficiently average the A/D inputs for relatively
 // long periods.
 //
+// The sample time, the oversampling ratio, and how long each channel is
+// averaged over can be changed at runtime through debug variables (adc_*),
+// to find the best trade-off between noise and latency for each sensor.
+// Changes only take effect while the ventilator is off, as the readings
+// stand still until the buffer has refilled with the new settings.
+// Characterization mode (adc_characterize) measures the noise of the
+// readings with the settings in use, while the inputs are held steady.
+//
 ////////////////////////////////////////////////////////////////////
 
+#include "adc_config.h"
 #include "clocks.h"
 #include "gpio.h"
 #include "hal.h"
@@ -57,6 +66,7 @@ limitations under the License.
 #if defined(BARE_STM32)
 
 #include "hal_stm32.h"
+#include "vars.h"
 
 /*
 Please refer to [PCB] as the ultimate source of which pin is used for which function.
@@ -71,90 +81,161 @@ The following pins are used as analog inputs on the rev-1 PCB:
 Reference abbreviations ([RM], [PCB], etc) are defined in hal/README.md
 */
 
-// How long a period (in seconds) we want to average the A/D readings.
-static constexpr float SampleHistoryTimeSec = 0.001f;
-
 // Total number of A/D inputs we're sampling
 static constexpr int AdcChannels = 5;
+// AnalogReadAll() relies on the channels being in the buffer in AnalogPin order.
+static_assert(AdcChannels == NumAnalogPins);
 
-// Resolution of the ADC channels (in bits).
-// We are using the default value (which is also the highest possible one - see [RM] 16.4.22).
-static constexpr int AdcResolution = 12;
+// Most frames (readings of all channels) the DMA buffer can hold.
+static constexpr uint32_t MaxAdcFrames = 256;
 
-// This constant controls how many times we have the A/D sample each input
+// Default sampling settings, see AdcConfig.
+//
+// I'm using 92.5 A/D clocks to sample.
+// This is the time we give the analog input to charge the A/D sampling cap.
+static constexpr ADCSampleTimeReg DefaultSampleTime{ADCSampleTimeReg::S92p5};
+// How long a period we want to average the A/D readings.
+static constexpr Duration DefaultWindow{milliseconds(1)};
+// This controls how many times we have the A/D sample each input
 // and sum them before moving on to the next input.  The constant is set
 // as a log base 2, so a value of 3 for example would mean sample 8 times
 // (2^3 == 8).  Legal values range from 0 to 8.
-static constexpr int OversampleLog2 = 4;
-static constexpr int OversampleCount = 1 << OversampleLog2;
-
-// [RM] 16.4.30: Oversampler (pg 425)
-// This calculated constant gives the maximum A/D reading based on the number of samples.
-// It is the maximum value reached when summing all samples in a 16 bits (internal) register,
-// considering all samples have maximum value (2 ^ resolution).
-// In other words, it is 2 ^ resolution * Number of samples, maxed out at 2^16
-static constexpr int MaxAdcReading =
-    (OversampleLog2 >= (16 - AdcResolution)) ? 65536 : (1 << (AdcResolution + OversampleLog2));
-
-// Set sample time ([RM] 16.4.12).
-enum class ADCSampleTimeReg {
-  S2p5 = 0,    // 2.5 clock cycles
-  S6p5 = 1,    // 6.5 clock cycles
-  S12p5 = 2,   // 12.5 clock cycles
-  S24p5 = 3,   // 24.5 clock cycles
-  S47p5 = 4,   // 47.5 clock cycles
-  S92p5 = 5,   // 92.5 clock cycles
-  S247p5 = 6,  // 247.5 clock cycles
-  S640p5 = 7   // 640.5 clock cycles
-};
-// I'm using 92.5 A/D clocks to sample.
-// A/D sample time in CPU clock cycles.  Fixed for now.
-// This is the time we give the analog input to charge the A/D sampling cap.
-static constexpr ADCSampleTimeReg AdcSampleTime{ADCSampleTimeReg::S92p5};
-
-// Time of an A/D conversion in CPU clock cycles (see [RM] 16.4.16):
-// sample time (in clock cycles, rounded up) + 12 (one per bit of resolution).
-static constexpr int AdcConversionTime = [] {
-  switch (AdcSampleTime) {
-    case ADCSampleTimeReg::S2p5:
-      return 3 + AdcResolution;
-    case ADCSampleTimeReg::S6p5:
-      return 7 + AdcResolution;
-    case ADCSampleTimeReg::S12p5:
-      return 13 + AdcResolution;
-    case ADCSampleTimeReg::S24p5:
-      return 25 + AdcResolution;
-    case ADCSampleTimeReg::S47p5:
-      return 48 + AdcResolution;
-    case ADCSampleTimeReg::S92p5:
-      return 93 + AdcResolution;
-    case ADCSampleTimeReg::S247p5:
-      return 248 + AdcResolution;
-    case ADCSampleTimeReg::S640p5:
-      return 640 + AdcResolution;
-  }
-  // All cases covered above (and GCC checks this).
-  __builtin_unreachable();
-}();
-
-// Calculate how long our history buffer needs to be based on the above.
-static constexpr uint32_t AdcSampleHistory = static_cast<uint32_t>(
-    SampleHistoryTimeSec * CPUFrequencyHz / AdcConversionTime / OversampleCount / AdcChannels);
-
-// This scaler converts the sum of the A/D readings (a total of
-// AdcSampleHistory) into a voltage.  The A/D is scaled so a value of 0
-// corresponds to 0 volts, and MaxAdcReading corresponds to 3.3V
-static constexpr float AdcScaler = 3.3f / (MaxAdcReading * AdcSampleHistory);
+static constexpr uint32_t DefaultOversampleLog2 = 4;
+
+// The settings can be changed at runtime, through these debug variables.
+// They're applied by the next AnalogReadAll() call that's allowed to (see
+// HalApi::AnalogAllowReconfiguration()).
+static Debug::Variable::FloatArray<NumAnalogPins> dbg_sample_time(
+    "adc_sample_time", Debug::Variable::Access::ReadWrite, static_cast<float>(DefaultSampleTime),
+    "", "A/D sample time of each AnalogPin, from 0 to 7 for 2.5 to 640.5 A/D clocks ([RM] 16.4.12)",
+    "%.0f");
+static Debug::Variable::FloatArray<NumAnalogPins> dbg_window(
+    "adc_window", Debug::Variable::Access::ReadWrite, DefaultWindow.milliseconds(), "ms",
+    "Time over which the A/D readings of each AnalogPin are averaged");
+static Debug::Variable::UInt32 dbg_oversample_log2(
+    "adc_oversample_log2", Debug::Variable::Access::ReadWrite, DefaultOversampleLog2, "",
+    "A/D oversampling ratio of all AnalogPins, as a power of 2 (0 to 8)");
+static Debug::Variable::FloatArray<NumAnalogPins> dbg_group_delay(
+    "adc_group_delay", Debug::Variable::Access::ReadOnly, 0.f, "ms",
+    "Delay of each AnalogPin's reading behind its input (half its window)");
+
+// Characterization mode: with steady inputs, gives the noise of each
+// channel's reading for the current settings.
+static Debug::Variable::UInt32 dbg_characterize(
+    "adc_characterize", Debug::Variable::Access::ReadWrite, 0, "",
+    "A/D characterization mode: 0 for off, or 1 + the AnalogPin to copy a raw sample of to "
+    "adc_raw_sample.  Statistics start over when this or the A/D settings change");
+static Debug::Variable::Float dbg_raw_sample(
+    "adc_raw_sample", Debug::Variable::Access::ReadOnly, 0.f, "V",
+    "Latest single A/D reading of the AnalogPin picked by adc_characterize.  Only updated once "
+    "per pressure loop cycle, and traced at the trace rate, so a trace of it is a subsample of "
+    "the A/D's readings, not all of them");
+static Debug::Variable::UInt32 dbg_characterize_count(
+    "adc_characterize_count", Debug::Variable::Access::ReadOnly, 0, "",
+    "Number of readings the A/D noise statistics are from");
+static Debug::Variable::FloatArray<NumAnalogPins> dbg_noise_rms(
+    "adc_noise_rms", Debug::Variable::Access::ReadOnly, 0.f, "mV",
+    "RMS noise of each AnalogPin's reading, in characterization mode");
+static Debug::Variable::FloatArray<NumAnalogPins> dbg_effective_bits(
+    "adc_effective_bits", Debug::Variable::Access::ReadOnly, 0.f, "bits",
+    "Effective resolution of each AnalogPin's reading over the 3.3V range, in characterization "
+    "mode");
+
+// Settings in use, and what they work out to.
+static AdcConfig adc_config;
+static AdcTiming adc_timing(adc_config, CPUFrequencyHz, MaxAdcFrames);
+
+// When the DMA buffer starts holding readings from the settings in use.
+static Time adc_settled;
+
+// Latest good readings, returned while the DMA buffer settles.
+static AnalogSnapshot last_snapshot;
+
+// See HalApi::AnalogAllowReconfiguration().
+static volatile bool reconfiguration_allowed = false;
+
+static uint32_t characterize = 0;
+static AdcNoiseStats noise_stats[AdcChannels];
 
 // This buffer will hold the readings from the A/D
-static volatile uint16_t adc_buff[AdcSampleHistory * AdcChannels];
+static volatile uint16_t adc_buff[MaxAdcFrames * AdcChannels];
 
 // NOTE - we need the sample history to be small for two reasons:
-// - We sum to a 32-bit floating point number and will lose precision if we add in too many samples
+// - We sum to a 32-bit number and will overflow if we add in too many samples
 // - We want the A/D reading to be fast, so summing up a really large array might be too slow.
 //
 // If you get hit with this assertion you may need to rethink the way this function works.
-static_assert(AdcSampleHistory < 100);
+static_assert(MaxAdcFrames * 65536ull <= UINT32_MAX);
+
+// Settings from the debug variables, made valid.
+static AdcConfig RequestedConfig() {
+  AdcConfig config;
+  for (size_t i = 0; i < NumAnalogPins; ++i) {
+    config.sample_time[i] =
+        static_cast<ADCSampleTimeReg>(std::clamp(std::round(dbg_sample_time.data[i]), 0.f, 7.f));
+    config.window[i] = microseconds(
+        static_cast<int64_t>(std::max(dbg_window.data[i], 0.f) * 1000.f));
+  }
+  config.oversample_log2 = std::min(dbg_oversample_log2.get(), MaxOversampleLog2);
+  return config;
+}
+
+// Stops the A/D and its DMA if they're running, applies adc_config, and
+// starts them again.
+static void StartConversions() {
+  AdcReg *adc = AdcBase;
+  DmaReg *dma = Dma1Base;
+  auto c1 = static_cast<uint8_t>(DmaChannel::Chan1);
+
+  // Stop conversions ([RM] 16.4.17).  The control register bits are only
+  // ever set by software, so only write the one we're setting.
+  static constexpr uint32_t ControlSetBits = 0x8000003F;
+  static constexpr uint32_t ADStart = 0x00000004;
+  static constexpr uint32_t ADStop = 0x00000010;
+  if (adc->adc[0].control & ADStart) {
+    adc->adc[0].control = (adc->adc[0].control & ~ControlSetBits) | ADStop;
+    while (adc->adc[0].control & ADStart) {
+    }
+  }
+  dma->channel[c1].config.enable = 0;
+
+  uint32_t oversample_log2 = adc_config.oversample_log2;
+  adc->adc[0].configuration2.regular_oversampling = (oversample_log2 > 0) ? 1 : 0;
+
+  adc->adc[0].configuration2.oversampling_ratio =
+      ((oversample_log2 > 0) ? oversample_log2 - 1 : 0) & 0x7;
+
+  // Set oversampling shift if necessary (see [RM] Table 66)
+  adc->adc[0].configuration2.oversampling_shift =
+      ((oversample_log2 < 4) ? 0 : (oversample_log2 - 4)) & 0xF;
+
+  // Set sample times ([RM] 16.4.12), in AnalogPin order.
+  auto sample_time = [&](AnalogPin pin) {
+    return static_cast<uint32_t>(adc_config.sample_time[static_cast<size_t>(pin)]);
+  };
+  adc->adc[0].sample_times.ch1 = sample_time(AnalogPin::InterimBoardAnalogPressure) & 0x7;
+  adc->adc[0].sample_times.ch6 = sample_time(AnalogPin::U3PatientPressure) & 0x7;
+  adc->adc[0].sample_times.ch9 = sample_time(AnalogPin::U4InhaleFlow) & 0x7;
+  adc->adc[0].sample_times.ch15 = sample_time(AnalogPin::U5ExhaleFlow) & 0x7;
+  adc->adc[0].sample_times.ch2 = sample_time(AnalogPin::InterimBoardOxygenSensor) & 0x7;
+
+  // The buffer only needs to be as long as the longest window, so that the
+  // DMA goes around it as fast as possible.
+  adc_timing = AdcTiming(adc_config, CPUFrequencyHz, MaxAdcFrames);
+  dma->channel[c1].count = adc_timing.buffer_frames * AdcChannels;
+  dma->channel[c1].config.enable = 1;
+
+  for (size_t i = 0; i < NumAnalogPins; ++i) {
+    dbg_group_delay.data[i] = adc_timing.group_delay_ms(i);
+  }
+
+  // Start the A/D converter (by setting bit 2 of the control register - per [RM] p457)
+  adc->adc[0].control = (adc->adc[0].control & ~ControlSetBits) | ADStart;
+
+  // Once the DMA has gone around the buffer, with a frame to spare.
+  float settle_us = adc_timing.frame_time_us * static_cast<float>(adc_timing.buffer_frames + 1);
+  adc_settled = hal.Now() + microseconds(static_cast<int64_t>(std::ceil(settle_us)));
+}
 
 void HalApi::InitADC() {
   // Enable the clock to the A/D converter
@@ -218,20 +299,6 @@ void HalApi::InitADC() {
     }
   }();
 
-  adc->adc[0].configuration2.regular_oversampling = (OversampleLog2 > 0) ? 1 : 0;
-
-  adc->adc[0].configuration2.oversampling_ratio = (OversampleLog2 > 0) ? OversampleLog2 - 1 : 0;
-
-  // Set oversampling shift if necessary (see [RM] Table 66)
-  adc->adc[0].configuration2.oversampling_shift = (OversampleLog2 < 4) ? 0 : (OversampleLog2 - 4);
-
-  // Set sample times ([RM] 16.4.12).
-  adc->adc[0].sample_times.ch1 = static_cast<uint32_t>(AdcSampleTime);
-  adc->adc[0].sample_times.ch6 = static_cast<uint32_t>(AdcSampleTime);
-  adc->adc[0].sample_times.ch9 = static_cast<uint32_t>(AdcSampleTime);
-  adc->adc[0].sample_times.ch15 = static_cast<uint32_t>(AdcSampleTime);
-  adc->adc[0].sample_times.ch2 = static_cast<uint32_t>(AdcSampleTime);
-
   // Set conversion sequence length (number of used channels - 1, per [RM] p468)
   adc->adc[0].sequence.length = AdcChannels - 1;
 
@@ -248,7 +315,6 @@ void HalApi::InitADC() {
 
   dma->channel[c1].peripheral_address = &adc->adc[0].data;
   dma->channel[c1].memory_address = adc_buff;
-  dma->channel[c1].count = AdcSampleHistory * AdcChannels;
 
   dma->channel[c1].config.enable = 0;
   dma->channel[c1].config.tx_complete_interrupt = 0;
@@ -261,10 +327,22 @@ void HalApi::InitADC() {
   dma->channel[c1].config.peripheral_size = 1;
   dma->channel[c1].config.memory_size = 1;
   dma->channel[c1].config.priority = 0;
-  dma->channel[c1].config.enable = 1;
 
-  // Start the A/D converter (by setting bit 2 of the control register - per [RM] p457)
-  adc->adc[0].control |= 0x00000004;
+  // Oversampling, sample times, and the DMA buffer length depend on the
+  // settings.
+  adc_config = RequestedConfig();
+  StartConversions();
+}
+
+// Index in the DMA buffer of the latest frame that the DMA is done writing.
+static uint32_t LatestFrame() {
+  uint32_t remaining = Dma1Base->channel[static_cast<uint8_t>(DmaChannel::Chan1)].count;
+  uint32_t written = adc_timing.buffer_frames * AdcChannels - remaining;
+  return (written / AdcChannels + adc_timing.buffer_frames - 1) % adc_timing.buffer_frames;
+}
+
+static uint32_t PreviousFrame(uint32_t frame) {
+  return (frame == 0 ? adc_timing.buffer_frames : frame) - 1;
 }
 
 // Read the specified analog input.
@@ -286,14 +364,79 @@ Voltage HalApi::AnalogRead(AnalogPin pin) const {
     __builtin_unreachable();
   }();
 
-  // We just run through the buffer and add up all the readings for
-  // this channel.  The DMA is still writing to this buffer in the
-  // background, but that shouldn't cause any problems because memory
-  // accesses for 16-bit values are atomic.
-  float sum = 0;
-  for (int i = 0; i < AdcSampleHistory; i++) sum += adc_buff[i * AdcChannels + offset];
+  // We just run back through the buffer from the latest frame and add up
+  // the readings for this channel over its window.  The DMA is still writing
+  // to this buffer in the background, but that shouldn't cause any problems
+  // because memory accesses for 16-bit values are atomic, and there's a
+  // spare frame for it to write to.
+  uint32_t sum = 0;
+  uint32_t frame = LatestFrame();
+  for (uint32_t i = 0; i < adc_timing.frames[offset]; i++) {
+    sum += adc_buff[frame * AdcChannels + offset];
+    frame = PreviousFrame(frame);
+  }
+
+  return volts(static_cast<float>(sum) * adc_timing.scaler[offset]);
+}
+
+// In characterization mode, adds a snapshot to the noise statistics.
+static void Characterize(const AnalogSnapshot &snapshot, uint32_t latest_frame) {
+  if (dbg_characterize.get() != characterize) {
+    characterize = dbg_characterize.get();
+    for (auto &stats : noise_stats) stats.Reset();
+  }
+  if (characterize == 0) return;
+
+  if (characterize <= AdcChannels) {
+    uint16_t raw = adc_buff[latest_frame * AdcChannels + characterize - 1];
+    dbg_raw_sample.set(static_cast<float>(raw) * AdcFullScaleVolts /
+                       static_cast<float>(AdcMaxReading(adc_config.oversample_log2)));
+  }
+
+  for (int channel = 0; channel < AdcChannels; channel++) {
+    noise_stats[channel].Add(snapshot.voltages[channel].volts());
+    dbg_noise_rms.data[channel] = noise_stats[channel].rms() * 1000.f;
+    dbg_effective_bits.data[channel] = noise_stats[channel].effective_bits(AdcFullScaleVolts);
+  }
+  dbg_characterize_count.set(noise_stats[0].count());
+}
+
+void HalApi::AnalogAllowReconfiguration(bool allow) { reconfiguration_allowed = allow; }
+
+AnalogSnapshot HalApi::AnalogReadAll() {
+  // Apply new settings.  This is only done here, in the control loop, so that
+  // nothing reads the buffer while it changes.
+  AdcConfig requested = RequestedConfig();
+  if (reconfiguration_allowed && requested != adc_config) {
+    adc_config = requested;
+    StartConversions();
+    for (auto &stats : noise_stats) stats.Reset();
+  }
+  if (Now() < adc_settled) return last_snapshot;
+
+  AnalogSnapshot snapshot{.time = Now()};
+
+  // Same as AnalogRead(), but for all channels in a single pass over the
+  // buffer, so they're all sampled at the same time, up to their own
+  // windows.  Summing integers is also cheaper than floats.
+  uint32_t sums[AdcChannels] = {};
+  uint32_t latest = LatestFrame();
+  uint32_t frame = latest;
+  for (uint32_t i = 0; i < adc_timing.buffer_frames - 1; i++) {
+    for (int channel = 0; channel < AdcChannels; channel++) {
+      if (i < adc_timing.frames[channel]) sums[channel] += adc_buff[frame * AdcChannels + channel];
+    }
+    frame = PreviousFrame(frame);
+  }
+
+  for (int channel = 0; channel < AdcChannels; channel++) {
+    snapshot.voltages[channel] =
+        volts(static_cast<float>(sums[channel]) * adc_timing.scaler[channel]);
+  }
+  last_snapshot = snapshot;
 
-  return volts(sum * AdcScaler);
+  Characterize(snapshot, latest);
+  return snapshot;
 }
 
 #endif
@@ -0,0 +1,178 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+// A/D sampling settings, and the arithmetic that goes with them, kept apart
+// from adc.cpp so that it can be tested off the STM32.  See adc.cpp for how
+// the A/D and its DMA buffer work.
+
+#pragma once
+
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdint>
+
+#include "hal.h"
+#include "units.h"
+
+// Resolution of the ADC channels (in bits).
+// We are using the default value (which is also the highest possible one - see [RM] 16.4.22).
+static constexpr int AdcResolution = 12;
+
+// Full scale of the A/D inputs.
+static constexpr float AdcFullScaleVolts = 3.3f;
+
+// Oversampling ratios go up to 256 ([RM] 16.4.30).
+static constexpr uint32_t MaxOversampleLog2 = 8;
+
+// Set sample time ([RM] 16.4.12).
+enum class ADCSampleTimeReg : uint8_t {
+  S2p5 = 0,    // 2.5 clock cycles
+  S6p5 = 1,    // 6.5 clock cycles
+  S12p5 = 2,   // 12.5 clock cycles
+  S24p5 = 3,   // 24.5 clock cycles
+  S47p5 = 4,   // 47.5 clock cycles
+  S92p5 = 5,   // 92.5 clock cycles
+  S247p5 = 6,  // 247.5 clock cycles
+  S640p5 = 7   // 640.5 clock cycles
+};
+
+// Time of an A/D conversion in clock cycles (see [RM] 16.4.16):
+// sample time (in clock cycles, rounded up) + 12 (one per bit of resolution).
+constexpr uint32_t AdcConversionCycles(ADCSampleTimeReg sample_time) {
+  switch (sample_time) {
+    case ADCSampleTimeReg::S2p5:
+      return 3 + AdcResolution;
+    case ADCSampleTimeReg::S6p5:
+      return 7 + AdcResolution;
+    case ADCSampleTimeReg::S12p5:
+      return 13 + AdcResolution;
+    case ADCSampleTimeReg::S24p5:
+      return 25 + AdcResolution;
+    case ADCSampleTimeReg::S47p5:
+      return 48 + AdcResolution;
+    case ADCSampleTimeReg::S92p5:
+      return 93 + AdcResolution;
+    case ADCSampleTimeReg::S247p5:
+      return 248 + AdcResolution;
+    case ADCSampleTimeReg::S640p5:
+      return 640 + AdcResolution;
+  }
+  // All cases covered above (and GCC checks this).
+  __builtin_unreachable();
+}
+
+// [RM] 16.4.30: Oversampler (pg 425)
+// This gives the maximum A/D reading based on the number of samples.
+// It is the maximum value reached when summing all samples in a 16 bits (internal) register,
+// considering all samples have maximum value (2 ^ resolution).
+// In other words, it is 2 ^ resolution * Number of samples, maxed out at 2^16
+constexpr uint32_t AdcMaxReading(uint32_t oversample_log2) {
+  return (oversample_log2 >= (16 - AdcResolution)) ? 65536
+                                                    : (1 << (AdcResolution + oversample_log2));
+}
+
+// How the A/D inputs are sampled.
+//
+// The sample time is set per channel in hardware.  The oversampling ratio
+// can't be: it applies to all regular channels of the A/D.  Each channel's
+// reading is then the average of its samples over its own window, which is
+// how long it takes the A/D to go through all channels that many times.
+struct AdcConfig {
+  std::array<ADCSampleTimeReg, NumAnalogPins> sample_time;
+  std::array<Duration, NumAnalogPins> window;
+  uint32_t oversample_log2;
+
+  bool operator==(const AdcConfig &other) const {
+    return sample_time == other.sample_time && window == other.window &&
+           oversample_log2 == other.oversample_log2;
+  }
+  bool operator!=(const AdcConfig &other) const { return !(*this == other); }
+};
+
+// What the DMA buffer and the averaging look like for a given AdcConfig.
+//
+// A frame is one (oversampled) reading of each channel, in AnalogPin order.
+struct AdcTiming {
+  // clock_hz is the A/D clock, and max_frames the size of the DMA buffer.
+  AdcTiming(const AdcConfig &config, float clock_hz, uint32_t max_frames) {
+    uint32_t frame_cycles = 0;
+    for (ADCSampleTimeReg sample_time : config.sample_time) {
+      frame_cycles += AdcConversionCycles(sample_time) << config.oversample_log2;
+    }
+    frame_time_us = static_cast<float>(frame_cycles) * 1e6f / clock_hz;
+
+    buffer_frames = 0;
+    for (size_t i = 0; i < NumAnalogPins; ++i) {
+      float window_frames = static_cast<float>(config.window[i].microseconds()) / frame_time_us;
+      // Leave a spare frame for the DMA to write while the others are read.
+      frames[i] = static_cast<uint32_t>(
+          std::clamp(std::round(window_frames), 1.f, static_cast<float>(max_frames - 1)));
+      buffer_frames = std::max(buffer_frames, frames[i] + 1);
+      scaler[i] = AdcFullScaleVolts /
+                  static_cast<float>(AdcMaxReading(config.oversample_log2) * frames[i]);
+    }
+  }
+
+  // Delay of a channel's reading behind its input, for slow changes: half
+  // its window.
+  float group_delay_ms(size_t channel) const {
+    return frame_time_us * static_cast<float>(frames[channel]) / 2.f / 1000.f;
+  }
+
+  // Frames can be too short for Duration's resolution.
+  float frame_time_us;
+  // Frames each channel is averaged over.
+  std::array<uint32_t, NumAnalogPins> frames;
+  // Frames the DMA goes through before wrapping around.
+  uint32_t buffer_frames;
+  // Converts the sum of a channel's readings over its frames into volts.
+  std::array<float, NumAnalogPins> scaler;
+};
+
+// Running mean and standard deviation of a reading (Welford's algorithm), to
+// characterize A/D noise while the input is steady.
+class AdcNoiseStats {
+ public:
+  void Reset() { *this = AdcNoiseStats(); }
+
+  void Add(float value) {
+    count_++;
+    float delta = value - mean_;
+    mean_ += delta / static_cast<float>(count_);
+    sum_squares_ += delta * (value - mean_);
+  }
+
+  uint32_t count() const { return count_; }
+  float mean() const { return mean_; }
+
+  // Standard deviation, i.e. RMS of the noise.
+  float rms() const {
+    return count_ < 2 ? 0.f : std::sqrt(sum_squares_ / static_cast<float>(count_ - 1));
+  }
+
+  // Resolution of an ideal converter with the same full scale, whose
+  // quantization noise (a step / sqrt(12)) is as large as the noise measured.
+  float effective_bits(float full_scale) const {
+    float noise = rms();
+    if (noise <= 0) return static_cast<float>(AdcResolution);
+    return std::log2(full_scale / (noise * std::sqrt(12.f)));
+  }
+
+ private:
+  uint32_t count_{0};
+  float mean_{0};
+  float sum_squares_{0};
+};
@@ -67,6 +67,18 @@ class CircularBuffer {
     return val;
   }
 
+  // Get the element `index` places after the oldest one, without removing it
+  // from the buffer.
+  std::optional<T> Peek(size_t index) const {
+    BlockInterrupts block;
+
+    if (index >= FullCount()) {
+      return std::nullopt;
+    }
+
+    return buffer_[(static_cast<size_t>(tail_) + index) % (N + 1)];
+  }
+
   // Add an element to the buffer.
   //
   // Returns false if the buffer is full.
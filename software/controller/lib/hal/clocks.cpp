@@ -198,6 +198,13 @@ void enable_peripheral_clock(const PeripheralID id) {
   RccBase->peripheral_clock_enable[static_cast<uint8_t>(mapping.offset)] |= (1 << mapping.bit);
 }
 
+uint32_t take_reset_flags() {
+  uint32_t flags = RccBase->status & 0xFF000000;
+  // Writing the RMVF bit clears all the reset flags
+  RccBase->status |= (1 << 23);
+  return flags;
+}
+
 void configure_pll() {
   // We use the MSI clock as the source for the PLL.
   // MSI clock is running at its default frequency of 4MHz.
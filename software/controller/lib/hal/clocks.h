@@ -82,3 +82,11 @@ enum class PeripheralID {
 void enable_peripheral_clock(PeripheralID);
 
 void configure_pll();
+
+// Flags in RCC_CSR telling what caused the last reset [RM] 6.4.29 (pg 239)
+inline constexpr uint32_t ResetFlagIndependentWatchdog = 1 << 29;
+inline constexpr uint32_t ResetFlagWindowWatchdog = 1 << 30;
+
+// Returns the reset flags, and clears them so that they only ever describe the latest reset.
+// Once set, a flag stays set across further resets until it is cleared.
+uint32_t take_reset_flags();
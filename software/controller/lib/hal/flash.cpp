@@ -16,6 +16,8 @@ limitations under the License.
 
 #include "flash.h"
 
+#include <cstring>
+
 #include "hal.h"
 #include "hal_stm32.h"
 
@@ -61,6 +63,11 @@ static inline void LockFlash(FlashReg *reg) { reg->control.flash_lock = 1; }
 bool HalApi::FlashErasePage(uint32_t addr) {
   if (!ValidFlashParameters(addr, FlashPageSize)) return false;
 
+  // The event log writes flash from the loop timer interrupt, which mustn't
+  // break into an erase or a write from the background loop.  Interrupt
+  // handlers are fetched from flash, so they'd wait for it anyway.
+  BlockInterrupts block;
+
   // Clear all the status bits
   FlashReg *reg = FlashBase;
   reg->status = 0x0000C3FB;
@@ -87,6 +94,7 @@ bool HalApi::FlashErasePage(uint32_t addr) {
 
 bool HalApi::FlashWrite(uint32_t addr, void *data, size_t ct) {
   if (!ValidFlashParameters(addr, ct)) return false;
+  BlockInterrupts block;  // See FlashErasePage()
   FlashReg *reg = FlashBase;
 
   // Clear all the status bits
@@ -121,4 +129,9 @@ bool HalApi::FlashWrite(uint32_t addr, void *data, size_t ct) {
   return !(reg->status & 0x0000C3FA);
 }
 
+void HalApi::FlashRead(uint32_t addr, void *data, size_t ct) {
+  // Flash is mapped in the address space, so there's nothing special about reading it.
+  memcpy(data, reinterpret_cast<const void *>(addr), ct);
+}
+
 #endif
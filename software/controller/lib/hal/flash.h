@@ -21,5 +21,20 @@ limitations under the License.
 
 // Flash memory location & size info
 inline constexpr uint32_t FlashStartAddr{0x08000000};
-inline constexpr size_t FlashSize{32 * 1024};
+inline constexpr size_t FlashSize{512 * 1024};
 inline constexpr size_t FlashPageSize{2 * 1024};
+
+// The linker script keeps the program out of the last two pages of flash, so
+// that we can store data there.
+inline constexpr uint32_t ReservedFlashAddr{FlashStartAddr + FlashSize - 2 * FlashPageSize};
+inline constexpr size_t ReservedFlashSize{2 * FlashPageSize};
+
+// And out of the 256K before those, for the event log (see EventLog).
+inline constexpr size_t LogFlashSize{128 * FlashPageSize};
+inline constexpr uint32_t LogFlashAddr{ReservedFlashAddr - LogFlashSize};
+
+// The program gets the rest: LENGTH of FLASH in the linker script, which fails
+// the link ("region `FLASH' overflowed") if the firmware doesn't fit.
+inline constexpr size_t ProgramFlashSize{252 * 1024};
+static_assert(FlashStartAddr + ProgramFlashSize == LogFlashAddr,
+              "Keep FLASH in platformio/build_config/stm32_ldscript.ld in sync");
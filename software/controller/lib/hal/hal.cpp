@@ -1,3 +1,54 @@
 #include "hal.h"
 
+#ifdef TEST_MODE
+#include <algorithm>
+#include <random>
+#endif
+
 HalApi hal;
+
+#ifdef TEST_MODE
+
+void HalApi::TESTRaiseLoopTimer() {
+  loop_timer_pending_ = true;
+  TESTDispatchLoopTimer();
+}
+
+void HalApi::TESTDispatchLoopTimer() {
+  // If the callback raises the interrupt again, it runs again right after, as
+  // it would on the STM32.
+  while (loop_timer_pending_ && interrupts_enabled_ && !in_interrupt_handler_ &&
+         loop_timer_callback_) {
+    loop_timer_pending_ = false;
+    in_interrupt_handler_ = true;
+    loop_timer_runs_++;
+    loop_timer_callback_(loop_timer_arg_);
+    in_interrupt_handler_ = false;
+  }
+}
+
+void HalApi::TESTPreemptionPoint() {
+  // The callback doesn't preempt itself.
+  if (in_interrupt_handler_ || !should_preempt_) return;
+  if (should_preempt_(preemption_points_++)) TESTRaiseLoopTimer();
+}
+
+void HalApi::TESTSetPreemption(std::function<bool(uint32_t n)> should_preempt) {
+  should_preempt_ = std::move(should_preempt);
+  preemption_points_ = 0;
+}
+
+void HalApi::TESTPreemptAt(std::vector<uint32_t> points) {
+  TESTSetPreemption([points = std::move(points)](uint32_t n) {
+    return std::find(points.begin(), points.end(), n) != points.end();
+  });
+}
+
+void HalApi::TESTPreemptRandomly(double probability, uint32_t seed) {
+  TESTSetPreemption([generator = std::mt19937(seed),
+                     distribution = std::bernoulli_distribution(probability)](uint32_t) mutable {
+    return distribution(generator);
+  });
+}
+
+#endif  // TEST_MODE
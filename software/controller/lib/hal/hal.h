@@ -34,7 +34,11 @@ limitations under the License.
 #include <stdint.h>
 
 #include <algorithm>
+#include <array>
 
+#include "flash.h"
+#include "loop_timing.h"
+#include "serial_listeners.h"
 #include "units.h"
 
 #ifdef TEST_MODE
@@ -47,6 +51,7 @@ limitations under the License.
 
 #include <cstring>
 #include <deque>
+#include <functional>
 #include <map>
 #include <vector>
 
@@ -89,6 +94,18 @@ enum class AnalogPin {
   U5ExhaleFlow,
   InterimBoardOxygenSensor,
 };
+// Keep this in sync with the AnalogPin enum above
+constexpr size_t NumAnalogPins{5};
+
+// Voltages of all the analog inputs, averaged over the same window of A/D
+// samples.
+struct AnalogSnapshot {
+  // When it was taken, i.e. the end of the window.
+  Time time;
+  std::array<Voltage, NumAnalogPins> voltages;
+
+  Voltage operator[](AnalogPin pin) const { return voltages[static_cast<size_t>(pin)]; }
+};
 
 // Pulse-width modulated outputs from the controller.  These can be set to
 // values in [0-255].
@@ -130,6 +147,10 @@ enum class IntPriority {
 
 enum class InterruptVector;
 
+// Baud rate the GUI serial link starts at, and falls back to if a faster rate
+// doesn't work out.
+static constexpr uint32_t SerialDefaultBaudRate = 115200;
+
 #ifdef TEST_MODE
 class TestSerialPort {
  public:
@@ -138,6 +159,7 @@ class TestSerialPort {
   uint16_t BytesAvailableForWrite();
   uint16_t BytesAvailableForRead();
   void PutIncomingData(const char *data, uint16_t len);
+  void PutOutgoingData(const char *data, uint16_t len);
   uint16_t GetOutgoingData(char *data, uint16_t len);
 
  private:
@@ -146,6 +168,37 @@ class TestSerialPort {
 };
 #endif  // TEST_MODE
 
+// Why the processor crashed.  Faults are numbered after their exception
+// number [PM] 2.3.2.
+enum class CrashReason : uint32_t {
+  HardFault = 3,
+  MemManageFault = 4,
+  BusFault = 5,
+  UsageFault = 6,
+  // The control loop stopped petting the watchdog, which is about to reset
+  // the processor.
+  Watchdog = 0x100,
+};
+
+// State of the processor when it crashed, as passed to the crash handler (see
+// HalApi::SetCrashHandler).
+struct CrashInfo {
+  CrashReason reason;
+  // Registers saved by the processor when entering the exception, in the
+  // order it saves them: r0, r1, r2, r3, r12, lr, pc, xpsr.  For a watchdog
+  // crash, those of the code that was running when we noticed, which is most
+  // likely the code that's stuck.
+  uint32_t registers[8];
+  uint32_t stack_pointer;
+  // Fault status and address registers (CFSR, HFSR, MMFAR, BFAR) [PM] 4.4
+  uint32_t fault_status;
+  uint32_t hard_fault_status;
+  uint32_t mem_manage_fault_address;
+  uint32_t bus_fault_address;
+  uint32_t uptime_ms;
+  LoopTiming loop_timing;
+};
+
 // Singleton class which implements a hardware abstraction layer.
 //
 // Access this via the `hal` global variable, e.g. `hal.millis()`.
@@ -161,7 +214,7 @@ class HalApi {
   // program.
   //
   // Faked when testing.  Time doesn't advance unless you call Delay().
-  Time Now();
+  Time Now() const;
 
   // Sleeps for some number of milliseconds.
   //
@@ -181,6 +234,20 @@ class HalApi {
   // In test mode, will return the last value set via TESTSetAnalogPin.
   Voltage AnalogRead(AnalogPin pin) const;
 
+  // Reads all the analog inputs in one go, so that they're sampled at the
+  // same time.  Also cheaper than reading them one at a time.
+  //
+  // In test mode, pins never set read 0V.
+  AnalogSnapshot AnalogReadAll();
+
+  // Whether AnalogReadAll() may apply new A/D settings from the adc_* debug
+  // variables.  Its readings then stay as they were until the A/D's buffer
+  // has been refilled, which can take seconds, so the control loop only
+  // allows it while the ventilator is off.  Not allowed until this is called.
+  //
+  // Does nothing in test mode.
+  void AnalogAllowReconfiguration(bool allow);
+
 #ifdef TEST_MODE
   void TESTSetAnalogPin(AnalogPin pin, Voltage value);
 #endif
@@ -224,6 +291,30 @@ class HalApi {
   // Number of bytes we can write without blocking.
   uint16_t SerialBytesAvailableForWrite();
 
+  // Starts sending `len` bytes from `buf` to the GUI in the background, using
+  // DMA, and returns immediately.  This is much cheaper than SerialWrite for
+  // whole messages: the data isn't copied, and the CPU isn't interrupted for
+  // every byte.
+  //
+  // `buf` must not be modified until the transfer is done, which is signalled
+  // by a call to listener->on_tx_complete() or on_tx_error() from interrupt
+  // context.  Returns false, and does nothing, if the previous transfer is
+  // still in progress.
+  //
+  // Don't mix this with SerialWrite.
+  //
+  // Faked when testing: the data is "sent", and the listener called, before
+  // this returns.
+  [[nodiscard]] bool SerialStartTx(const uint8_t *buf, uint16_t len, TxListener *listener);
+
+  // Changes the baud rate of the serial link to the GUI.  Anything being
+  // received at the time is garbled, so only call this between messages.
+  // All serial ports start at SerialDefaultBaudRate.
+  //
+  // Returns false, and leaves the rate as it was, if the last byte sent is
+  // still on its way out.  This doesn't wait for it: try again later.
+  [[nodiscard]] bool SerialSetBaudRate(uint32_t baud);
+
   // Serial port used for debugging
   [[nodiscard]] uint16_t DebugWrite(const char *buf, uint16_t len);
   [[nodiscard]] uint16_t DebugRead(char *buf, uint16_t len);
@@ -252,6 +343,9 @@ class HalApi {
   //               NOTE - must be a multiple of 8
   bool FlashWrite(uint32_t addr, void *data, size_t ct);
 
+  // Read data from flash memory at the specified address
+  void FlashRead(uint32_t addr, void *data, size_t ct);
+
 #ifndef TEST_MODE
   // Translates to a numeric pin that can be passed to the Arduino API.
   uint8_t RawPin(PwmPin pin);
@@ -295,9 +389,57 @@ class HalApi {
   //
   void TESTSerialPutIncomingData(const char *data, uint16_t len);
 
+  // Last baud rate set via SerialSetBaudRate.
+  uint32_t TESTSerialBaudRate() const { return serial_baud_rate_; }
+
+  // Makes SerialSetBaudRate fail as if a byte were still being sent.
+  void TESTSerialSetTxBusy(bool busy) { serial_tx_busy_ = busy; }
+
   // Same as above, but for the debug serial port.
   uint16_t TESTDebugGetOutgoingData(char *data, uint16_t len);
   void TESTDebugPutIncomingData(const char *data, uint16_t len);
+
+  // Preemption simulator.
+  //
+  // Nothing ever interrupts the code under test on its own.  These functions
+  // run the loop timer callback (see StartLoopTimer) the way its interrupt
+  // would: in the middle of background code, deferred while interrupts are
+  // disabled until they're enabled again, and never nested within itself.
+  // That's what makes it possible to test code that shares data between the
+  // control loop and the background loop.
+  //
+  // The interrupt can only fire at preemption points, i.e. on calls to Now(),
+  // CycleCount(), DisableInterrupts() (just before disabling them) and
+  // TESTPreemptionPoint(), made from outside of the callback.  Code under test
+  // that doesn't call the HAL can be given preemption points by calling
+  // TESTPreemptionPoint() from a test double, e.g. a copy constructor.
+
+  // Raises the loop timer interrupt: runs the callback now if interrupts are
+  // enabled, or as soon as they are.
+  void TESTRaiseLoopTimer();
+
+  void TESTPreemptionPoint();
+
+  // Raises the interrupt at each preemption point for which
+  // should_preempt(n) is true, n counting points from 0 since this call.
+  void TESTSetPreemption(std::function<bool(uint32_t n)> should_preempt);
+
+  // Raises the interrupt at the given preemption points.
+  void TESTPreemptAt(std::vector<uint32_t> points);
+
+  // Raises the interrupt at each preemption point with the given probability,
+  // drawn from a generator seeded with `seed`, so that any failure can be
+  // reproduced.
+  void TESTPreemptRandomly(double probability, uint32_t seed);
+
+  // Back to never raising the interrupt on its own.
+  void TESTStopPreempting() { TESTSetPreemption(nullptr); }
+
+  // Number of preemption points since the last TESTSetPreemption, and
+  // number of times the callback ran.  Handy to pick points for
+  // TESTPreemptAt, and to check that a randomized test did preempt.
+  uint32_t TESTPreemptionPoints() const { return preemption_points_; }
+  uint32_t TESTLoopTimerRuns() const { return loop_timer_runs_; }
 #endif
 
   // Performs the device soft-reset
@@ -328,6 +470,47 @@ class HalApi {
   // Return true if we are currently executing in an interrupt handler
   bool InInterruptHandler();
 
+  // Free-running count of CPU cycles, for timing short stretches of code.  It
+  // wraps around (every ~54s on STM32), so only use differences between two
+  // readings.
+  //
+  // Faked when testing: counts the microseconds of Now().
+  uint32_t CycleCount();
+
+  // Longest time interrupts have been disabled by a BlockInterrupts since
+  // startup, or since the last ResetMaxInterruptsBlockedTime().
+  Duration MaxInterruptsBlockedTime();
+  void ResetMaxInterruptsBlockedTime() { max_interrupts_blocked_cycles_ = 0; }
+
+  // Sets the function to call when the processor crashes, i.e. on a fault, or
+  // when the control loop hasn't pet the watchdog for a while and it's about
+  // to reset us.  It's called from an exception handler with interrupts
+  // disabled, so that it's the last thing that runs, and the device resets
+  // when it returns.  It must keep petting the watchdog if it takes long.
+  //
+  // No-op when testing.
+  void SetCrashHandler(void (*handler)(const CrashInfo &info));
+
+  // What caused the last reset: bits 24 to 31 of RCC_CSR [RM] 6.4.29, e.g.
+  // bit 29 for the independent watchdog.
+  //
+  // Faked when testing: always 0.
+  uint32_t ResetFlags();
+
+  // Looks for the most stack ever used, a little at a time, so that it can be
+  // called on every pass of the background loop.  The results are debug
+  // variables (stack_max, stack_isr_max, isr_nesting_max).
+  //
+  // No-op when testing.
+  void ScanStack();
+
+  // Called by BlockInterrupts, with interrupts still disabled.
+  void NoteInterruptsBlocked(uint32_t cycles) {
+    if (cycles > max_interrupts_blocked_cycles_) {
+      max_interrupts_blocked_cycles_ = cycles;
+    }
+  }
+
  private:
   // Initializes watchdog, sets appropriate pins to Output, etc.  Called by
   // HalApi::Init
@@ -349,6 +532,8 @@ class HalApi {
   void SetDigitalPinMode(PwmPin pin, PinMode mode);
   void SetDigitalPinMode(BinaryPin pin, PinMode mode);
 
+  volatile uint32_t max_interrupts_blocked_cycles_{0};
+
 #ifdef TEST_MODE
   Time time_ = microsSinceStartup(0);
   bool interrupts_enabled_ = true;
@@ -367,6 +552,22 @@ class HalApi {
 
   TestSerialPort serial_port_;
   TestSerialPort debug_serial_port_;
+  uint32_t serial_baud_rate_ = SerialDefaultBaudRate;
+  bool serial_tx_busy_ = false;
+
+  // Starts erased, like the real thing.
+  std::vector<uint8_t> flash_ = std::vector<uint8_t>(FlashSize, 0xFF);
+
+  // Preemption simulator
+  void (*loop_timer_callback_)(void *) = nullptr;
+  void *loop_timer_arg_ = nullptr;
+  bool in_interrupt_handler_ = false;
+  bool loop_timer_pending_ = false;
+  std::function<bool(uint32_t)> should_preempt_;
+  uint32_t preemption_points_ = 0;
+  uint32_t loop_timer_runs_ = 0;
+  // Runs the callback if it's pending and can run.
+  void TESTDispatchLoopTimer();
 #endif
 };
 
@@ -381,11 +582,15 @@ extern HalApi hal;
 //
 // This class is reentrant, i.e. it's safe to BlockInterrupts even when
 // interrupts are already disabled.
+//
+// The outermost BlockInterrupts measures how long interrupts stay disabled;
+// see HalApi::MaxInterruptsBlockedTime().
 class [[nodiscard]] BlockInterrupts {
  public:
   BlockInterrupts() : active_(hal.InterruptsEnabled()) {
     if (active_) {
       hal.DisableInterrupts();
+      start_ = hal.CycleCount();
     }
   }
 
@@ -398,12 +603,14 @@ class [[nodiscard]] BlockInterrupts {
 
   ~BlockInterrupts() {
     if (active_) {
+      hal.NoteInterruptsBlocked(hal.CycleCount() - start_);
       hal.EnableInterrupts();
     }
   }
 
  private:
   bool active_;
+  uint32_t start_{0};
 };
 
 #if defined(BARE_STM32)
@@ -425,10 +632,33 @@ inline bool HalApi::InInterruptHandler() {
 #else
 inline void HalApi::Init() {}
 inline void HalApi::WatchdogHandler() {}
-
-inline Time HalApi::Now() { return time_; }
+inline void HalApi::ScanStack() {}
+inline uint32_t HalApi::ResetFlags() { return 0; }
+
+inline Time HalApi::Now() const {
+  // A preemption point stands for an interrupt, which may happen whatever the
+  // code being interrupted is allowed to change.
+  const_cast<HalApi *>(this)->TESTPreemptionPoint();
+  return time_;
+}
+inline uint32_t HalApi::CycleCount() {
+  TESTPreemptionPoint();
+  return static_cast<uint32_t>(time_.microsSinceStartup());
+}
+inline Duration HalApi::MaxInterruptsBlockedTime() {
+  return microseconds(max_interrupts_blocked_cycles_);
+}
 inline void HalApi::Delay(Duration d) { time_ = time_ + d; }
 inline Voltage HalApi::AnalogRead(AnalogPin pin) const { return analog_pin_values_.at(pin); }
+inline AnalogSnapshot HalApi::AnalogReadAll() {
+  AnalogSnapshot snapshot{.time = Now()};
+  for (size_t i = 0; i < NumAnalogPins; ++i) {
+    auto it = analog_pin_values_.find(static_cast<AnalogPin>(i));
+    snapshot.voltages[i] = it == analog_pin_values_.end() ? volts(0) : it->second;
+  }
+  return snapshot;
+}
+inline void HalApi::AnalogAllowReconfiguration(bool allow) {}
 inline void HalApi::TESTSetAnalogPin(AnalogPin pin, Voltage value) {
   analog_pin_values_[pin] = value;
 }
@@ -459,6 +689,21 @@ inline uint16_t HalApi::SerialWrite(const char *buf, uint16_t len) {
 inline uint16_t HalApi::SerialBytesAvailableForWrite() {
   return serial_port_.BytesAvailableForWrite();
 }
+inline bool HalApi::SerialStartTx(const uint8_t *buf, uint16_t len, TxListener *listener) {
+  // The fake port never runs out of room for a whole message.
+  serial_port_.PutOutgoingData(reinterpret_cast<const char *>(buf), len);
+  if (listener) {
+    listener->on_tx_complete();
+  }
+  return true;
+}
+inline bool HalApi::SerialSetBaudRate(uint32_t baud) {
+  if (serial_tx_busy_) {
+    return false;
+  }
+  serial_baud_rate_ = baud;
+  return true;
+}
 inline uint16_t HalApi::TESTSerialGetOutgoingData(char *data, uint16_t len) {
   return serial_port_.GetOutgoingData(data, len);
 }
@@ -485,10 +730,16 @@ inline void HalApi::TESTDebugPutIncomingData(const char *data, uint16_t len) {
   debug_serial_port_.PutIncomingData(data, len);
 }
 
-inline void HalApi::DisableInterrupts() { interrupts_enabled_ = false; }
-inline void HalApi::EnableInterrupts() { interrupts_enabled_ = true; }
+inline void HalApi::DisableInterrupts() {
+  TESTPreemptionPoint();
+  interrupts_enabled_ = false;
+}
+inline void HalApi::EnableInterrupts() {
+  interrupts_enabled_ = true;
+  TESTDispatchLoopTimer();
+}
 inline bool HalApi::InterruptsEnabled() const { return interrupts_enabled_; }
-inline bool HalApi::InInterruptHandler() { return false; }
+inline bool HalApi::InInterruptHandler() { return in_interrupt_handler_; }
 
 inline uint16_t TestSerialPort::Read(char *buf, uint16_t len) {
   if (incoming_data_.empty()) {
@@ -516,6 +767,9 @@ inline uint16_t TestSerialPort::BytesAvailableForWrite() {
   // the Arduino tx buffer.
   return 64;
 }
+inline void TestSerialPort::PutOutgoingData(const char *data, uint16_t len) {
+  outgoing_data_.insert(outgoing_data_.end(), data, data + len);
+}
 inline uint16_t TestSerialPort::GetOutgoingData(char *data, uint16_t len) {
   uint16_t n = std::min(len, static_cast<uint16_t>(outgoing_data_.size()));
   memcpy(data, outgoing_data_.data(), n);
@@ -532,13 +786,36 @@ inline void TestSerialPort::PutIncomingData(const char *data, uint16_t len) {
   incoming_data_.push_back(std::vector<char>(data, data + len));
 }
 
-inline void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), void *arg) {}
+inline void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), void *arg) {
+  loop_timer_callback_ = callback;
+  loop_timer_arg_ = arg;
+}
 
 inline void BuzzerOn(float volume) {}
 inline void BuzzerOff() {}
 inline void InitPSOL() {}
 inline void PSolValue(float val) {}
-inline bool HalApi::FlashErasePage(uint32_t address) { return true; }
-inline bool HalApi::FlashWrite(uint32_t addr, void *data, size_t ct) { return true; }
+inline bool HalApi::FlashErasePage(uint32_t address) {
+  if (address < FlashStartAddr || address >= FlashStartAddr + FlashSize ||
+      (address - FlashStartAddr) % FlashPageSize) {
+    return false;
+  }
+  std::fill_n(flash_.begin() + (address - FlashStartAddr), FlashPageSize, 0xFF);
+  return true;
+}
+inline bool HalApi::FlashWrite(uint32_t addr, void *data, size_t ct) {
+  if (addr < FlashStartAddr || addr + ct > FlashStartAddr + FlashSize || ct % 8 || addr % 8) {
+    return false;
+  }
+  uint8_t *dest = &flash_[addr - FlashStartAddr];
+  // Like on the STM32, flash has to be erased before it can be written again.
+  if (std::any_of(dest, dest + ct, [](uint8_t b) { return b != 0xFF; })) return false;
+  memcpy(dest, data, ct);
+  return true;
+}
+inline void HalApi::FlashRead(uint32_t addr, void *data, size_t ct) {
+  memcpy(data, &flash_.at(addr - FlashStartAddr), ct);
+}
+inline void HalApi::SetCrashHandler(void (*handler)(const CrashInfo &info)) {}
 
 #endif
@@ -26,6 +26,7 @@ Abbreviations [RM], [DS], etc are defined in hal/README.md.
 
 #include "hal_stm32.h"
 
+#include <algorithm>
 #include <cstdarg>
 #include <cstdio>
 #include <optional>
@@ -35,6 +36,8 @@ Abbreviations [RM], [DS], etc are defined in hal/README.md.
 #include "clocks.h"
 #include "gpio.h"
 #include "hal.h"
+#include "loop_timing.h"
+#include "stack_monitor.h"
 #include "stepper.h"
 #include "uart_dma.h"
 #include "vars.h"
@@ -44,12 +47,66 @@ Abbreviations [RM], [DS], etc are defined in hal/README.md.
 // This is the main stack used in our system.
 __attribute__((aligned(8))) uint32_t system_stack[SYSTEM_STACK_SIZE];
 
+// Stack usage monitoring.  The free part of the stack is painted at startup
+// (see HalApi::Init), and HalApi::ScanStack() looks for its high water mark.
+//
+// Interrupt handlers share the stack with the background loop, and nest on
+// top of each other by priority, so the high water mark alone doesn't tell who
+// used it.  We also keep track of the most stack in use whenever an interrupt
+// handler is entered, and of how deeply handlers nest.
+static StackMonitor stack_monitor(system_stack, system_stack + SYSTEM_STACK_SIZE);
+static uintptr_t isr_min_stack_pointer = UINTPTR_MAX;
+static uint32_t isr_nesting;
+static uint32_t isr_max_nesting;
+
+static Debug::Variable::UInt32 dbg_stack_size("stack_size", Debug::Variable::Access::ReadOnly,
+                                              SYSTEM_STACK_SIZE * sizeof(uint32_t), "bytes",
+                                              "Size of the system stack");
+static Debug::Variable::UInt32 dbg_stack_max("stack_max", Debug::Variable::Access::ReadOnly, 0,
+                                             "bytes", "Most of the system stack ever used");
+static Debug::Variable::UInt32 dbg_stack_isr_max(
+    "stack_isr_max", Debug::Variable::Access::ReadOnly, 0, "bytes",
+    "Most of the system stack in use on entry to an interrupt handler");
+static Debug::Variable::Primitive32 dbg_isr_nesting_max("isr_nesting_max",
+                                                        Debug::Variable::Access::ReadOnly,
+                                                        &isr_max_nesting, "",
+                                                        "Deepest nesting of interrupt handlers");
+
+static inline uintptr_t StackPointer() {
+  uintptr_t sp;
+  asm volatile("mov %0, sp" : "=r"(sp));
+  return sp;
+}
+
+// Wraps the interrupt handlers in the vector table, to track their stack usage.
+template <void (*Handler)()>
+static void TrackStack() {
+  uintptr_t sp = StackPointer();
+  if (sp < isr_min_stack_pointer) isr_min_stack_pointer = sp;
+  // A handler which interrupts us restores the nesting count before we resume.
+  uint32_t nesting = ++isr_nesting;
+  if (nesting > isr_max_nesting) isr_max_nesting = nesting;
+  Handler();
+  isr_nesting = nesting - 1;
+}
+
 // local data
 static volatile int64_t ms_count;
 
+// Crash handling, see CrashEntry()
+static void (*crash_handler)(const CrashInfo &info);
+static volatile bool watchdog_running;
+static volatile uint32_t watchdog_pet_ms;
+// The watchdog bites after about 250ms (see WatchdogInit), give up a bit
+// before that.
+static constexpr uint32_t WatchdogPreTimeoutMs{150};
+
 // local static functions.  I don't want to add any private
 // functions to the Hal class to avoid complexity with other
 // builds.
+static void InitLoopTiming();
+extern "C" void CrashEntry();
+
 // Those are Interrupt Service Routines, i.e callback functions for the
 // interrupt handlers. They are referenced in the Interrupt Vector Table.
 static void Timer6ISR();
@@ -124,6 +181,24 @@ void HalApi::EarlyInit() {
  * One time init of HAL.
  */
 void HalApi::Init() {
+  // Start the cycle counter, used to time critical sections.
+  *DebugMonitorControl |= DebugMonitorTraceEnable;
+  DwtBase->cycle_count = 0;
+  DwtBase->control |= 1;
+
+  // Do this before anything else has a chance to overwrite the loop timing
+  // record of the previous run.
+  InitLoopTiming();
+
+  // PendSV reports watchdog crashes, and needs to preempt the control loop
+  // (see CrashEntry).  Its priority is in bits 16-23 of SHPR3 [PM] 4.4.8
+  SysControlBase->system_priority[2] =
+      (SysControlBase->system_priority[2] & ~0x00FF0000) |
+      (static_cast<uint32_t>(IntPriority::Standard) << 4 << 16);
+
+  // Paint the free part of the stack, leaving some room for our own frame.
+  StackMonitor::Paint(system_stack, reinterpret_cast<uint32_t *>(StackPointer()) - 16);
+
   // Init various components needed by the system.
   InitGpio();
   InitSysTimer();
@@ -137,6 +212,23 @@ void HalApi::Init() {
   StepperMotorInit();
 }
 
+uint32_t HalApi::CycleCount() { return DwtBase->cycle_count; }
+
+void HalApi::ScanStack() {
+  // A full scan of an unused stack is a few thousand words, this spreads it
+  // over a few dozen calls.
+  stack_monitor.Scan(64);
+  dbg_stack_max.set(static_cast<uint32_t>(stack_monitor.high_water_mark()));
+  uintptr_t top = reinterpret_cast<uintptr_t>(system_stack + SYSTEM_STACK_SIZE);
+  if (isr_min_stack_pointer < top) {
+    dbg_stack_isr_max.set(static_cast<uint32_t>(top - isr_min_stack_pointer));
+  }
+}
+
+Duration HalApi::MaxInterruptsBlockedTime() {
+  return microseconds(max_interrupts_blocked_cycles_ / CPUFrequencyMhz);
+}
+
 // Reset the processor
 [[noreturn]] void HalApi::ResetDevice() {
   // Note that the system control registers are a standard ARM peripheral
@@ -260,6 +352,14 @@ void HalApi::InitSysTimer() {
 static void Timer6ISR() {
   Timer6Base->status = 0;
   ms_count++;
+
+  // The control loop is stuck, or at least very late: crash before the
+  // watchdog resets us without warning.
+  if (watchdog_running && crash_handler &&
+      static_cast<uint32_t>(ms_count) - watchdog_pet_ms > WatchdogPreTimeoutMs) {
+    // Set PendSV pending [PM] 4.4.3
+    SysControlBase->interrupt_control = 1 << 28;
+  }
 }
 
 void HalApi::Delay(Duration d) {
@@ -268,7 +368,7 @@ void HalApi::Delay(Duration d) {
   }
 }
 
-Time HalApi::Now() {
+Time HalApi::Now() const {
   // Disable interrupts so we can read ms_count and the timer state without
   // racing with the timer's interrupt handler.
   BlockInterrupts block_interrupts;
@@ -296,6 +396,7 @@ Time HalApi::Now() {
  *****************************************************************/
 static void (*controller_callback)(void *);
 static void *controller_arg;
+static uint32_t loop_timer_prescale = 1;
 void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), void *arg) {
   controller_callback = callback;
   controller_arg = arg;
@@ -315,6 +416,7 @@ void HalApi::StartLoopTimer(const Duration &period, void (*callback)(void *), vo
     prescale = static_cast<int>(reload / 65536.0) + 1;
     reload /= prescale;
   }
+  loop_timer_prescale = static_cast<uint32_t>(prescale);
 
   // Enable the clock to the timer
   enable_peripheral_clock(PeripheralID::Timer15);
@@ -348,20 +450,106 @@ static Debug::Variable::Primitive32 dbg_loop_time("loop_time", Debug::Variable::
                                                   &loop_time, "\xB5s", "Duration of loop function",
                                                   "%.2f");
 
+// Timing record of the loop function.  It lives in RAM that isn't cleared at
+// startup, so that it survives a watchdog reset; InitLoopTiming() saves it in
+// previous_loop_timing before starting a new one.
+[[gnu::section(".noinit")]] static LoopTiming loop_timing;
+static LoopTiming previous_loop_timing;
+
+static Debug::Variable::Primitive32 dbg_loop_overruns("loop_overruns",
+                                                      Debug::Variable::Access::ReadOnly,
+                                                      &loop_timing.overruns, "",
+                                                      "Number of times the loop function was "
+                                                      "still running when the next tick arrived");
+static Debug::Variable::Primitive32 dbg_loop_max_jitter("loop_max_jitter",
+                                                        Debug::Variable::Access::ReadOnly,
+                                                        &loop_timing.max_jitter_us, "\xB5s",
+                                                        "Maximum start latency of loop function");
+static Debug::Variable::Primitive32 dbg_loop_max_time("loop_max_time",
+                                                      Debug::Variable::Access::ReadOnly,
+                                                      &loop_timing.max_run_time_us, "\xB5s",
+                                                      "Maximum duration of loop function");
+static Debug::Variable::FloatArray<LoopTiming::JitterBins> dbg_loop_jitter_hist(
+    "loop_jitter_hist", Debug::Variable::Access::ReadOnly, 0.0f, "",
+    "Count of loop function start latencies, in bins of <2, <5, <10, <20, <50, <100, <1000 and "
+    ">=1000 \xB5s");
+
+static Debug::Variable::Primitive32 dbg_prev_loop_invocations(
+    "prev_loop_invocations", Debug::Variable::Access::ReadOnly,
+    &previous_loop_timing.invocations, "",
+    "Number of loop function calls before the last reset (0 if unknown)");
+static Debug::Variable::Primitive32 dbg_prev_loop_overruns(
+    "prev_loop_overruns", Debug::Variable::Access::ReadOnly, &previous_loop_timing.overruns, "",
+    "Number of loop function overruns before the last reset");
+static Debug::Variable::Primitive32 dbg_prev_loop_max_jitter(
+    "prev_loop_max_jitter", Debug::Variable::Access::ReadOnly,
+    &previous_loop_timing.max_jitter_us, "\xB5s",
+    "Maximum start latency of loop function before the last reset");
+static Debug::Variable::Primitive32 dbg_prev_loop_max_time(
+    "prev_loop_max_time", Debug::Variable::Access::ReadOnly,
+    &previous_loop_timing.max_run_time_us, "\xB5s",
+    "Maximum duration of loop function before the last reset");
+static Debug::Variable::FloatArray<LoopTiming::RecentCount> dbg_prev_loop_recent_time(
+    "prev_loop_recent_time", Debug::Variable::Access::ReadOnly, 0.0f, "\xB5s",
+    "Durations of the last loop function calls before the last reset, latest first");
+static Debug::Variable::Primitive32 dbg_watchdog_resets(
+    "watchdog_resets", Debug::Variable::Access::ReadOnly, &loop_timing.watchdog_resets, "",
+    "Number of consecutive watchdog resets leading up to this run");
+
+// Read by InitLoopTiming(), which clears them in RCC_CSR.
+static uint32_t reset_flags = 0;
+
+uint32_t HalApi::ResetFlags() { return reset_flags; }
+
+static void InitLoopTiming() {
+  reset_flags = take_reset_flags();
+  bool watchdog_reset = reset_flags & ResetFlagIndependentWatchdog;
+
+  uint32_t watchdog_resets = 0;
+  if (loop_timing.Valid()) {
+    previous_loop_timing = loop_timing;
+    if (watchdog_reset) watchdog_resets = loop_timing.watchdog_resets + 1;
+
+    size_t recent = std::min<size_t>(LoopTiming::RecentCount, loop_timing.invocations);
+    for (size_t i = 0; i < recent; i++) {
+      dbg_prev_loop_recent_time.data[i] = previous_loop_timing.Recent(i).run_time_us;
+    }
+  } else if (watchdog_reset) {
+    // Can't tell how many came before, but there was at least this one.
+    watchdog_resets = 1;
+  }
+
+  loop_timing.Reset();
+  loop_timing.watchdog_resets = watchdog_resets;
+}
+
 static void Timer15ISR() {
   uint32_t start = Timer15Base->counter;
+  uint32_t start_cycles = DwtBase->cycle_count;
   Timer15Base->status = 0;
 
-  // Keep track of loop latency in uSec
+  // The counter restarts from zero at each tick, so its value is how late we
+  // are.  Keep track of loop latency in uSec.
   // Also max latency since it was last zeroed
-  latency = static_cast<float>(start) * (1.0f / CPUFrequencyMhz);
+  uint32_t jitter_us = start * loop_timer_prescale / CPUFrequencyMhz;
+  latency = static_cast<float>(start * loop_timer_prescale) * (1.0f / CPUFrequencyMhz);
   if (latency > max_latency) max_latency = latency;
 
   // Call the function
   controller_callback(controller_arg);
 
-  uint32_t end = Timer15Base->counter;
-  loop_time = static_cast<float>(end - start) * (1.0f / CPUFrequencyMhz);
+  // The cycle counter doesn't wrap around at the timer period, so unlike the
+  // timer counter it still gives the right duration if we overran.
+  uint32_t run_time_us = (DwtBase->cycle_count - start_cycles) / CPUFrequencyMhz;
+  loop_time = static_cast<float>(run_time_us);
+
+  // If the next tick already arrived, the update flag we cleared on entry is
+  // set again, and this interrupt will fire again as soon as we return.
+  bool overrun = Timer15Base->status & 1;
+  loop_timing.Record(jitter_us, run_time_us, overrun);
+  for (size_t i = 0; i < LoopTiming::JitterBins; i++) {
+    dbg_loop_jitter_hist.data[i] = static_cast<float>(loop_timing.jitter_histogram[i]);
+  }
 
   // Start sending any queued commands to the stepper motor
   StepMotor::StartQueuedCommands();
@@ -458,7 +646,7 @@ class UART {
 
   void Init(uint32_t baud) {
     // Set baud rate register
-    uart_->baudrate = CPUFrequencyHz / baud;
+    uart_->baudrate = BaudRateDivisor(baud);
 
     uart_->control_reg1.bitfield.rx_interrupt = 1;  // enable receive interrupt
     uart_->control_reg1.bitfield.tx_enable = 1;     // enable transmitter
@@ -466,6 +654,22 @@ class UART {
     uart_->control_reg1.bitfield.enable = 1;        // enable uart
   }
 
+  // Changes the baud rate of an initialized UART.
+  //
+  // The baud rate register can only be written while the UART is disabled
+  // ([RM] 38.8.4), and disabling it cuts off whatever is being sent.  So
+  // until the last byte has left the shift register, we leave the rate as it
+  // is and return false, and the caller tries again later.
+  [[nodiscard]] bool SetBaud(uint32_t baud) {
+    if (!uart_->status.bitfield.tx_complete) {
+      return false;
+    }
+    uart_->control_reg1.bitfield.enable = 0;
+    uart_->baudrate = BaudRateDivisor(baud);
+    uart_->control_reg1.bitfield.enable = 1;
+    return true;
+  }
+
   // This is the interrupt handler for the UART.
   void ISR() {
     // Check for overrun error and framing errors.  Clear those errors if
@@ -545,13 +749,20 @@ class UART {
   // Returns the number of free locations in the
   // transmit buffer.
   uint16_t TxFree() { return static_cast<uint16_t>(tx_data_.FreeCount()); }
+
+ private:
+  // With 16x oversampling the baud rate is simply the UART clock divided by
+  // this ([RM] 38.5.5).  Rounding rather than truncating keeps the error at
+  // 921600 baud to 0.2% instead of 0.9%.
+  static uint32_t BaudRateDivisor(uint32_t baud) { return (CPUFrequencyHz + baud / 2) / baud; }
 };
 
 static UART rpi_uart(Uart3Base);
 static UART debug_uart(Uart2Base);
-#ifdef UART_VIA_DMA
-extern UartDma dma_uart;
-#endif
+// Sends ControllerStatus to the GUI straight out of the caller's buffer, while
+// rpi_uart keeps handling reception (and the baud rate) on the same UART.
+// DMA1 channel 2 is index 1, channel 3 is index 2.
+UartDma uart_dma(Uart3Base, Dma1Base, /*tx_channel=*/1, /*rx_channel=*/2, /*match_char=*/0);
 // The UART that talks to the rPi uses the following pins:
 //    PB10 - TX
 //    PB11 - RX
@@ -575,9 +786,7 @@ void HalApi::InitUARTs() {
   //        Need to do that as soon as the boards are available.
   enable_peripheral_clock(PeripheralID::USART2);
   enable_peripheral_clock(PeripheralID::USART3);
-#ifdef UART_VIA_DMA
   enable_peripheral_clock(PeripheralID::DMA1);
-#endif
   // [DS] Table 17 (pg 76)
   GPIO::alternate_function(GPIO::Port::A, /*pin =*/2,
                            GPIO::AlternativeFuncion::AF7);  // USART2_TX
@@ -594,10 +803,12 @@ void HalApi::InitUARTs() {
   GPIO::alternate_function(GPIO::Port::B, /*pin =*/14,
                            GPIO::AlternativeFuncion::AF7);  // USART3_RTS_DE
 
+  DmaCtrl(Dma1Base).init();
 #ifdef UART_VIA_DMA
-  dma_uart.Init(115200);
+  uart_dma.init(SerialDefaultBaudRate);
 #else
-  rpi_uart.Init(115200);
+  rpi_uart.Init(SerialDefaultBaudRate);
+  uart_dma.init_tx();
 #endif
   debug_uart.Init(115200);
 
@@ -621,6 +832,12 @@ uint16_t HalApi::SerialWrite(const char *buf, uint16_t len) { return rpi_uart.Wr
 
 uint16_t HalApi::SerialBytesAvailableForWrite() { return rpi_uart.TxFree(); }
 
+bool HalApi::SerialStartTx(const uint8_t *buf, uint16_t len, TxListener *listener) {
+  return uart_dma.start_tx(buf, len, listener);
+}
+
+bool HalApi::SerialSetBaudRate(uint32_t baud) { return rpi_uart.SetBaud(baud); }
+
 uint16_t HalApi::DebugWrite(const char *buf, uint16_t len) { return debug_uart.Write(buf, len); }
 
 uint16_t HalApi::DebugRead(char *buf, uint16_t len) { return debug_uart.Read(buf, len); }
@@ -664,25 +881,84 @@ void HalApi::WatchdogInit() {
 
   // Reset the timer.  This also locks the registers again.
   wdog->key = 0xAAAA;
+  watchdog_pet_ms = static_cast<uint32_t>(ms_count);
+  watchdog_running = true;
 }
 
 // Pet the watchdog so it doesn't bite us.
 void HalApi::WatchdogHandler() {
   WatchdogReg *wdog = WatchdogBase;
   wdog->key = 0xAAAA;
+  watchdog_pet_ms = static_cast<uint32_t>(ms_count);
 }
 
-// Fault handler
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wunused-function"
-[[noreturn]] static void Fault() {
-  while (true) {
-    ;  // noop
-    /* \todo this function is unused; could be made useful if implementation
-     * made sense? blink lights? scream? do something? */
-  }
+/******************************************************************
+ * Crash handling
+ *
+ * Faults end up in CrashEntry(), which gathers the state of the
+ * processor for the crash handler set by the application (that
+ * typically saves it to flash), and then resets.
+ *
+ * The watchdog resets the processor without warning, so Timer6ISR
+ * keeps an eye on when it was last pet, and gives up a little before
+ * it bites, by setting the PendSV exception pending.  PendSV also
+ * goes to CrashEntry(), and it runs as soon as the timer interrupt
+ * returns, instead of the code the timer interrupted.  That code's
+ * registers are still on the stack, so we can tell where it was
+ * stuck.
+ *****************************************************************/
+static constexpr uint32_t PendSVException{14};
+
+void HalApi::SetCrashHandler(void (*handler)(const CrashInfo &info)) { crash_handler = handler; }
+
+// Called by CrashEntry with the exception frame the processor pushed on the
+// stack, and the EXC_RETURN value it left in lr [PM] 2.3.7
+// NOLINTNEXTLINE(readability-identifier-naming)
+extern "C" [[noreturn]] [[gnu::used]] void Crash(const uint32_t *frame, uint32_t exc_return) {
+  hal.DisableInterrupts();
+
+  // If the crash handler itself crashes, don't try again.
+  static bool crashing = false;
+  if (crashing) hal.ResetDevice();
+  crashing = true;
+
+  // Number of the exception we're handling [PM] 2.1.3
+  uint32_t exception;
+  asm volatile("mrs %0, ipsr" : "=r"(exception));
+  exception &= 0x1FF;
+
+  CrashInfo info;
+  info.reason = exception == PendSVException ? CrashReason::Watchdog
+                                             : static_cast<CrashReason>(exception);
+  std::copy(frame, frame + 8, info.registers);
+  // Find the stack pointer from before the exception: the frame has 8 words,
+  // or 26 with floating point registers (bit 4 of EXC_RETURN clear), and one
+  // more if the processor had to align it (bit 9 of the saved xPSR set).
+  size_t frame_words = (exc_return & (1 << 4)) ? 8 : 26;
+  if (frame[7] & (1 << 9)) frame_words++;
+  info.stack_pointer = static_cast<uint32_t>(reinterpret_cast<uintptr_t>(frame + frame_words));
+  SysControlReg *sys_ctl = SysControlBase;
+  info.fault_status = sys_ctl->fault_status;
+  info.hard_fault_status = sys_ctl->hard_fault_status;
+  info.mem_manage_fault_address = sys_ctl->mm_fault_address;
+  info.bus_fault_address = sys_ctl->bus_fault_addr;
+  info.uptime_ms = static_cast<uint32_t>(ms_count);
+  info.loop_timing = loop_timing;
+
+  if (crash_handler) crash_handler(info);
+  hal.ResetDevice();
+}
+
+// Entry point of all fault exceptions, and of PendSV, which we only use for
+// watchdog crashes.  Naked, so that the stack pointer still points at the
+// exception frame.
+// NOLINTNEXTLINE(readability-identifier-naming)
+extern "C" [[gnu::naked]] void CrashEntry() {
+  asm volatile(
+      "mov r0, sp\n"
+      "mov r1, lr\n"
+      "b Crash\n");
 }
-#pragma GCC diagnostic pop
 
 static void StepperISR() { StepMotor::DmaISR(); }
 
@@ -692,12 +968,7 @@ static void StepperISR() { StepMotor::DmaISR(); }
  * very start of the flash memory.
  *****************************************************************/
 
-// TODO: these could optionally call Fault() but not in production
 static void NMI() {}
-static void FaultISR() {}
-static void MPUFaultISR() {}
-static void BusFaultISR() {}
-static void UsageFaultISR() {}
 static void BadISR() {}
 
 // We don't control this function's name, silence the style check
@@ -721,110 +992,109 @@ __attribute__((used)) __attribute__((section(".isr_vector"))) void (*const Vecto
 
     // The rest of the table is a list of exception and interrupt handlers.
     // [RM] chapter 12 (NVIC) gives a listing of the vector table offsets.
-    NMI,            //   2 - 0x008 The NMI handler
-    FaultISR,       //   3 - 0x00C The hard fault handler
-    MPUFaultISR,    //   4 - 0x010 The MPU fault handler
-    BusFaultISR,    //   5 - 0x014 The bus fault handler
-    UsageFaultISR,  //   6 - 0x018 The usage fault handler
-    BadISR,         //   7 - 0x01C Reserved
-    BadISR,         //   8 - 0x020 Reserved
-    BadISR,         //   9 - 0x024 Reserved
-    BadISR,         //  10 - 0x028 Reserved
-    BadISR,         //  11 - 0x02C SVCall handler
-    BadISR,         //  12 - 0x030 Debug monitor handler
-    BadISR,         //  13 - 0x034 Reserved
-    BadISR,         //  14 - 0x038 The PendSV handler
-    BadISR,         //  15 - 0x03C SysTick
-    BadISR,         //  16 - 0x040
-    BadISR,         //  17 - 0x044
-    BadISR,         //  18 - 0x048
-    BadISR,         //  19 - 0x04C
-    BadISR,         //  20 - 0x050
-    BadISR,         //  21 - 0x054
-    BadISR,         //  22 - 0x058
-    BadISR,         //  23 - 0x05C
-    BadISR,         //  24 - 0x060
-    BadISR,         //  25 - 0x064
-    BadISR,         //  26 - 0x068
-    BadISR,         //  27 - 0x06C
+    NMI,                          //   2 - 0x008 The NMI handler
+    CrashEntry,                   //   3 - 0x00C The hard fault handler
+    CrashEntry,                   //   4 - 0x010 The MPU fault handler
+    CrashEntry,                   //   5 - 0x014 The bus fault handler
+    CrashEntry,                   //   6 - 0x018 The usage fault handler
+    BadISR,                       //   7 - 0x01C Reserved
+    BadISR,                       //   8 - 0x020 Reserved
+    BadISR,                       //   9 - 0x024 Reserved
+    BadISR,                       //  10 - 0x028 Reserved
+    BadISR,                       //  11 - 0x02C SVCall handler
+    BadISR,                       //  12 - 0x030 Debug monitor handler
+    BadISR,                       //  13 - 0x034 Reserved
+    CrashEntry,                   //  14 - 0x038 The PendSV handler
+    BadISR,                       //  15 - 0x03C SysTick
+    BadISR,                       //  16 - 0x040
+    BadISR,                       //  17 - 0x044
+    BadISR,                       //  18 - 0x048
+    BadISR,                       //  19 - 0x04C
+    BadISR,                       //  20 - 0x050
+    BadISR,                       //  21 - 0x054
+    BadISR,                       //  22 - 0x058
+    BadISR,                       //  23 - 0x05C
+    BadISR,                       //  24 - 0x060
+    BadISR,                       //  25 - 0x064
+    BadISR,                       //  26 - 0x068
+    BadISR,                       //  27 - 0x06C
+    TrackStack<DMA1Channel2ISR>,  //  28 - 0x070 DMA1 CH2
 #ifdef UART_VIA_DMA
-    DMA1Channel2ISR,  //  28 - 0x070 DMA1 CH2
-    DMA1Channel3ISR,  //  29 - 0x074 DMA1 CH3
+    TrackStack<DMA1Channel3ISR>,  //  29 - 0x074 DMA1 CH3
 #else
-    BadISR,  //  28 - 0x070
     BadISR,  //  29 - 0x074
 #endif
-    BadISR,           //  30 - 0x078
-    BadISR,           //  31 - 0x07C
-    BadISR,           //  32 - 0x080
-    BadISR,           //  33 - 0x084
-    BadISR,           //  34 - 0x088
-    BadISR,           //  35 - 0x08C
-    BadISR,           //  36 - 0x090
-    BadISR,           //  37 - 0x094
-    BadISR,           //  38 - 0x098
-    BadISR,           //  39 - 0x09C
-    Timer15ISR,       //  40 - 0x0A0
-    BadISR,           //  41 - 0x0A4
-    BadISR,           //  42 - 0x0A8
-    BadISR,           //  43 - 0x0AC
-    BadISR,           //  44 - 0x0B0
-    BadISR,           //  45 - 0x0B4
-    BadISR,           //  46 - 0x0B8
-    I2c1EventISR,     //  47 - 0x0BC I2C1 Events
-    I2c1ErrorISR,     //  48 - 0x0C0 I2C1 Errors
-    BadISR,           //  49 - 0x0C4
-    BadISR,           //  50 - 0x0C8
-    BadISR,           //  51 - 0x0CC
-    BadISR,           //  52 - 0x0D0
-    BadISR,           //  53 - 0x0D4
-    Uart2ISR,         //  54 - 0x0D8
-    Uart3ISR,         //  55 - 0x0DC
-    BadISR,           //  56 - 0x0E0
-    BadISR,           //  57 - 0x0E4
-    BadISR,           //  58 - 0x0E8
-    BadISR,           //  59 - 0x0EC
-    BadISR,           //  60 - 0x0F0
-    BadISR,           //  61 - 0x0F4
-    BadISR,           //  62 - 0x0F8
-    BadISR,           //  63 - 0x0FC
-    BadISR,           //  64 - 0x100
-    BadISR,           //  65 - 0x104
-    BadISR,           //  66 - 0x108
-    BadISR,           //  67 - 0x10C
-    BadISR,           //  68 - 0x110
-    BadISR,           //  69 - 0x114
-    Timer6ISR,        //  70 - 0x118
-    BadISR,           //  71 - 0x11C
-    BadISR,           //  72 - 0x120
-    BadISR,           //  73 - 0x124
-    StepperISR,       //  74 - 0x128
-    BadISR,           //  75 - 0x12C
-    BadISR,           //  76 - 0x130
-    BadISR,           //  77 - 0x134
-    BadISR,           //  78 - 0x138
-    BadISR,           //  79 - 0x13C
-    BadISR,           //  80 - 0x140
-    BadISR,           //  81 - 0x144
-    BadISR,           //  82 - 0x148
-    BadISR,           //  83 - 0x14C
-    DMA2Channel6ISR,  //  84 - 0x150
-    DMA2Channel7ISR,  //  85 - 0x154
-    BadISR,           //  86 - 0x158
-    BadISR,           //  87 - 0x15C
-    BadISR,           //  88 - 0x160
-    BadISR,           //  89 - 0x164
-    BadISR,           //  90 - 0x168
-    BadISR,           //  91 - 0x16C
-    BadISR,           //  92 - 0x170
-    BadISR,           //  93 - 0x174
-    BadISR,           //  94 - 0x178
-    BadISR,           //  95 - 0x17C
-    BadISR,           //  96 - 0x180
-    BadISR,           //  97 - 0x184
-    BadISR,           //  98 - 0x188
-    BadISR,           //  99 - 0x18C
-    BadISR,           // 100 - 0x190
+    BadISR,                       //  30 - 0x078
+    BadISR,                       //  31 - 0x07C
+    BadISR,                       //  32 - 0x080
+    BadISR,                       //  33 - 0x084
+    BadISR,                       //  34 - 0x088
+    BadISR,                       //  35 - 0x08C
+    BadISR,                       //  36 - 0x090
+    BadISR,                       //  37 - 0x094
+    BadISR,                       //  38 - 0x098
+    BadISR,                       //  39 - 0x09C
+    TrackStack<Timer15ISR>,       //  40 - 0x0A0
+    BadISR,                       //  41 - 0x0A4
+    BadISR,                       //  42 - 0x0A8
+    BadISR,                       //  43 - 0x0AC
+    BadISR,                       //  44 - 0x0B0
+    BadISR,                       //  45 - 0x0B4
+    BadISR,                       //  46 - 0x0B8
+    TrackStack<I2c1EventISR>,     //  47 - 0x0BC I2C1 Events
+    TrackStack<I2c1ErrorISR>,     //  48 - 0x0C0 I2C1 Errors
+    BadISR,                       //  49 - 0x0C4
+    BadISR,                       //  50 - 0x0C8
+    BadISR,                       //  51 - 0x0CC
+    BadISR,                       //  52 - 0x0D0
+    BadISR,                       //  53 - 0x0D4
+    TrackStack<Uart2ISR>,         //  54 - 0x0D8
+    TrackStack<Uart3ISR>,         //  55 - 0x0DC
+    BadISR,                       //  56 - 0x0E0
+    BadISR,                       //  57 - 0x0E4
+    BadISR,                       //  58 - 0x0E8
+    BadISR,                       //  59 - 0x0EC
+    BadISR,                       //  60 - 0x0F0
+    BadISR,                       //  61 - 0x0F4
+    BadISR,                       //  62 - 0x0F8
+    BadISR,                       //  63 - 0x0FC
+    BadISR,                       //  64 - 0x100
+    BadISR,                       //  65 - 0x104
+    BadISR,                       //  66 - 0x108
+    BadISR,                       //  67 - 0x10C
+    BadISR,                       //  68 - 0x110
+    BadISR,                       //  69 - 0x114
+    TrackStack<Timer6ISR>,        //  70 - 0x118
+    BadISR,                       //  71 - 0x11C
+    BadISR,                       //  72 - 0x120
+    BadISR,                       //  73 - 0x124
+    TrackStack<StepperISR>,       //  74 - 0x128
+    BadISR,                       //  75 - 0x12C
+    BadISR,                       //  76 - 0x130
+    BadISR,                       //  77 - 0x134
+    BadISR,                       //  78 - 0x138
+    BadISR,                       //  79 - 0x13C
+    BadISR,                       //  80 - 0x140
+    BadISR,                       //  81 - 0x144
+    BadISR,                       //  82 - 0x148
+    BadISR,                       //  83 - 0x14C
+    TrackStack<DMA2Channel6ISR>,  //  84 - 0x150
+    TrackStack<DMA2Channel7ISR>,  //  85 - 0x154
+    BadISR,                       //  86 - 0x158
+    BadISR,                       //  87 - 0x15C
+    BadISR,                       //  88 - 0x160
+    BadISR,                       //  89 - 0x164
+    BadISR,                       //  90 - 0x168
+    BadISR,                       //  91 - 0x16C
+    BadISR,                       //  92 - 0x170
+    BadISR,                       //  93 - 0x174
+    BadISR,                       //  94 - 0x178
+    BadISR,                       //  95 - 0x17C
+    BadISR,                       //  96 - 0x180
+    BadISR,                       //  97 - 0x184
+    BadISR,                       //  98 - 0x188
+    BadISR,                       //  99 - 0x18C
+    BadISR,                       // 100 - 0x190
 };
 
 // Enable an interrupt with a specified priority (0 to 15)
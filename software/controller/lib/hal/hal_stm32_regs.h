@@ -57,6 +57,18 @@ struct SysControlStruct {
 typedef volatile SysControlStruct SysControlReg;
 inline SysControlReg *const SysControlBase = reinterpret_cast<SysControlReg *>(0xE000E000);
 
+// Data watchpoint and trace unit (DWT), of which we only use the cycle
+// counter.  It's powered up by the trace_enable bit of the debug exception and
+// monitor control register (DEMCR).  See [ARMv7-M] C1.8 and C1.6.5.
+struct DwtStruct {
+  uint32_t control;      // 0xE0001000 DWT_CTRL, bit 0 enables the cycle counter
+  uint32_t cycle_count;  // 0xE0001004 DWT_CYCCNT
+};
+typedef volatile DwtStruct DwtReg;
+inline DwtReg *const DwtBase = reinterpret_cast<DwtReg *>(0xE0001000);
+inline volatile uint32_t *const DebugMonitorControl = reinterpret_cast<uint32_t *>(0xE000EDFC);
+static constexpr uint32_t DebugMonitorTraceEnable = 1 << 24;
+
 // Nested vectored interrupt controller (NVIC) [PM] 4.3 (pg 208)
 struct InterruptControlStruct {
   uint32_t set_enable[32];
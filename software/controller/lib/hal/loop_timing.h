@@ -0,0 +1,91 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Timing record of the control loop interrupt: how late each invocation
+// started relative to its timer tick (jitter), how long it ran, and how often
+// it was still running when the next tick arrived (overrun).
+//
+// The record is meant to live in RAM that isn't cleared at startup (see
+// .noinit in the linker script), so that after a watchdog reset we can still
+// tell whether the loop was running late before it happened.  Valid() tells
+// whether the memory actually holds a record, rather than whatever RAM
+// contained at power-on.
+struct LoopTiming {
+  // Upper bound (exclusive) of each histogram bin, in microseconds.  The last
+  // bin counts everything at or above the last bound.
+  static constexpr uint32_t JitterBinLimitsUs[] = {2, 5, 10, 20, 50, 100, 1000};
+  static constexpr size_t JitterBins = sizeof(JitterBinLimitsUs) / sizeof(uint32_t) + 1;
+
+  // Number of most recent invocations kept in full.
+  static constexpr size_t RecentCount = 16;
+
+  struct Invocation {
+    uint16_t jitter_us;
+    uint16_t run_time_us;
+  };
+
+  // Clears all counters and marks the record as valid.
+  void Reset() {
+    *this = LoopTiming();
+    magic = Magic;
+    magic_check = ~Magic;
+  }
+
+  bool Valid() const { return magic == Magic && magic_check == ~Magic; }
+
+  // Records one invocation of the loop: it started jitter_us after its tick,
+  // ran for run_time_us, and overran if the next tick had already arrived
+  // when it finished.
+  void Record(uint32_t jitter_us, uint32_t run_time_us, bool overrun) {
+    size_t bin = 0;
+    while (bin < JitterBins - 1 && jitter_us >= JitterBinLimitsUs[bin]) {
+      bin++;
+    }
+    jitter_histogram[bin]++;
+    if (jitter_us > max_jitter_us) max_jitter_us = jitter_us;
+    if (run_time_us > max_run_time_us) max_run_time_us = run_time_us;
+    if (overrun) overruns++;
+    recent[invocations % RecentCount] = {Saturate(jitter_us), Saturate(run_time_us)};
+    invocations++;
+  }
+
+  // Returns the n-th most recent invocation (0 is the latest).  n must be
+  // smaller than both RecentCount and invocations.
+  Invocation Recent(size_t n) const { return recent[(invocations - 1 - n) % RecentCount]; }
+
+  uint32_t magic{0};
+  uint32_t invocations{0};
+  uint32_t overruns{0};
+  uint32_t max_jitter_us{0};
+  uint32_t max_run_time_us{0};
+  uint32_t jitter_histogram[JitterBins]{};
+  Invocation recent[RecentCount]{};
+  // Number of consecutive watchdog resets this record has been carried
+  // across; maintained by the HAL at startup.
+  uint32_t watchdog_resets{0};
+  uint32_t magic_check{0};
+
+ private:
+  static constexpr uint32_t Magic = 0x4C4F4F50;  // "LOOP"
+
+  static uint16_t Saturate(uint32_t us) {
+    return us > UINT16_MAX ? UINT16_MAX : static_cast<uint16_t>(us);
+  }
+};
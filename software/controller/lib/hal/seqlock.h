@@ -0,0 +1,117 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stdint.h>
+
+#include <atomic>
+
+// Lock-free ways of handing data between the background loop and interrupt
+// handlers, without disabling interrupts for the length of a copy.
+//
+// Both rely on the way interrupts work on a single core: an interrupt handler
+// runs to completion before the code it interrupted resumes, and it can't be
+// interrupted by that code.  Neither is safe between two threads running in
+// parallel.
+//
+// Which one to use depends on which side can interrupt the other:
+//
+//  - SeqLock, when the writer interrupts the reader (e.g. the control loop
+//    publishing its status to the background loop).  The writer never waits;
+//    the reader notices when it's been interrupted by a write, and tries again.
+//
+//  - DoubleBuffer, when the reader interrupts the writer (e.g. the background
+//    loop handing new parameters to the control loop).  The reader can't wait
+//    for the writer, so the writer fills in a spare copy, and then makes it
+//    current with a single store.
+
+// std::atomic_signal_fence only stops the compiler from moving memory accesses
+// across it; that's all we need on a single core.
+inline void CompilerBarrier() { std::atomic_signal_fence(std::memory_order_seq_cst); }
+
+template <typename T>
+class SeqLock {
+ public:
+  SeqLock() = default;
+
+  // Modifies the data in place, by calling update(T &).  Must not be
+  // interrupted by a Read().
+  template <typename Fn>
+  void Update(Fn update) {
+    seq_ = seq_ + 1;
+    CompilerBarrier();
+    update(data_);
+    CompilerBarrier();
+    seq_ = seq_ + 1;
+  }
+
+  void Write(const T &value) {
+    Update([&](T &data) { data = value; });
+  }
+
+  // Returns a consistent copy of the data, i.e. one that wasn't modified
+  // halfway through.
+  T Read() const {
+    while (true) {
+      uint32_t seq = seq_;
+      CompilerBarrier();
+      // An odd sequence number means that we're reading from inside Update(),
+      // which is only possible if the data is read by a handler that
+      // interrupts the writer.  That's what DoubleBuffer is for.
+      T copy = data_;
+      CompilerBarrier();
+      if (seq % 2 == 0 && seq == seq_) {
+        return copy;
+      }
+      retries_ = retries_ + 1;
+    }
+  }
+
+  // Number of times Read() had to start over, for tests and statistics.
+  uint32_t retries() const { return retries_; }
+
+ private:
+  T data_{};
+  volatile uint32_t seq_{0};
+  mutable volatile uint32_t retries_{0};
+};
+
+template <typename T>
+class DoubleBuffer {
+ public:
+  DoubleBuffer() = default;
+
+  // Must not be interrupted by another Write().
+  void Write(const T &value) {
+    uint32_t spare = 1 - current_;
+    buffers_[spare] = value;
+    CompilerBarrier();
+    current_ = spare;
+  }
+
+  // The most recently written value.  The next Write() goes to the other
+  // buffer, so a reader that interrupts the writer can use this reference for
+  // as long as it's running.
+  const T &Read() const {
+    uint32_t current = current_;
+    CompilerBarrier();
+    return buffers_[current];
+  }
+
+ private:
+  T buffers_[2]{};
+  volatile uint32_t current_{0};
+};
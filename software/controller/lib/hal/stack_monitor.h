@@ -0,0 +1,73 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Finds out how much of a stack has been used, by filling ("painting") the
+// unused part with a known pattern, and later looking for the deepest word
+// that no longer holds it.
+//
+// The stack grows down, from the end of its memory towards the beginning.
+class StackMonitor {
+ public:
+  static constexpr uint32_t PaintPattern = 0xC5C5C5C5;
+
+  StackMonitor(const uint32_t *begin, const uint32_t *end)
+      : begin_(begin), end_(end), cursor_(begin) {}
+
+  // Fills [begin, end) with the pattern.  Mind that this must not include the
+  // caller's own stack frame.
+  static void Paint(uint32_t *begin, uint32_t *end) {
+    for (uint32_t *p = begin; p < end; p++) *p = PaintPattern;
+  }
+
+  // Number of bytes below end that have been written since [begin, end) was
+  // painted.
+  static size_t Used(const uint32_t *begin, const uint32_t *end) {
+    const uint32_t *p = begin;
+    while (p < end && *p == PaintPattern) p++;
+    return static_cast<size_t>(end - p) * sizeof(uint32_t);
+  }
+
+  // Continues looking for the high water mark, checking at most max_words
+  // words, so that it's cheap enough to call on every pass of the background
+  // loop.  A full pass goes from the beginning of the stack up to the previous
+  // high water mark, then starts over.
+  void Scan(size_t max_words) {
+    const uint32_t *limit = end_ - high_water_mark_ / sizeof(uint32_t);
+    for (size_t i = 0; i < max_words; i++) {
+      if (cursor_ >= limit || *cursor_ != PaintPattern) {
+        size_t used = static_cast<size_t>(end_ - cursor_) * sizeof(uint32_t);
+        if (used > high_water_mark_) high_water_mark_ = used;
+        cursor_ = begin_;
+        return;
+      }
+      cursor_++;
+    }
+  }
+
+  // Most bytes of the stack ever used, as of the last complete Scan() pass.
+  size_t high_water_mark() const { return high_water_mark_; }
+  size_t size() const { return static_cast<size_t>(end_ - begin_) * sizeof(uint32_t); }
+
+ private:
+  const uint32_t *begin_;
+  const uint32_t *end_;
+  const uint32_t *cursor_;
+  size_t high_water_mark_{0};
+};
@@ -14,7 +14,7 @@ limitations under the License.
 
 */
 
-#if defined(BARE_STM32) && defined(UART_VIA_DMA)
+#if defined(BARE_STM32)
 
 #include "uart_dma.h"
 
@@ -40,7 +40,6 @@ void UartDma::init(uint32_t baud) {
   uart_->baudrate = CPUFrequencyHz / baud;
 
   uart_->control3.bitfield.rx_dma = 1;  // set DMAR bit to enable DMA for receiver
-  uart_->control3.bitfield.tx_dma = 1;  // set DMAT bit to enable DMA for transmitter
   uart_->control3.bitfield.dma_disable_on_rx_error = 1;  // DMA disabled following a reception error
   uart_->control2.bitfield.rx_timeout_enable = 0;        // Disable receive timeout feature
   uart_->control2.bitfield.addr = match_char_;           // set match char
@@ -72,6 +71,14 @@ void UartDma::init(uint32_t baud) {
   rx_dma_config.circular = 0;              // not circular
   rx_dma_config.direction = static_cast<uint32_t>(DmaChannelDir::PeripheralToMemory);
 
+  init_tx();
+}
+
+// Sets up UART3 transmission over DMA.  Doesn't touch the baud rate or the
+// receiver.
+void UartDma::init_tx() {
+  uart_->control3.bitfield.tx_dma = 1;  // set DMAT bit to enable DMA for transmitter
+
   auto &tx_dma_config = dma_->channel[tx_channel_].config;
   tx_dma_config.priority = 0b11;            // high priority
   tx_dma_config.tx_error_interrupt = 1;     // interrupt on error
@@ -108,7 +115,7 @@ bool UartDma::rx_in_progress() const {
 // Returns false if DMA transmission is in progress, does not
 // interrupt previous transmission.
 // Returns true if no transmission is in progress
-bool UartDma::start_tx(uint8_t *buf, uint32_t length, TxListener *txl) {
+bool UartDma::start_tx(const uint8_t *buf, uint32_t length, TxListener *txl) {
   if (tx_in_progress()) {
     return false;
   }
@@ -281,6 +288,7 @@ void DMA1Channel2ISR() {
   dma->interrupt_clear.gif2 = 1;  // clear all channel 3 flags
 }
 
+#ifdef UART_VIA_DMA
 void DMA1Channel3ISR() {
   DmaReg *dma = Dma1Base;
   uart_dma.DMA_rx_interrupt_handler();
@@ -289,5 +297,6 @@ void DMA1Channel3ISR() {
 
 // This is the interrupt handler for the UART.
 void Uart3ISR() { uart_dma.UART_interrupt_handler(); }
+#endif
 
 #endif
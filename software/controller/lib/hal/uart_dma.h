@@ -47,8 +47,11 @@ class UartDma {
         match_char_(match_char) {}
 
   void init(uint32_t baud);
+  // Sets up transmission over DMA only, for use alongside an interrupt-driven
+  // receiver on the same UART, which is also responsible for the baud rate.
+  void init_tx();
 
-  [[nodiscard]] bool start_tx(uint8_t *buf, uint32_t length, TxListener *txl);
+  [[nodiscard]] bool start_tx(const uint8_t *buf, uint32_t length, TxListener *txl);
   [[nodiscard]] bool start_rx(uint8_t *buf, uint32_t length, RxListener *rxl);
 
   bool tx_in_progress() const;
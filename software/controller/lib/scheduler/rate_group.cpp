@@ -0,0 +1,53 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "rate_group.h"
+
+#include "hal.h"
+
+using DbgAccess = Debug::Variable::Access;
+
+RateGroup::RateGroup(const char *name, uint32_t divisor, Task task)
+    : divisor_(divisor > 0 ? divisor : 1),
+      task_(task),
+      dbg_exec_time_("exec_time", DbgAccess::ReadOnly, 0, "\xB5s",
+                     "Execution time of the last run of this rate group"),
+      dbg_max_exec_time_("max_exec_time", DbgAccess::ReadWrite, 0, "\xB5s",
+                         "Longest execution time of this rate group since last zeroed"),
+      dbg_misses_("deadline_misses", DbgAccess::ReadWrite, 0, "",
+                  "Number of times this rate group did not complete within its period") {
+  dbg_exec_time_.prepend_name(name);
+  dbg_max_exec_time_.prepend_name(name);
+  dbg_misses_.prepend_name(name);
+}
+
+void RateGroup::run(Time deadline) {
+  Time start = hal.Now();
+  task_(start);
+  Time end = hal.Now();
+
+  run_count_++;
+  last_exec_time_ = end - start;
+  dbg_exec_time_.set(static_cast<uint32_t>(last_exec_time_.microseconds()));
+
+  // The max can be zeroed through the debug interface, so it is re-read every time.
+  if (static_cast<uint32_t>(last_exec_time_.microseconds()) > dbg_max_exec_time_.get()) {
+    dbg_max_exec_time_.set(static_cast<uint32_t>(last_exec_time_.microseconds()));
+  }
+
+  if (end > deadline) {
+    dbg_misses_.set(dbg_misses_.get() + 1);
+  }
+}
@@ -0,0 +1,66 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "units.h"
+#include "vars.h"
+
+/*! \class RateGroup rate_group.h "rate_group.h"
+ *  \brief A job that runs from the loop timer interrupt at a fixed multiple of the loop period.
+ *
+ * A rate group is statically allocated and handed to a Scheduler (see scheduler.h), which calls
+ * run() once every `divisor` loop timer ticks.  The group's deadline is its own period: if its task
+ * has not completed by the time the group is due again, that is counted as a deadline miss.
+ *
+ * Each group publishes its execution time and miss count as debug variables, all prefixed by the
+ * group's name.
+ */
+class RateGroup {
+ public:
+  using Task = void (*)(Time now);
+
+  /*! \param name prefix for the group's debug variables, e.g. "ctrl_"
+   *  \param divisor group period, in units of the scheduler's base period; must be > 0
+   *  \param task function to call when the group is due
+   */
+  RateGroup(const char *name, uint32_t divisor, Task task);
+
+  uint32_t divisor() const { return divisor_; }
+
+  /*! \brief Runs the group's task and updates its statistics.
+   *  \param deadline time by which the task should have completed, i.e. the time at which the
+   *         group is next due
+   */
+  void run(Time deadline);
+
+  uint32_t run_count() const { return run_count_; }
+  uint32_t deadline_misses() const { return dbg_misses_.get(); }
+  Duration last_exec_time() const { return last_exec_time_; }
+  Duration max_exec_time() const { return microseconds(dbg_max_exec_time_.get()); }
+
+ private:
+  const uint32_t divisor_;
+  const Task task_;
+
+  uint32_t run_count_{0};
+  Duration last_exec_time_{microseconds(0)};
+
+  Debug::Variable::UInt32 dbg_exec_time_;
+  Debug::Variable::UInt32 dbg_max_exec_time_;
+  Debug::Variable::UInt32 dbg_misses_;
+};
@@ -0,0 +1,74 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+#include "rate_group.h"
+#include "units.h"
+
+/*! \class Scheduler scheduler.h "scheduler.h"
+ *  \brief Static multi-rate scheduler driven by the loop timer interrupt.
+ *
+ * The set of rate groups is fixed at compile time: the scheduler only holds pointers to statically
+ * allocated RateGroups and a countdown per group, so there is no dynamic allocation.
+ *
+ * Call tick() once per base period (from the loop timer callback).  Each group whose countdown
+ * expires runs to completion, in the order in which the groups were given.  List them fastest
+ * first (rate-monotonic order) so that a slow group can't delay a fast one within a tick.
+ *
+ * All groups are due on the very first tick, after which each one runs every `divisor` ticks.
+ *
+ * Usage:
+ *   static RateGroup fast("fast_", 1, FastTask);
+ *   static RateGroup slow("slow_", 10, SlowTask);
+ *   static Scheduler scheduler(milliseconds(10), std::array{&fast, &slow});
+ */
+template <size_t N>
+class Scheduler {
+ public:
+  Scheduler(Duration base_period, const std::array<RateGroup *, N> &groups)
+      : base_period_(base_period), groups_(groups) {
+    countdown_.fill(1);
+  }
+
+  Duration base_period() const { return base_period_; }
+
+  // Makes a group due without waiting out its period, e.g. so that a slow group reacts to a mode
+  // change right away.  When called from a group listed before it, it runs later in the same
+  // tick, otherwise on the next tick.  It then runs every `divisor` ticks from there.
+  void run_soon(const RateGroup *group) {
+    for (size_t i = 0; i < N; ++i) {
+      if (groups_[i] == group) countdown_[i] = 1;
+    }
+  }
+
+  // Runs all the groups which are due at this tick.
+  void tick(Time now) {
+    for (size_t i = 0; i < N; ++i) {
+      if (--countdown_[i] > 0) continue;
+      countdown_[i] = groups_[i]->divisor();
+      groups_[i]->run(now + static_cast<int64_t>(groups_[i]->divisor()) * base_period_);
+    }
+  }
+
+ private:
+  const Duration base_period_;
+  const std::array<RateGroup *, N> groups_;
+  std::array<uint32_t, N> countdown_;
+};
@@ -0,0 +1,94 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "ms4525do.h"
+
+// Full scale of the 14-bit pressure and 11-bit temperature outputs.
+static constexpr float PressureCounts{16383.f};
+static constexpr float TemperatureCounts{2047.f};
+
+MS4525DO::MS4525DO(const char *name, const char *help_supplement, I2C::Channel *channel,
+                   uint8_t address, Pressure min, Pressure max)
+    : PressureSensor(name, help_supplement),
+      channel_(channel),
+      address_(address),
+      min_(min),
+      max_(max),
+      dbg_age_("age", Debug::Variable::Access::ReadOnly, 0.f, "ms", "Age of the latest sample "),
+      dbg_temperature_("temperature", Debug::Variable::Access::ReadOnly, 0.f, "C",
+                       "Temperature of the pressure sensor "),
+      dbg_errors_("errors", Debug::Variable::Access::ReadOnly, 0, "",
+                  "Number of fault or failed readings from the pressure sensor ") {
+  dbg_age_.prepend_name(name);
+  dbg_age_.append_help(help_supplement);
+  dbg_temperature_.prepend_name(name);
+  dbg_temperature_.append_help(help_supplement);
+  dbg_errors_.prepend_name(name);
+  dbg_errors_.append_help(help_supplement);
+}
+
+MS4525DO::Status MS4525DO::Decode(const uint8_t (&raw)[ReadSize], Sample *sample) const {
+  auto pressure_counts = static_cast<uint16_t>((raw[0] & 0x3F) << 8 | raw[1]);
+  auto temperature_counts = static_cast<uint16_t>((raw[2] << 8 | raw[3]) >> 5);
+
+  // Type A: min and max at 10% and 90% of the counts.
+  sample->pressure =
+      min_ + (max_ - min_) * ((static_cast<float>(pressure_counts) - 0.1f * PressureCounts) /
+                              (0.8f * PressureCounts));
+  sample->temperature_C = static_cast<float>(temperature_counts) * 200.f / TemperatureCounts - 50.f;
+  return static_cast<Status>(raw[0] >> 6);
+}
+
+void MS4525DO::Poll(Time now) {
+  if (request_sent_ && !processed_) {
+    if (now - request_time_ < RequestTimeout) return;
+    // The channel gave up on it; send another.
+    dbg_errors_.set(dbg_errors_.get() + 1);
+  } else if (request_sent_) {
+    Sample sample;
+    switch (Decode(raw_, &sample)) {
+      case Status::Normal:
+        sample.time = now;
+        sample.count = ++count_;
+        sample_.Write(sample);
+        dbg_temperature_.set(sample.temperature_C);
+        break;
+      case Status::Stale:
+        // Read again, there'll be a new one soon.
+        break;
+      case Status::Reserved:
+      case Status::Fault:
+        dbg_errors_.set(dbg_errors_.get() + 1);
+        break;
+    }
+  }
+
+  // If the channel's queue is full, try again on the next call.
+  request_time_ = now;
+  request_sent_ = channel_->SendRequest({
+      .slave_address = address_,
+      .direction = I2C::ExchangeDirection::Read,
+      .size = ReadSize,
+      .data = raw_,
+      .processed = &processed_,
+  });
+}
+
+Pressure MS4525DO::read(const HalApi &hal_api) const {
+  const Sample &latest = sample();
+  dbg_pressure_.set(latest.pressure.cmH2O());
+  dbg_age_.set(sample_age(hal_api.Now()).milliseconds());
+  return latest.pressure;
+}
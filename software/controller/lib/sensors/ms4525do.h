@@ -0,0 +1,125 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#pragma once
+
+#include <cstdint>
+
+#include "i2c.h"
+#include "sensor_base.h"
+#include "seqlock.h"
+
+// TE MS4525DO digital differential pressure sensor, on the I²C bus (see
+// pcb/sensor-daughterboards/pressure_ms4525do and the MS4525DO datasheet).
+//
+// The sensor measures continuously on its own; reading its 4 bytes returns the
+// latest measurement.  Poll() keeps a DMA read of them in flight at all times,
+// and publishes each new measurement to a DoubleBuffer, so that read() is a
+// plain load that never waits on the bus.
+//
+// Poll() runs in the background loop and read() in the control loop, which
+// interrupts it; that's the case DoubleBuffer is for.  Poll() must not be
+// called from an interrupt handler: I2C::Channel::SendRequest() isn't safe
+// against a call from the background loop that it interrupts.
+class MS4525DO : public PressureSensor {
+ public:
+  // Address of the "I" interface type.
+  static constexpr uint8_t DefaultAddress{0x28};
+
+  // Range of the 001PD version, +/-1 psi.
+  static constexpr Pressure MinPressure{kPa(-6.894757f)};
+  static constexpr Pressure MaxPressure{kPa(6.894757f)};
+
+  // The sensor updates its measurement every 0.5 ms or so, so a sample much
+  // older than a control loop cycle means the bus or the sensor is stuck.
+  static constexpr Duration MaxSampleAge{milliseconds(20)};
+
+  // A read takes well under a millisecond, even behind others on the bus.
+  // If one hasn't completed after this long, the channel has given up on it
+  // after too many bus errors, and won't ever report it processed.
+  static constexpr Duration RequestTimeout{MaxSampleAge};
+
+  // Top two bits of the first byte read.
+  enum class Status : uint8_t {
+    Normal = 0,
+    Reserved = 1,
+    // Measurement already read, the sensor hasn't made a new one yet.
+    Stale = 2,
+    Fault = 3,
+  };
+
+  struct Sample {
+    Pressure pressure{kPa(0)};
+    float temperature_C{0};
+    // When Poll() got it.
+    Time time;
+    // Number of samples so far, including this one.  0 means no sample yet.
+    uint32_t count{0};
+  };
+
+  // Bytes read from the sensor at a time: status and pressure, then
+  // temperature.
+  static constexpr uint16_t ReadSize{4};
+
+  // min and max are the pressures at 10% and 90% of the output range (type A
+  // transfer function), which depend on the version of the sensor.
+  MS4525DO(const char *name, const char *help_supplement, I2C::Channel *channel,
+           uint8_t address = DefaultAddress, Pressure min = MinPressure,
+           Pressure max = MaxPressure);
+
+  // Publishes the measurement the last read brought back if it's new, and
+  // starts the next read.  Called by the background loop, as often as it can.
+  //
+  // A read still outstanding after RequestTimeout is abandoned and sent
+  // again.  Until a read succeeds, read() keeps returning the last sample,
+  // and stale() says so.
+  void Poll(Time now);
+
+  // Pressure from the latest sample, or 0 if there's none yet.
+  Pressure read(const HalApi &hal_api) const override;
+
+  // Latest sample.  Only for the control loop, or for code that it can't
+  // interrupt; see DoubleBuffer.
+  const Sample &sample() const { return sample_.Read(); }
+
+  Duration sample_age(Time now) const { return now - sample().time; }
+
+  // Whether there's no sample yet, or the latest one is too old to use.
+  bool stale(Time now) const { return sample().count == 0 || sample_age(now) > MaxSampleAge; }
+
+  // Decodes the bytes read from the sensor into *sample's pressure and
+  // temperature.  They're only valid if the status is Normal.
+  Status Decode(const uint8_t (&raw)[ReadSize], Sample *sample) const;
+
+ private:
+  I2C::Channel *channel_;
+  uint8_t address_;
+  Pressure min_;
+  Pressure max_;
+
+  // Read in flight; the DMA writes raw_, and the channel sets processed_
+  // when it's done.
+  uint8_t raw_[ReadSize]{};
+  bool processed_{false};
+  bool request_sent_{false};
+  Time request_time_;
+
+  DoubleBuffer<Sample> sample_;
+  uint32_t count_{0};
+
+  mutable Debug::Variable::Float dbg_age_;
+  Debug::Variable::Float dbg_temperature_;
+  Debug::Variable::UInt32 dbg_errors_;
+};
@@ -22,4 +22,8 @@ class TeledyneR24 : public OxygenSensor, public AnalogSensor {
   TeledyneR24(const char* name, const char* help_supplement, AnalogPin pin);
 
   float read(const HalApi& hal_api, Pressure p_ambient) const override;
+  float read(const AnalogSnapshot& snapshot, Pressure p_ambient) const;
+
+ private:
+  float to_fio2(float diff_volts, Pressure p_ambient) const;
 };
@@ -22,7 +22,15 @@ AnalogPressureSensor::AnalogPressureSensor(const char *name, const char *help_su
       voltage_to_kPa_(voltage_to_kPa) {}
 
 Pressure AnalogPressureSensor::read(const HalApi &hal_api) const {
-  auto ret = kPa(AnalogSensor::read_diff_volts(hal_api) * voltage_to_kPa_);
+  return to_pressure(AnalogSensor::read_diff_volts(hal_api));
+}
+
+Pressure AnalogPressureSensor::read(const AnalogSnapshot &snapshot) const {
+  return to_pressure(AnalogSensor::read_diff_volts(snapshot));
+}
+
+Pressure AnalogPressureSensor::to_pressure(float diff_volts) const {
+  auto ret = kPa(diff_volts * voltage_to_kPa_);
   dbg_pressure_.set(ret.cmH2O());
   return ret;
 }
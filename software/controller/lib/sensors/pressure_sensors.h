@@ -23,8 +23,11 @@ class AnalogPressureSensor : public PressureSensor, public AnalogSensor {
                        float voltage_to_kPa);
 
   Pressure read(const HalApi &hal_api) const override;
+  Pressure read(const AnalogSnapshot &snapshot) const;
 
  private:
+  Pressure to_pressure(float diff_volts) const;
+
   // Assume linear relationship, pending further research
   float voltage_to_kPa_;
 };
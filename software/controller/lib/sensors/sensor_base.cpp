@@ -34,7 +34,15 @@ void AnalogSensor::set_zero(const HalApi &hal_api) {
 }
 
 float AnalogSensor::read_diff_volts(const HalApi &hal_api) const {
-  auto ret = (hal_api.AnalogRead(pin_) - zero_).volts();
+  return diff_volts(hal_api.AnalogRead(pin_));
+}
+
+float AnalogSensor::read_diff_volts(const AnalogSnapshot &snapshot) const {
+  return diff_volts(snapshot[pin_]);
+}
+
+float AnalogSensor::diff_volts(Voltage reading) const {
+  auto ret = (reading - zero_).volts();
   dbg_voltage_.set(ret);
   return ret;
 }
@@ -26,8 +26,11 @@ class AnalogSensor {
   void set_zero(const HalApi &hal_api);
 
   float read_diff_volts(const HalApi &hal_api) const;
+  float read_diff_volts(const AnalogSnapshot &snapshot) const;
 
  private:
+  float diff_volts(Voltage reading) const;
+
   AnalogPin pin_;
   Voltage zero_;
 
@@ -48,7 +48,11 @@ VenturiFlowSensor::VenturiFlowSensor(const char* name, const char* help_suppleme
  * the venturi.
  */
 VolumetricFlow VenturiFlowSensor::read(const HalApi& hal_api, float air_density) const {
-  auto ret = pressure_delta_to_flow(pressure_sensor_->read(hal_api), air_density);
+  return read(pressure_sensor_->read(hal_api), air_density);
+}
+
+VolumetricFlow VenturiFlowSensor::read(Pressure delta, float air_density) const {
+  auto ret = pressure_delta_to_flow(delta, air_density);
   dbg_flow_.set(ret.ml_per_sec());
   return ret;
 }
@@ -27,6 +27,9 @@ class VenturiFlowSensor : public FlowSensor {
   /// \param air_density in units of kg/m^3, will depend on temperature and pressure
   VolumetricFlow read(const HalApi& hal_api, float air_density) const override;
 
+  /// Same as above, with the pressure sensor already read
+  VolumetricFlow read(Pressure delta, float air_density) const;
+
   /// This is exposed as static so the math can be tested without HAL
   VolumetricFlow pressure_delta_to_flow(Pressure delta, float air_density) const;
 
@@ -0,0 +1,146 @@
+#!/usr/bin/env python3
+
+__copyright__ = "Copyright 2021 RespiraWorks"
+
+__license__ = """
+
+    Copyright 2021 RespiraWorks
+
+    Licensed under the Apache License, Version 2.0 (the "License");
+    you may not use this file except in compliance with the License.
+    You may obtain a copy of the License at
+
+       http://www.apache.org/licenses/LICENSE-2.0
+
+    Unless required by applicable law or agreed to in writing, software
+    distributed under the License is distributed on an "AS IS" BASIS,
+    WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+    See the License for the specific language governing permissions and
+    limitations under the License.
+
+"""
+
+# Reports how much static RAM (.data, .bss and .noinit) each module of the
+# stm32 firmware uses, from the map file the linker writes next to this script.
+#
+# Usage: ram_report.py [map file] [--symbols N]
+
+import argparse
+import collections
+import os
+import re
+import shutil
+import subprocess
+
+RAM_SECTIONS = (".data", ".bss", ".noinit", "COMMON")
+
+# An input section line of the memory map, e.g.
+#  .bss._ZL3hal   0x20000a2c        0x8 .pio/build/stm32/src/main.cpp.o
+# Long section names push the rest of the line onto the next one.
+SECTION_RE = re.compile(r"^ (\S+)(?:\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S.*))?$")
+CONTINUATION_RE = re.compile(r"^\s+(0x[0-9a-f]+)\s+(0x[0-9a-f]+)\s+(\S.*)$")
+
+
+def module_name(object_file):
+    """Turns an object file path from the map into a short module name."""
+    # Objects pulled out of archives: path/to/libhal.a(hal_stm32.cpp.o)
+    archive = re.match(r"^(.*/)?([^/]+)\.a\((.+)\)$", object_file)
+    if archive:
+        return "%s/%s" % (archive.group(2), re.sub(r"\.o$", "", archive.group(3)))
+    # .pio/build/stm32/<lib dir>/<lib name>/file.cpp.o or .pio/build/stm32/src/file.cpp.o
+    parts = re.sub(r"\.o$", "", object_file).split("/")
+    return "/".join(parts[-2:])
+
+
+def parse_map(path):
+    """Yields (section, symbol, size, module) for each RAM input section."""
+    with open(path) as f:
+        lines = f.read().split("\n")
+    try:
+        start = lines.index("Linker script and memory map")
+    except ValueError:
+        start = 0
+    i = start
+    while i < len(lines):
+        match = SECTION_RE.match(lines[i])
+        i += 1
+        if not match or not match.group(1).startswith(RAM_SECTIONS):
+            continue
+        name, _, size, obj = match.groups()
+        if size is None:
+            if i >= len(lines):
+                break
+            continuation = CONTINUATION_RE.match(lines[i])
+            if not continuation:
+                continue
+            _, size, obj = continuation.groups()
+            i += 1
+        size = int(size, 16)
+        if size == 0:
+            continue
+        section = next(s for s in RAM_SECTIONS if name.startswith(s))
+        symbol = name[len(section) :].lstrip(".")
+        yield section, symbol, size, module_name(obj.strip())
+
+
+def demangle(symbols):
+    cxxfilt = shutil.which("arm-none-eabi-c++filt") or shutil.which("c++filt")
+    if not cxxfilt or not symbols:
+        return symbols
+    result = subprocess.run(
+        [cxxfilt], input="\n".join(symbols), capture_output=True, text=True
+    )
+    if result.returncode != 0:
+        return symbols
+    return result.stdout.split("\n")[: len(symbols)]
+
+
+def main():
+    default_map = os.path.join(os.path.dirname(os.path.abspath(__file__)), "stm32.map")
+    parser = argparse.ArgumentParser(
+        description="Static RAM used by each module of the stm32 firmware"
+    )
+    parser.add_argument("map_file", nargs="?", default=default_map)
+    parser.add_argument(
+        "--symbols",
+        type=int,
+        default=20,
+        help="also list this many of the largest variables",
+    )
+    args = parser.parse_args()
+
+    per_module = collections.defaultdict(collections.Counter)
+    variables = []
+    for section, symbol, size, module in parse_map(args.map_file):
+        per_module[module][section] += size
+        variables.append((size, symbol or "(%s)" % section, module))
+
+    columns = (".data", ".bss", ".noinit")
+    print("%-48s %8s %8s %8s %8s" % (("module",) + columns + ("total",)))
+    totals = collections.Counter()
+    for module, sizes in sorted(
+        per_module.items(), key=lambda item: -sum(item[1].values())
+    ):
+        sizes[".bss"] += sizes.pop("COMMON", 0)
+        totals.update(sizes)
+        print(
+            "%-48s %8d %8d %8d %8d"
+            % ((module,) + tuple(sizes[c] for c in columns) + (sum(sizes.values()),))
+        )
+    print(
+        "%-48s %8d %8d %8d %8d"
+        % (("TOTAL",) + tuple(totals[c] for c in columns) + (sum(totals.values()),))
+    )
+
+    if args.symbols > 0:
+        variables.sort(reverse=True)
+        largest = variables[: args.symbols]
+        names = demangle([symbol for _, symbol, _ in largest])
+        print()
+        print("%8s  %-40s %s" % ("bytes", "module", "variable"))
+        for (size, _, module), name in zip(largest, names):
+            print("%8d  %-40s %s" % (size, module, name))
+
+
+if __name__ == "__main__":
+    main()
@@ -17,12 +17,17 @@ limitations under the License.
 #include "commands.h"
 #include "comms.h"
 #include "controller.h"
+#include "crash_dump.h"
 #include "eeprom.h"
+#include "event_log.h"
 #include "hal.h"
 #include "interface.h"
 #include "network_protocol.pb.h"
 #include "nvparams.h"
+#include "sample_batcher.h"
+#include "scheduler.h"
 #include "sensors.h"
+#include "seqlock.h"
 #include "trace.h"
 #include "version.h"
 
@@ -63,11 +68,24 @@ static DFloat forced_fio2(
     "forced_fio2", DAccess::ReadWrite, 21, "%",
     "Target percent oxygen [21, 100]; overrides GUI setting when forced_mode is valid");
 
+static DUint32 dbg_irq_off_max("irq_off_max_us", DAccess::ReadOnly, 0, "us",
+                               "Longest time interrupts were disabled by BlockInterrupts");
+
 static Controller controller;
-static ControllerStatus controller_status;
+// Status of the control loop, published by the loop for the background loop to
+// send to the GUI.  Its uptime and active_params are filled in when sending.
+static SeqLock<ControllerStatus> controller_status;
+// Params for the control loop to use, published by the background loop.
+static DoubleBuffer<VentParams> active_params;
+// Control loop samples not yet sent to the GUI.
+static SampleBatcher sample_batcher(Controller::GetLoopPeriod());
+// Index of the first sample the background loop hasn't sent yet; see
+// SampleBatcher::EndOf().  A single word, so it's written atomically.
+static volatile uint32_t samples_sent_end = 0;
 static Sensors sensors;
 static NVParams::Handler nv_params;
 static I2Ceeprom eeprom = I2Ceeprom(0x50, 64, 32768, &i2c1);
+static EventLog event_log(LogFlashAddr, LogFlashSize);
 
 // Global variables for the debug interface
 static Debug::Trace trace;
@@ -79,52 +97,124 @@ static Debug::Command::PokeHandler poke_command;
 static Debug::Command::VarHandler var_command;
 static Debug::Command::TraceHandler trace_command(&trace);
 static Debug::Command::EepromHandler eeprom_command(&eeprom);
+static Debug::CrashDump crash_dump(ReservedFlashAddr, ReservedFlashSize, &trace);
+static Debug::Command::CrashDumpHandler crash_dump_command(&crash_dump);
+static Debug::Command::EventLogHandler event_log_command(LogFlashAddr, LogFlashSize);
 
-static Debug::Interface debug(&trace, 12, Debug::Command::Code::Mode, &mode_command,
+static Debug::Interface debug(&trace, 15, Debug::Command::Code::Mode, &mode_command,
                               Debug::Command::Code::Peek, &peek_command, Debug::Command::Code::Poke,
                               &poke_command, Debug::Command::Code::Variable, &var_command,
                               Debug::Command::Code::Trace, &trace_command,
-                              Debug::Command::Code::EepromAccess, &eeprom_command);
-
-static SensorsProto AsSensorsProto(const SensorReadings &r, const ControllerState &c) {
-  SensorsProto proto = SensorsProto_init_zero;
-  proto.patient_pressure_cm_h2o = r.patient_pressure.cmH2O();
-  proto.inflow_pressure_diff_cm_h2o = 0;   // \TODO field unused and obsolete, should change proto
-  proto.outflow_pressure_diff_cm_h2o = 0;  // \TODO field unused and obsolete, should change proto
-  proto.flow_ml_per_min = c.net_flow.ml_per_min();
-  proto.volume_ml = c.patient_volume.ml();
-  proto.breath_id = c.breath_id;
-  proto.flow_correction_ml_per_min = c.flow_correction.ml_per_min();
-  proto.fio2 = r.fio2;
-  return proto;
-}
-
-// This function handles all the high priority tasks which need to be called
-// periodically.  The HAL calls this function from a timer interrupt.
-//
-// NOTE - its important that anything being called from this function executes
-// quickly.  No busy waiting here.
-static void HighPriorityTask(void *arg) {
+                              Debug::Command::Code::EepromAccess, &eeprom_command,
+                              Debug::Command::Code::CrashDump, &crash_dump_command,
+                              Debug::Command::Code::EventLog, &event_log_command);
+
+// Rate groups run from the loop timer interrupt, fastest first.  The trace
+// period is expressed in loop cycles, i.e. periods of the breath FSM, so
+// tracing runs at the breath FSM's rate.
+static void PressureTask(Time now);
+static void BreathTask(Time now);
+static void Fio2Task(Time now);
+static void TraceTask(Time now);
+static void LogTask(Time now);
+static const uint32_t BreathDivisor =
+    static_cast<uint32_t>(Controller::GetLoopPeriod() / Controller::GetPressureLoopPeriod());
+static RateGroup pressure_group("loop_pressure_", 1, PressureTask);
+static RateGroup breath_group("loop_ctrl_", BreathDivisor, BreathTask);
+static RateGroup fio2_group("loop_fio2_",
+                            static_cast<uint32_t>(Controller::GetFio2LoopPeriod() /
+                                                  Controller::GetPressureLoopPeriod()),
+                            Fio2Task);
+static RateGroup trace_group("loop_trace_", BreathDivisor, TraceTask);
+static RateGroup log_group("loop_log_", BreathDivisor, LogTask);
+static Scheduler scheduler(Controller::GetPressureLoopPeriod(),
+                           std::array{&pressure_group, &breath_group, &fio2_group, &trace_group,
+                                      &log_group});
+
+// Latest sensor readings, read by the pressure loop and shared with the
+// slower rate groups.
+static SensorReadings sensor_readings;
+// Latest actuator commands from the pressure loop.
+static ActuatorsState actuators_state;
+
+// Pressure loop, towards the setpoint last given by the breath FSM.
+static void PressureTask(Time now) {
   // Read the sensors
-  SensorReadings sensor_readings = sensors.get_readings();
+  sensor_readings = sensors.get_readings();
 
   // Run our PID loop
-  auto [actuators_state, controller_state] =
-      controller.Run(hal.Now(), controller_status.active_params, sensor_readings);
+  actuators_state = controller.RunPressureLoop(now, sensor_readings);
+
+  // Update the outputs from the PID
+  ActuatorsExecute(actuators_state);
+}
+
+// Breath FSM.  Runs after the pressure loop in the same tick, so its setpoint
+// is applied from the next tick on.
+static void BreathTask(Time now) {
+  const VentParams params = active_params.Read();
+
+  // When the mode or FiO2 changes, e.g. the ventilator is switched on, run the
+  // FiO2 loop right away rather than up to a period later.  It comes after
+  // this group, so it runs in this same tick.
+  static VentMode last_mode = VentMode_OFF;
+  static float last_fio2 = 0;
+  if (params.mode != last_mode || params.fio2 != last_fio2) {
+    last_mode = params.mode;
+    last_fio2 = params.fio2;
+    scheduler.run_soon(&fio2_group);
+  }
+
+  ControllerState controller_state = controller.RunBreathFsm(now, params, sensor_readings);
+  // New A/D settings would hold the sensor readings still for a while.
+  hal.AnalogAllowReconfiguration(!controller_state.ventilator_on);
 
   // TODO update pb library to replace fan_power in ControllerStatus with
   // actuators_state, and remove pressure_setpoint_cm_h2o from ControllerStatus
 
-  // Update the outputs from the PID
-  ActuatorsExecute(actuators_state);
+  if (controller_state.breath_summary) {
+    event_log.AddBreath(now, *controller_state.breath_summary);
+  }
+
+  sample_batcher.DropBefore(samples_sent_end);
+  sample_batcher.AddSample(sensor_readings, controller_state);
 
   // Update controller_status.  This is periodically sent back to the GUI.
-  controller_status.sensor_readings = AsSensorsProto(sensor_readings, controller_state);
-  controller_status.fan_power = actuators_state.blower_power;
-  controller_status.pressure_setpoint_cm_h2o = controller_state.pressure_setpoint.cmH2O();
+  controller_status.Update([&](ControllerStatus &status) {
+    status.sensor_readings = AsSensorsProto(sensor_readings, controller_state);
+    status.fan_power = actuators_state.blower_power;
+    status.pressure_setpoint_cm_h2o = controller_state.pressure_setpoint.cmH2O();
+    if (controller_state.breath_summary) {
+      AppendBreathSummary(*controller_state.breath_summary, &status);
+    }
+    status.samples = sample_batcher.batch();
+    status.has_samples = true;
+  });
+}
+
+// FiO2 loop; its output is applied by the next runs of the pressure loop.
+static void Fio2Task(Time now) {
+  controller.RunFio2(now, active_params.Read(), sensor_readings);
+}
 
-  // Sample any trace variables that are enabled
-  debug.SampleTraceVars();
+// Sample any trace variables that are enabled
+static void TraceTask(Time now) { debug.SampleTraceVars(); }
+
+// Writes a little of the event log to flash.  Flash stalls the CPU while it's
+// written, so this comes last, right after the other groups are done with
+// this tick, and writes at most one record.  About once per page of records,
+// it erases the next page instead, which holds up the next ~22 ticks of the
+// pressure loop.
+static void LogTask(Time now) { (void)event_log.Step(); }
+
+// This function handles all the high priority tasks which need to be called
+// periodically.  The HAL calls this function from a timer interrupt.
+//
+// NOTE - its important that anything being called from this function executes
+// quickly.  No busy waiting here.
+static void HighPriorityTask(void *arg) {
+  // Run the rate groups that are due on this tick
+  scheduler.tick(hal.Now());
 
   // Pet the watchdog
   hal.WatchdogHandler();
@@ -153,35 +243,34 @@ static void HighPriorityTask(void *arg) {
     hal.Delay(milliseconds(10));
     hal.WatchdogHandler();
     debug.Poll();
+    // The control loop isn't running yet, so this is a good time for the log
+    // to erase flash ahead.
+    event_log.Flush();
   }
 
   // Calibrate the sensors.
   // This needs to be done before the sensors are used.
   sensors.calibrate();
 
-  // Current controller status.
-  // Updated when we receive data from the GUI, when sensors read data, etc.
-  controller_status = ControllerStatus_init_zero;
-
   // Last-received status from the GUI.
   GuiStatus gui_status = GuiStatus_init_zero;
+  VentMode logged_mode = VentMode_OFF;
 
   // After all initialization is done, ask the HAL to start our high priority thread.
-  hal.StartLoopTimer(Controller::GetLoopPeriod(), HighPriorityTask, nullptr);
+  hal.StartLoopTimer(scheduler.base_period(), HighPriorityTask, nullptr);
 
   while (true) {
-    controller_status.uptime_ms = hal.Now().microsSinceStartup() / 1000;
-
-    // Copy the current controller status with interrupts disabled to ensure that the data we
-    // send to the GUI is self-consistent.
-    ControllerStatus local_controller_status;
-    {
-      BlockInterrupts block;
-      local_controller_status = controller_status;
+    // Take a self-consistent copy of what the control loop last published.
+    ControllerStatus local_controller_status = controller_status.Read();
+    local_controller_status.uptime_ms = hal.Now().microsSinceStartup() / 1000;
+    local_controller_status.has_active_params = true;
+    local_controller_status.active_params = active_params.Read();
+
+    if (CommsHandler(local_controller_status, &gui_status)) {
+      // Those samples are on their way, only send newer ones next time.
+      samples_sent_end = SampleBatcher::EndOf(local_controller_status.samples);
     }
 
-    CommsHandler(local_controller_status, &gui_status);
-
     // Override received gui_status from the RPi with values from DebugVars iff
     // the forced_mode DebugVar has a legal value.
     if (uint32_t m = forced_mode.get(); m >= _VentMode_MIN && m <= _VentMode_MAX) {
@@ -194,13 +283,18 @@ static void HighPriorityTask(void *arg) {
       p.fio2 = forced_fio2.get() / 100.f;
     }
 
-    // Copy the gui_status data into our controller status with interrupts disabled.
-    // This ensures that the data is copied atomically
-    {
-      BlockInterrupts block;
-      controller_status.active_params = gui_status.desired_params;
+    // Hand the params over to the control loop.  It picks them up atomically
+    // on its next run.
+    active_params.Write(gui_status.desired_params);
+    if (gui_status.desired_params.mode != logged_mode) {
+      logged_mode = gui_status.desired_params.mode;
+      event_log.AddEvent(hal.Now(), EventLog::Event::ModeChange,
+                         static_cast<uint16_t>(logged_mode));
     }
 
+    dbg_irq_off_max.set(static_cast<uint32_t>(hal.MaxInterruptsBlockedTime().microseconds()));
+    hal.ScanStack();
+
     // Handle the debug serial interface
     debug.Poll();
 
@@ -213,6 +307,12 @@ int main() {
   // Initialize hal first because it initializes the watchdog. See comment on HalApi::Init().
   hal.Init();
 
+  // If we crash, save what we can to flash, for the debug interface to read after the reset.
+  hal.SetCrashHandler([](const CrashInfo &info) { (void)crash_dump.save(info); });
+
+  // Find where the event log left off, and log this reset
+  event_log.Init(hal.Now());
+
   // Locate our non-volatile parameter block in flash
   nv_params.Init(&eeprom);
 
@@ -0,0 +1,123 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "adc_config.h"
+
+#include <random>
+
+#include "gtest/gtest.h"
+
+static constexpr float ClockHz{80e6f};
+static constexpr uint32_t MaxFrames{256};
+
+static AdcConfig UniformConfig(ADCSampleTimeReg sample_time, Duration window,
+                               uint32_t oversample_log2) {
+  AdcConfig config;
+  config.sample_time.fill(sample_time);
+  config.window.fill(window);
+  config.oversample_log2 = oversample_log2;
+  return config;
+}
+
+TEST(AdcTiming, DefaultSettings) {
+  AdcTiming timing(UniformConfig(ADCSampleTimeReg::S92p5, milliseconds(1), 4), ClockHz, MaxFrames);
+
+  // 5 channels * 16 samples * (93 + 12) cycles at 80MHz.
+  EXPECT_FLOAT_EQ(timing.frame_time_us, 105.f);
+  for (size_t i = 0; i < NumAnalogPins; ++i) {
+    EXPECT_EQ(timing.frames[i], 10u);
+    EXPECT_FLOAT_EQ(timing.group_delay_ms(i), 0.525f);
+    // Sums of full scale readings come out at full scale.
+    EXPECT_FLOAT_EQ(timing.scaler[i] * 65536.f * 10.f, AdcFullScaleVolts);
+  }
+  EXPECT_EQ(timing.buffer_frames, 11u);
+}
+
+TEST(AdcTiming, PerChannelSettings) {
+  AdcConfig config = UniformConfig(ADCSampleTimeReg::S2p5, microseconds(100), 0);
+  config.sample_time[1] = ADCSampleTimeReg::S640p5;
+  config.window[2] = microseconds(0);
+  config.window[3] = seconds(1);
+  AdcTiming timing(config, ClockHz, MaxFrames);
+
+  // 4 * (3 + 12) + (640 + 12) cycles.
+  EXPECT_FLOAT_EQ(timing.frame_time_us, 712.f / 80.f);
+  EXPECT_EQ(timing.frames[0], 11u);
+  EXPECT_EQ(timing.frames[1], 11u);
+  // At least one frame, and no more than fit in the buffer with one to spare.
+  EXPECT_EQ(timing.frames[2], 1u);
+  EXPECT_EQ(timing.frames[3], MaxFrames - 1);
+  EXPECT_EQ(timing.buffer_frames, MaxFrames);
+
+  // Without oversampling, readings are 12 bits.
+  EXPECT_FLOAT_EQ(timing.scaler[0] * 4096.f * 11.f, AdcFullScaleVolts);
+}
+
+TEST(AdcTiming, OversamplingOverflow) {
+  // Up to 16 samples, the sum fits in the 16-bit data register; beyond that
+  // the A/D shifts it down.
+  EXPECT_EQ(AdcMaxReading(0), 4096u);
+  EXPECT_EQ(AdcMaxReading(3), 32768u);
+  EXPECT_EQ(AdcMaxReading(4), 65536u);
+  EXPECT_EQ(AdcMaxReading(MaxOversampleLog2), 65536u);
+}
+
+TEST(AdcConfig, Equality) {
+  AdcConfig a = UniformConfig(ADCSampleTimeReg::S92p5, milliseconds(1), 4);
+  AdcConfig b = a;
+  EXPECT_EQ(a, b);
+  b.window[4] = milliseconds(2);
+  EXPECT_NE(a, b);
+  b = a;
+  b.sample_time[0] = ADCSampleTimeReg::S47p5;
+  EXPECT_NE(a, b);
+  b = a;
+  b.oversample_log2 = 5;
+  EXPECT_NE(a, b);
+}
+
+TEST(AdcNoiseStats, MeanAndRms) {
+  AdcNoiseStats stats;
+  EXPECT_EQ(stats.rms(), 0);
+  // No noise measured: as good as the A/D gets.
+  EXPECT_EQ(stats.effective_bits(AdcFullScaleVolts), AdcResolution);
+
+  std::mt19937 gen(0);
+  std::normal_distribution<float> noise(1.5f, 0.002f);
+  for (int i = 0; i < 10000; ++i) {
+    stats.Add(noise(gen));
+  }
+  EXPECT_EQ(stats.count(), 10000u);
+  EXPECT_NEAR(stats.mean(), 1.5f, 0.0001f);
+  EXPECT_NEAR(stats.rms(), 0.002f, 0.0001f);
+  EXPECT_NEAR(stats.effective_bits(AdcFullScaleVolts),
+              std::log2(AdcFullScaleVolts / (0.002f * std::sqrt(12.f))), 0.1f);
+
+  stats.Reset();
+  EXPECT_EQ(stats.count(), 0u);
+  EXPECT_EQ(stats.rms(), 0);
+}
+
+TEST(AdcNoiseStats, QuantizationNoise) {
+  // A reading that's uniformly spread over one step of an ideal 12-bit
+  // converter has 12 effective bits.
+  float step = AdcFullScaleVolts / 4096;
+  AdcNoiseStats stats;
+  for (int i = 0; i < 1000; ++i) {
+    stats.Add(step * (static_cast<float>(i) + 0.5f) / 1000.f);
+  }
+  EXPECT_NEAR(stats.effective_bits(AdcFullScaleVolts), 12.f, 0.01f);
+}
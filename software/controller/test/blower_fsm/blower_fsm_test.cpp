@@ -239,6 +239,9 @@ struct FlowTraceResults {
 
   // Time relative to start of breath when FSM indicated it was done.
   std::optional<Duration> finish_time;
+
+  // Whether the FSM reported that the breath ended due to patient effort.
+  bool patient_triggered = false;
 };
 
 // Runs a breath using a fresh FSM of type FsmTy, using the given array of
@@ -292,6 +295,7 @@ FlowTraceResults RunFlowTrace(const VolumetricFlow *trace, size_t n, const VentP
 
     if (desired_state.is_end_of_breath) {
       results.finish_time = hal.Now() - start;
+      results.patient_triggered = desired_state.patient_triggered;
       break;
     }
 
@@ -331,6 +335,7 @@ TEST(BlowerFsmTest, PressureAssistFlowTrace1) {
   // around 1800ms and ends at around 2040ms.
   EXPECT_GE(results.finish_time->milliseconds(), 1800.f);
   EXPECT_LE(results.finish_time->milliseconds(), 2000.f);
+  EXPECT_TRUE(results.patient_triggered);
 }
 
 // Test a pressure-assist trace which doesn't have inspiratory effort.
@@ -361,6 +366,7 @@ TEST(BlowerFsmTest, PressureAssistFlowTrace2) {
   // No inspiratory effort, so this trace should end right at 5s, according to
   // the minimum respiratory rate in the VentParams.
   EXPECT_GE(results.finish_time->milliseconds(), 5000.f);
+  EXPECT_FALSE(results.patient_triggered);
 }
 
 }  // anonymous namespace
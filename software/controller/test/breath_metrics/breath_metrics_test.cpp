@@ -0,0 +1,118 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "breath_metrics.h"
+
+#include "gtest/gtest.h"
+
+static constexpr Time base = microsSinceStartup(10'000'000);
+static constexpr Duration sample_period = milliseconds(10);
+static Time ticks(int num_ticks) { return base + num_ticks * sample_period; }
+
+// Feeds a square breath: `inspire` ticks at PIP with constant inflow, then
+// `expire` ticks at PEEP with constant outflow.  Returns the next tick.
+static int AddBreath(BreathMetrics *metrics, int t, int inspire, int expire,
+                     VolumetricFlow inflow, VolumetricFlow outflow,
+                     VolumetricFlow flow_correction = ml_per_sec(0)) {
+  for (int i = 0; i < inspire; ++i) {
+    metrics->AddSample(ticks(t++), FlowDirection::Inspiratory, cmH2O(20), inflow,
+                       inflow - flow_correction);
+  }
+  VolumetricFlow expire_flow = ml_per_sec(0) - outflow;
+  for (int i = 0; i < expire; ++i) {
+    metrics->AddSample(ticks(t++), FlowDirection::Expiratory, cmH2O(5), expire_flow,
+                       expire_flow - flow_correction);
+  }
+  return t;
+}
+
+TEST(BreathMetrics, NoSamplesNoSummary) {
+  BreathMetrics metrics;
+  EXPECT_FALSE(metrics.EndBreath(1, BreathTrigger_MACHINE).has_value());
+}
+
+TEST(BreathMetrics, SquareBreath) {
+  BreathMetrics metrics;
+  // The first sample only starts the breath, so add one before the breath
+  // proper, as if the previous breath had just ended.
+  metrics.AddSample(ticks(0), FlowDirection::Expiratory, cmH2O(5), ml_per_sec(0), ml_per_sec(0));
+  metrics.EndBreath(0, BreathTrigger_MACHINE);
+
+  // 1s of inspiration at 500 mL/s, then 2s of expiration at 250 mL/s.  As with
+  // the breath FSMs, expiration starts with the first expiratory sample, at
+  // tick 100, and the breath ends with the last one, at tick 300.
+  AddBreath(&metrics, 1, 99, 201, ml_per_sec(500), ml_per_sec(250));
+  std::optional<BreathSummary> summary = metrics.EndBreath(42, BreathTrigger_PATIENT);
+  ASSERT_TRUE(summary.has_value());
+  EXPECT_EQ(summary->breath_id, 42);
+  EXPECT_FLOAT_EQ(summary->pip_cm_h2o, 20);
+  EXPECT_FLOAT_EQ(summary->peep_cm_h2o, 5);
+  // Flow is integrated over the interval before each sample, so the first
+  // expiratory sample counts 10ms of expiratory flow.
+  EXPECT_NEAR(summary->inspired_tidal_volume_ml, 495, 0.1);
+  EXPECT_NEAR(summary->expired_tidal_volume_ml, 502.5, 0.1);
+  EXPECT_EQ(summary->inspiratory_time_ms, 1000);
+  EXPECT_EQ(summary->expiratory_time_ms, 2000);
+  // About 500 mL every 3 seconds.
+  EXPECT_NEAR(summary->minute_volume_ml_per_min, 20 * 502.5, 1);
+  // 7.5 mL more came out than went in, over 3 seconds.
+  EXPECT_NEAR(summary->leak_ml_per_min, -150, 0.1);
+  EXPECT_EQ(summary->trigger, BreathTrigger_PATIENT);
+
+  // The next breath starts where this one ended.
+  EXPECT_FALSE(metrics.EndBreath(43, BreathTrigger_MACHINE).has_value());
+}
+
+TEST(BreathMetrics, Leak) {
+  BreathMetrics metrics;
+  metrics.AddSample(ticks(0), FlowDirection::Expiratory, cmH2O(5), ml_per_sec(0), ml_per_sec(0));
+  metrics.EndBreath(0, BreathTrigger_MACHINE);
+
+  // 100 mL more goes in than comes out over 2s, as measured.  The flow
+  // correction hides this from the corrected flow.
+  AddBreath(&metrics, 1, 100, 100, ml_per_sec(450), ml_per_sec(450), ml_per_sec(-50));
+  std::optional<BreathSummary> summary = metrics.EndBreath(1, BreathTrigger_MACHINE);
+  ASSERT_TRUE(summary.has_value());
+  EXPECT_NEAR(summary->inspired_tidal_volume_ml, summary->expired_tidal_volume_ml, 0.1);
+  EXPECT_NEAR(summary->leak_ml_per_min, 3000, 1);
+}
+
+TEST(BreathMetrics, ResetDropsBreathInProgress) {
+  BreathMetrics metrics;
+  int t = AddBreath(&metrics, 0, 50, 10, ml_per_sec(500), ml_per_sec(250));
+  metrics.Reset();
+  EXPECT_FALSE(metrics.EndBreath(1, BreathTrigger_MACHINE).has_value());
+
+  // After a reset, the first sample starts a fresh breath.
+  AddBreath(&metrics, t + 100, 10, 10, ml_per_sec(100), ml_per_sec(100));
+  std::optional<BreathSummary> summary = metrics.EndBreath(2, BreathTrigger_MACHINE);
+  ASSERT_TRUE(summary.has_value());
+  EXPECT_EQ(summary->inspiratory_time_ms, 100);
+  EXPECT_EQ(summary->expiratory_time_ms, 90);
+}
+
+TEST(BreathMetrics, AppendBreathSummaryKeepsMostRecent) {
+  ControllerStatus status = ControllerStatus_init_zero;
+  constexpr size_t Capacity = std::size(status.breath_summaries);
+  for (uint64_t id = 1; id <= Capacity + 2; ++id) {
+    BreathSummary summary = BreathSummary_init_zero;
+    summary.breath_id = id;
+    AppendBreathSummary(summary, &status);
+    ASSERT_EQ(status.breath_summaries_count, std::min<size_t>(id, Capacity));
+    // Oldest first, newest last.
+    EXPECT_EQ(status.breath_summaries[status.breath_summaries_count - 1].breath_id, id);
+    EXPECT_EQ(status.breath_summaries[0].breath_id, id > Capacity ? id - Capacity + 1 : 1);
+  }
+}
@@ -170,3 +170,24 @@ TEST(CircularBuffer, SmallBufferFullTest) {
     ASSERT_EQ(buff.FreeCount(), BufferSize);
   }
 }
+
+TEST(CircularBuffer, Peek) {
+  constexpr uint BufferSize = 4;
+  CircularBuffer<uint8_t, BufferSize> buff;
+  ASSERT_EQ(buff.Peek(0), std::nullopt);
+
+  // Go around the end of the underlying array a few times.
+  uint8_t next = 0;
+  for (int i = 0; i < 10; i++) {
+    while (buff.Put(next)) next++;
+    for (uint j = 0; j < BufferSize; j++) {
+      ASSERT_EQ(buff.Peek(j), next - BufferSize + j);
+    }
+    ASSERT_EQ(buff.Peek(BufferSize), std::nullopt);
+    // Peeking leaves the data in the buffer.
+    ASSERT_EQ(buff.FullCount(), BufferSize);
+    (void)buff.Get();
+    (void)buff.Get();
+    (void)buff.Get();
+  }
+}
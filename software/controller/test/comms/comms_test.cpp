@@ -4,15 +4,17 @@
 #include <pb_decode.h>
 #include <pb_encode.h>
 
+#include "capabilities.h"
+#include "framing.h"
 #include "gtest/gtest.h"
 #include "hal.h"
 #include "network_protocol.pb.h"
 
 TEST(CommTests, SendControllerStatus) {
-  // Initialize a large ControllerStatus so as to force multiple calls to
-  // CommsHandler to send it.
+  // Initialize a large ControllerStatus, and check that it all goes out.
   ControllerStatus s = ControllerStatus_init_zero;
   s.uptime_ms = 42;
+  s.has_active_params = true;
   s.active_params.mode = VentMode_PRESSURE_CONTROL;
   s.active_params.peep_cm_h2o = 10;
   s.active_params.breaths_per_min = 15;
@@ -43,6 +45,31 @@ TEST(CommTests, SendControllerStatus) {
             sent.sensor_readings.patient_pressure_cm_h2o);
 }
 
+// Waits until it's time to send another ControllerStatus, sends `s`, and
+// returns what the GUI would decode.  `framed` says whether we expect it to
+// go out in a frame.
+static ControllerStatus SendAndReceive(const ControllerStatus &s, bool framed = false) {
+  hal.Delay(milliseconds(100));
+  bool started_tx = false;
+  for (int i = 0; i < 10; i++) {
+    GuiStatus gui_status_ignored = GuiStatus_init_zero;
+    started_tx |= CommsHandler(s, &gui_status_ignored);
+  }
+  EXPECT_TRUE(started_tx);
+
+  char tx_buffer[Framing::MaxEncodedSize(ControllerStatus_size)];
+  uint16_t len = hal.TESTSerialGetOutgoingData(tx_buffer, sizeof(tx_buffer));
+  auto *data = reinterpret_cast<unsigned char *>(tx_buffer);
+  uint32_t message_length = len;
+  if (framed) {
+    EXPECT_EQ(Framing::DecodeInPlace(data, len, &message_length), Framing::DecodeStatus::Ok);
+  }
+  pb_istream_t stream = pb_istream_from_buffer(data, message_length);
+  ControllerStatus sent = ControllerStatus_init_zero;
+  EXPECT_TRUE(pb_decode(&stream, ControllerStatus_fields, &sent));
+  return sent;
+}
+
 TEST(CommTests, CommandRx) {
   GuiStatus s = GuiStatus_init_zero;
   s.uptime_ms = std::numeric_limits<uint32_t>::max() / 2;
@@ -76,3 +103,238 @@ TEST(CommTests, CommandRx) {
   EXPECT_EQ(s.uptime_ms, received.uptime_ms);
   EXPECT_EQ(s.desired_params.mode, received.desired_params.mode);
 }
+
+// Delivers `s` to CommsHandler the way the GUI would, in a frame or not.
+static void ReceiveGuiStatus(const GuiStatus &s, bool framed = false) {
+  uint8_t rx_buffer[GuiStatus_size];
+  pb_ostream_t stream = pb_ostream_from_buffer(rx_buffer, sizeof(rx_buffer));
+  ASSERT_TRUE(pb_encode(&stream, GuiStatus_fields, &s));
+  if (framed) {
+    uint8_t frame[Framing::MaxEncodedSize(GuiStatus_size)];
+    uint32_t size = Framing::EncodeFrame(rx_buffer, static_cast<uint32_t>(stream.bytes_written),
+                                         frame, sizeof(frame));
+    hal.TESTSerialPutIncomingData(reinterpret_cast<char *>(frame), static_cast<uint16_t>(size));
+  } else {
+    hal.TESTSerialPutIncomingData(reinterpret_cast<char *>(rx_buffer),
+                                  static_cast<uint16_t>(stream.bytes_written));
+  }
+
+  ControllerStatus controller_status_ignored = ControllerStatus_init_zero;
+  GuiStatus received = GuiStatus_init_zero;
+  for (int i = 0; i < 10; i++) {
+    CommsHandler(controller_status_ignored, &received);
+    hal.Delay(milliseconds(1));
+  }
+  EXPECT_EQ(s.uptime_ms, received.uptime_ms);
+  // Throw away whatever CommsHandler sent meanwhile.
+  char tx_buffer[Framing::MaxEncodedSize(ControllerStatus_size)];
+  while (hal.TESTSerialGetOutgoingData(tx_buffer, sizeof(tx_buffer)) > 0) {
+  }
+}
+
+// ControllerStatus as GUIs from before active_params became optional decode
+// it: they reject any message without it.
+struct LegacyControllerStatus {
+  uint64_t uptime_ms;
+  VentParams active_params;
+  SensorsProto sensor_readings;
+  float pressure_setpoint_cm_h2o;
+  float fan_power;
+};
+#define LegacyControllerStatus_FIELDLIST(X, a)                 \
+  X(a, STATIC, REQUIRED, UINT64, uptime_ms, 1)                 \
+  X(a, STATIC, REQUIRED, MESSAGE, active_params, 2)            \
+  X(a, STATIC, REQUIRED, MESSAGE, sensor_readings, 3)          \
+  X(a, STATIC, REQUIRED, FLOAT, pressure_setpoint_cm_h2o, 5)   \
+  X(a, STATIC, REQUIRED, FLOAT, fan_power, 6)
+#define LegacyControllerStatus_CALLBACK NULL
+#define LegacyControllerStatus_DEFAULT NULL
+#define LegacyControllerStatus_active_params_MSGTYPE VentParams
+#define LegacyControllerStatus_sensor_readings_MSGTYPE SensorsProto
+PB_BIND(LegacyControllerStatus, LegacyControllerStatus, AUTO)
+
+TEST(CommTests, LegacyGuiAlwaysGetsParams) {
+  ControllerStatus s = ControllerStatus_init_zero;
+  s.uptime_ms = 42;
+  s.has_active_params = true;
+  s.active_params.mode = VentMode_PRESSURE_ASSIST;
+  s.active_params.peep_cm_h2o = 7;
+  s.breath_summaries_count = 1;
+  s.has_samples = true;
+
+  // A GUI that never said hello gets the params in every status, even though
+  // they don't change, and can decode each one.
+  ReceiveGuiStatus(GuiStatus_init_zero);
+  for (int i = 0; i < 5; i++) {
+    hal.Delay(milliseconds(100));
+    for (int j = 0; j < 10; j++) {
+      GuiStatus gui_status_ignored = GuiStatus_init_zero;
+      CommsHandler(s, &gui_status_ignored);
+    }
+    uint8_t tx_buffer[ControllerStatus_size];
+    uint16_t len = hal.TESTSerialGetOutgoingData(reinterpret_cast<char *>(tx_buffer),
+                                                 sizeof(tx_buffer));
+    ASSERT_GT(len, 0);
+    pb_istream_t stream = pb_istream_from_buffer(tx_buffer, len);
+    LegacyControllerStatus sent = {};
+    ASSERT_TRUE(pb_decode(&stream, &LegacyControllerStatus_msg, &sent)) << PB_GET_ERROR(&stream);
+    EXPECT_EQ(sent.uptime_ms, 42u);
+    EXPECT_EQ(sent.active_params.mode, VentMode_PRESSURE_ASSIST);
+    EXPECT_EQ(sent.active_params.peep_cm_h2o, 7u);
+  }
+}
+
+TEST(CommTests, ParamsOnlySentWhenChangedOrStale) {
+  ControllerStatus s = ControllerStatus_init_zero;
+  s.has_active_params = true;
+  s.active_params.mode = VentMode_PRESSURE_ASSIST;
+  s.active_params.peep_cm_h2o = 9;
+
+  GuiStatus gui = GuiStatus_init_zero;
+  gui.has_capabilities = true;
+  gui.capabilities = {ProtocolVersion, Feature_PARAMS_ON_CHANGE, SerialDefaultBaudRate};
+  ReceiveGuiStatus(gui);
+
+  ControllerStatus sent = SendAndReceive(s);
+  EXPECT_TRUE(sent.has_active_params);
+  EXPECT_EQ(sent.active_params.peep_cm_h2o, 9u);
+
+  // Unchanged params are left out...
+  EXPECT_FALSE(SendAndReceive(s).has_active_params);
+
+  // ...until they change...
+  s.active_params.peep_cm_h2o = 8;
+  sent = SendAndReceive(s);
+  EXPECT_TRUE(sent.has_active_params);
+  EXPECT_EQ(sent.active_params.peep_cm_h2o, 8u);
+  EXPECT_FALSE(SendAndReceive(s).has_active_params);
+
+  // ...or haven't been sent for a while.
+  hal.Delay(seconds(1));
+  EXPECT_TRUE(SendAndReceive(s).has_active_params);
+
+  // Once the GUI goes quiet, it may have been replaced by one that needs
+  // them every time.
+  hal.Delay(seconds(2));
+  SendAndReceive(s);
+  EXPECT_TRUE(SendAndReceive(s).has_active_params);
+}
+
+TEST(CommTests, BaudRateNegotiation) {
+  ControllerStatus s = ControllerStatus_init_zero;
+  GuiStatus gui = GuiStatus_init_zero;
+  gui.has_max_baud_rate = true;
+  gui.max_baud_rate = 1'500'000;
+  ReceiveGuiStatus(gui);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), SerialDefaultBaudRate);
+
+  // We announce the fastest rate we support within the GUI's limit, and
+  // switch to it once that announcement is out.
+  ControllerStatus sent = SendAndReceive(s);
+  EXPECT_TRUE(sent.has_baud_rate);
+  EXPECT_EQ(sent.baud_rate, 1'000'000u);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), 1'000'000u);
+  EXPECT_FALSE(SendAndReceive(s).has_baud_rate);
+
+  // As long as the GUI keeps talking to us, we stay there.
+  hal.Delay(milliseconds(800));
+  ReceiveGuiStatus(gui);
+  hal.Delay(milliseconds(800));
+  SendAndReceive(s);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), 1'000'000u);
+
+  // If it goes quiet, we fall back to the default rate...
+  hal.Delay(seconds(1));
+  SendAndReceive(s);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), SerialDefaultBaudRate);
+
+  // ...and won't try that rate again.
+  ReceiveGuiStatus(gui);
+  sent = SendAndReceive(s);
+  EXPECT_EQ(sent.baud_rate, 921'600u);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), 921'600u);
+
+  // The GUI can also ask us to slow down.
+  gui.max_baud_rate = 300'000;
+  ReceiveGuiStatus(gui);
+  sent = SendAndReceive(s);
+  EXPECT_EQ(sent.baud_rate, 230'400u);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), 230'400u);
+
+  gui.has_max_baud_rate = false;
+  ReceiveGuiStatus(gui);
+  SendAndReceive(s);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), SerialDefaultBaudRate);
+
+  // After a while, we give the rate we fell back from another chance.
+  hal.Delay(seconds(30));
+  gui.has_max_baud_rate = true;
+  gui.max_baud_rate = 1'500'000;
+  ReceiveGuiStatus(gui);
+
+  // The switch waits for the UART to finish sending the announcement, and
+  // nothing else goes out at the old rate meanwhile.
+  hal.TESTSerialSetTxBusy(true);
+  hal.Delay(milliseconds(100));
+  GuiStatus gui_status_ignored = GuiStatus_init_zero;
+  EXPECT_TRUE(CommsHandler(s, &gui_status_ignored));
+  for (int i = 0; i < 5; i++) {
+    hal.Delay(milliseconds(100));
+    EXPECT_FALSE(CommsHandler(s, &gui_status_ignored));
+  }
+  EXPECT_EQ(hal.TESTSerialBaudRate(), SerialDefaultBaudRate);
+  hal.TESTSerialSetTxBusy(false);
+  SendAndReceive(s);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), 1'000'000u);
+
+  // Leave the link as the other tests expect it.
+  hal.Delay(seconds(2));
+  SendAndReceive(s);
+  EXPECT_EQ(hal.TESTSerialBaudRate(), SerialDefaultBaudRate);
+}
+
+TEST(CommTests, CapabilityHandshake) {
+  ControllerStatus s = ControllerStatus_init_zero;
+  s.breath_summaries_count = 1;
+  s.breath_summaries[0].breath_id = 7;
+  s.has_samples = true;
+  s.samples.first_sample = 42;
+
+  // A GUI from before the handshake gets neither, and no frames.
+  GuiStatus gui = GuiStatus_init_zero;
+  ReceiveGuiStatus(gui);
+  ControllerStatus sent = SendAndReceive(s);
+  EXPECT_FALSE(sent.has_capabilities);
+  EXPECT_EQ(sent.breath_summaries_count, 0u);
+  EXPECT_FALSE(sent.has_samples);
+
+  // One that says hello gets our answer, once, and what we both support.
+  gui.has_capabilities = true;
+  gui.capabilities = {ProtocolVersion, Feature_BREATH_SUMMARIES, SerialDefaultBaudRate};
+  ReceiveGuiStatus(gui);
+  sent = SendAndReceive(s);
+  EXPECT_TRUE(sent.has_capabilities);
+  EXPECT_EQ(sent.capabilities.protocol_version, ProtocolVersion);
+  EXPECT_EQ(sent.capabilities.features, AllFeatures);
+  EXPECT_EQ(sent.breath_summaries_count, 1u);
+  EXPECT_FALSE(sent.has_samples);
+  EXPECT_FALSE(SendAndReceive(s).has_capabilities);
+
+  // With framing, we send frames, and take frames as well as raw messages.
+  gui.capabilities.features = AllFeatures;
+  ReceiveGuiStatus(gui, /*framed=*/true);
+  sent = SendAndReceive(s, /*framed=*/true);
+  EXPECT_TRUE(sent.has_capabilities);
+  EXPECT_TRUE(sent.has_samples);
+  EXPECT_EQ(sent.samples.first_sample, 42u);
+  gui.has_capabilities = false;
+  gui.uptime_ms = 1234;
+  ReceiveGuiStatus(gui);
+  EXPECT_EQ(SendAndReceive(s, /*framed=*/true).breath_summaries_count, 1u);
+
+  // If the GUI goes quiet, we forget what we agreed on until the next hello.
+  hal.Delay(seconds(2));
+  sent = SendAndReceive(s);
+  EXPECT_EQ(sent.breath_summaries_count, 0u);
+  EXPECT_FALSE(sent.has_samples);
+}
@@ -16,8 +16,10 @@ limitations under the License.
 #include "controller.h"
 
 #include <cmath>
+#include <vector>
 
 #include "gtest/gtest.h"
+#include "microbench.h"
 
 // TODO: There ought to be many more tests in here.
 
@@ -272,3 +274,240 @@ TEST(ControllerTest, ControlLaws) {
                                              .blower_valve = ValveClosed,
                                              .exhale_valve = ValveOpen}}});
 }
+
+TEST(ControllerTest, Fio2LoopRunsSeparately) {
+  EXPECT_EQ(Controller::GetFio2LoopPeriod().microseconds() %
+                Controller::GetLoopPeriod().microseconds(),
+            0);
+
+  VentParams params = VentParams_init_zero;
+  params.mode = VentMode::VentMode_PRESSURE_CONTROL;
+  params.peep_cm_h2o = 5;
+  params.pip_cm_h2o = 15;
+  params.breaths_per_min = 15;
+  params.inspiratory_expiratory_ratio = 1;
+  params.fio2 = 0.5f;
+
+  // Pressure well below setpoint so the blower valve is open, and FiO2 below
+  // setpoint so the FiO2 loop asks for oxygen.
+  SensorReadings readings = {
+      .patient_pressure = cmH2O(-500),
+      .fio2 = 0.21f,
+      .air_inflow = ml_per_min(0),
+      .oxygen_inflow = ml_per_min(0),
+      .outflow = ml_per_min(0),
+  };
+
+  Controller controller;
+  Time now = microsSinceStartup(0);
+  auto [act_state, unused_status] = controller.Run(now, params, readings);
+  (void)unused_status;
+  // The FiO2 loop hasn't run yet, so no oxygen is coupled in.
+  EXPECT_FLOAT_EQ(act_state.fio2_valve, 0);
+
+  now = now + Controller::GetFio2LoopPeriod();
+  controller.RunFio2(now, params, readings);
+  controller.RunFio2(now + Controller::GetFio2LoopPeriod(), params, readings);
+  act_state = controller.Run(now + Controller::GetFio2LoopPeriod(), params, readings).first;
+  EXPECT_GT(act_state.fio2_valve, 0);
+
+  // The FiO2 loop output is held until its next run.
+  float fio2_valve = act_state.fio2_valve;
+  act_state = controller.Run(now + Controller::GetFio2LoopPeriod() + Controller::GetLoopPeriod(),
+                             params, readings)
+                  .first;
+  EXPECT_FLOAT_EQ(act_state.fio2_valve, fio2_valve);
+}
+
+TEST(ControllerTest, Fio2LoopResetWhenOff) {
+  VentParams params = VentParams_init_zero;
+  params.mode = VentMode::VentMode_PRESSURE_CONTROL;
+  params.peep_cm_h2o = 5;
+  params.pip_cm_h2o = 15;
+  params.breaths_per_min = 15;
+  params.inspiratory_expiratory_ratio = 1;
+  params.fio2 = 0.5f;
+
+  SensorReadings readings = {
+      .patient_pressure = cmH2O(-500),
+      .fio2 = 0.21f,
+      .air_inflow = ml_per_min(0),
+      .oxygen_inflow = ml_per_min(0),
+      .outflow = ml_per_min(0),
+  };
+
+  Controller controller;
+  Time now = microsSinceStartup(0);
+  EXPECT_TRUE(controller.Run(now, params, readings).second.ventilator_on);
+  controller.RunFio2(now, params, readings);
+  now = now + Controller::GetFio2LoopPeriod();
+  controller.RunFio2(now, params, readings);
+  EXPECT_GT(controller.Run(now, params, readings).first.fio2_valve, 0);
+
+  // Turning the ventilator off drops the FiO2 loop's output and state, so
+  // that turning it back on starts from scratch.
+  // (The breath FSM turns off on the cycle after it's asked to.)
+  VentParams off = params;
+  off.mode = VentMode::VentMode_OFF;
+  for (int i = 0; i < 2; i++) {
+    now = now + Controller::GetLoopPeriod();
+    EXPECT_EQ(controller.Run(now, off, readings).second.ventilator_on, i == 0);
+  }
+  now = now + Controller::GetLoopPeriod();
+  EXPECT_FLOAT_EQ(controller.Run(now, params, readings).first.fio2_valve, 0);
+}
+
+TEST(ControllerTest, PressureLoopFollowsBreathFsm) {
+  EXPECT_EQ(Controller::GetLoopPeriod().microseconds() %
+                Controller::GetPressureLoopPeriod().microseconds(),
+            0);
+
+  VentParams params = VentParams_init_zero;
+  params.mode = VentMode::VentMode_PRESSURE_CONTROL;
+  params.peep_cm_h2o = 5;
+  params.pip_cm_h2o = 15;
+  params.breaths_per_min = 15;
+  params.inspiratory_expiratory_ratio = 1;
+  params.fio2 = 0.21f;
+
+  SensorReadings readings = {
+      .patient_pressure = cmH2O(-500),
+      .fio2 = 0.21f,
+      .air_inflow = ml_per_min(0),
+      .oxygen_inflow = ml_per_min(0),
+      .outflow = ml_per_min(0),
+  };
+
+  Controller controller;
+  Time now = microsSinceStartup(0);
+  // Until the breath FSM runs, the ventilator is off.
+  ActuatorsState act_state = controller.RunPressureLoop(now, readings);
+  EXPECT_FLOAT_EQ(act_state.blower_power, 0);
+
+  ControllerState state = controller.RunBreathFsm(now, params, readings);
+  EXPECT_GT(state.pressure_setpoint.cmH2O(), 0);
+
+  // The pressure loop keeps pushing towards that setpoint between runs of the
+  // breath FSM.
+  for (int i = 1; i < 10; i++) {
+    now = now + Controller::GetPressureLoopPeriod();
+    act_state = controller.RunPressureLoop(now, readings);
+    EXPECT_FLOAT_EQ(act_state.blower_power, 1);
+    EXPECT_FLOAT_EQ(act_state.blower_valve.value(), 1);
+  }
+
+  // Until the breath FSM says otherwise, on the cycle after it's asked to.
+  params.mode = VentMode::VentMode_OFF;
+  controller.RunBreathFsm(now, params, readings);
+  controller.RunBreathFsm(now + Controller::GetLoopPeriod(), params, readings);
+  act_state = controller.RunPressureLoop(now + Controller::GetPressureLoopPeriod(), readings);
+  EXPECT_FLOAT_EQ(act_state.blower_power, 0);
+  EXPECT_FLOAT_EQ(act_state.exhale_valve.value(), 1);
+}
+
+TEST(ControllerTest, AsSensorsProto) {
+  SensorReadings readings = {
+      .patient_pressure = cmH2O(12.5f),
+      .fio2 = 0.4f,
+      .air_inflow = ml_per_min(0),
+      .oxygen_inflow = ml_per_min(0),
+      .outflow = ml_per_min(0),
+  };
+  ControllerState state = {
+      .pressure_setpoint = cmH2O(15),
+      .patient_volume = ml(321),
+      .net_flow = ml_per_sec(50),
+      .flow_correction = ml_per_min(-120),
+      .breath_id = 42,
+  };
+  SensorsProto proto = AsSensorsProto(readings, state);
+  EXPECT_FLOAT_EQ(proto.patient_pressure_cm_h2o, 12.5f);
+  EXPECT_FLOAT_EQ(proto.flow_ml_per_min, 3000);
+  EXPECT_FLOAT_EQ(proto.volume_ml, 321);
+  EXPECT_FLOAT_EQ(proto.flow_correction_ml_per_min, -120);
+  EXPECT_FLOAT_EQ(proto.fio2, 0.4f);
+  EXPECT_EQ(proto.breath_id, 42);
+}
+
+TEST(ControllerTest, BreathSummary) {
+  Controller c;
+  VentParams params = VentParams_init_zero;
+  params.mode = VentMode::VentMode_PRESSURE_CONTROL;
+  params.peep_cm_h2o = 5;
+  params.pip_cm_h2o = 15;
+  params.breaths_per_min = 20;
+  params.inspiratory_expiratory_ratio = 1;
+  params.fio2 = 0.21f;
+
+  SensorReadings readings = {
+      .patient_pressure = cmH2O(5),
+      .fio2 = 0.21f,
+      .air_inflow = ml_per_min(0),
+      .oxygen_inflow = ml_per_min(0),
+      .outflow = ml_per_min(0),
+  };
+
+  // Run for a bit more than two breaths, with the patient pressure following
+  // the setpoint perfectly.
+  std::vector<BreathSummary> summaries;
+  uint64_t breath_id = 0;
+  Time now = microsSinceStartup(0);
+  for (int i = 0; i < 650; ++i) {
+    auto [actuators, state] = c.Run(now, params, readings);
+    if (state.breath_summary.has_value()) {
+      // The summary is for the breath that just ended.
+      EXPECT_EQ(state.breath_summary->breath_id, breath_id);
+      summaries.push_back(*state.breath_summary);
+    }
+    breath_id = state.breath_id;
+    readings.patient_pressure = state.pressure_setpoint;
+    now += Controller::GetLoopPeriod();
+  }
+
+  ASSERT_EQ(summaries.size(), 2);
+  // The first breath starts when the ventilator is switched on, with no
+  // previous sample, so it's one loop cycle short.  Check the second one.
+  const BreathSummary &summary = summaries[1];
+  EXPECT_FLOAT_EQ(summary.pip_cm_h2o, 15);
+  EXPECT_FLOAT_EQ(summary.peep_cm_h2o, 5);
+  EXPECT_EQ(summary.inspiratory_time_ms, 1500);
+  EXPECT_EQ(summary.expiratory_time_ms, 1500);
+  EXPECT_EQ(summary.trigger, BreathTrigger_MACHINE);
+}
+
+// Cost of one pass of the control loop and of packing its output for the GUI,
+// i.e. the unit-heavy path run from the loop timer interrupt.
+TEST(ControllerBenchmark, RunAndAsSensorsProto) {
+  constexpr uint32_t Iterations = 100'000;
+  VentParams params = VentParams_init_zero;
+  params.mode = VentMode::VentMode_PRESSURE_CONTROL;
+  params.peep_cm_h2o = 5;
+  params.pip_cm_h2o = 15;
+  params.breaths_per_min = 15;
+  params.inspiratory_expiratory_ratio = 1;
+  params.fio2 = 0.21f;
+  SensorReadings readings = {
+      .patient_pressure = cmH2O(10),
+      .fio2 = 0.21f,
+      .air_inflow = ml_per_min(6000),
+      .oxygen_inflow = ml_per_min(0),
+      .outflow = ml_per_min(5000),
+  };
+
+  Controller controller;
+  Time now = microsSinceStartup(0);
+  ControllerState state;
+  double run_ns = Microbench::NanosPerCall(Iterations, [&] {
+    now += Controller::GetLoopPeriod();
+    auto [actuators, controller_state] = controller.Run(now, params, readings);
+    Microbench::DoNotOptimize(actuators);
+    state = controller_state;
+  });
+  Microbench::Report("Controller::Run", run_ns);
+
+  double proto_ns = Microbench::NanosPerCall(Iterations, [&] {
+    SensorsProto proto = AsSensorsProto(readings, state);
+    Microbench::DoNotOptimize(proto);
+  });
+  Microbench::Report("AsSensorsProto", proto_ns);
+}
@@ -0,0 +1,220 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "crash_dump.h"
+
+#include <array>
+#include <cstring>
+#include <functional>
+#include <vector>
+
+#include "commands.h"
+#include "gtest/gtest.h"
+
+namespace Debug {
+
+static CrashInfo TestCrashInfo() {
+  CrashInfo info{};
+  info.reason = CrashReason::BusFault;
+  for (uint32_t i = 0; i < 8; ++i) info.registers[i] = 0x1000 + i;
+  info.stack_pointer = 0x20001234;
+  info.fault_status = 0x8200;
+  info.bus_fault_address = 0xDEADBEEF;
+  info.uptime_ms = 123456;
+  info.loop_timing.Reset();
+  info.loop_timing.Record(3, 400, true);
+  return info;
+}
+
+class CrashDumpTest : public ::testing::Test {
+ protected:
+  void SetUp() override { ASSERT_TRUE(dump.erase()); }
+
+  // Traces a counter, and ten times its value.
+  void StartTrace(uint32_t samples) {
+    trace.set_traced_variable(0, x.id());
+    trace.set_traced_variable(2, y.id());
+    trace.start();
+    for (value = 0; value < samples; ++value) trace.maybe_sample();
+  }
+
+  CrashDump::Header ReadHeader() {
+    CrashDump::Header header;
+    EXPECT_TRUE(dump.read(0, &header, sizeof(header)));
+    return header;
+  }
+
+  std::vector<uint32_t> ReadSamples(const CrashDump::Header &header) {
+    std::vector<uint32_t> words(header.trace_samples * header.trace_variables);
+    EXPECT_TRUE(dump.read(sizeof(header), words.data(), words.size() * sizeof(uint32_t)));
+    return words;
+  }
+
+  uint32_t value{0};
+  Variable::Primitive32 x{"crash_x", Variable::Access::ReadOnly, &value, ""};
+  Variable::FnVar32<std::function<void(void *)>, std::function<void(const void *)>> y{
+      Variable::Type::UInt32,
+      "crash_y",
+      Variable::Access::ReadOnly,
+      "",
+      [&](void *write_buff) {
+        uint32_t v = 10 * value;
+        std::memcpy(write_buff, &v, 4);
+      },
+      [](const void *) {},
+      ""};
+  Trace trace;
+  CrashDump dump{ReservedFlashAddr, ReservedFlashSize, &trace};
+};
+
+TEST_F(CrashDumpTest, NoDump) {
+  EXPECT_EQ(dump.size(), 0u);
+  uint8_t byte;
+  EXPECT_FALSE(dump.read(0, &byte, 1));
+}
+
+TEST_F(CrashDumpTest, SavesCrashInfo) {
+  ASSERT_TRUE(dump.save(TestCrashInfo()));
+  ASSERT_EQ(dump.size(), sizeof(CrashDump::Header));
+
+  CrashDump::Header header = ReadHeader();
+  EXPECT_EQ(header.info.reason, CrashReason::BusFault);
+  EXPECT_EQ(header.info.registers[6], 0x1006u);
+  EXPECT_EQ(header.info.stack_pointer, 0x20001234u);
+  EXPECT_EQ(header.info.fault_status, 0x8200u);
+  EXPECT_EQ(header.info.bus_fault_address, 0xDEADBEEFu);
+  EXPECT_EQ(header.info.uptime_ms, 123456u);
+  EXPECT_TRUE(header.info.loop_timing.Valid());
+  EXPECT_EQ(header.info.loop_timing.overruns, 1u);
+  EXPECT_EQ(header.trace_variables, 0u);
+  EXPECT_EQ(header.trace_samples, 0u);
+
+  // Reading doesn't consume the dump, erasing does.
+  EXPECT_EQ(dump.size(), sizeof(CrashDump::Header));
+  EXPECT_TRUE(dump.erase());
+  EXPECT_EQ(dump.size(), 0u);
+}
+
+TEST_F(CrashDumpTest, SavesTrace) {
+  StartTrace(5);
+  ASSERT_TRUE(dump.save(TestCrashInfo()));
+
+  CrashDump::Header header = ReadHeader();
+  EXPECT_EQ(header.trace_variables, 2u);
+  EXPECT_EQ(header.trace_samples, 5u);
+  EXPECT_EQ(header.trace_variable_ids[0], x.id());
+  EXPECT_EQ(header.trace_variable_ids[1], Variable::InvalidID);
+  EXPECT_EQ(header.trace_variable_ids[2], y.id());
+  EXPECT_EQ(dump.size(), sizeof(header) + 5 * 2 * sizeof(uint32_t));
+  EXPECT_EQ(ReadSamples(header), (std::vector<uint32_t>{0, 0, 1, 10, 2, 20, 3, 30, 4, 40}));
+
+  // The trace itself is left alone.
+  EXPECT_EQ(trace.sample_count(), 5u);
+}
+
+TEST_F(CrashDumpTest, KeepsNewestSamples) {
+  // More than fits in flash.
+  StartTrace(1000);
+  ASSERT_TRUE(dump.save(TestCrashInfo()));
+
+  CrashDump::Header header = ReadHeader();
+  size_t fit = (ReservedFlashSize - sizeof(header)) / (2 * sizeof(uint32_t));
+  EXPECT_EQ(header.trace_samples, fit);
+  EXPECT_LE(dump.size(), ReservedFlashSize);
+  std::vector<uint32_t> samples = ReadSamples(header);
+  EXPECT_EQ(samples[samples.size() - 2], 999u);
+  EXPECT_EQ(samples[samples.size() - 1], 9990u);
+  EXPECT_EQ(samples[0], 1000 - fit);
+}
+
+TEST_F(CrashDumpTest, OddNumberOfWords) {
+  // One variable, so one word per sample: the end gets padded to the 8 bytes
+  // flash is written in.
+  trace.set_traced_variable(0, x.id());
+  trace.start();
+  for (value = 0; value < 3; ++value) trace.maybe_sample();
+  ASSERT_TRUE(dump.save(TestCrashInfo()));
+  CrashDump::Header header = ReadHeader();
+  EXPECT_EQ(header.trace_samples, 3u);
+  EXPECT_EQ(dump.size(), sizeof(header) + 3 * sizeof(uint32_t));
+  EXPECT_EQ(ReadSamples(header), (std::vector<uint32_t>{0, 1, 2}));
+}
+
+TEST_F(CrashDumpTest, Command) {
+  StartTrace(3);
+  ASSERT_TRUE(dump.save(TestCrashInfo()));
+  Command::CrashDumpHandler handler(&dump);
+
+  auto process = [&](std::vector<uint8_t> request, std::vector<uint8_t> *response) {
+    std::array<uint8_t, 100> buffer;
+    bool processed = false;
+    Command::Context context = {
+        .request = request.data(),
+        .request_length = static_cast<uint32_t>(request.size()),
+        .response = buffer.data(),
+        .max_response_length = std::size(buffer),
+        .response_length = 0,
+        .processed = &processed,
+    };
+    ErrorCode error = handler.Process(&context);
+    if (error == ErrorCode::None) {
+      EXPECT_TRUE(processed);
+    }
+    response->assign(buffer.begin(), buffer.begin() + context.response_length);
+    return error;
+  };
+  using Subcommand = Command::CrashDumpHandler::Subcommand;
+  std::vector<uint8_t> response;
+
+  ASSERT_EQ(process({static_cast<uint8_t>(Subcommand::GetSize)}, &response), ErrorCode::None);
+  ASSERT_EQ(response.size(), 4u);
+  uint32_t size = u8_to_u32(response.data());
+  EXPECT_EQ(size, dump.size());
+
+  // Read the dump in chunks, as the debug interface does.
+  std::vector<uint8_t> contents;
+  while (contents.size() < size) {
+    std::vector<uint8_t> request(7);
+    request[0] = static_cast<uint8_t>(Subcommand::Read);
+    u32_to_u8(static_cast<uint32_t>(contents.size()), &request[1]);
+    u16_to_u8(static_cast<uint16_t>(std::min<size_t>(size - contents.size(), 64)), &request[5]);
+    ASSERT_EQ(process(request, &response), ErrorCode::None);
+    contents.insert(contents.end(), response.begin(), response.end());
+  }
+  std::vector<uint8_t> expected(size);
+  ASSERT_TRUE(dump.read(0, expected.data(), size));
+  EXPECT_EQ(contents, expected);
+
+  // Reading beyond the end, or too much at once, fails.
+  std::vector<uint8_t> request(7);
+  request[0] = static_cast<uint8_t>(Subcommand::Read);
+  u32_to_u8(size - 4, &request[1]);
+  u16_to_u8(8, &request[5]);
+  EXPECT_EQ(process(request, &response), ErrorCode::InvalidData);
+  u32_to_u8(0, &request[1]);
+  u16_to_u8(200, &request[5]);
+  EXPECT_EQ(process(request, &response), ErrorCode::NoMemory);
+  EXPECT_EQ(process({static_cast<uint8_t>(Subcommand::Read), 0}, &response),
+            ErrorCode::MissingData);
+
+  ASSERT_EQ(process({static_cast<uint8_t>(Subcommand::Erase)}, &response), ErrorCode::None);
+  ASSERT_EQ(process({static_cast<uint8_t>(Subcommand::GetSize)}, &response), ErrorCode::None);
+  EXPECT_EQ(u8_to_u32(response.data()), 0u);
+
+  EXPECT_EQ(process({0x42}, &response), ErrorCode::InvalidData);
+  EXPECT_EQ(process({}, &response), ErrorCode::MissingData);
+}
+
+}  // namespace Debug
@@ -0,0 +1,275 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "event_log.h"
+
+#include <vector>
+
+#include "flash_log.h"
+#include "gtest/gtest.h"
+
+using Record = FlashLog::Record;
+
+static void EraseLogFlash() {
+  for (uint32_t page = LogFlashAddr; page < LogFlashAddr + LogFlashSize; page += FlashPageSize) {
+    ASSERT_TRUE(hal.FlashErasePage(page));
+  }
+}
+
+static std::vector<Record> Records(const FlashLog &log) {
+  std::vector<Record> records;
+  log.ForEach([&](Record r) { records.push_back(r); });
+  return records;
+}
+
+class FlashLogTest : public ::testing::Test {
+ protected:
+  static constexpr size_t Pages = 4;
+
+  void SetUp() override { EraseLogFlash(); }
+
+  FlashLog NewLog() { return FlashLog(0x12345678, LogFlashAddr, Pages * FlashPageSize); }
+
+  // Appends and flushes records first, ..., last - 1.
+  static void AppendRange(FlashLog *log, Record first, Record last) {
+    for (Record r = first; r < last; ++r) {
+      ASSERT_TRUE(log->Append(r));
+      if ((r + 1) % FlashLog::QueueSize == 0) log->Flush();
+    }
+    log->Flush();
+  }
+};
+
+TEST_F(FlashLogTest, StartsEmpty) {
+  FlashLog log = NewLog();
+  log.Init();
+  EXPECT_TRUE(Records(log).empty());
+  log.Flush();
+  EXPECT_TRUE(Records(log).empty());
+}
+
+TEST_F(FlashLogTest, NothingWrittenBeforeFlush) {
+  FlashLog log = NewLog();
+  log.Init();
+  ASSERT_TRUE(log.Append(1));
+  EXPECT_TRUE(Records(log).empty());
+  log.Flush();
+  EXPECT_EQ(Records(log), std::vector<Record>{1});
+}
+
+TEST_F(FlashLogTest, ResumesAfterInit) {
+  {
+    FlashLog log = NewLog();
+    log.Init();
+    AppendRange(&log, 0, 300);
+  }
+  FlashLog log = NewLog();
+  log.Init();
+  AppendRange(&log, 300, 310);
+
+  std::vector<Record> expected;
+  for (Record r = 0; r < 310; ++r) expected.push_back(r);
+  EXPECT_EQ(Records(log), expected);
+}
+
+TEST_F(FlashLogTest, DropsOldestPagesWhenFull) {
+  constexpr Record Count = 10 * FlashLog::RecordsPerPage + 17;
+  FlashLog log = NewLog();
+  log.Init();
+  AppendRange(&log, 0, Count);
+
+  // The last page is partly written, the one after it erased ahead, so the
+  // two before it hold the oldest records.
+  std::vector<Record> records = Records(log);
+  ASSERT_EQ(records.size(), 2 * FlashLog::RecordsPerPage + 17);
+  for (size_t i = 0; i < records.size(); ++i) {
+    EXPECT_EQ(records[i], Count - records.size() + i);
+  }
+
+  // Same after a reset.
+  FlashLog resumed = NewLog();
+  resumed.Init();
+  AppendRange(&resumed, Count, Count + 1);
+  records = Records(resumed);
+  EXPECT_EQ(records.front(), Count + 1 - records.size());
+  EXPECT_EQ(records.back(), Count);
+}
+
+TEST_F(FlashLogTest, DropsWhenQueueIsFull) {
+  FlashLog log = NewLog();
+  log.Init();
+  for (Record r = 0; r < FlashLog::QueueSize; ++r) {
+    ASSERT_TRUE(log.Append(r));
+  }
+  EXPECT_FALSE(log.Append(FlashLog::QueueSize));
+  EXPECT_EQ(log.dropped(), 1u);
+  log.Flush();
+  EXPECT_EQ(Records(log).size(), FlashLog::QueueSize);
+}
+
+TEST_F(FlashLogTest, StepsOneFlashOperationAtATime) {
+  constexpr Record Full = 3 * FlashLog::RecordsPerPage;
+  FlashLog log = NewLog();
+  log.Init();
+  AppendRange(&log, 0, Full);
+  ASSERT_EQ(Records(log).size(), Full);
+
+  ASSERT_TRUE(log.Append(Full));
+  ASSERT_TRUE(log.Append(Full + 1));
+  // The last page, erased ahead, gets its header...
+  EXPECT_TRUE(log.Step());
+  EXPECT_EQ(Records(log).size(), Full);
+  // ...then one record per step.
+  EXPECT_TRUE(log.Step());
+  EXPECT_EQ(Records(log).size(), Full + 1);
+  EXPECT_TRUE(log.Step());
+  EXPECT_EQ(Records(log).size(), Full + 2);
+  // Only then is the oldest page erased, ahead of need, in a step of its own.
+  EXPECT_TRUE(log.Step());
+  EXPECT_EQ(Records(log).size(), Full + 2 - FlashLog::RecordsPerPage);
+  EXPECT_FALSE(log.Step());
+}
+
+TEST_F(FlashLogTest, IgnoresOtherLogs) {
+  FlashLog other(0x87654321, LogFlashAddr, Pages * FlashPageSize);
+  other.Init();
+  AppendRange(&other, 0, 10);
+
+  // Pages of another log are as good as garbage: erased before use.
+  FlashLog log = NewLog();
+  log.Init();
+  EXPECT_TRUE(Records(log).empty());
+  AppendRange(&log, 100, 110);
+  EXPECT_EQ(Records(log).size(), 10u);
+}
+
+class EventLogTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    EraseLogFlash();
+    log.Init(microsSinceStartup(0));
+    log.Flush();
+  }
+
+  static BreathSummary Breath(float pip, float peep, float volume, uint32_t duration_ms) {
+    BreathSummary summary = BreathSummary_init_zero;
+    summary.pip_cm_h2o = pip;
+    summary.peep_cm_h2o = peep;
+    summary.inspired_tidal_volume_ml = volume;
+    summary.inspiratory_time_ms = duration_ms / 3;
+    summary.expiratory_time_ms = duration_ms - duration_ms / 3;
+    summary.trigger = BreathTrigger_PATIENT;
+    return summary;
+  }
+
+  // Adds `count` breaths of 4 seconds each, starting at `start`.  Returns the
+  // end of the last one.
+  Time AddBreaths(Time start, int count) {
+    Time now = start;
+    for (int i = 0; i < count; ++i) {
+      now = now + seconds(4);
+      log.AddBreath(now, Breath(20, 5, 400, 4000));
+      log.Flush();
+    }
+    return now;
+  }
+
+  template <typename T>
+  std::vector<T> RecordsOfType(const FlashLog &flash_log, EventLog::RecordType type) {
+    std::vector<T> records;
+    flash_log.ForEach([&](Record r) {
+      if (EventLog::TypeOf(r) == type) records.push_back(EventLog::Decode<T>(r));
+    });
+    return records;
+  }
+
+  EventLog log{LogFlashAddr, LogFlashSize};
+};
+
+TEST_F(EventLogTest, LogsReset) {
+  auto events =
+      RecordsOfType<EventLog::EventRecord>(log.history_log(), EventLog::RecordType::Event);
+  ASSERT_EQ(events.size(), 1u);
+  EXPECT_EQ(events[0].event, EventLog::Event::Reset);
+  EXPECT_EQ(events[0].uptime_ms, 0u);
+}
+
+TEST_F(EventLogTest, LogsEvents) {
+  log.AddEvent(microsSinceStartup(12'345'000), EventLog::Event::ModeChange,
+               VentMode_PRESSURE_CONTROL);
+  log.Flush();
+  auto events =
+      RecordsOfType<EventLog::EventRecord>(log.history_log(), EventLog::RecordType::Event);
+  ASSERT_EQ(events.size(), 2u);
+  EXPECT_EQ(events[1].event, EventLog::Event::ModeChange);
+  EXPECT_EQ(events[1].arg, VentMode_PRESSURE_CONTROL);
+  EXPECT_EQ(events[1].uptime_ms, 12'345u);
+}
+
+TEST_F(EventLogTest, LogsBreaths) {
+  log.AddBreath(microsSinceStartup(10'000'000), Breath(25.3f, 4.9f, 512.6f, 3000));
+  log.Flush();
+
+  std::vector<Record> records = Records(log.breath_log());
+  ASSERT_EQ(records.size(), 2u);
+  ASSERT_EQ(EventLog::TypeOf(records[0]), EventLog::RecordType::Time);
+  EXPECT_EQ(EventLog::Decode<EventLog::TimeRecord>(records[0]).uptime_ms, 10'000u);
+
+  ASSERT_EQ(EventLog::TypeOf(records[1]), EventLog::RecordType::Breath);
+  auto breath = EventLog::Decode<EventLog::BreathRecord>(records[1]);
+  EXPECT_EQ(breath.trigger, BreathTrigger_PATIENT);
+  EXPECT_EQ(breath.pip, 51);   // 25.5 cmH2O
+  EXPECT_EQ(breath.peep, 10);  // 5 cmH2O
+  EXPECT_EQ(breath.volume_ml, 513);
+  EXPECT_EQ(breath.duration_cs, 300);
+}
+
+TEST_F(EventLogTest, TimeRecordsOnlyWhenNeeded) {
+  // Back to back breaths are timed by their durations, with a time record
+  // every so often.
+  Time now = AddBreaths(microsSinceStartup(0), 2 * EventLog::BreathsPerTimeRecord);
+  auto times = RecordsOfType<EventLog::TimeRecord>(log.breath_log(), EventLog::RecordType::Time);
+  EXPECT_EQ(times.size(), 2u);
+
+  // After a pause, there's a new time record.
+  AddBreaths(now + seconds(30), 1);
+  times = RecordsOfType<EventLog::TimeRecord>(log.breath_log(), EventLog::RecordType::Time);
+  ASSERT_EQ(times.size(), 3u);
+  EXPECT_EQ(times.back().uptime_ms, (now + seconds(34)).microsSinceStartup() / 1000);
+}
+
+TEST_F(EventLogTest, SummarizesMinutes) {
+  // 15 breaths a minute, for 2 minutes and a bit.
+  AddBreaths(microsSinceStartup(0), 31);
+  auto minutes =
+      RecordsOfType<EventLog::MinuteRecord>(log.history_log(), EventLog::RecordType::Minute);
+  ASSERT_EQ(minutes.size(), 2u);
+  // The first minute ends before the 15th breath ends, at 60s.
+  EXPECT_EQ(minutes[0].uptime_min, 0);
+  EXPECT_EQ(minutes[0].breaths, 14);
+  EXPECT_EQ(minutes[1].uptime_min, 1);
+  EXPECT_EQ(minutes[1].breaths, 15);
+  EXPECT_EQ(minutes[1].pip, 40);
+  EXPECT_EQ(minutes[1].peep, 10);
+  EXPECT_EQ(minutes[1].volume_ml, 400);
+}
+
+TEST_F(EventLogTest, FitsAWeekOfHistory) {
+  // A minute record per minute, for a week, plus a few events.
+  constexpr size_t Week = 7 * 24 * 60;
+  size_t history_records = (EventLog::HistoryPages - 2) * FlashLog::RecordsPerPage;
+  EXPECT_GT(history_records, Week + Week / 10);
+}
@@ -0,0 +1,87 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "loop_timing.h"
+
+#include <cstring>
+
+#include "gtest/gtest.h"
+
+TEST(LoopTiming, Histogram) {
+  LoopTiming timing;
+  timing.Reset();
+  for (uint32_t jitter_us : {0, 1, 2, 4, 9, 19, 49, 99, 999, 1000, 50000}) {
+    timing.Record(jitter_us, 100, false);
+  }
+  const uint32_t expected[LoopTiming::JitterBins] = {2, 2, 1, 1, 1, 1, 1, 2};
+  for (size_t i = 0; i < LoopTiming::JitterBins; i++) {
+    EXPECT_EQ(timing.jitter_histogram[i], expected[i]) << "bin " << i;
+  }
+  EXPECT_EQ(timing.invocations, 11u);
+  EXPECT_EQ(timing.max_jitter_us, 50000u);
+  EXPECT_EQ(timing.overruns, 0u);
+}
+
+TEST(LoopTiming, OverrunsAndRunTime) {
+  LoopTiming timing;
+  timing.Reset();
+  timing.Record(3, 500, false);
+  timing.Record(4, 12000, true);
+  timing.Record(2000, 300, false);
+  EXPECT_EQ(timing.overruns, 1u);
+  EXPECT_EQ(timing.max_run_time_us, 12000u);
+  EXPECT_EQ(timing.max_jitter_us, 2000u);
+}
+
+TEST(LoopTiming, RecentInvocations) {
+  LoopTiming timing;
+  timing.Reset();
+  for (uint32_t i = 0; i < 3 * LoopTiming::RecentCount + 5; i++) {
+    timing.Record(i, 10 * i, false);
+  }
+  uint32_t last = timing.invocations - 1;
+  for (size_t n = 0; n < LoopTiming::RecentCount; n++) {
+    EXPECT_EQ(timing.Recent(n).jitter_us, last - n);
+    EXPECT_EQ(timing.Recent(n).run_time_us, 10 * (last - n));
+  }
+
+  // Values too large to keep for every recent call saturate.
+  timing.Record(100000, 70000, true);
+  EXPECT_EQ(timing.Recent(0).jitter_us, UINT16_MAX);
+  EXPECT_EQ(timing.Recent(0).run_time_us, UINT16_MAX);
+  EXPECT_EQ(timing.max_jitter_us, 100000u);
+}
+
+TEST(LoopTiming, Validity) {
+  // Uninitialized RAM is unlikely to look like a valid record, whether it
+  // comes up all zeros or all ones.
+  LoopTiming timing;
+  EXPECT_FALSE(timing.Valid());
+  memset(static_cast<void *>(&timing), 0xFF, sizeof(timing));
+  EXPECT_FALSE(timing.Valid());
+
+  timing.Reset();
+  EXPECT_TRUE(timing.Valid());
+  EXPECT_EQ(timing.invocations, 0u);
+  EXPECT_EQ(timing.jitter_histogram[LoopTiming::JitterBins - 1], 0u);
+
+  // The record is what survives a reset, and it must keep counting from where
+  // it was.
+  timing.Record(1, 1, true);
+  LoopTiming copy;
+  memcpy(static_cast<void *>(&copy), &timing, sizeof(timing));
+  EXPECT_TRUE(copy.Valid());
+  EXPECT_EQ(copy.overruns, 1u);
+}
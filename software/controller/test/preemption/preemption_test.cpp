@@ -0,0 +1,247 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+// Tests of the preemption simulator in the fake HAL, and of the code it's for:
+// data shared between the loop timer interrupt and the background loop.
+
+#include <functional>
+#include <vector>
+
+#include "circular_buffer.h"
+#include "gtest/gtest.h"
+#include "hal.h"
+#include "seqlock.h"
+#include "trace.h"
+#include "vars.h"
+
+// What the loop timer "interrupt" runs.
+static std::function<void()> isr;
+static void LoopTimerCallback(void *) {
+  if (isr) isr();
+}
+
+class PreemptionTest : public ::testing::Test {
+ protected:
+  void SetUp() override { hal.StartLoopTimer(milliseconds(10), LoopTimerCallback, nullptr); }
+  void TearDown() override {
+    hal.TESTStopPreempting();
+    hal.StartLoopTimer(milliseconds(10), nullptr, nullptr);
+    isr = nullptr;
+  }
+};
+
+TEST_F(PreemptionTest, RunsWhenRaised) {
+  int runs = 0;
+  isr = [&] {
+    EXPECT_TRUE(hal.InInterruptHandler());
+    runs++;
+  };
+  EXPECT_FALSE(hal.InInterruptHandler());
+  hal.TESTRaiseLoopTimer();
+  EXPECT_EQ(runs, 1);
+  EXPECT_FALSE(hal.InInterruptHandler());
+}
+
+TEST_F(PreemptionTest, DeferredWhileInterruptsBlocked) {
+  int runs = 0;
+  isr = [&] { runs++; };
+  {
+    BlockInterrupts block;
+    hal.TESTRaiseLoopTimer();
+    {
+      BlockInterrupts nested;
+    }
+    // Still in the outer block.
+    EXPECT_EQ(runs, 0);
+  }
+  EXPECT_EQ(runs, 1);
+}
+
+TEST_F(PreemptionTest, DoesNotNest) {
+  int depth = 0;
+  int runs = 0;
+  isr = [&] {
+    EXPECT_EQ(depth++, 0);
+    // Raised from within the handler, it runs again once the handler is done.
+    if (++runs == 1) hal.TESTRaiseLoopTimer();
+    hal.TESTPreemptionPoint();
+    depth--;
+  };
+  hal.TESTPreemptRandomly(1.0, 0);
+  hal.TESTRaiseLoopTimer();
+  EXPECT_EQ(runs, 2);
+}
+
+TEST_F(PreemptionTest, PreemptsAtChosenPoints) {
+  std::vector<uint32_t> preempted;
+  isr = [&] { preempted.push_back(hal.TESTPreemptionPoints()); };
+  hal.TESTPreemptAt({1, 4});
+  for (int i = 0; i < 6; ++i) (void)hal.Now();
+  // Counted after each point, so the count is one past the point.
+  EXPECT_EQ(preempted, (std::vector<uint32_t>{2, 5}));
+  EXPECT_EQ(hal.TESTPreemptionPoints(), 6u);
+}
+
+TEST_F(PreemptionTest, RandomPreemptionIsReproducible) {
+  auto run = [&](uint32_t seed) {
+    std::vector<uint32_t> preempted;
+    isr = [&] { preempted.push_back(hal.TESTPreemptionPoints()); };
+    hal.TESTPreemptRandomly(0.1, seed);
+    for (int i = 0; i < 1000; ++i) hal.TESTPreemptionPoint();
+    return preempted;
+  };
+  std::vector<uint32_t> first = run(42);
+  EXPECT_GT(first.size(), 50u);
+  EXPECT_LT(first.size(), 150u);
+  EXPECT_EQ(run(42), first);
+  EXPECT_NE(run(43), first);
+}
+
+// The simulator catches what it's meant to catch: without a critical section,
+// the interrupt landing between a read and a write loses an update.
+TEST_F(PreemptionTest, CatchesUnprotectedReadModifyWrite) {
+  auto lost_updates = [&](bool protect) {
+    volatile int counter = 0;
+    int isr_runs = 0;
+    isr = [&] {
+      counter = counter + 1;
+      isr_runs++;
+    };
+    hal.TESTPreemptRandomly(0.3, 1);
+    for (int i = 0; i < 1000; ++i) {
+      auto increment = [&] {
+        int value = counter;
+        hal.TESTPreemptionPoint();
+        counter = value + 1;
+      };
+      if (protect) {
+        BlockInterrupts block;
+        increment();
+      } else {
+        increment();
+      }
+    }
+    return 1000 + isr_runs - counter;
+  };
+  EXPECT_GT(lost_updates(false), 0);
+  EXPECT_EQ(lost_updates(true), 0);
+}
+
+TEST_F(PreemptionTest, CircularBuffer) {
+  CircularBuffer<uint32_t, 16> buffer;
+  uint32_t produced = 0;
+  std::vector<uint32_t> dropped;
+  isr = [&] {
+    // A few values per tick, so that the buffer fills up now and then.
+    for (int i = 0; i < 3; ++i, ++produced) {
+      if (!buffer.Put(produced)) dropped.push_back(produced);
+    }
+  };
+
+  hal.TESTPreemptRandomly(0.2, 2021);
+  std::vector<uint32_t> received;
+  while (produced < 10'000) {
+    if (auto value = buffer.Get()) received.push_back(*value);
+    hal.TESTPreemptionPoint();
+  }
+  hal.TESTStopPreempting();
+  while (auto value = buffer.Get()) received.push_back(*value);
+
+  // Every value got through exactly once, in order, unless it was dropped.
+  EXPECT_FALSE(dropped.empty());
+  ASSERT_EQ(received.size() + dropped.size(), produced);
+  size_t next_dropped = 0;
+  uint32_t expected = 0;
+  for (uint32_t value : received) {
+    while (next_dropped < dropped.size() && dropped[next_dropped] == expected) {
+      next_dropped++;
+      expected++;
+    }
+    ASSERT_EQ(value, expected++);
+  }
+}
+
+TEST_F(PreemptionTest, TraceRecords) {
+  uint32_t a = 0;
+  uint32_t b = 0;
+  Debug::Variable::Primitive32 var_a("preempt_a", Debug::Variable::Access::ReadOnly, &a, "");
+  Debug::Variable::Primitive32 var_b("preempt_b", Debug::Variable::Access::ReadOnly, &b, "");
+  Debug::Trace trace;
+  ASSERT_TRUE(trace.set_traced_variable(0, var_a.id()));
+  ASSERT_TRUE(trace.set_traced_variable(1, var_b.id()));
+  trace.start();
+  isr = [&] {
+    a++;
+    b = 2 * a;
+    trace.maybe_sample();
+  };
+
+  hal.TESTPreemptRandomly(0.3, 7);
+  uint32_t last = 0;
+  size_t records = 0;
+  while (a < 5'000) {
+    std::array<uint32_t, Debug::Trace::MaxVars> record;
+    size_t count;
+    if (trace.get_next_record(&record, &count)) {
+      ASSERT_EQ(count, 2u);
+      ASSERT_EQ(record[1], 2 * record[0]);
+      ASSERT_GT(record[0], last);
+      last = record[0];
+      records++;
+    }
+    hal.TESTPreemptionPoint();
+  }
+  EXPECT_GT(records, 1000u);
+}
+
+// A pair of values that the background loop may be preempted in the middle of
+// copying.  Consistent as long as a == b.
+struct Pair {
+  uint32_t a = 0;
+  uint32_t b = 0;
+
+  Pair() = default;
+  Pair(const Pair &other) { *this = other; }
+  Pair &operator=(const Pair &other) {
+    a = other.a;
+    hal.TESTPreemptionPoint();
+    b = other.b;
+    return *this;
+  }
+};
+
+TEST_F(PreemptionTest, SeqLock) {
+  SeqLock<Pair> lock;
+  uint32_t writes = 0;
+  isr = [&] {
+    writes++;
+    lock.Update([&](Pair &p) {
+      p.a = writes;
+      p.b = writes;
+    });
+  };
+
+  hal.TESTPreemptRandomly(0.3, 3);
+  uint32_t last = 0;
+  while (writes < 5'000) {
+    Pair p = lock.Read();
+    ASSERT_EQ(p.a, p.b);
+    ASSERT_GE(p.a, last);
+    last = p.a;
+  }
+  // Some of those reads were torn, and retried.
+  EXPECT_GT(lock.retries(), 0u);
+}
@@ -0,0 +1,132 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "sample_batcher.h"
+
+#include <pb_decode.h>
+#include <pb_encode.h>
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+static SensorReadings Readings(float pressure_cm_h2o, float fio2) {
+  return {
+      .patient_pressure = cmH2O(pressure_cm_h2o),
+      .fio2 = fio2,
+      .air_inflow = ml_per_min(0),
+      .oxygen_inflow = ml_per_min(0),
+      .outflow = ml_per_min(0),
+  };
+}
+
+static ControllerState State(float flow_ml_per_min, float volume_ml, float setpoint_cm_h2o) {
+  return {
+      .pressure_setpoint = cmH2O(setpoint_cm_h2o),
+      .patient_volume = ml(volume_ml),
+      .net_flow = ml_per_min(flow_ml_per_min),
+      .flow_correction = ml_per_min(0),
+  };
+}
+
+// Undoes the delta encoding of one SampleBatch field.
+static std::vector<int32_t> Decode(const int32_t *values, pb_size_t count) {
+  std::vector<int32_t> result;
+  for (pb_size_t i = 0; i < count; ++i) {
+    result.push_back(i == 0 ? values[0] : result.back() + values[i]);
+  }
+  return result;
+}
+
+TEST(SampleBatcher, DeltaEncoding) {
+  SampleBatcher batcher(milliseconds(10));
+  batcher.AddSample(Readings(5.f, 0.21f), State(0, 0, 5));
+  batcher.AddSample(Readings(7.25f, 0.21f), State(12'000, 20, 15));
+  batcher.AddSample(Readings(12.5f, 0.22f), State(30'000, 70.5f, 15));
+
+  const SampleBatch &b = batcher.batch();
+  EXPECT_EQ(b.first_sample, 0u);
+  EXPECT_EQ(b.sample_period_us, 10'000u);
+  EXPECT_EQ(Decode(b.patient_pressure_cm_h2o_x100, b.patient_pressure_cm_h2o_x100_count),
+            (std::vector<int32_t>{500, 725, 1250}));
+  EXPECT_EQ(Decode(b.flow_ml_per_min, b.flow_ml_per_min_count),
+            (std::vector<int32_t>{0, 12'000, 30'000}));
+  EXPECT_EQ(Decode(b.volume_ml_x10, b.volume_ml_x10_count), (std::vector<int32_t>{0, 200, 705}));
+  EXPECT_EQ(Decode(b.pressure_setpoint_cm_h2o_x100, b.pressure_setpoint_cm_h2o_x100_count),
+            (std::vector<int32_t>{500, 1500, 1500}));
+  EXPECT_EQ(Decode(b.fio2_x1000, b.fio2_x1000_count), (std::vector<int32_t>{210, 210, 220}));
+  // Stored as deltas.
+  EXPECT_EQ(b.pressure_setpoint_cm_h2o_x100[2], 0);
+}
+
+TEST(SampleBatcher, OverflowDropsOldest) {
+  SampleBatcher batcher(milliseconds(10));
+  constexpr size_t Capacity = std::size(SampleBatch{}.flow_ml_per_min);
+  for (size_t i = 0; i < Capacity + 2; ++i) {
+    batcher.AddSample(Readings(0, 0), State(static_cast<float>(i * 100), 0, 0));
+  }
+  const SampleBatch &b = batcher.batch();
+  EXPECT_EQ(b.first_sample, 2u);
+  std::vector<int32_t> flow = Decode(b.flow_ml_per_min, b.flow_ml_per_min_count);
+  ASSERT_EQ(flow.size(), Capacity);
+  EXPECT_EQ(flow.front(), 200);
+  EXPECT_EQ(flow.back(), static_cast<int32_t>((Capacity + 1) * 100));
+}
+
+TEST(SampleBatcher, DropSentKeepsNewerSamples) {
+  SampleBatcher batcher(milliseconds(10));
+  batcher.AddSample(Readings(1, 0), State(0, 0, 0));
+  batcher.AddSample(Readings(2, 0), State(0, 0, 0));
+  SampleBatch sent = batcher.batch();
+  batcher.AddSample(Readings(3, 0), State(0, 0, 0));
+  batcher.AddSample(Readings(4, 0), State(0, 0, 0));
+
+  batcher.DropSent(sent);
+  const SampleBatch &b = batcher.batch();
+  EXPECT_EQ(b.first_sample, 2u);
+  EXPECT_EQ(Decode(b.patient_pressure_cm_h2o_x100, b.patient_pressure_cm_h2o_x100_count),
+            (std::vector<int32_t>{300, 400}));
+
+  batcher.DropSent(batcher.batch());
+  EXPECT_EQ(batcher.batch().patient_pressure_cm_h2o_x100_count, 0);
+  batcher.AddSample(Readings(5, 0), State(0, 0, 0));
+  EXPECT_EQ(batcher.batch().first_sample, 4u);
+  EXPECT_EQ(batcher.batch().patient_pressure_cm_h2o_x100[0], 500);
+}
+
+// The three loop samples taken per ControllerStatus take fewer bytes than a
+// single SensorsProto snapshot.
+TEST(SampleBatcher, EncodedSize) {
+  SampleBatcher batcher(milliseconds(10));
+  batcher.AddSample(Readings(14.9f, 0.21f), State(25'000, 310, 15));
+  batcher.AddSample(Readings(15.1f, 0.21f), State(24'100, 314, 15));
+  batcher.AddSample(Readings(15.0f, 0.21f), State(23'300, 318, 15));
+
+  uint8_t buffer[SampleBatch_size];
+  pb_ostream_t stream = pb_ostream_from_buffer(buffer, sizeof(buffer));
+  ASSERT_TRUE(pb_encode(&stream, SampleBatch_fields, &batcher.batch()));
+
+  SensorsProto snapshot = AsSensorsProto(Readings(15.0f, 0.21f), State(23'300, 318, 15));
+  snapshot.breath_id = 123'456'789;
+  size_t snapshot_size = 0;
+  ASSERT_TRUE(pb_get_encoded_size(&snapshot_size, SensorsProto_fields, &snapshot));
+  EXPECT_LT(stream.bytes_written, snapshot_size);
+
+  SampleBatch decoded = SampleBatch_init_zero;
+  pb_istream_t istream = pb_istream_from_buffer(buffer, stream.bytes_written);
+  ASSERT_TRUE(pb_decode(&istream, SampleBatch_fields, &decoded));
+  EXPECT_EQ(Decode(decoded.volume_ml_x10, decoded.volume_ml_x10_count),
+            (std::vector<int32_t>{3100, 3140, 3180}));
+}
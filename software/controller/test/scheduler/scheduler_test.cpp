@@ -0,0 +1,187 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "scheduler.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+#include "hal.h"
+
+static constexpr Duration BasePeriod = milliseconds(10);
+
+// Each task records when it ran and pretends to take some time to execute.
+static std::vector<Time> fast_runs;
+static Duration fast_exec_time = microseconds(0);
+static void FastTask(Time now) {
+  fast_runs.push_back(now);
+  hal.Delay(fast_exec_time);
+}
+
+static std::vector<Time> slow_runs;
+static Duration slow_exec_time = microseconds(0);
+static void SlowTask(Time now) {
+  slow_runs.push_back(now);
+  hal.Delay(slow_exec_time);
+}
+
+class SchedulerTest : public ::testing::Test {
+ protected:
+  void SetUp() override {
+    fast_runs.clear();
+    slow_runs.clear();
+    fast_exec_time = microseconds(0);
+    slow_exec_time = microseconds(0);
+  }
+
+  // Simulates the loop timer: calls tick() every BasePeriod, accounting for
+  // the time the tasks took to execute.
+  template <size_t N>
+  void RunTicks(Scheduler<N> *scheduler, int ticks) {
+    for (int i = 0; i < ticks; ++i) {
+      Time start = hal.Now();
+      scheduler->tick(start);
+      Duration elapsed = hal.Now() - start;
+      if (elapsed < BasePeriod) hal.Delay(BasePeriod - elapsed);
+    }
+  }
+};
+
+TEST_F(SchedulerTest, GroupsRunAtTheirOwnRate) {
+  RateGroup fast("fast_", 1, FastTask);
+  RateGroup slow("slow_", 5, SlowTask);
+  Scheduler scheduler(BasePeriod, std::array{&fast, &slow});
+  EXPECT_EQ(scheduler.base_period(), BasePeriod);
+
+  Time start = hal.Now();
+  RunTicks(&scheduler, 20);
+
+  ASSERT_EQ(fast_runs.size(), 20);
+  ASSERT_EQ(slow_runs.size(), 4);
+  EXPECT_EQ(fast.run_count(), 20);
+  EXPECT_EQ(slow.run_count(), 4);
+
+  // Every group is due on the first tick.
+  EXPECT_EQ(fast_runs[0], start);
+  EXPECT_EQ(slow_runs[0], start);
+  for (size_t i = 1; i < slow_runs.size(); ++i) {
+    EXPECT_EQ(slow_runs[i] - slow_runs[i - 1], 5 * BasePeriod);
+  }
+
+  EXPECT_EQ(fast.deadline_misses(), 0);
+  EXPECT_EQ(slow.deadline_misses(), 0);
+}
+
+TEST_F(SchedulerTest, RunSoon) {
+  RateGroup fast("fast_", 1, FastTask);
+  RateGroup slow("slow_", 10, SlowTask);
+  Scheduler scheduler(BasePeriod, std::array{&fast, &slow});
+
+  RunTicks(&scheduler, 3);
+  ASSERT_EQ(slow_runs.size(), 1);
+
+  // Due on the next tick rather than 7 ticks from now, then every 10 ticks.
+  scheduler.run_soon(&slow);
+  Time soon = hal.Now();
+  RunTicks(&scheduler, 11);
+  ASSERT_EQ(slow_runs.size(), 3);
+  EXPECT_EQ(slow_runs[1], soon);
+  EXPECT_EQ(slow_runs[2] - slow_runs[1], 10 * BasePeriod);
+  EXPECT_EQ(fast_runs.size(), 14);
+}
+
+TEST_F(SchedulerTest, ZeroDivisorRunsEveryTick) {
+  RateGroup fast("fast_", 0, FastTask);
+  Scheduler scheduler(BasePeriod, std::array{&fast});
+  EXPECT_EQ(fast.divisor(), 1);
+  RunTicks(&scheduler, 3);
+  EXPECT_EQ(fast_runs.size(), 3);
+}
+
+TEST_F(SchedulerTest, MeasuresExecutionTime) {
+  RateGroup fast("fast_", 1, FastTask);
+  RateGroup slow("slow_", 2, SlowTask);
+  Scheduler scheduler(BasePeriod, std::array{&fast, &slow});
+
+  fast_exec_time = microseconds(300);
+  slow_exec_time = microseconds(2000);
+  RunTicks(&scheduler, 2);
+  EXPECT_EQ(fast.last_exec_time(), microseconds(300));
+  EXPECT_EQ(slow.last_exec_time(), microseconds(2000));
+
+  // The slow group runs after the fast one in the same tick, but that is not
+  // counted in its execution time.
+  EXPECT_EQ(slow_runs[0] - fast_runs[0], microseconds(300));
+
+  fast_exec_time = microseconds(100);
+  RunTicks(&scheduler, 1);
+  EXPECT_EQ(fast.last_exec_time(), microseconds(100));
+  EXPECT_EQ(fast.max_exec_time(), microseconds(300));
+}
+
+TEST_F(SchedulerTest, CountsDeadlineMisses) {
+  RateGroup fast("fast_", 1, FastTask);
+  RateGroup slow("slow_", 3, SlowTask);
+  Scheduler scheduler(BasePeriod, std::array{&fast, &slow});
+
+  // The slow group has 30ms to complete, including the time taken by the fast
+  // group in the same tick.
+  fast_exec_time = milliseconds(5);
+  slow_exec_time = milliseconds(24);
+  RunTicks(&scheduler, 3);
+  EXPECT_EQ(fast.deadline_misses(), 0);
+  EXPECT_EQ(slow.deadline_misses(), 0);
+
+  slow_exec_time = milliseconds(26);
+  RunTicks(&scheduler, 6);
+  EXPECT_EQ(fast.deadline_misses(), 0);
+  EXPECT_EQ(slow.deadline_misses(), 2);
+
+  fast_exec_time = milliseconds(11);
+  RunTicks(&scheduler, 1);
+  EXPECT_EQ(fast.deadline_misses(), 1);
+}
+
+TEST_F(SchedulerTest, DebugVars) {
+  auto &registry = Debug::Variable::Registry::singleton();
+  uint16_t count_offset = registry.count();
+  RateGroup fast("fast_", 1, FastTask);
+  Scheduler scheduler(BasePeriod, std::array{&fast});
+  ASSERT_EQ(registry.count(), 3 + count_offset);
+
+  auto exec_time = reinterpret_cast<Debug::Variable::UInt32 *>(registry.find(count_offset));
+  auto max_exec_time =
+      reinterpret_cast<Debug::Variable::UInt32 *>(registry.find(uint16_t(count_offset + 1)));
+  auto misses =
+      reinterpret_cast<Debug::Variable::UInt32 *>(registry.find(uint16_t(count_offset + 2)));
+  EXPECT_STREQ(exec_time->name(), "fast_exec_time");
+  EXPECT_STREQ(max_exec_time->name(), "fast_max_exec_time");
+  EXPECT_STREQ(misses->name(), "fast_deadline_misses");
+
+  fast_exec_time = microseconds(700);
+  RunTicks(&scheduler, 1);
+  EXPECT_EQ(exec_time->get(), 700);
+  EXPECT_EQ(max_exec_time->get(), 700);
+
+  // Zeroing the max through the debug interface restarts the measurement.
+  max_exec_time->set(0);
+  fast_exec_time = microseconds(200);
+  RunTicks(&scheduler, 1);
+  EXPECT_EQ(max_exec_time->get(), 200);
+
+  fast_exec_time = milliseconds(12);
+  RunTicks(&scheduler, 1);
+  EXPECT_EQ(misses->get(), 1);
+}
@@ -0,0 +1,165 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+
+#include "ms4525do.h"
+
+#include <array>
+
+#include "gtest/gtest.h"
+#include "hal.h"
+
+using Status = MS4525DO::Status;
+
+static constexpr float PressureToleranceKPa{0.001f};
+
+// Bytes the sensor returns for a measurement.
+static std::array<uint8_t, MS4525DO::ReadSize> Raw(Status status, uint16_t pressure_counts,
+                                                   uint16_t temperature_counts) {
+  return {
+      static_cast<uint8_t>(static_cast<uint8_t>(status) << 6 | pressure_counts >> 8),
+      static_cast<uint8_t>(pressure_counts),
+      static_cast<uint8_t>(temperature_counts >> 3),
+      static_cast<uint8_t>(temperature_counts << 5),
+  };
+}
+
+// Completes the read in flight on `channel`, with `raw` as the sensor's answer.
+static void Answer(I2C::TestChannel *channel, const std::array<uint8_t, MS4525DO::ReadSize> &raw) {
+  for (uint8_t byte : raw) {
+    channel->TESTQueueReceiveData(byte);
+  }
+  for (size_t i = 0; i < raw.size(); ++i) {
+    channel->I2CEventHandler();
+  }
+}
+
+TEST(MS4525DO, Decode) {
+  I2C::TestChannel channel;
+  MS4525DO sensor("", "", &channel);
+
+  struct {
+    uint16_t counts;
+    Pressure expected;
+  } cases[] = {
+      {1638, MS4525DO::MinPressure},
+      {14745, MS4525DO::MaxPressure},
+      {8192, kPa(0)},
+      {0, MS4525DO::MinPressure - (MS4525DO::MaxPressure - MS4525DO::MinPressure) / 8},
+  };
+  for (const auto &c : cases) {
+    auto raw = Raw(Status::Normal, c.counts, 0);
+    MS4525DO::Sample sample;
+    EXPECT_EQ(sensor.Decode({raw[0], raw[1], raw[2], raw[3]}, &sample), Status::Normal);
+    EXPECT_NEAR(sample.pressure.kPa(), c.expected.kPa(), PressureToleranceKPa) << c.counts;
+  }
+
+  // Temperature goes from -50 to 150 C over 11 bits.
+  MS4525DO::Sample sample;
+  auto raw = Raw(Status::Fault, 8192, 1023);
+  EXPECT_EQ(sensor.Decode({raw[0], raw[1], raw[2], raw[3]}, &sample), Status::Fault);
+  EXPECT_NEAR(sample.temperature_C, 49.95f, 0.01f);
+  raw = Raw(Status::Stale, 8192, 2047);
+  EXPECT_EQ(sensor.Decode({raw[0], raw[1], raw[2], raw[3]}, &sample), Status::Stale);
+  EXPECT_NEAR(sample.temperature_C, 150.f, 0.01f);
+}
+
+TEST(MS4525DO, PollsContinuously) {
+  I2C::TestChannel channel;
+  MS4525DO sensor("", "", &channel);
+
+  Time start = hal.Now();
+  EXPECT_TRUE(sensor.stale(start));
+  EXPECT_EQ(sensor.read(hal).kPa(), 0);
+
+  // Nothing is published until the read completes.
+  sensor.Poll(hal.Now());
+  sensor.Poll(hal.Now());
+  EXPECT_EQ(sensor.sample().count, 0u);
+
+  Answer(&channel, Raw(Status::Normal, 14745, 512));
+  Time first = hal.Now();
+  sensor.Poll(first);
+  EXPECT_EQ(sensor.sample().count, 1u);
+  EXPECT_EQ(sensor.sample().time, first);
+  EXPECT_NEAR(sensor.read(hal).kPa(), MS4525DO::MaxPressure.kPa(), PressureToleranceKPa);
+  EXPECT_FALSE(sensor.stale(first));
+
+  // Polling again sent the next read; a stale answer leaves the sample as is.
+  hal.Delay(milliseconds(1));
+  Answer(&channel, Raw(Status::Stale, 1638, 512));
+  sensor.Poll(hal.Now());
+  EXPECT_EQ(sensor.sample().count, 1u);
+  EXPECT_NEAR(sensor.read(hal).kPa(), MS4525DO::MaxPressure.kPa(), PressureToleranceKPa);
+
+  // So does a fault.
+  Answer(&channel, Raw(Status::Fault, 1638, 512));
+  sensor.Poll(hal.Now());
+  EXPECT_EQ(sensor.sample().count, 1u);
+
+  Answer(&channel, Raw(Status::Normal, 1638, 512));
+  sensor.Poll(hal.Now());
+  EXPECT_EQ(sensor.sample().count, 2u);
+  EXPECT_NEAR(sensor.read(hal).kPa(), MS4525DO::MinPressure.kPa(), PressureToleranceKPa);
+}
+
+TEST(MS4525DO, SampleAge) {
+  I2C::TestChannel channel;
+  MS4525DO sensor("", "", &channel);
+
+  sensor.Poll(hal.Now());
+  Answer(&channel, Raw(Status::Normal, 8192, 512));
+  Time sampled = hal.Now();
+  sensor.Poll(sampled);
+
+  // If the bus stops answering, the sample ages until it's stale.
+  hal.Delay(MS4525DO::MaxSampleAge);
+  sensor.Poll(hal.Now());
+  EXPECT_EQ(sensor.sample_age(hal.Now()), MS4525DO::MaxSampleAge);
+  EXPECT_FALSE(sensor.stale(hal.Now()));
+  hal.Delay(milliseconds(1));
+  EXPECT_TRUE(sensor.stale(hal.Now()));
+
+  // Until a new sample comes in.
+  Answer(&channel, Raw(Status::Normal, 8192, 512));
+  sensor.Poll(hal.Now());
+  EXPECT_FALSE(sensor.stale(hal.Now()));
+  EXPECT_EQ(sensor.sample_age(hal.Now()), microseconds(0));
+}
+
+TEST(MS4525DO, ResendsAbandonedRead) {
+  I2C::TestChannel channel;
+  MS4525DO sensor("", "", &channel);
+
+  // The channel gives up on the read after MaxRetries bus errors, and never
+  // reports it processed.
+  sensor.Poll(hal.Now());
+  for (int i = 0; i < 5; ++i) {
+    channel.I2CErrorHandler();
+  }
+
+  // We wait for it for a while...
+  hal.Delay(milliseconds(1));
+  sensor.Poll(hal.Now());
+  EXPECT_EQ(sensor.sample().count, 0u);
+
+  // ...then send another.
+  hal.Delay(MS4525DO::RequestTimeout);
+  sensor.Poll(hal.Now());
+  Answer(&channel, Raw(Status::Normal, 14745, 512));
+  sensor.Poll(hal.Now());
+  EXPECT_EQ(sensor.sample().count, 1u);
+  EXPECT_NEAR(sensor.read(hal).kPa(), MS4525DO::MaxPressure.kPa(), PressureToleranceKPa);
+}
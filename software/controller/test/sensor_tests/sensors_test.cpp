@@ -285,3 +285,42 @@ TEST(SensorTests, Calibration) {
                    typical_venturi.pressure_delta_to_flow(kPa(0.01f), air_density));
   EXPECT_NEAR(readings.fio2, 0.25f + 0.21f, ComparisonToleranceFIO2);
 }
+
+TEST(SensorTests, ReadingsShareOneSnapshot) {
+  Voltage voltage_at_0kPa = MPXV5004_PressureToVoltage(kPa(0));
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::PatientPressure), MPXV5010_PressureToVoltage(kPa(0)));
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::OxygenInflowPressureDiff), voltage_at_0kPa);
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::AirInflowPressureDiff), voltage_at_0kPa);
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::OutflowPressureDiff), voltage_at_0kPa);
+  hal.TESTSetAnalogPin(sensor_pin(Sensor::FIO2), FIO2ToVoltage(0.21f, atm(1.0f)));
+
+  Sensors sensors;
+  sensors.calibrate();
+
+  Pressure patient_pressure = kPa(1.2f);
+  Pressure air_influx_dp = kPa(0.4f);
+  Pressure outflow_dp = kPa(-0.3f);
+  SensorReadings readings = update_readings(/*dt=*/milliseconds(10),
+                                            /*oxy_influx_dp=*/kPa(0), patient_pressure,
+                                            air_influx_dp, outflow_dp,
+                                            /*ambient pressure=*/atm(1.0f),
+                                            /*fio2=*/0.21f, &sensors);
+
+  // All the readings come from one snapshot, taken when get_readings() was
+  // called.
+  EXPECT_EQ(readings.time, hal.Now());
+  AnalogSnapshot snapshot = hal.AnalogReadAll();
+  for (AnalogPin pin : {AnalogPin::InterimBoardAnalogPressure, AnalogPin::U3PatientPressure,
+                        AnalogPin::U4InhaleFlow, AnalogPin::U5ExhaleFlow,
+                        AnalogPin::InterimBoardOxygenSensor}) {
+    EXPECT_EQ(snapshot[pin].volts(), hal.AnalogRead(pin).volts());
+  }
+
+  EXPECT_PRESSURE_NEAR(readings.patient_pressure, patient_pressure);
+  EXPECT_FLOW_NEAR(readings.air_inflow,
+                   typical_venturi.pressure_delta_to_flow(air_influx_dp, air_density));
+  EXPECT_FLOW_NEAR(readings.outflow,
+                   typical_venturi.pressure_delta_to_flow(outflow_dp, air_density));
+  EXPECT_FLOW_NEAR(readings.oxygen_inflow, ml_per_sec(0));
+  EXPECT_NEAR(readings.fio2, 0.21f, ComparisonToleranceFIO2);
+}
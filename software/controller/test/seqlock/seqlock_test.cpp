@@ -0,0 +1,134 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "seqlock.h"
+
+#include <functional>
+#include <utility>
+
+#include "gtest/gtest.h"
+#include "hal.h"
+#include "microbench.h"
+#include "network_protocol.pb.h"
+
+// Called once in the middle of copying a Pair, to simulate an interrupt
+// arriving at the worst possible time.
+static std::function<void()> interrupt;
+
+static void MaybeInterrupt() {
+  if (interrupt) {
+    std::exchange(interrupt, nullptr)();
+  }
+}
+
+// Consistent as long as a == b.
+struct Pair {
+  int a = 0;
+  int b = 0;
+
+  Pair() = default;
+  Pair(int a, int b) : a(a), b(b) {}
+  Pair(const Pair &other) { *this = other; }
+  Pair &operator=(const Pair &other) {
+    a = other.a;
+    MaybeInterrupt();
+    b = other.b;
+    return *this;
+  }
+};
+
+TEST(SeqLock, ReadsWhatWasWritten) {
+  SeqLock<Pair> lock;
+  EXPECT_EQ(lock.Read().a, 0);
+  lock.Write(Pair(1, 1));
+  EXPECT_EQ(lock.Read().b, 1);
+  lock.Update([](Pair &p) { p.b = 2; });
+  EXPECT_EQ(lock.Read().b, 2);
+  EXPECT_EQ(lock.retries(), 0u);
+}
+
+TEST(SeqLock, RetriesTornRead) {
+  SeqLock<Pair> lock;
+  lock.Write(Pair(1, 1));
+
+  // The writer interrupts the reader halfway through its copy.
+  interrupt = [&] {
+    lock.Update([](Pair &p) {
+      p.a = 2;
+      p.b = 2;
+    });
+  };
+  Pair p = lock.Read();
+  EXPECT_EQ(p.a, 2);
+  EXPECT_EQ(p.b, 2);
+  EXPECT_EQ(lock.retries(), 1u);
+}
+
+TEST(DoubleBuffer, ReaderInterruptingWriterSeesPreviousValue) {
+  DoubleBuffer<Pair> buffer;
+  buffer.Write(Pair(1, 1));
+
+  // The reader interrupts the writer halfway through its copy.
+  Pair seen;
+  interrupt = [&] { seen = buffer.Read(); };
+  buffer.Write(Pair(2, 2));
+  EXPECT_EQ(seen.a, 1);
+  EXPECT_EQ(seen.b, 1);
+  EXPECT_EQ(buffer.Read().a, 2);
+  EXPECT_EQ(buffer.Read().b, 2);
+
+  // Both buffers get reused.
+  buffer.Write(Pair(3, 3));
+  EXPECT_EQ(buffer.Read().a, 3);
+}
+
+TEST(BlockInterrupts, MeasuresLongestBlock) {
+  hal.ResetMaxInterruptsBlockedTime();
+  {
+    BlockInterrupts block;
+    hal.Delay(microseconds(30));
+    {
+      // Nested blocks don't count separately.
+      BlockInterrupts inner;
+      hal.Delay(microseconds(20));
+    }
+  }
+  {
+    BlockInterrupts block;
+    hal.Delay(microseconds(10));
+  }
+  EXPECT_EQ(hal.MaxInterruptsBlockedTime().microseconds(), 50);
+  hal.ResetMaxInterruptsBlockedTime();
+  EXPECT_EQ(hal.MaxInterruptsBlockedTime().microseconds(), 0);
+}
+
+// How long the background loop used to keep interrupts disabled on every
+// iteration, copying ControllerStatus, compared to the cost of the seqlock
+// read which replaces it (with interrupts enabled).
+TEST(SeqLockBenchmark, ControllerStatusCopy) {
+  constexpr uint32_t Iterations = 100'000;
+  ControllerStatus shared = ControllerStatus_init_zero;
+  SeqLock<ControllerStatus> lock;
+
+  Microbench::Report("BlockInterrupts + copy", Microbench::NanosPerCall(Iterations, [&] {
+                       BlockInterrupts block;
+                       ControllerStatus copy = shared;
+                       Microbench::DoNotOptimize(copy);
+                     }));
+  Microbench::Report("SeqLock::Read", Microbench::NanosPerCall(Iterations, [&] {
+                       ControllerStatus copy = lock.Read();
+                       Microbench::DoNotOptimize(copy);
+                     }));
+}
@@ -0,0 +1,98 @@
+/* Copyright 2020-2021, RespiraWorks
+
+Licensed under the Apache License, Version 2.0 (the "License");
+you may not use this file except in compliance with the License.
+You may obtain a copy of the License at
+
+    http://www.apache.org/licenses/LICENSE-2.0
+
+Unless required by applicable law or agreed to in writing, software
+distributed under the License is distributed on an "AS IS" BASIS,
+WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+See the License for the specific language governing permissions and
+limitations under the License.
+*/
+
+#include "stack_monitor.h"
+
+#include <array>
+
+#include "gtest/gtest.h"
+
+static constexpr size_t StackWords = 1000;
+
+// Simulates using the top `bytes` bytes of the stack.
+static void Use(std::array<uint32_t, StackWords> &stack, size_t bytes) {
+  for (size_t i = StackWords - bytes / sizeof(uint32_t); i < StackWords; i++) {
+    stack[i] = static_cast<uint32_t>(i);
+  }
+}
+
+static void ScanFully(StackMonitor &monitor) {
+  // Two full passes are enough to pick up anything that changed.
+  for (size_t i = 0; i < 2 * StackWords; i++) {
+    monitor.Scan(1);
+  }
+}
+
+TEST(StackMonitor, PaintAndUsed) {
+  std::array<uint32_t, StackWords> stack{};
+  StackMonitor::Paint(stack.begin(), stack.end());
+  EXPECT_EQ(StackMonitor::Used(stack.begin(), stack.end()), 0u);
+
+  Use(stack, 400);
+  EXPECT_EQ(StackMonitor::Used(stack.begin(), stack.end()), 400u);
+
+  // Locals that are never written leave holes in the used part of the stack;
+  // they don't count.
+  stack[StackWords - 50] = StackMonitor::PaintPattern;
+  EXPECT_EQ(StackMonitor::Used(stack.begin(), stack.end()), 400u);
+
+  // Measured relative to any window of the stack.
+  EXPECT_EQ(StackMonitor::Used(stack.begin(), stack.begin() + StackWords - 10), 360u);
+}
+
+TEST(StackMonitor, HighWaterMark) {
+  std::array<uint32_t, StackWords> stack{};
+  StackMonitor::Paint(stack.begin(), stack.end());
+  StackMonitor monitor(stack.begin(), stack.end());
+  EXPECT_EQ(monitor.size(), StackWords * sizeof(uint32_t));
+
+  ScanFully(monitor);
+  EXPECT_EQ(monitor.high_water_mark(), 0u);
+
+  Use(stack, 800);
+  ScanFully(monitor);
+  EXPECT_EQ(monitor.high_water_mark(), 800u);
+
+  // The high water mark never goes down, even if the stack gets repainted.
+  StackMonitor::Paint(stack.begin(), stack.end());
+  Use(stack, 100);
+  ScanFully(monitor);
+  EXPECT_EQ(monitor.high_water_mark(), 800u);
+
+  Use(stack, 2000);
+  ScanFully(monitor);
+  EXPECT_EQ(monitor.high_water_mark(), 2000u);
+
+  // Everything used.
+  Use(stack, StackWords * sizeof(uint32_t));
+  ScanFully(monitor);
+  EXPECT_EQ(monitor.high_water_mark(), monitor.size());
+}
+
+TEST(StackMonitor, ScanIsIncremental) {
+  std::array<uint32_t, StackWords> stack{};
+  StackMonitor::Paint(stack.begin(), stack.end());
+  StackMonitor monitor(stack.begin(), stack.end());
+  Use(stack, 40);
+
+  // 990 painted words to get through, 64 at a time.
+  int calls = 0;
+  while (monitor.high_water_mark() == 0) {
+    monitor.Scan(64);
+    calls++;
+  }
+  EXPECT_EQ(calls, 16);
+  EXPECT_EQ(monitor.high_water_mark(), 40u);
+}
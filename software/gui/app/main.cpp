@@ -3,6 +3,7 @@
 #include "controller_history.h"
 #include "gui_state_container.h"
 #include "latching_alarm.h"
+#include "loop_graph.h"
 #include "periodic_closure.h"
 #include "respira_connected_device.h"
 
@@ -10,12 +11,14 @@
 #include <QStandardPaths>
 
 #include "time_series_graph.h"
+#include "waveform_graph.h"
 #include <QCommandLineParser>
 #include <QDebug>
 #include <QFontDatabase>
 #include <QFontInfo>
 #include <QGuiApplication>
 #include <QQmlApplicationEngine>
+#include <QTimer>
 #include <QtCore/QDir>
 #include <QtQml/QQmlContext>
 #include <QtQml/QQmlEngine>
@@ -159,6 +162,8 @@ int main(int argc, char *argv[]) {
     std::unique_lock<std::mutex> l(gui_status_mutex);
     gui_status = state_container->GetGuiStatus();
   });
+  // Cycles that are missed while a receive blocks are skipped rather than
+  // made up for: each cycle reads whatever came in since the last.
   PeriodicClosure communicate(DurationMs(30), [&] {
     auto now = SteadyClock::now();
     ControllerStatus controller_status;
@@ -177,6 +182,8 @@ int main(int argc, char *argv[]) {
   communicate.Start();
 
   qmlRegisterType<TimeSeriesGraph>("Respira", 1, 0, "TimeSeriesGraph");
+  qmlRegisterType<WaveformGraph>("Respira", 1, 0, "WaveformGraph");
+  qmlRegisterType<LoopGraph>("Respira", 1, 0, "LoopGraph");
   qmlRegisterUncreatableType<AlarmPriority>("Respira", 1, 0, "AlarmPriority",
                                             "is an enum");
   qmlRegisterUncreatableType<AlarmManager>(
@@ -188,6 +195,24 @@ int main(int argc, char *argv[]) {
   qmlRegisterSingletonType<GuiStateContainer>(
       "Respira", 1, 0, "GuiStateContainer", &gui_state_instance);
 
+#ifdef QT_DEBUG
+  // Shows whether the logs are complete.
+  QTimer log_stats_timer;
+  QObject::connect(&log_stats_timer, &QTimer::timeout,
+                   [dropped = size_t{0}, suppressed = size_t{0}]() mutable {
+                     size_t now_dropped = CustomLogger::droppedMessages();
+                     size_t now_suppressed = CustomLogger::suppressedMessages();
+                     if (now_dropped != dropped ||
+                         now_suppressed != suppressed) {
+                       dropped = now_dropped;
+                       suppressed = now_suppressed;
+                       DBG("Log messages dropped: {}, suppressed: {}",
+                           dropped, suppressed);
+                     }
+                   });
+  log_stats_timer.start(std::chrono::seconds(10));
+#endif
+
   install_fonts();
 
   QQmlApplicationEngine engine;
@@ -198,5 +223,12 @@ int main(int argc, char *argv[]) {
     return EXIT_SUCCESS;
   }
 
-  return app.exec();
+  int status = app.exec();
+  communicate.Stop();
+  PeriodicClosure::Stats comm_stats = communicate.GetStats();
+  INFO("Communication ran {} times, {} overran, {} skipped", comm_stats.runs,
+       comm_stats.overruns, comm_stats.skipped);
+  // Writes out the messages still queued.
+  CustomLogger::closeLogger();
+  return status;
 }
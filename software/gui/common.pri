@@ -12,6 +12,7 @@ SOURCES += \
     $$top_srcdir/../common/third_party/nanopb/pb_decode.c \
     $$top_srcdir/../common/third_party/nanopb/pb_encode.c \
     $$top_srcdir/../common/libs/units/units.cpp \
+    $$top_srcdir/../common/libs/checksum/checksum.cpp \
     $$files("$$top_srcdir//../common/**/*.c")
 
 HEADERS += \
@@ -20,11 +21,26 @@ HEADERS += \
     $$top_srcdir/../common/third_party/nanopb/pb_common.h \
     $$top_srcdir/../common/third_party/nanopb/pb_decode.h \
     $$top_srcdir/../common/third_party/nanopb/pb_encode.h \
-    $$top_srcdir/../common/libs/units/units.h
+    $$top_srcdir/../common/libs/units/units.h \
+    $$top_srcdir/../common/libs/dsp/biquad.h \
+    $$top_srcdir/../common/libs/dsp/ewma.h \
+    $$top_srcdir/../common/libs/dsp/fixed_point.h \
+    $$top_srcdir/../common/libs/dsp/moving_average.h \
+    $$top_srcdir/../common/libs/dsp/moving_median.h \
+    $$top_srcdir/../common/libs/checksum/checksum.h \
+    $$top_srcdir/../common/libs/framing/framing.h \
+    $$top_srcdir/../common/libs/proto_traits/proto_traits.h \
+    $$top_srcdir/../common/libs/proto_traits/proto_codec.h \
+    $$top_srcdir/../common/libs/capabilities/capabilities.h
 
 HEADERS += $$files("$$top_srcdir/../common/**/*.h")
 
 INCLUDEPATH += \
     $$top_srcdir/../common/generated_libs/network_protocol \
     $$top_srcdir/../common/third_party/nanopb \
-    $$top_srcdir/../common/libs/units
+    $$top_srcdir/../common/libs/units \
+    $$top_srcdir/../common/libs/dsp \
+    $$top_srcdir/../common/libs/checksum \
+    $$top_srcdir/../common/libs/framing \
+    $$top_srcdir/../common/libs/proto_traits \
+    $$top_srcdir/../common/libs/capabilities
@@ -1,8 +1,11 @@
 # Structured per https://dragly.org/2014/03/13/new-project-structure-for-projects-in-qt-creator-with-unit-tests/
 TEMPLATE = subdirs
 CONFIG += ordered
-SUBDIRS = src app tests
+SUBDIRS = src app tests benchmark
+
+benchmark.subdir = tests/benchmark
 
 # build.depends = app
 app.depends = src
 tests.depends = src
+benchmark.depends = src
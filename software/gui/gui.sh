@@ -38,6 +38,9 @@ The following options are provided:
       [--no-checks]      - do not run static checks (yes, it's to annoy you!)
   --test      Run the unit QTest autotest suite, options:
       [-x]               - forwards to Xvfb (for CLI-only testing)
+  --benchmark Run the headless frame cost benchmark, forwards options:
+      [--frames]       - number of frames to measure
+      [--output]       - file to write the JSON results to
   --run       Run the application, forwards app options:
       [--startup-only] - just start up momentarily and shutdown
       [--serial-port]  - port for communicating with controller
@@ -211,6 +214,15 @@ if [ "$1" == "--test" ]; then
 fi
 
 
+#############
+# BENCHMARK #
+#############
+
+if [ "$1" == "--benchmark" ]; then
+  QT_QPA_PLATFORM=offscreen ./build/tests/benchmark/gui_benchmark "${@:2}"
+  exit 0
+fi
+
 #######
 # RUN #
 #######
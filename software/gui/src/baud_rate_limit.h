@@ -0,0 +1,39 @@
+#ifndef BAUD_RATE_LIMIT_H
+#define BAUD_RATE_LIMIT_H
+
+#include "chrono.h"
+
+#include <algorithm>
+#include <cstdint>
+
+// Fastest baud rate we offer the controller.  Each time a rate fails, we stop
+// offering it for a while, so that it isn't retried over and over; once that
+// while is over, we offer the fastest rate again, since whatever made it fail
+// (e.g. a flaky cable or a busy system) may be gone by then.  This mirrors
+// baud_limit and baud_limit_expiry on the controller side.
+//
+// Non-thread-safe, needs external synchronization.
+class BaudRateLimit {
+public:
+  BaudRateLimit(int32_t max_rate, DurationMs retry_interval)
+      : max_rate_(max_rate), retry_interval_(retry_interval) {}
+
+  // Fastest rate to offer at `now`.
+  int32_t Get(SteadyInstant now) const {
+    return now < expiry_ ? limit_ : max_rate_;
+  }
+
+  // Stops offering `failed_rate` or faster until retry_interval from `now`.
+  void Lower(SteadyInstant now, int32_t failed_rate) {
+    limit_ = std::min(Get(now), failed_rate - 1);
+    expiry_ = now + retry_interval_;
+  }
+
+private:
+  int32_t max_rate_;
+  DurationMs retry_interval_;
+  int32_t limit_ = max_rate_;
+  SteadyInstant expiry_;
+};
+
+#endif // BAUD_RATE_LIMIT_H
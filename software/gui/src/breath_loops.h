@@ -0,0 +1,68 @@
+#ifndef BREATH_LOOPS_H
+#define BREATH_LOOPS_H
+
+#include "network_protocol.pb.h"
+
+#include <stdint.h>
+#include <vector>
+
+// The pressure, flow and volume readings of the breath in progress and of
+// the previous one, for pressure-volume and flow-volume loops.
+//
+// Readings are appended to the current breath as statuses come in, and when
+// breath_id changes the current breath becomes the previous one as is. So a
+// loop graph only needs to draw the previous breath once, and the points of
+// the current one as they're added.
+//
+// Non-thread-safe, needs external synchronization.
+class BreathLoops {
+public:
+  struct Point {
+    float pressure_cm_h2o;
+    // In L/min, like the graphs.
+    float flow_l_per_min;
+    float volume_ml;
+  };
+
+  // A breath longer than this many points, e.g. in a mode without breaths,
+  // starts over rather than growing without bound.
+  static constexpr size_t MaxPoints = 6000;
+
+  void Update(const ControllerStatus &status) {
+    uint64_t breath_id = status.sensor_readings.breath_id;
+    if (breath_id != current_breath_id_) {
+      current_breath_id_ = breath_id;
+      // Also once at startup, with an empty "breath" before the first one.
+      previous_.swap(current_);
+      current_.clear();
+      ++completed_breaths_;
+    } else if (current_.size() >= MaxPoints) {
+      current_.clear();
+      ++restarts_;
+    }
+    current_.push_back({status.sensor_readings.patient_pressure_cm_h2o,
+                        0.001f * status.sensor_readings.flow_ml_per_min,
+                        status.sensor_readings.volume_ml});
+  }
+
+  const std::vector<Point> &current() const { return current_; }
+  const std::vector<Point> &previous() const { return previous_; }
+
+  // Changes whenever previous() does.
+  uint64_t completed_breaths() const { return completed_breaths_; }
+
+  // Changes whenever current() loses points rather than gains them: on a
+  // new breath, or when the current one starts over.
+  uint64_t current_generation() const {
+    return completed_breaths_ + restarts_;
+  }
+
+private:
+  uint64_t current_breath_id_ = 0;
+  uint64_t completed_breaths_ = 0;
+  uint64_t restarts_ = 0;
+  std::vector<Point> current_;
+  std::vector<Point> previous_;
+};
+
+#endif // BREATH_LOOPS_H
@@ -11,9 +11,17 @@
 #include <iostream>
 #include <optional>
 
+// Per-breath signals (PIP, PEEP, RR).
+//
+// The controller computes these at its full loop rate and sends them as
+// BreathSummary messages, which are preferred whenever we've received any.
+// Otherwise they're estimated from the (subsampled, possibly lossy)
+// ControllerStatus pressure readings.
 class BreathSignals {
 public:
   void Update(SteadyInstant now, const ControllerStatus &status) {
+    UpdateSummaries(status);
+
     float pressure = status.sensor_readings.patient_pressure_cm_h2o;
     uint64_t breath_id = status.sensor_readings.breath_id;
 
@@ -41,9 +49,31 @@ public:
   }
 
   uint32_t num_breaths() const { return num_breaths_; }
-  std::optional<float> pip() const { return latest_pip_; }
-  std::optional<float> peep() const { return latest_peep_; }
+  std::optional<BreathSummary> last_summary() const { return last_summary_; }
+  std::optional<float> pip() const {
+    if (last_summary_.has_value()) {
+      return last_summary_->pip_cm_h2o;
+    }
+    return latest_pip_;
+  }
+  std::optional<float> peep() const {
+    if (last_summary_.has_value()) {
+      return last_summary_->peep_cm_h2o;
+    }
+    return latest_peep_;
+  }
   std::optional<float> rr() const {
+    if (recent_breath_durations_ms_.size() >= MinRecentBreathStarts - 1) {
+      uint32_t total_ms = 0;
+      for (uint32_t ms : recent_breath_durations_ms_) {
+        total_ms += ms;
+      }
+      if (total_ms > 0) {
+        return 60000.0f *
+               static_cast<float>(recent_breath_durations_ms_.size()) /
+               static_cast<float>(total_ms);
+      }
+    }
     if (recent_breath_starts_.size() < MinRecentBreathStarts) {
       return std::nullopt;
     }
@@ -56,8 +86,36 @@ public:
   }
 
 private:
+  // The controller resends each summary several times; only look at the ones
+  // we haven't seen yet.
+  void UpdateSummaries(const ControllerStatus &status) {
+    for (pb_size_t i = 0; i < status.breath_summaries_count; ++i) {
+      const BreathSummary &summary = status.breath_summaries[i];
+      if (std::find(seen_summary_ids_.begin(), seen_summary_ids_.end(),
+                    summary.breath_id) != seen_summary_ids_.end()) {
+        continue;
+      }
+      seen_summary_ids_.push_back(summary.breath_id);
+      if (seen_summary_ids_.size() > MaxSeenSummaryIds) {
+        seen_summary_ids_.pop_front();
+      }
+
+      last_summary_ = summary;
+      recent_breath_durations_ms_.push_back(summary.inspiratory_time_ms +
+                                            summary.expiratory_time_ms);
+      if (recent_breath_durations_ms_.size() > MaxRecentBreathStarts - 1) {
+        recent_breath_durations_ms_.pop_front();
+      }
+    }
+  }
+
   uint32_t num_breaths_ = 0;
 
+  std::optional<BreathSummary> last_summary_;
+  std::deque<uint32_t> recent_breath_durations_ms_;
+  static constexpr size_t MaxSeenSummaryIds = 8;
+  std::deque<uint64_t> seen_summary_ids_;
+
   std::optional<float> latest_pip_;
   std::optional<float> current_pip_;
 
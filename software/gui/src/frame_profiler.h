@@ -0,0 +1,101 @@
+#ifndef FRAME_PROFILER_H
+#define FRAME_PROFILER_H
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+
+// Adds up the time spent in each phase of producing a frame, for the
+// benchmark in tests/benchmark.
+//
+// Code marks a phase with a FrameProfiler::Scope. Unless a profiler is
+// installed, which only the benchmark does, a Scope costs one atomic load.
+// Scopes may run on the GUI thread and on the render thread.
+class FrameProfiler {
+public:
+  enum class Phase {
+    // Emitting the GuiStateContainer signals that QML binds to, which
+    // re-evaluates the bindings.
+    BINDINGS,
+    // Building the graph series in GuiStateContainer::UpdateGraphs.
+    UPDATE_GRAPHS,
+    // Drawing the graphs: TimeSeriesGraphPainter::paint, or updating the
+    // scene graph nodes of WaveformGraph.
+    GRAPH_PAINT,
+    // Copying the QML items into the scene graph.
+    SCENE_GRAPH_SYNC,
+    // Rendering the scene graph, graphs included.
+    RENDER,
+    COUNT,
+  };
+  static constexpr int NUM_PHASES = static_cast<int>(Phase::COUNT);
+
+  using Totals = std::array<std::chrono::nanoseconds, NUM_PHASES>;
+
+  // Name of a phase, as used in the benchmark output.
+  static const char *PhaseName(Phase phase) {
+    switch (phase) {
+    case Phase::BINDINGS:
+      return "bindings";
+    case Phase::UPDATE_GRAPHS:
+      return "update_graphs";
+    case Phase::GRAPH_PAINT:
+      return "graph_paint";
+    case Phase::SCENE_GRAPH_SYNC:
+      return "scene_graph_sync";
+    case Phase::RENDER:
+      return "render";
+    case Phase::COUNT:
+      break;
+    }
+    return "unknown";
+  }
+
+  // Makes Scopes report to `profiler`, or to nothing if it's null.
+  // `profiler` must outlive all Scopes.
+  static void Install(FrameProfiler *profiler) { instance_ = profiler; }
+
+  void Add(Phase phase, std::chrono::nanoseconds time) {
+    totals_[static_cast<int>(phase)] += time.count();
+  }
+
+  // Returns the time spent in each phase since the last call.
+  Totals TakeTotals() {
+    Totals totals;
+    for (int i = 0; i < NUM_PHASES; i++) {
+      totals[i] = std::chrono::nanoseconds(totals_[i].exchange(0));
+    }
+    return totals;
+  }
+
+  // Counts the time until it goes out of scope toward `phase`.
+  class Scope {
+  public:
+    explicit Scope(Phase phase)
+        : profiler_(instance_.load(std::memory_order_relaxed)), phase_(phase) {
+      if (profiler_ != nullptr) {
+        start_ = std::chrono::steady_clock::now();
+      }
+    }
+    ~Scope() {
+      if (profiler_ != nullptr) {
+        profiler_->Add(phase_, std::chrono::steady_clock::now() - start_);
+      }
+    }
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+
+  private:
+    FrameProfiler *profiler_;
+    Phase phase_;
+    std::chrono::steady_clock::time_point start_;
+  };
+
+private:
+  static inline std::atomic<FrameProfiler *> instance_{nullptr};
+
+  std::array<std::atomic<int64_t>, NUM_PHASES> totals_{};
+};
+
+#endif // FRAME_PROFILER_H
@@ -1,28 +1,80 @@
 #include "gui_state_container.h"
+#include "frame_profiler.h"
 
 void GuiStateContainer::UpdateGraphs() {
   auto now = SteadyClock::now();
   QVector<QPointF> pressure_points, flow_points, tv_points;
 
-  int history_size = history_.Size();
+  {
+    FrameProfiler::Scope profile(FrameProfiler::Phase::UPDATE_GRAPHS);
+    // Prefer the full-rate samples, if the controller sends them.
+    if (!samples_.samples().empty()) {
+      int num_samples = samples_.samples().size();
+      pressure_points.reserve(num_samples);
+      flow_points.reserve(num_samples);
+      tv_points.reserve(num_samples);
+      for (const auto &sample : samples_.samples()) {
+        qreal secs_ago = TimeAMinusB(sample.time, now).count() * 0.001;
+        pressure_points.append(
+            QPointF(secs_ago, sample.patient_pressure_cm_h2o));
+        // The graph should be in L/min, but the data is ml/min
+        flow_points.append(QPointF(secs_ago, 0.001 * sample.flow_ml_per_min));
+        tv_points.append(QPointF(secs_ago, sample.volume_ml));
+      }
+    } else {
+      int history_size = history_.Size();
 
-  pressure_points.reserve(history_size);
-  flow_points.reserve(history_size);
-  tv_points.reserve(history_size);
+      pressure_points.reserve(history_size);
+      flow_points.reserve(history_size);
+      tv_points.reserve(history_size);
 
-  for (const auto &[time, controller_status] : GetControllerStatusHistory()) {
-    int neg_millis_ago = TimeAMinusB(time, now).count();
-    pressure_points.append(
-        QPointF(neg_millis_ago * 0.001,
-                controller_status.sensor_readings.patient_pressure_cm_h2o));
-    flow_points.append(
-        QPointF(neg_millis_ago * 0.001,
-                // The graph should be in L/min, but the data is ml/min
-                0.001 * controller_status.sensor_readings.flow_ml_per_min));
-    tv_points.append(QPointF(neg_millis_ago * 0.001,
-                             controller_status.sensor_readings.volume_ml));
+      for (const auto &[time, controller_status] :
+           GetControllerStatusHistory()) {
+        int neg_millis_ago = TimeAMinusB(time, now).count();
+        pressure_points.append(QPointF(
+            neg_millis_ago * 0.001,
+            controller_status.sensor_readings.patient_pressure_cm_h2o));
+        flow_points.append(QPointF(
+            neg_millis_ago * 0.001,
+            // The graph should be in L/min, but the data is ml/min
+            0.001 * controller_status.sensor_readings.flow_ml_per_min));
+        tv_points.append(QPointF(neg_millis_ago * 0.001,
+                                 controller_status.sensor_readings.volume_ml));
+      }
+    }
   }
+
+  FrameProfiler::Scope profile(FrameProfiler::Phase::BINDINGS);
   SetPressureSeries(std::move(pressure_points));
   SetFlowSeries(std::move(flow_points));
   SetTidalSeries(std::move(tv_points));
 }
+
+void GuiStateContainer::Publish() {
+  if (graphs_stale_) {
+    graphs_stale_ = false;
+    UpdateGraphs();
+  }
+  if (loops_stale_) {
+    loops_stale_ = false;
+    emit LoopsChanged();
+  }
+
+  FrameProfiler::Scope profile(FrameProfiler::Phase::BINDINGS);
+  NotifyIfChanged(get_measured_pressure(), &published_.pressure,
+                  &GuiStateContainer::measured_pressure_changed);
+  NotifyIfChanged(get_measured_flow(), &published_.flow,
+                  &GuiStateContainer::measured_flow_changed);
+  NotifyIfChanged(get_measured_tv(), &published_.tv,
+                  &GuiStateContainer::measured_tv_changed);
+  NotifyIfChanged(get_measured_rr(), &published_.rr,
+                  &GuiStateContainer::measured_rr_changed);
+  NotifyIfChanged(get_measured_peep(), &published_.peep,
+                  &GuiStateContainer::measured_peep_changed);
+  NotifyIfChanged(get_measured_pip(), &published_.pip,
+                  &GuiStateContainer::measured_pip_changed);
+  NotifyIfChanged(get_measured_ier(), &published_.ier,
+                  &GuiStateContainer::measured_ier_changed);
+  NotifyIfChanged(get_measured_fio2_percent(), &published_.fio2_percent,
+                  &GuiStateContainer::measured_fio2_percent_changed);
+}
@@ -5,17 +5,23 @@
 #include <stdint.h>
 
 #include "alarm_manager.h"
+#include "breath_loops.h"
 #include "breath_signals.h"
 #include "chrono.h"
 #include "controller_history.h"
+#include "frame_profiler.h"
+#include "sample_history.h"
 #include "simple_clock.h"
+#include "trend_history.h"
 
+#include <cmath>
 #include <iostream>
 #include <tuple>
 #include <vector>
 
 #include "logger.h"
 #include <QPointF>
+#include <QTimer>
 #include <QVector>
 #include <QtCore/QObject>
 
@@ -28,6 +34,11 @@
 //
 // In other words, this is essentially an MVC "Model".
 //
+// Statuses come in at the controller's rate, but QML only needs to hear
+// about them once per frame on the display: changes are published to QML
+// at most once per publish interval, and each property notifies only when
+// its value changed.
+//
 // TODO(jkff, paulovap): This class embodies the "God object" antipattern. We
 // should split it into several parts, with GuiStateContainer being only the
 // entry point for them.
@@ -42,11 +53,23 @@ public:
   };
   Q_ENUM(VentilationMode)
 
+  // A frame on a 60 Hz display.
+  static constexpr DurationMs DEFAULT_PUBLISH_INTERVAL = DurationMs(16);
+
   // Initializes the state container to keep the history of controller
-  // statuses in a given time window with given granularity.
-  GuiStateContainer(DurationMs history_window, DurationMs granularity)
+  // statuses in a given time window with given granularity, and to publish
+  // changes to QML at most once per publish_interval.
+  GuiStateContainer(DurationMs history_window, DurationMs granularity,
+                    DurationMs publish_interval = DEFAULT_PUBLISH_INTERVAL)
       : startup_time_(SteadyClock::now()),
-        history_(history_window, granularity) {
+        history_(history_window, granularity), samples_(history_window) {
+    publish_timer_.setSingleShot(true);
+    publish_timer_.setInterval(publish_interval);
+    QObject::connect(&publish_timer_, &QTimer::timeout, this,
+                     &GuiStateContainer::Publish);
+    // Measured RR and I:E depend on the commanded parameters.
+    QObject::connect(this, &GuiStateContainer::params_changed, this,
+                     &GuiStateContainer::SchedulePublish);
     QObject::connect(this, &GuiStateContainer::params_changed, [this]() {
       // TODO: This could come from GUI alarm settings instead.
       // Source for +/-5 is this thread:
@@ -103,23 +126,32 @@ public:
     return history_.GetHistory();
   }
 
+  // Returns hours of measurements, for trend graphs.
+  const TrendHistory &GetPressureTrend() const { return pressure_trend_; }
+  const TrendHistory &GetFlowTrend() const { return flow_trend_; }
+  const TrendHistory &GetVolumeTrend() const { return volume_trend_; }
+  const TrendHistory &GetFio2Trend() const { return fio2_trend_; }
+
+  // Returns the points of the current and previous breaths, for loop graphs.
+  const BreathLoops &GetBreathLoops() const { return loops_; }
+
   Q_PROPERTY(bool is_using_fake_data READ get_is_using_fake_data CONSTANT)
   // Measured parameters
   Q_PROPERTY(qreal measured_pressure READ get_measured_pressure NOTIFY
-                 measurements_changed)
+                 measured_pressure_changed)
   Q_PROPERTY(
-      qreal measured_flow READ get_measured_flow NOTIFY measurements_changed)
-  Q_PROPERTY(qreal measured_tv READ get_measured_tv NOTIFY measurements_changed)
+      qreal measured_flow READ get_measured_flow NOTIFY measured_flow_changed)
+  Q_PROPERTY(qreal measured_tv READ get_measured_tv NOTIFY measured_tv_changed)
   Q_PROPERTY(
-      quint32 measured_rr READ get_measured_rr NOTIFY measurements_changed)
+      quint32 measured_rr READ get_measured_rr NOTIFY measured_rr_changed)
   Q_PROPERTY(
-      quint32 measured_peep READ get_measured_peep NOTIFY measurements_changed)
+      quint32 measured_peep READ get_measured_peep NOTIFY measured_peep_changed)
   Q_PROPERTY(
-      quint32 measured_pip READ get_measured_pip NOTIFY measurements_changed)
+      quint32 measured_pip READ get_measured_pip NOTIFY measured_pip_changed)
   Q_PROPERTY(
-      qreal measured_ier READ get_measured_ier NOTIFY measurements_changed)
+      qreal measured_ier READ get_measured_ier NOTIFY measured_ier_changed)
   Q_PROPERTY(qreal measured_fio2_percent READ get_measured_fio2_percent NOTIFY
-                 measurements_changed)
+                 measured_fio2_percent_changed)
 
   // Graphs
   Q_PROPERTY(QVector<QPointF> pressureSeries READ GetPressureSeries NOTIFY
@@ -180,7 +212,14 @@ public:
   AlarmManager *GetAlarmManager() { return &alarm_manager_; }
 
 signals:
-  void measurements_changed();
+  void measured_pressure_changed();
+  void measured_flow_changed();
+  void measured_tv_changed();
+  void measured_rr_changed();
+  void measured_peep_changed();
+  void measured_pip_changed();
+  void measured_ier_changed();
+  void measured_fio2_percent_changed();
   void params_changed();
   void battery_percentage_changed();
   void clock_changed();
@@ -189,6 +228,7 @@ signals:
   void TidalSeriesChanged();
   void IsDebugBuildChanged();
   void AlarmManagerChanged();
+  void LoopsChanged();
 
 public slots:
   // Adds a data point of controller status to the history.
@@ -196,15 +236,45 @@ public slots:
                                  const ControllerStatus &status) {
     breath_signals_.Update(now, status);
     alarm_manager_.Update(now, status, breath_signals_);
+    if (status.has_samples) {
+      samples_.Append(now, status.samples);
+    }
+    pressure_trend_.Add(now, status.sensor_readings.patient_pressure_cm_h2o);
+    // Flow in L/min, like the graphs, and FiO2 in percent.
+    flow_trend_.Add(now, 0.001 * status.sensor_readings.flow_ml_per_min);
+    volume_trend_.Add(now, status.sensor_readings.volume_ml);
+    fio2_trend_.Add(now, 100 * status.sensor_readings.fio2);
+    loops_.Update(status);
+    loops_stale_ = true;
     if (history_.Append(now, status)) {
-      UpdateGraphs();
-      measurements_changed();
+      graphs_stale_ = true;
     }
+    SchedulePublish();
   }
 
   void UpdateGraphs();
 
+  // Tells QML about what changed since the last call: graphs, loops, and
+  // measurements whose values are different from what QML last got.
+  void Publish();
+
 private:
+  void SchedulePublish() {
+    if (!publish_timer_.isActive()) {
+      publish_timer_.start();
+    }
+  }
+
+  // Emits `signal` if `value` is different from *published, and keeps it
+  // there.
+  void NotifyIfChanged(qreal value, qreal *published,
+                       void (GuiStateContainer::*signal)()) {
+    if (value != *published) {
+      *published = value;
+      emit(this->*signal)();
+    }
+  }
+
   int get_battery_percentage() const {
     return battery_percentage_;
     // TODO: Figure our how battery will be implemented
@@ -245,6 +315,28 @@ private:
   const SteadyInstant startup_time_ = SteadyClock::now();
   bool is_using_fake_data_ = false;
   ControllerHistory history_;
+  SampleHistory samples_;
+  TrendHistory pressure_trend_;
+  TrendHistory flow_trend_;
+  TrendHistory volume_trend_;
+  TrendHistory fio2_trend_;
+  BreathLoops loops_;
+
+  QTimer publish_timer_;
+  bool graphs_stale_ = false;
+  bool loops_stale_ = false;
+  // Measurements as QML last got them; NaN until then.
+  struct {
+    qreal pressure = NAN;
+    qreal flow = NAN;
+    qreal tv = NAN;
+    qreal rr = NAN;
+    qreal peep = NAN;
+    qreal pip = NAN;
+    qreal ier = NAN;
+    qreal fio2_percent = NAN;
+  } published_;
+
   BreathSignals breath_signals_;
   int battery_percentage_ = 70;
   SimpleClock clock_;
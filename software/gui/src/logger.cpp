@@ -1,10 +1,22 @@
 #include "logger.h"
 
+#include <atomic>
+#include <spdlog/async.h>
 #include <spdlog/sinks/basic_file_sink.h>
 #include <spdlog/sinks/stdout_color_sinks.h>
 
 namespace CustomLogger {
 
+namespace {
+
+// Messages the queue holds. Writing is much faster than we log on average,
+// so this is only there for bursts.
+constexpr size_t QUEUE_SIZE = 8192;
+
+std::atomic<size_t> suppressed_total{0};
+
+} // namespace
+
 void initLogger(const spdlog::level::level_enum &LoggingLevel, bool console_log,
                 const std::string &log_file_name) {
   closeLogger();
@@ -25,18 +37,43 @@ void initLogger(const spdlog::level::level_enum &LoggingLevel, bool console_log,
     sinks.push_back(file_sink);
   }
 
-  auto combined_logger = std::make_shared<spdlog::logger>(
-      "daquiri_logger", begin(sinks), end(sinks));
+  // A single thread keeps the messages in order.
+  spdlog::init_thread_pool(QUEUE_SIZE, 1);
+  auto combined_logger = std::make_shared<spdlog::async_logger>(
+      "daquiri_logger", begin(sinks), end(sinks), spdlog::thread_pool(),
+      spdlog::async_overflow_policy::overrun_oldest);
   combined_logger->set_level(LoggingLevel);
+  // Flushes are queued like messages, so these don't block either.
   combined_logger->flush_on(LoggingLevel);
   spdlog::flush_every(std::chrono::seconds(1));
   spdlog::set_default_logger(combined_logger);
 }
 
 void closeLogger() {
-  // Release all spdlog resources, and drop all loggers in the registry.
-  // This is optional (only mandatory if using windows + async log).
+  // Write out what's queued, release all spdlog resources, and drop all
+  // loggers in the registry.
   spdlog::shutdown();
 }
 
+size_t droppedMessages() {
+  auto pool = spdlog::thread_pool();
+  return pool == nullptr ? 0 : pool->overrun_counter();
+}
+
+size_t suppressedMessages() { return suppressed_total; }
+
+bool LogLimiter::Allow(size_t *suppressed) {
+  auto now = std::chrono::steady_clock::now();
+  if (logged_ && now - last_ < interval_) {
+    suppressed_++;
+    suppressed_total++;
+    return false;
+  }
+  *suppressed = suppressed_;
+  suppressed_ = 0;
+  last_ = now;
+  logged_ = true;
+  return true;
+}
+
 } // namespace CustomLogger
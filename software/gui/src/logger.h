@@ -1,5 +1,6 @@
 #pragma once
 
+#include <chrono>
 #include <string>
 
 #include <spdlog/spdlog.h>
@@ -8,10 +9,39 @@
 
 namespace CustomLogger {
 
+/// Logging is asynchronous: messages go into a bounded queue, and a
+/// background thread writes them to the sinks. When the queue is full, the
+/// oldest messages are dropped, so that logging never blocks the caller,
+/// e.g. the communication thread.
 void initLogger(const spdlog::level::level_enum &LoggingLevel, bool console_log,
                 const std::string &log_file_name);
 void closeLogger();
 
+/// Messages dropped because the queue was full, since initLogger.
+size_t droppedMessages();
+/// Messages held back by LogLimiters, since the program started.
+size_t suppressedMessages();
+
+/// \brief Lets a message through at most once per interval, for messages
+///   that can repeat at a high rate, like comm timeouts. Use it through the
+///   *_LIMITED macros below, with one LogLimiter per message.
+///   Not thread-safe: a LogLimiter is for use by one thread.
+class LogLimiter {
+public:
+  explicit LogLimiter(std::chrono::milliseconds interval)
+      : interval_(interval) {}
+
+  /// Returns whether to log the message now. If so, *suppressed is set to
+  /// the number of times it was held back since it was last logged.
+  bool Allow(size_t *suppressed);
+
+private:
+  std::chrono::milliseconds interval_;
+  std::chrono::steady_clock::time_point last_;
+  bool logged_ = false;
+  size_t suppressed_ = 0;
+};
+
 } // namespace CustomLogger
 
 /// Do not use directly; use the defines below instead
@@ -29,3 +59,21 @@ void closeLogger();
 #define INFO(Format, ...) LOG(spdlog::level::info, Format, ##__VA_ARGS__)
 #define DBG(Format, ...) LOG(spdlog::level::debug, Format, ##__VA_ARGS__)
 #define TRC(Format, ...) LOG(spdlog::level::trace, Format, ##__VA_ARGS__)
+
+/// Same, but only as often as a LogLimiter lets them through:
+///     CRIT_LIMITED(timeout_log_, "Timeout after {}ms", timeout);
+#define LOG_LIMITED(Limiter, Severity, Format, ...)                            \
+  do {                                                                         \
+    size_t suppressed_messages;                                                \
+    if ((Limiter).Allow(&suppressed_messages)) {                               \
+      if (suppressed_messages > 0) {                                           \
+        LOG(Severity, "{} similar messages suppressed", suppressed_messages);  \
+      }                                                                        \
+      LOG(Severity, Format, ##__VA_ARGS__);                                    \
+    }                                                                          \
+  } while (0)
+
+#define CRIT_LIMITED(Limiter, Format, ...)                                     \
+  LOG_LIMITED(Limiter, spdlog::level::critical, Format, ##__VA_ARGS__)
+#define WARN_LIMITED(Limiter, Format, ...)                                     \
+  LOG_LIMITED(Limiter, spdlog::level::warn, Format, ##__VA_ARGS__)
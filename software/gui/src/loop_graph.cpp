@@ -0,0 +1,223 @@
+#include "loop_graph.h"
+#include "frame_profiler.h"
+#include "scene_graph_nodes.h"
+#include <QSGFlatColorMaterial>
+#include <QSGTransformNode>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Vertices per segment between two points of the current breath.
+constexpr int LINE_VERTICES = 2;
+
+// Segments to make room for at first in the current breath: 6 seconds at
+// 100 Hz. There's twice as much room each time they don't fit.
+constexpr int INITIAL_SEGMENTS = 600;
+
+QPointF Coordinates(const BreathLoops::Point &point, LoopGraph::Kind kind) {
+  switch (kind) {
+  case LoopGraph::PRESSURE_VOLUME:
+    return {point.pressure_cm_h2o, point.volume_ml};
+  case LoopGraph::FLOW_VOLUME:
+    return {point.volume_ml, point.flow_l_per_min};
+  }
+  return {};
+}
+
+// The scene graph side of LoopGraph: the previous breath as one line strip,
+// and the current one as line segments that are only ever added to, until
+// the breath ends. Slots not written yet are all zeros, which draw nothing.
+class LoopNode : public QSGTransformNode {
+public:
+  LoopNode()
+      : previous_(NewGeometryNode(QSGGeometry::DrawLineStrip, 0)),
+        current_(NewGeometryNode(QSGGeometry::DrawLines,
+                                 LINE_VERTICES * INITIAL_SEGMENTS)) {
+    previous_->geometry()->setLineWidth(2.0f);
+    current_->geometry()->setLineWidth(2.0f);
+    appendChildNode(previous_);
+    appendChildNode(current_);
+  }
+
+  void SetColors(QColor current, QColor previous) {
+    static_cast<QSGFlatColorMaterial *>(current_->material())
+        ->setColor(current);
+    static_cast<QSGFlatColorMaterial *>(previous_->material())
+        ->setColor(previous);
+    current_->markDirty(QSGNode::DirtyMaterial);
+    previous_->markDirty(QSGNode::DirtyMaterial);
+  }
+
+  // Brings the nodes up to date with `loops`, redrawing everything if
+  // `rebuild`.
+  void Update(const BreathLoops &loops, LoopGraph::Kind kind, bool rebuild) {
+    if (rebuild || loops.completed_breaths() != completed_breaths_) {
+      completed_breaths_ = loops.completed_breaths();
+      SetPrevious(loops.previous(), kind);
+    }
+    if (rebuild || loops.current_generation() != generation_ ||
+        loops.current().size() < drawn_) {
+      generation_ = loops.current_generation();
+      ResetCurrent();
+    }
+    AddCurrent(loops.current(), kind);
+  }
+
+private:
+  void SetPrevious(const std::vector<BreathLoops::Point> &points,
+                   LoopGraph::Kind kind) {
+    QSGGeometry *geometry = previous_->geometry();
+    geometry->allocate(points.size());
+    QSGGeometry::Point2D *v = geometry->vertexDataAsPoint2D();
+    for (size_t i = 0; i < points.size(); i++) {
+      QPointF p = Coordinates(points[i], kind);
+      v[i].set(p.x(), p.y());
+    }
+    geometry->markVertexDataDirty();
+    previous_->markDirty(QSGNode::DirtyGeometry);
+  }
+
+  void ResetCurrent() {
+    QSGGeometry *geometry = current_->geometry();
+    std::memset(geometry->vertexData(), 0,
+                geometry->vertexCount() * geometry->sizeOfVertex());
+    geometry->markVertexDataDirty();
+    current_->markDirty(QSGNode::DirtyGeometry);
+    drawn_ = 0;
+  }
+
+  void AddCurrent(const std::vector<BreathLoops::Point> &points,
+                  LoopGraph::Kind kind) {
+    if (points.size() <= drawn_) {
+      return;
+    }
+    QSGGeometry *geometry = current_->geometry();
+    size_t segments = points.size() - 1;
+    if (LINE_VERTICES * segments > size_t(geometry->vertexCount())) {
+      // Make room, keeping the segments we have.
+      int capacity = geometry->vertexCount();
+      while (size_t(capacity) < LINE_VERTICES * segments) {
+        capacity *= 2;
+      }
+      std::vector<QSGGeometry::Point2D> kept(
+          geometry->vertexDataAsPoint2D(),
+          geometry->vertexDataAsPoint2D() + geometry->vertexCount());
+      geometry->allocate(capacity);
+      std::memset(geometry->vertexData(), 0,
+                  geometry->vertexCount() * geometry->sizeOfVertex());
+      std::copy(kept.begin(), kept.end(), geometry->vertexDataAsPoint2D());
+    }
+    QSGGeometry::Point2D *v = geometry->vertexDataAsPoint2D();
+    for (size_t i = std::max<size_t>(drawn_, 1); i < points.size(); i++) {
+      QPointF from = Coordinates(points[i - 1], kind);
+      QPointF to = Coordinates(points[i], kind);
+      v[LINE_VERTICES * (i - 1)].set(from.x(), from.y());
+      v[LINE_VERTICES * (i - 1) + 1].set(to.x(), to.y());
+    }
+    drawn_ = points.size();
+    geometry->markVertexDataDirty();
+    current_->markDirty(QSGNode::DirtyGeometry);
+  }
+
+  QSGGeometryNode *previous_;
+  QSGGeometryNode *current_;
+
+  // What's drawn: the breath in previous_, the version of the current
+  // breath, and how many of its points.
+  uint64_t completed_breaths_ = 0;
+  uint64_t generation_ = 0;
+  size_t drawn_ = 0;
+};
+
+} // namespace
+
+LoopGraph::LoopGraph(QQuickItem *parent) : QQuickItem(parent) {
+  setFlag(ItemHasContents, true);
+  setClip(true);
+}
+
+void LoopGraph::SetSource(GuiStateContainer *source) {
+  if (source_ == source) {
+    return;
+  }
+  QObject::disconnect(source_connection_);
+  source_ = source;
+  if (source_ != nullptr) {
+    source_connection_ =
+        connect(source_, &GuiStateContainer::LoopsChanged, this,
+                [this]() { update(); });
+  }
+  pending_rebuild_ = true;
+  emit SourceChanged();
+  update();
+}
+
+void LoopGraph::SetKind(Kind kind) {
+  if (kind_ != kind) {
+    kind_ = kind;
+    pending_rebuild_ = true;
+    emit KindChanged();
+    update();
+  }
+}
+
+void LoopGraph::SetRangeValue(float *member, float value) {
+  if (*member != value) {
+    *member = value;
+    emit RangeChanged();
+    update();
+  }
+}
+
+void LoopGraph::SetMinX(float value) { SetRangeValue(&min_x_, value); }
+void LoopGraph::SetMaxX(float value) { SetRangeValue(&max_x_, value); }
+void LoopGraph::SetMinY(float value) { SetRangeValue(&min_y_, value); }
+void LoopGraph::SetMaxY(float value) { SetRangeValue(&max_y_, value); }
+
+void LoopGraph::SetLineColor(QColor color) {
+  if (line_color_ != color) {
+    line_color_ = color;
+    pending_style_ = true;
+    emit LineColorChanged();
+    update();
+  }
+}
+
+void LoopGraph::SetPreviousLineColor(QColor color) {
+  if (previous_line_color_ != color) {
+    previous_line_color_ = color;
+    pending_style_ = true;
+    emit PreviousLineColorChanged();
+    update();
+  }
+}
+
+void LoopGraph::geometryChanged(const QRectF &new_geometry,
+                                const QRectF &old_geometry) {
+  QQuickItem::geometryChanged(new_geometry, old_geometry);
+  update();
+}
+
+QSGNode *LoopGraph::updatePaintNode(QSGNode *old_node, UpdatePaintNodeData *) {
+  FrameProfiler::Scope profile(FrameProfiler::Phase::GRAPH_PAINT);
+  auto *node = static_cast<LoopNode *>(old_node);
+  if (node == nullptr) {
+    node = new LoopNode();
+    pending_rebuild_ = true;
+    pending_style_ = true;
+  }
+  if (pending_style_) {
+    node->SetColors(line_color_, previous_line_color_);
+    pending_style_ = false;
+  }
+  if (source_ != nullptr) {
+    // The GUI thread waits while we're here, so the loops can't change.
+    node->Update(source_->GetBreathLoops(), kind_, pending_rebuild_);
+    pending_rebuild_ = false;
+  }
+  node->setMatrix(
+      DataToItem(min_x_, max_x_, min_y_, max_y_, width(), height()));
+  return node;
+}
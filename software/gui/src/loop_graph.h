@@ -0,0 +1,96 @@
+#ifndef LOOP_GRAPH_H_
+#define LOOP_GRAPH_H_
+
+#include "gui_state_container.h"
+#include <QColor>
+#include <QMetaObject>
+#include <QPointer>
+#include <QQuickItem>
+
+/**
+ * @brief The LoopGraph is a QQuickItem that displays the pressure-volume or
+ * flow-volume loop of the breath in progress, over that of the previous
+ * breath.
+ *
+ * It reads the points straight from the BreathLoops of its `source`, when
+ * the scene graph syncs. The previous breath is drawn once, when it ends;
+ * on other frames only the points the current breath gained are added to
+ * the vertex buffer. Scaling to the item is a transform, as in
+ * WaveformGraph.
+ */
+class LoopGraph : public QQuickItem {
+  Q_OBJECT
+
+public:
+  enum Kind {
+    // Volume over pressure.
+    PRESSURE_VOLUME,
+    // Flow over volume.
+    FLOW_VOLUME,
+  };
+  Q_ENUM(Kind)
+
+  Q_PROPERTY(GuiStateContainer *source READ GetSource WRITE SetSource NOTIFY
+                 SourceChanged)
+  Q_PROPERTY(Kind kind READ GetKind WRITE SetKind NOTIFY KindChanged)
+  Q_PROPERTY(float minX READ GetMinX WRITE SetMinX NOTIFY RangeChanged)
+  Q_PROPERTY(float maxX READ GetMaxX WRITE SetMaxX NOTIFY RangeChanged)
+  Q_PROPERTY(float minY READ GetMinY WRITE SetMinY NOTIFY RangeChanged)
+  Q_PROPERTY(float maxY READ GetMaxY WRITE SetMaxY NOTIFY RangeChanged)
+  Q_PROPERTY(QColor lineColor READ GetLineColor WRITE SetLineColor NOTIFY
+                 LineColorChanged)
+  Q_PROPERTY(QColor previousLineColor READ GetPreviousLineColor WRITE
+                 SetPreviousLineColor NOTIFY PreviousLineColorChanged)
+
+  explicit LoopGraph(QQuickItem *parent = nullptr);
+
+  GuiStateContainer *GetSource() const { return source_; }
+  Kind GetKind() const { return kind_; }
+  float GetMinX() const { return min_x_; }
+  float GetMaxX() const { return max_x_; }
+  float GetMinY() const { return min_y_; }
+  float GetMaxY() const { return max_y_; }
+  QColor GetLineColor() const { return line_color_; }
+  QColor GetPreviousLineColor() const { return previous_line_color_; }
+
+public slots:
+  void SetSource(GuiStateContainer *source);
+  void SetKind(Kind kind);
+  void SetMinX(float value);
+  void SetMaxX(float value);
+  void SetMinY(float value);
+  void SetMaxY(float value);
+  void SetLineColor(QColor color);
+  void SetPreviousLineColor(QColor color);
+
+signals:
+  void SourceChanged();
+  void KindChanged();
+  void RangeChanged();
+  void LineColorChanged();
+  void PreviousLineColorChanged();
+
+protected:
+  QSGNode *updatePaintNode(QSGNode *old_node, UpdatePaintNodeData *) override;
+  void geometryChanged(const QRectF &new_geometry,
+                       const QRectF &old_geometry) override;
+
+private:
+  void SetRangeValue(float *member, float value);
+
+  QPointer<GuiStateContainer> source_;
+  QMetaObject::Connection source_connection_;
+  Kind kind_ = PRESSURE_VOLUME;
+  float min_x_ = 0;
+  float max_x_ = 1;
+  float min_y_ = 0;
+  float max_y_ = 1;
+  QColor line_color_ = QColor(255, 255, 255, 255);
+  QColor previous_line_color_ = QColor(255, 255, 255, 90);
+  // Whether the next frame should draw everything from scratch, and update
+  // the colors.
+  bool pending_rebuild_ = true;
+  bool pending_style_ = true;
+};
+
+#endif // LOOP_GRAPH_H_
@@ -1,8 +1,20 @@
 #include "periodic_closure.h"
 
-#include <iostream>
+#include <algorithm>
+
+void PeriodicClosure::Histogram::Add(std::chrono::nanoseconds duration) {
+  int i = 0;
+  while (i < NUM_BUCKETS - 1 && duration >= BucketStart(i + 1)) {
+    i++;
+  }
+  counts[i]++;
+}
 
 void PeriodicClosure::Start() {
+  {
+    std::unique_lock<std::mutex> l(mu_);
+    stop_requested_ = false;
+  }
   loop_thread_ = std::thread(&PeriodicClosure::Loop, this);
 }
 
@@ -21,12 +33,41 @@ void PeriodicClosure::Stop() {
   loop_thread_.join();
 }
 
+PeriodicClosure::Stats PeriodicClosure::GetStats() {
+  std::unique_lock<std::mutex> l(mu_);
+  return stats_;
+}
+
 void PeriodicClosure::Loop() {
+  // When the current run was due. Runs are due at whole multiples of the
+  // interval since the first one, so that the time fn_() takes doesn't add
+  // up from one run to the next.
+  SteadyInstant due = SteadyClock::now();
   while (true) {
+    SteadyInstant start = SteadyClock::now();
     fn_();
+    SteadyInstant end = SteadyClock::now();
 
-    auto next_run = SteadyClock::now() + interval_;
+    SteadyInstant next_run = due + interval_;
     std::unique_lock<std::mutex> l(mu_);
+    stats_.runs++;
+    stats_.lateness.Add(start - due);
+    stats_.duration.Add(end - start);
+    if (end - start > interval_) {
+      stats_.overruns++;
+    }
+    if (next_run < end) {
+      // Behind schedule: the runs due by now, next_run included, were missed.
+      auto missed = (end - next_run) / interval_ + 1;
+      auto to_skip = policy_ == OverrunPolicy::SKIP
+                         ? missed
+                         : std::max<decltype(missed)>(
+                               0, missed - MAX_CATCH_UP_RUNS);
+      next_run += to_skip * interval_;
+      stats_.skipped += to_skip;
+    }
+    due = next_run;
+
     while (true) {
       if (stop_requested_) {
         // We're done.
@@ -3,32 +3,75 @@
 
 #include "chrono.h"
 
+#include <array>
 #include <condition_variable>
+#include <cstdint>
 #include <functional>
+#include <mutex>
 #include <thread>
 
-// Executes a given lambda with a given interval between finishing one execution
-// and scheduling the next one. The interval is a lower bound.
+// Executes a given lambda on its own thread at a fixed rate: runs are
+// scheduled at whole multiples of the interval since Start(), however long
+// each run takes, so the rate doesn't drift.
 //
-// TODO: This class desperately needs unit tests, testing e.g.:
-//  - The closure is invoked with about the given interval
-//  - The closure is never invoked after Stop() completes
-//  - Stop() works correctly whether it's called while the closure runs or not
-//  - What happens if you never call Start()
-//  - etc.
+// A run that takes longer than the interval (an overrun) makes the next ones
+// late. What happens then is up to the OverrunPolicy. Either way, the number
+// of overruns, and histograms of how late runs started and of how long they
+// took, are kept in Stats.
 class PeriodicClosure {
 public:
+  enum class OverrunPolicy {
+    // Runs the missed runs right away, back to back, to get back on schedule.
+    // For closures that must run a given number of times, e.g. that advance
+    // a simulation by one interval each. Catching up stops after
+    // MAX_CATCH_UP_RUNS, e.g. if the system was suspended: the rest are
+    // skipped.
+    CATCH_UP,
+    // Skips the missed runs, and waits for the next one on schedule. For
+    // closures that do the latest work each time, e.g. polling.
+    SKIP,
+  };
+  static constexpr int MAX_CATCH_UP_RUNS = 10;
+
+  // How many times durations fell in each bucket: [0, 1ms), then powers of
+  // two, [1ms, 2ms), [2ms, 4ms), ..., and the last one is open-ended.
+  struct Histogram {
+    static constexpr int NUM_BUCKETS = 12;
+    std::array<uint64_t, NUM_BUCKETS> counts{};
+
+    void Add(std::chrono::nanoseconds duration);
+    // Where bucket i starts.
+    static DurationMs BucketStart(int i) {
+      return i == 0 ? DurationMs(0) : DurationMs(1 << (i - 1));
+    }
+  };
+
+  struct Stats {
+    uint64_t runs = 0;
+    // Runs that took longer than the interval.
+    uint64_t overruns = 0;
+    // Runs that were not done because of overruns, with SKIP, or because
+    // they were too many to catch up on.
+    uint64_t skipped = 0;
+    // How late runs started against their schedule.
+    Histogram lateness;
+    // How long runs took.
+    Histogram duration;
+  };
+
   // Initializes a PeriodicClosure to run the given lambda with a given
   // interval.
   //
   // Note that you have to explicitly call Start().
-  PeriodicClosure(DurationMs interval, std::function<void()> fn)
-      : interval_(interval), fn_(std::move(fn)) {}
+  PeriodicClosure(DurationMs interval, std::function<void()> fn,
+                  OverrunPolicy policy = OverrunPolicy::SKIP)
+      : interval_(interval), fn_(std::move(fn)), policy_(policy) {}
 
   // Calls Stop().
   ~PeriodicClosure() { Stop(); }
 
-  // Begins periodically running the given lambda.
+  // Begins periodically running the given lambda, the first time right away.
+  // Can be called again after Stop(), but not while running.
   void Start();
   // Signals that periodical execution must cease, and waits for it to cease.
   // After this completes, the lambda will never execute again.
@@ -37,17 +80,22 @@ public:
   // large.
   void Stop();
 
+  // Returns the stats since the first Start(). Thread-safe.
+  Stats GetStats();
+
 private:
   void Loop();
 
   const DurationMs interval_;
   const std::function<void()> fn_;
+  const OverrunPolicy policy_;
 
   std::thread loop_thread_;
 
   std::mutex mu_;
   bool stop_requested_ = false;
   std::condition_variable stop_requested_cv_;
+  Stats stats_;
 };
 
 #endif // PERIODIC_CLOSURE_H
@@ -1,10 +1,14 @@
+#include "baud_rate_limit.h"
+#include "capabilities.h"
 #include "chrono.h"
 #include "connected_device.h"
+#include "framing.h"
 #include "logger.h"
 #include "network_protocol.pb.h"
 #include "pb_common.h"
 #include "pb_decode.h"
 #include "pb_encode.h"
+#include "proto_codec.h"
 #include <QSerialPort>
 #include <memory>
 
@@ -30,6 +34,27 @@ constexpr DurationMs INTER_FRAME_TIMEOUT_MS = DurationMs(42);
 // will usually swallow it immeadetely, but just in case we set a timeout.
 constexpr DurationMs WRITE_TIMEOUT_MS = DurationMs(15);
 
+// The link starts out at DEFAULT_BAUD_RATE.  We offer the controller to go up
+// to MAX_BAUD_RATE, and it tells us in ControllerStatus.baud_rate which rate
+// it picked.
+constexpr qint32 DEFAULT_BAUD_RATE = 115200;
+constexpr qint32 MAX_BAUD_RATE = 1000000;
+
+// After switching to a faster rate, this many failed receptions in a row
+// (about a second's worth) make us go back to DEFAULT_BAUD_RATE, and stop
+// offering that rate for BAUD_RATE_RETRY_INTERVAL.  The controller does the
+// same on its side.
+constexpr int BAUD_RATE_FALLBACK_FAILURES = 20;
+constexpr DurationMs BAUD_RATE_RETRY_INTERVAL = DurationMs(30000);
+
+// We send our Capabilities in every GuiStatus until the controller answers
+// with its own, and then this often, in case it restarted and forgot them.
+constexpr DurationMs HELLO_INTERVAL = DurationMs(1000);
+
+// While the link is down, every cycle fails the same way; we log each kind
+// of failure at most this often.
+constexpr DurationMs FAILURE_LOG_INTERVAL = DurationMs(1000);
+
 class RespiraConnectedDevice : public ConnectedDevice {
 
 public:
@@ -49,7 +74,7 @@ public:
 
     serialPort_ = std::make_unique<QSerialPort>();
     serialPort_->setPortName(serialPortName_);
-    serialPort_->setBaudRate(QSerialPort::Baud115200);
+    serialPort_->setBaudRate(baudRate_);
     serialPort_->setDataBits(QSerialPort::Data8);
     serialPort_->setParity(QSerialPort::NoParity);
     serialPort_->setStopBits(QSerialPort::OneStop);
@@ -63,26 +88,44 @@ public:
 
   bool SendGuiStatus(const GuiStatus &gui_status) override {
     if (!createPortMaybe()) {
-      CRIT("Could not open serial port for sending {}",
-           serialPortName_.toStdString());
+      CRIT_LIMITED(openFailureLog_, "Could not open serial port for sending {}",
+                   serialPortName_.toStdString());
       // TODO Raise an Alert?
       return false;
     }
 
+    GuiStatus status = gui_status;
+    status.has_max_baud_rate = true;
+    SteadyInstant now = SteadyClock::now();
+    status.max_baud_rate = offeredBaudRate_.Get(now);
+    if (!helloAnswered_ || now - lastHello_ >= HELLO_INTERVAL) {
+      status.has_capabilities = true;
+      status.capabilities = OurCapabilities();
+      lastHello_ = now;
+    }
+
     uint8_t tx_buffer[GuiStatus_size];
 
     pb_ostream_t stream = pb_ostream_from_buffer(tx_buffer, sizeof(tx_buffer));
-    if (!pb_encode(&stream, GuiStatus_fields, &gui_status)) {
+    if (!pb_encode(&stream, GuiStatus_fields, &status)) {
       // TODO Raise an Alert?
       CRIT("Could not serialize GuiStatus");
       return false;
     }
 
-    serialPort_->write((const char *)tx_buffer, stream.bytes_written);
+    if (HasFeature(link_, Feature_FRAMING)) {
+      uint8_t frame[Framing::MaxEncodedSize(GuiStatus_size)];
+      uint32_t size = Framing::EncodeFrame(
+          tx_buffer, static_cast<uint32_t>(stream.bytes_written), frame,
+          sizeof(frame));
+      serialPort_->write((const char *)frame, size);
+    } else {
+      serialPort_->write((const char *)tx_buffer, stream.bytes_written);
+    }
 
     if (!serialPort_->waitForBytesWritten(WRITE_TIMEOUT_MS.count())) {
       // TODO Raise an Alert?
-      CRIT("Timeout while sending GuiStatus");
+      CRIT_LIMITED(sendTimeoutLog_, "Timeout while sending GuiStatus");
       return false;
     }
     return true;
@@ -90,8 +133,8 @@ public:
 
   bool ReceiveControllerStatus(ControllerStatus *controller_status) override {
     if (!createPortMaybe()) {
-      CRIT("Could not open serial port for reading {}",
-           serialPortName_.toStdString());
+      CRIT_LIMITED(openFailureLog_, "Could not open serial port for reading {}",
+                   serialPortName_.toStdString());
       // TODO Raise an Alert?
       return false;
     }
@@ -99,31 +142,127 @@ public:
     // wait for incomming data
     if (!serialPort_->waitForReadyRead(INTER_FRAME_TIMEOUT_MS.count())) {
       // TODO Raise an Alert?
-      CRIT("Timeout while waiting for a serial frame from Cycle Controller");
+      CRIT_LIMITED(
+          receiveTimeoutLog_,
+          "Timeout while waiting for a serial frame from Cycle Controller");
+      OnReceiveFailure();
       return false;
     }
 
     QByteArray responseData = serialPort_->readAll();
 
     // continue reading characters until we don't see
-    // any data for long enough to estimate end of packet silence
-    while (serialPort_->waitForReadyRead(INTER_FRAME_TIMEOUT_MS.count() / 5)) {
+    // any data for long enough to estimate end of packet silence, or, once
+    // we agreed on framing, until the end of a frame.
+    bool framed = HasFeature(link_, Feature_FRAMING);
+    while (!(framed && responseData.endsWith('\0')) &&
+           serialPort_->waitForReadyRead(INTER_FRAME_TIMEOUT_MS.count() / 5)) {
       responseData += serialPort_->readAll();
     }
 
-    pb_istream_t stream = pb_istream_from_buffer(
-        (const uint8_t *)responseData.data(), responseData.length());
-
-    if (!pb_decode(&stream, ControllerStatus_fields, controller_status)) {
-      CRIT("Could not de-serialize received data as Controller Status");
+    // The controller frames its answer to our hello, before we know it
+    // agreed to, and goes back to raw messages if it restarts; so we take
+    // either, whatever we last agreed on.
+    if (!DecodeLastFrame(responseData, controller_status) &&
+        // Same results as pb_decode(), which it falls back to for anything
+        // but the usual encoding.
+        !ProtoCodec::Decode((const uint8_t *)responseData.data(),
+                            responseData.length(), controller_status)) {
+      CRIT_LIMITED(decodeFailureLog_,
+                   "Could not de-serialize received data as Controller Status");
       // TODO: Raise an Alert?
+      OnReceiveFailure();
       return false;
     }
 
+    consecutiveFailures_ = 0;
+    if (controller_status->has_capabilities) {
+      link_ = Negotiate(OurCapabilities(), controller_status->capabilities);
+      if (!helloAnswered_) {
+        INFO("Controller speaks protocol version {}, using features {:#x}",
+             controller_status->capabilities.protocol_version,
+             link_.features);
+      }
+      helloAnswered_ = true;
+    }
+    // The controller switched rates right after sending this, so we follow
+    // before sending anything else.
+    if (controller_status->has_baud_rate &&
+        static_cast<qint32>(controller_status->baud_rate) != baudRate_) {
+      INFO("Switching serial port to {} baud", controller_status->baud_rate);
+      SetBaudRate(controller_status->baud_rate);
+    }
+
     return true;
   }
 
 private:
+  static Capabilities OurCapabilities() {
+    return {ProtocolVersion, AllFeatures, static_cast<uint32_t>(MAX_BAUD_RATE)};
+  }
+
+  // Decodes the last complete frame in `data`, if there is one.
+  static bool DecodeLastFrame(const QByteArray &data,
+                              ControllerStatus *controller_status) {
+    if (!data.endsWith('\0')) {
+      return false;
+    }
+    int start = data.lastIndexOf('\0', data.length() - 2) + 1;
+    // DecodeInPlace overwrites the frame.
+    QByteArray frame = data.mid(start);
+    uint32_t message_length;
+    if (Framing::DecodeInPlace(reinterpret_cast<uint8_t *>(frame.data()),
+                               static_cast<uint32_t>(frame.length()),
+                               &message_length) != Framing::DecodeStatus::Ok) {
+      return false;
+    }
+    return ProtoCodec::Decode(reinterpret_cast<const uint8_t *>(frame.data()),
+                              message_length, controller_status);
+  }
+
+  void SetBaudRate(qint32 rate) {
+    if (serialPort_->setBaudRate(rate)) {
+      baudRate_ = rate;
+    } else {
+      // Stay where we are, stop offering this rate for a while, and leave it
+      // to the controller to time out and fall back.
+      CRIT("Could not set serial port to {} baud", rate);
+      offeredBaudRate_.Lower(SteadyClock::now(), rate);
+    }
+  }
+
+  void OnReceiveFailure() {
+    if (++consecutiveFailures_ < BAUD_RATE_FALLBACK_FAILURES) {
+      return;
+    }
+    // The controller may have restarted, or timed out on us: start over.
+    if (helloAnswered_) {
+      WARN("Nothing valid from the controller, redoing the handshake");
+    }
+    link_ = LegacyCapabilities(DEFAULT_BAUD_RATE);
+    helloAnswered_ = false;
+    if (baudRate_ == DEFAULT_BAUD_RATE) {
+      consecutiveFailures_ = 0;
+      return;
+    }
+    WARN("Nothing valid from the controller at {} baud, falling back to {}",
+         baudRate_, DEFAULT_BAUD_RATE);
+    offeredBaudRate_.Lower(SteadyClock::now(), baudRate_);
+    consecutiveFailures_ = 0;
+    SetBaudRate(DEFAULT_BAUD_RATE);
+  }
+
+  qint32 baudRate_ = DEFAULT_BAUD_RATE;
+  BaudRateLimit offeredBaudRate_{MAX_BAUD_RATE, BAUD_RATE_RETRY_INTERVAL};
+  int consecutiveFailures_ = 0;
+  // What we and the controller agreed on, and when we last told it ours.
+  Capabilities link_ = LegacyCapabilities(DEFAULT_BAUD_RATE);
+  bool helloAnswered_ = false;
+  SteadyInstant lastHello_;
+  CustomLogger::LogLimiter openFailureLog_{FAILURE_LOG_INTERVAL};
+  CustomLogger::LogLimiter sendTimeoutLog_{FAILURE_LOG_INTERVAL};
+  CustomLogger::LogLimiter receiveTimeoutLog_{FAILURE_LOG_INTERVAL};
+  CustomLogger::LogLimiter decodeFailureLog_{FAILURE_LOG_INTERVAL};
   std::unique_ptr<QSerialPort> serialPort_ = nullptr;
   QString serialPortName_;
 };
@@ -0,0 +1,113 @@
+#ifndef SAMPLE_HISTORY_H
+#define SAMPLE_HISTORY_H
+
+#include "chrono.h"
+#include "network_protocol.pb.h"
+
+#include <algorithm>
+#include <deque>
+#include <optional>
+
+// Keeps the recent control loop samples received in the SampleBatch of each
+// ControllerStatus, i.e. every sample the controller took, rather than just
+// the one that was current when the ControllerStatus was sent.
+//
+// Non-thread-safe, needs external synchronization.
+class SampleHistory {
+public:
+  struct Sample {
+    SteadyInstant time;
+    float patient_pressure_cm_h2o;
+    float flow_ml_per_min;
+    float volume_ml;
+    float pressure_setpoint_cm_h2o;
+    float fio2;
+  };
+
+  // Samples older than `window` relative to the newest one are kicked out.
+  explicit SampleHistory(DurationMs window) : window_(window) {}
+
+  // Appends the samples in a batch received at gui_now, skipping any we
+  // already have.
+  void Append(SteadyInstant gui_now, const SampleBatch &batch) {
+    pb_size_t count = std::min({batch.patient_pressure_cm_h2o_x100_count,
+                                batch.flow_ml_per_min_count,
+                                batch.volume_ml_x10_count,
+                                batch.pressure_setpoint_cm_h2o_x100_count,
+                                batch.fio2_x1000_count});
+    if (count == 0 || batch.sample_period_us == 0) {
+      return;
+    }
+    std::chrono::microseconds period(batch.sample_period_us);
+    int64_t last_index = int64_t{batch.first_sample} + count - 1;
+
+    // We don't know when the controller took each sample in GUI time, only
+    // that the newest one was taken a bit before gui_now, and that samples
+    // are sample_period_us apart.  So we pin one sample index to a GUI time,
+    // and place every sample relative to it.  That keeps the spacing even
+    // despite jitter in when batches arrive.  Re-pin if the controller
+    // restarted, or if the clocks drifted too far apart.
+    bool restarted = next_index_.has_value() && last_index < *next_index_ - 1;
+    if (!anchor_.has_value() || restarted ||
+        TimeOf(last_index, period) > gui_now ||
+        gui_now - TimeOf(last_index, period) > MaxLag) {
+      anchor_ = {last_index, gui_now};
+      if (restarted) {
+        next_index_.reset();
+      }
+    }
+
+    int32_t pressure = 0, flow = 0, volume = 0, setpoint = 0, fio2 = 0;
+    for (pb_size_t i = 0; i < count; ++i) {
+      // Values are deltas from the previous sample in the batch.
+      pressure += batch.patient_pressure_cm_h2o_x100[i];
+      flow += batch.flow_ml_per_min[i];
+      volume += batch.volume_ml_x10[i];
+      setpoint += batch.pressure_setpoint_cm_h2o_x100[i];
+      fio2 += batch.fio2_x1000[i];
+
+      int64_t index = int64_t{batch.first_sample} + i;
+      if (next_index_.has_value() && index < *next_index_) {
+        continue;
+      }
+      samples_.push_back({
+          .time = TimeOf(index, period),
+          .patient_pressure_cm_h2o = 0.01f * pressure,
+          .flow_ml_per_min = static_cast<float>(flow),
+          .volume_ml = 0.1f * volume,
+          .pressure_setpoint_cm_h2o = 0.01f * setpoint,
+          .fio2 = 0.001f * fio2,
+      });
+    }
+    next_index_ = last_index + 1;
+
+    while (!samples_.empty() &&
+           samples_.back().time - samples_.front().time > window_) {
+      samples_.pop_front();
+    }
+  }
+
+  const std::deque<Sample> &samples() const { return samples_; }
+
+private:
+  // How far behind the GUI clock the newest sample may appear to be before
+  // we re-pin the sample clock.
+  static constexpr DurationMs MaxLag = DurationMs(250);
+
+  struct Anchor {
+    int64_t index;
+    SteadyInstant time;
+  };
+
+  SteadyInstant TimeOf(int64_t index, std::chrono::microseconds period) const {
+    return anchor_->time + (index - anchor_->index) * period;
+  }
+
+  DurationMs window_;
+  std::optional<Anchor> anchor_;
+  // Index of the sample after the newest one we have.
+  std::optional<int64_t> next_index_;
+  std::deque<Sample> samples_;
+};
+
+#endif // SAMPLE_HISTORY_H
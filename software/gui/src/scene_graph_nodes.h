@@ -0,0 +1,47 @@
+#ifndef SCENE_GRAPH_NODES_H_
+#define SCENE_GRAPH_NODES_H_
+
+#include <QMatrix4x4>
+#include <QSGFlatColorMaterial>
+#include <QSGGeometryNode>
+#include <cstring>
+
+// Returns a node that draws `vertex_count` 2D vertices, all zeros for now,
+// in a flat color, for items that write their vertices themselves as data
+// comes in (see WaveformGraph and LoopGraph).
+//
+// The node keeps its own vertex buffer, and the transform of its parents is
+// applied in the shader. Otherwise the renderer may merge the node with
+// others, which means copying all of its vertices with the transform applied
+// whenever the transform changes, e.g. on every frame of a scrolling graph.
+inline QSGGeometryNode *NewGeometryNode(QSGGeometry::DrawingMode mode,
+                                        int vertex_count) {
+  auto *geometry = new QSGGeometry(QSGGeometry::defaultAttributes_Point2D(),
+                                   vertex_count);
+  geometry->setDrawingMode(mode);
+  geometry->setVertexDataPattern(QSGGeometry::DynamicPattern);
+  std::memset(geometry->vertexData(), 0,
+              vertex_count * geometry->sizeOfVertex());
+
+  auto *material = new QSGFlatColorMaterial();
+  material->setFlag(QSGMaterial::RequiresFullMatrix);
+
+  auto *node = new QSGGeometryNode();
+  node->setGeometry(geometry);
+  node->setMaterial(material);
+  node->setFlags(QSGNode::OwnsGeometry | QSGNode::OwnsMaterial);
+  return node;
+}
+
+// Maps [min_x, max_x] x [min_y, max_y] to a width x height item, y up.
+inline QMatrix4x4 DataToItem(float min_x, float max_x, float min_y,
+                             float max_y, float width, float height) {
+  float sx = max_x != min_x ? width / (max_x - min_x) : 0;
+  float sy = max_y != min_y ? -height / (max_y - min_y) : 0;
+  return QMatrix4x4(sx, 0, 0, -sx * min_x,         //
+                    0, sy, 0, height - sy * min_y, //
+                    0, 0, 1, 0,                    //
+                    0, 0, 0, 1);
+}
+
+#endif // SCENE_GRAPH_NODES_H_
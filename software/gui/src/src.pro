@@ -17,22 +17,32 @@ CONFIG += staticlib
 HEADERS += \
   alarm.h \
   alarm_manager.h \
+  baud_rate_limit.h \
+  breath_loops.h \
   chrono.h \
   connected_device.h \
   controller_history.h \
+  frame_profiler.h \
   gui_state_container.h \
   latching_alarm.h \
+  loop_graph.h \
   patient_detached_alarm.h \
   periodic_closure.h \
   pip_exceeded_alarm.h \
   pip_not_reached_alarm.h \
   respira_connected_device.h \
+  sample_history.h \
+  scene_graph_nodes.h \
   simple_clock.h \
   time_series_graph.h \
   time_series_graph_painter.h \
+  trend_history.h \
+  waveform_graph.h \
   logger.h
 
 SOURCES += gui_state_container.cpp \
+  loop_graph.cpp \
   periodic_closure.cpp \
   time_series_graph_painter.cpp \
+  waveform_graph.cpp \
   logger.cpp
@@ -1,4 +1,5 @@
 #include "time_series_graph_painter.h"
+#include "frame_profiler.h"
 #include "qnanocolor.h"
 #include "time_series_graph.h"
 #include <QDebug>
@@ -9,6 +10,7 @@
 TimeSeriesGraphPainter::TimeSeriesGraphPainter() {}
 
 void TimeSeriesGraphPainter::paint(QNanoPainter *m_painter) {
+  FrameProfiler::Scope profile(FrameProfiler::Phase::GRAPH_PAINT);
   float w = width();
   float h = height();
 
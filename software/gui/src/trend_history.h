@@ -0,0 +1,146 @@
+#ifndef TREND_HISTORY_H
+#define TREND_HISTORY_H
+
+#include "chrono.h"
+
+#include <algorithm>
+#include <deque>
+#include <limits>
+#include <optional>
+#include <vector>
+
+// Min, max and mean of the values that fell in a span of time.
+struct TrendBucket {
+  SteadyInstant start;
+  float min = std::numeric_limits<float>::max();
+  float max = std::numeric_limits<float>::lowest();
+  double sum = 0;
+  int count = 0;
+
+  float mean() const { return count == 0 ? 0 : sum / count; }
+
+  void Add(float value) {
+    min = std::min(min, value);
+    max = std::max(max, value);
+    sum += value;
+    count++;
+  }
+};
+
+// Keeps hours of one signal for trend graphs, at several resolutions.
+//
+// ControllerHistory keeps every point of a short window, which doesn't scale
+// to hours. Instead, each level of a TrendHistory sums the values up in
+// buckets of a fixed duration, and keeps the buckets of a fixed retention.
+// Fine levels cover the last hour or so, coarse ones days. So memory is
+// bounded by the number of buckets of all levels, however long the GUI runs,
+// and adding a value is constant time.
+//
+// Buckets start at whole multiples of their duration since the first value,
+// and only exist for spans that have values: a gap in the data is a gap
+// between buckets.
+//
+// Non-thread-safe, needs external synchronization.
+class TrendHistory {
+public:
+  struct Level {
+    DurationMs bucket;
+    DurationMs retention;
+  };
+
+  // 1 second buckets for an hour, 10 seconds for 12 hours, a minute for 72
+  // hours: 12240 buckets in all.
+  static std::vector<Level> DefaultLevels() {
+    return {{DurationMs(1000), std::chrono::hours(1)},
+            {DurationMs(10000), std::chrono::hours(12)},
+            {std::chrono::minutes(1), std::chrono::hours(72)}};
+  }
+
+  // `levels` go from the finest to the coarsest.
+  explicit TrendHistory(std::vector<Level> levels = DefaultLevels()) {
+    for (const Level &level : levels) {
+      levels_.push_back({level, {}, false});
+    }
+  }
+
+  // Adds a value obtained at a given time point in GUI time, which never goes
+  // backwards (see ControllerHistory::Append).
+  void Add(SteadyInstant gui_now, float value) {
+    if (!origin_.has_value()) {
+      origin_ = gui_now;
+    }
+    for (LevelState &state : levels_) {
+      DurationMs d = state.level.bucket;
+      if (state.buckets.empty() ||
+          gui_now - state.buckets.back().start >= d) {
+        state.buckets.push_back({*origin_ + (gui_now - *origin_) / d * d});
+        // Buckets that ended longer than the retention ago go, except the
+        // one being filled.
+        while (state.buckets.size() > 1 &&
+               gui_now - (state.buckets.front().start + d) >
+                   state.level.retention) {
+          state.buckets.pop_front();
+          state.dropped = true;
+        }
+      }
+      state.buckets.back().Add(value);
+    }
+  }
+
+  // Returns the buckets that overlap [from, to], oldest first, from the
+  // finest level that has at most about `max_buckets` of them, e.g. one per
+  // pixel of the graph, and that goes back to `from`. If none goes back that
+  // far, from the coarsest level.
+  std::vector<TrendBucket> Query(SteadyInstant from, SteadyInstant to,
+                                 int max_buckets) const {
+    if (levels_.empty() || to < from || max_buckets <= 0) {
+      return {};
+    }
+    auto wanted = (to - from) / max_buckets;
+    const LevelState *chosen = &levels_.back();
+    for (const LevelState &state : levels_) {
+      if (state.level.bucket < wanted) {
+        continue;
+      }
+      if (!state.dropped || state.buckets.empty() ||
+          state.buckets.front().start <= from) {
+        chosen = &state;
+        break;
+      }
+    }
+
+    const auto &buckets = chosen->buckets;
+    DurationMs d = chosen->level.bucket;
+    auto first = std::partition_point(
+        buckets.begin(), buckets.end(),
+        [&](const TrendBucket &b) { return b.start + d <= from; });
+    auto last = std::partition_point(
+        first, buckets.end(),
+        [&](const TrendBucket &b) { return b.start <= to; });
+    return {first, last};
+  }
+
+  // Buckets kept in all levels.
+  size_t Size() const {
+    size_t size = 0;
+    for (const LevelState &state : levels_) {
+      size += state.buckets.size();
+    }
+    return size;
+  }
+
+private:
+  struct LevelState {
+    Level level;
+    // The last one is still being filled.
+    std::deque<TrendBucket> buckets;
+    // Whether buckets went out of the retention, i.e. the level doesn't go
+    // back to the first value anymore.
+    bool dropped;
+  };
+
+  std::optional<SteadyInstant> origin_;
+  std::vector<LevelState> levels_;
+};
+
+#endif // TREND_HISTORY_H
@@ -0,0 +1,341 @@
+#include "waveform_graph.h"
+#include "frame_profiler.h"
+#include "scene_graph_nodes.h"
+#include <QSGFlatColorMaterial>
+#include <QSGTransformNode>
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+namespace {
+
+// Vertices per segment between two points: a line, and the two triangles
+// of the area under it.
+constexpr int LINE_VERTICES = 2;
+constexpr int AREA_VERTICES = 6;
+
+// Segments to make room for at first. There's twice as much room each time
+// the visible ones don't fit anymore.
+constexpr int INITIAL_SEGMENTS = 512;
+
+// Bottom of the area under the line, in the units of the data: far enough
+// below any minValue that the item's clip cuts it off.
+constexpr float AREA_BOTTOM = -1e6f;
+
+// How old time_base_ gets before it's moved to now. Times are floats, which
+// still have a resolution of 0.1ms at this many seconds.
+constexpr float REBASE_AFTER_SECS = 1000;
+
+// The scene graph side of WaveformGraph: the area under the series, the
+// series, and the baseline, all in seconds and in the units of the data,
+// under a transform to the item's coordinates.
+//
+// The segments between consecutive points are kept in a ring: each new one
+// overwrites the oldest, unless that one is still visible, in which case the
+// ring grows. Slots not written yet are all zeros, which draw nothing.
+class WaveformNode : public QSGTransformNode {
+public:
+  WaveformNode()
+      : area_(NewGeometryNode(QSGGeometry::DrawTriangles, 0)),
+        line_(NewGeometryNode(QSGGeometry::DrawLines, 0)),
+        baseline_(NewGeometryNode(QSGGeometry::DrawLines, 2)) {
+    line_->geometry()->setLineWidth(2.0f);
+    baseline_->geometry()->setLineWidth(1.0f);
+    appendChildNode(area_);
+    appendChildNode(line_);
+    appendChildNode(baseline_);
+    Resize(INITIAL_SEGMENTS);
+  }
+
+  void SetColors(QColor line, QColor area) {
+    static_cast<QSGFlatColorMaterial *>(line_->material())->setColor(line);
+    static_cast<QSGFlatColorMaterial *>(area_->material())->setColor(area);
+    line_->markDirty(QSGNode::DirtyMaterial);
+    area_->markDirty(QSGNode::DirtyMaterial);
+  }
+
+  void AddPoint(QPointF point, float range_in_secs) {
+    if (!have_last_) {
+      last_ = point;
+      have_last_ = true;
+      return;
+    }
+    // The oldest segment is the next one to overwrite.
+    float oldest_end = Line()[LINE_VERTICES * next_ + 1].x;
+    if (count_ == capacity_ && oldest_end > point.x() - range_in_secs) {
+      Resize(2 * capacity_);
+    }
+    WriteSegment(next_, last_, point);
+    next_ = (next_ + 1) % capacity_;
+    count_ = std::min(count_ + 1, capacity_);
+    last_ = point;
+    line_->geometry()->markVertexDataDirty();
+    area_->geometry()->markVertexDataDirty();
+    line_->markDirty(QSGNode::DirtyGeometry);
+    area_->markDirty(QSGNode::DirtyGeometry);
+  }
+
+  // Forgets all points.
+  void Reset() {
+    have_last_ = false;
+    count_ = 0;
+    next_ = 0;
+    Resize(capacity_);
+  }
+
+  // Moves all points `secs` back in time, as WaveformGraph's time base moved
+  // forward by as much.
+  void Shift(float secs) {
+    last_.rx() -= secs;
+    for (auto *node : {line_, area_}) {
+      QSGGeometry::Point2D *v = node->geometry()->vertexDataAsPoint2D();
+      for (int i = 0; i < node->geometry()->vertexCount(); i++) {
+        v[i].x -= secs;
+      }
+      node->geometry()->markVertexDataDirty();
+      node->markDirty(QSGNode::DirtyGeometry);
+    }
+  }
+
+  void SetBaseline(bool show, float value, float view_time,
+                   float range_in_secs) {
+    QSGGeometry::Point2D *v = baseline_->geometry()->vertexDataAsPoint2D();
+    // When hidden, both ends are at the same point, which draws nothing.
+    v[0].set(show ? view_time - range_in_secs : view_time, value);
+    v[1].set(view_time, value);
+    baseline_->geometry()->markVertexDataDirty();
+    baseline_->markDirty(QSGNode::DirtyGeometry);
+  }
+
+  // Maps view_time to the right edge of a width x height item, and
+  // [min_value, max_value] to its height.
+  void SetView(float view_time, float range_in_secs, float min_value,
+               float max_value, float width, float height) {
+    setMatrix(DataToItem(view_time - range_in_secs, view_time, min_value,
+                         max_value, width, height));
+  }
+
+private:
+  QSGGeometry::Point2D *Line() {
+    return line_->geometry()->vertexDataAsPoint2D();
+  }
+  QSGGeometry::Point2D *Area() {
+    return area_->geometry()->vertexDataAsPoint2D();
+  }
+
+  void WriteSegment(int slot, QPointF from, QPointF to) {
+    float x0 = from.x(), y0 = from.y(), x1 = to.x(), y1 = to.y();
+    QSGGeometry::Point2D *line = Line() + LINE_VERTICES * slot;
+    line[0].set(x0, y0);
+    line[1].set(x1, y1);
+    QSGGeometry::Point2D *area = Area() + AREA_VERTICES * slot;
+    area[0].set(x0, y0);
+    area[1].set(x1, y1);
+    area[2].set(x0, AREA_BOTTOM);
+    area[3].set(x1, y1);
+    area[4].set(x1, AREA_BOTTOM);
+    area[5].set(x0, AREA_BOTTOM);
+  }
+
+  // Makes room for `capacity` segments, keeping the ones we have, oldest
+  // first.
+  void Resize(int capacity) {
+    int oldest = count_ == capacity_ ? next_ : 0;
+    for (auto [node, per_segment] :
+         {std::make_pair(line_, LINE_VERTICES),
+          std::make_pair(area_, AREA_VERTICES)}) {
+      QSGGeometry *geometry = node->geometry();
+      QSGGeometry::Point2D *v = geometry->vertexDataAsPoint2D();
+      std::vector<QSGGeometry::Point2D> kept;
+      kept.reserve(count_ * per_segment);
+      for (int i = 0; i < count_; i++) {
+        int slot = (oldest + i) % capacity_;
+        kept.insert(kept.end(), v + slot * per_segment,
+                    v + (slot + 1) * per_segment);
+      }
+      geometry->allocate(capacity * per_segment);
+      std::memset(geometry->vertexData(), 0,
+                  geometry->vertexCount() * geometry->sizeOfVertex());
+      std::copy(kept.begin(), kept.end(), geometry->vertexDataAsPoint2D());
+      geometry->markVertexDataDirty();
+      node->markDirty(QSGNode::DirtyGeometry);
+    }
+    capacity_ = capacity;
+    next_ = count_ % capacity_;
+  }
+
+  QSGGeometryNode *area_;
+  QSGGeometryNode *line_;
+  QSGGeometryNode *baseline_;
+
+  // Segments there's room for, segments written, and the slot of the next.
+  int capacity_ = 0;
+  int count_ = 0;
+  int next_ = 0;
+  // The last point added, where the next segment starts.
+  QPointF last_;
+  bool have_last_ = false;
+};
+
+} // namespace
+
+WaveformGraph::WaveformGraph(QQuickItem *parent)
+    : QQuickItem(parent), time_base_(SteadyClock::now()) {
+  setFlag(ItemHasContents, true);
+  // Cuts off what scrolled out on the left, and the area under the line.
+  setClip(true);
+}
+
+float WaveformGraph::SecondsSince(SteadyInstant base, SteadyInstant t) const {
+  return std::chrono::duration<float>(t - base).count();
+}
+
+void WaveformGraph::SetDataset(QVector<QPointF> &dataset) {
+  dataset_ = dataset;
+
+  SteadyInstant now = SteadyClock::now();
+  float now_secs = SecondsSince(time_base_, now);
+  if (now_secs > REBASE_AFTER_SECS) {
+    for (QPointF &point : new_points_) {
+      point.rx() -= now_secs;
+    }
+    newest_time_ -= now_secs;
+    pending_shift_ += now_secs;
+    time_base_ = now;
+    now_secs = 0;
+  }
+  view_time_ = now_secs;
+
+  // The x of each point is its time in seconds before now, rounded, so the
+  // points we already have can come back a little off from where they were.
+  // New points are at least half the time between points newer than those.
+  int size = dataset.size();
+  float tolerance =
+      size >= 2 ? 0.5f * (dataset[size - 1].x() - dataset[size - 2].x()) : 0;
+  if (size > 0 && have_points_ &&
+      now_secs + dataset[size - 1].x() < newest_time_ - tolerance) {
+    // The series went back in time: start over.
+    pending_reset_ = true;
+    new_points_.clear();
+    have_points_ = false;
+  }
+  int first_new = size;
+  while (first_new > 0 &&
+         (!have_points_ ||
+          now_secs + dataset[first_new - 1].x() > newest_time_ + tolerance)) {
+    first_new--;
+  }
+  for (int i = first_new; i < size; i++) {
+    new_points_.emplace_back(now_secs + dataset[i].x(), dataset[i].y());
+  }
+  if (first_new < size) {
+    newest_time_ = now_secs + dataset[size - 1].x();
+    have_points_ = true;
+  }
+
+  emit DatasetChanged();
+  update();
+}
+
+void WaveformGraph::SetMinValue(float value) {
+  if (min_value_ != value) {
+    min_value_ = value;
+    emit MinValueChanged();
+    update();
+  }
+}
+
+void WaveformGraph::SetMaxValue(float value) {
+  if (max_value_ != value) {
+    max_value_ = value;
+    emit MaxValueChanged();
+    update();
+  }
+}
+
+void WaveformGraph::SetRangeInSeconds(float range_in_secs) {
+  if (range_in_secs_ != range_in_secs) {
+    range_in_secs_ = range_in_secs;
+    emit RangeInSecondsChanged();
+    update();
+  }
+}
+
+void WaveformGraph::SetLineColor(QColor color) {
+  if (line_color_ != color) {
+    line_color_ = color;
+    pending_style_ = true;
+    emit LineColorChanged();
+    update();
+  }
+}
+
+void WaveformGraph::SetAreaColor(QColor color) {
+  if (area_color_ != color) {
+    area_color_ = color;
+    pending_style_ = true;
+    emit AreaColorChanged();
+    update();
+  }
+}
+
+void WaveformGraph::SetShowBaseline(bool value) {
+  if (show_baseline_ != value) {
+    show_baseline_ = value;
+    emit ShowBaselineChanged();
+    update();
+  }
+}
+
+void WaveformGraph::SetBaselineValue(float baseline) {
+  if (baseline_value_ != baseline) {
+    baseline_value_ = baseline;
+    emit BaselineValueChanged();
+    update();
+  }
+}
+
+void WaveformGraph::geometryChanged(const QRectF &new_geometry,
+                                    const QRectF &old_geometry) {
+  QQuickItem::geometryChanged(new_geometry, old_geometry);
+  update();
+}
+
+QSGNode *WaveformGraph::updatePaintNode(QSGNode *old_node,
+                                        UpdatePaintNodeData *) {
+  FrameProfiler::Scope profile(FrameProfiler::Phase::GRAPH_PAINT);
+  auto *node = static_cast<WaveformNode *>(old_node);
+  if (node == nullptr) {
+    // First frame, or the scene graph was thrown away: draw all we have.
+    node = new WaveformNode();
+    pending_reset_ = false;
+    pending_shift_ = 0;
+    pending_style_ = true;
+    new_points_.clear();
+    for (const QPointF &point : dataset_) {
+      new_points_.emplace_back(view_time_ + point.x(), point.y());
+    }
+  }
+
+  if (pending_reset_) {
+    node->Reset();
+    pending_reset_ = false;
+  }
+  if (pending_shift_ != 0) {
+    node->Shift(pending_shift_);
+    pending_shift_ = 0;
+  }
+  for (const QPointF &point : new_points_) {
+    node->AddPoint(point, range_in_secs_);
+  }
+  new_points_.clear();
+  if (pending_style_) {
+    node->SetColors(line_color_, area_color_);
+    pending_style_ = false;
+  }
+  node->SetBaseline(show_baseline_, baseline_value_, view_time_,
+                    range_in_secs_);
+  node->SetView(view_time_, range_in_secs_, min_value_, max_value_, width(),
+                height());
+  return node;
+}
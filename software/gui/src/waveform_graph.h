@@ -0,0 +1,114 @@
+#ifndef WAVEFORM_GRAPH_H_
+#define WAVEFORM_GRAPH_H_
+
+#include "chrono.h"
+#include <QColor>
+#include <QPointF>
+#include <QQuickItem>
+#include <QVector>
+#include <vector>
+
+/**
+ * @brief The WaveformGraph is a QQuickItem that displays a scrolling time
+ * series straight from the scene graph, as a cheaper alternative to
+ * TimeSeriesGraph.
+ *
+ * It has the same properties as TimeSeriesGraph, so QML can use either.
+ *
+ * TimeSeriesGraph redraws the whole series through NanoVG on every frame.
+ * WaveformGraph instead keeps the points it has seen in vertex buffers,
+ * in seconds and in the units of the data, and only writes the points that
+ * are new since the last frame. Scrolling and scaling the series to the
+ * item is a transform applied to all of them at once. So the work per frame
+ * doesn't depend on how many points are visible.
+ *
+ * The points in `dataset` are timed in seconds before it was set, as
+ * GuiStateContainer does. Points newer than the ones already drawn are added
+ * to the graph; a dataset that ends before what's drawn starts it over.
+ */
+class WaveformGraph : public QQuickItem {
+  Q_OBJECT
+
+  Q_PROPERTY(QVector<QPointF> dataset READ GetDataset WRITE SetDataset NOTIFY
+                 DatasetChanged)
+  Q_PROPERTY(
+      float minValue READ GetMinValue WRITE SetMinValue NOTIFY MinValueChanged)
+  Q_PROPERTY(
+      float maxValue READ GetMaxValue WRITE SetMaxValue NOTIFY MaxValueChanged)
+  Q_PROPERTY(float rangeInSeconds READ GetRangeInSeconds WRITE SetRangeInSeconds
+                 NOTIFY RangeInSecondsChanged)
+  Q_PROPERTY(QColor lineColor READ GetLineColor WRITE SetLineColor NOTIFY
+                 LineColorChanged)
+  Q_PROPERTY(QColor areaColor READ GetAreaColor WRITE SetAreaColor NOTIFY
+                 AreaColorChanged)
+  Q_PROPERTY(bool showBaseline READ GetShowBaseline WRITE SetShowBaseline NOTIFY
+                 ShowBaselineChanged)
+  Q_PROPERTY(float baselineValue READ GetBaselineValue WRITE SetBaselineValue
+                 NOTIFY BaselineValueChanged)
+
+public:
+  explicit WaveformGraph(QQuickItem *parent = nullptr);
+
+  QVector<QPointF> GetDataset() const { return dataset_; }
+  float GetMinValue() const { return min_value_; }
+  float GetMaxValue() const { return max_value_; }
+  float GetRangeInSeconds() const { return range_in_secs_; }
+  QColor GetLineColor() const { return line_color_; }
+  QColor GetAreaColor() const { return area_color_; }
+  bool GetShowBaseline() const { return show_baseline_; }
+  float GetBaselineValue() const { return baseline_value_; }
+
+public slots:
+  void SetDataset(QVector<QPointF> &dataset);
+  void SetMinValue(float value);
+  void SetMaxValue(float value);
+  void SetRangeInSeconds(float range_in_secs);
+  void SetLineColor(QColor color);
+  void SetAreaColor(QColor color);
+  void SetShowBaseline(bool value);
+  void SetBaselineValue(float baseline);
+
+signals:
+  void DatasetChanged();
+  void MinValueChanged();
+  void MaxValueChanged();
+  void LineColorChanged();
+  void AreaColorChanged();
+  void RangeInSecondsChanged();
+  void ShowBaselineChanged();
+  void BaselineValueChanged();
+
+protected:
+  QSGNode *updatePaintNode(QSGNode *old_node, UpdatePaintNodeData *) override;
+  void geometryChanged(const QRectF &new_geometry,
+                       const QRectF &old_geometry) override;
+
+private:
+  float SecondsSince(SteadyInstant base, SteadyInstant t) const;
+
+  QVector<QPointF> dataset_;
+  float max_value_ = 0;
+  float min_value_ = 0;
+  float range_in_secs_ = 30.0;
+  QColor line_color_ = QColor(255, 255, 255, 255);
+  QColor area_color_ = QColor(255, 255, 255, 255);
+  bool show_baseline_ = true;
+  float baseline_value_ = 0;
+
+  // Times in the vertex buffers are in seconds since time_base_, which moves
+  // forward now and then so that they keep their precision as floats.
+  SteadyInstant time_base_;
+  // What the next frame shows: the newest time, in seconds since
+  // time_base_, and the points that came in since the last frame.
+  float view_time_ = 0;
+  float newest_time_ = 0;
+  bool have_points_ = false;
+  std::vector<QPointF> new_points_;
+  // Whether the next frame should start over, or move the points already
+  // drawn back by pending_shift_ seconds (as time_base_ moved).
+  bool pending_reset_ = false;
+  float pending_shift_ = 0;
+  bool pending_style_ = true;
+};
+
+#endif // WAVEFORM_GRAPH_H_
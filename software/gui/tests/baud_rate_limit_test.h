@@ -0,0 +1,58 @@
+#ifndef BAUD_RATE_LIMIT_TEST_H_
+#define BAUD_RATE_LIMIT_TEST_H_
+
+#include "baud_rate_limit.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+class BaudRateLimitTest : public QObject {
+  Q_OBJECT
+public:
+  BaudRateLimitTest() = default;
+  ~BaudRateLimitTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testOffersMaxRateUntilOneFails() {
+    BaudRateLimit limit(1000000, DurationMs(30000));
+    QCOMPARE(limit.Get(ms(0)), 1000000);
+    limit.Lower(ms(100), 1000000);
+    QCOMPARE(limit.Get(ms(100)), 999999);
+  }
+
+  void testRecoversAfterRetryInterval() {
+    BaudRateLimit limit(1000000, DurationMs(30000));
+    limit.Lower(ms(1000), 1000000);
+    QCOMPARE(limit.Get(ms(30999)), 999999);
+    QCOMPARE(limit.Get(ms(31000)), 1000000);
+  }
+
+  void testFailuresWhileLoweredKeepTheLowestRate() {
+    BaudRateLimit limit(1000000, DurationMs(30000));
+    limit.Lower(ms(0), 1000000);
+    limit.Lower(ms(10000), 460800);
+    // A slower rate failing doesn't make us try the faster one sooner...
+    limit.Lower(ms(20000), 921600);
+    QCOMPARE(limit.Get(ms(20000)), 460799);
+    // ...but the wait starts over from the latest failure.
+    QCOMPARE(limit.Get(ms(49999)), 460799);
+    QCOMPARE(limit.Get(ms(50000)), 1000000);
+  }
+
+  void testFailureAfterRecoveryStartsFromMaxRate() {
+    BaudRateLimit limit(1000000, DurationMs(30000));
+    limit.Lower(ms(0), 460800);
+    limit.Lower(ms(40000), 1000000);
+    QCOMPARE(limit.Get(ms(40000)), 999999);
+  }
+
+private:
+  SteadyInstant ms(int millis) const { return base_ + DurationMs(millis); }
+
+  SteadyInstant base_ = SteadyClock::now();
+};
+
+#endif // BAUD_RATE_LIMIT_TEST_H_
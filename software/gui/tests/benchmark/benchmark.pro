@@ -0,0 +1,31 @@
+include( ../../defaults.pri )
+! include( ../../common.pri ) {
+    error( "Couldn't find the common.pri file!" )
+}
+
+! include( ../../src/third_party/qnanopainter/libqnanopainter/include.pri ) {
+    error( "Couldn't find the libqnanopainter file!" )
+}
+
+QT += core quick serialport multimedia
+
+TEMPLATE = app
+TARGET = gui_benchmark
+CONFIG += console
+CONFIG -= app_bundle
+
+SOURCES += gui_benchmark.cpp
+
+LIBS += -L../../src -leverything
+
+# The same resources as the app, under the same paths, so that main.qml loads
+# as it does there.
+APP_DIR = $$SRC_DIR/app
+app_resources.files = \
+    $$files($$APP_DIR/images/*, true) \
+    $$files($$APP_DIR/sounds/*, true) \
+    $$files($$APP_DIR/controls/*, true) \
+    $$files($$APP_DIR/fonts/*, true) \
+    $$files($$APP_DIR/modes/*, true)
+app_resources.base = $$APP_DIR
+RESOURCES += $$APP_DIR/qml.qrc app_resources
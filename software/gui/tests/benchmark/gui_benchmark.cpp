@@ -0,0 +1,290 @@
+// Headless benchmark of the GUI's per-frame cost.
+//
+// Loads main.qml on the offscreen QPA platform, feeds GuiStateContainer with
+// synthetic ControllerStatuses at 100 Hz through a FakeConnectedDevice, as
+// main.cpp does with the recorded sample data, and renders a fixed number of
+// frames back to back. Then prints, as JSON, how long each frame took and how
+// that time was spent (see FrameProfiler), so that runs on a Linux box can be
+// compared before anything goes to the Pi.
+//
+//   QT_QPA_PLATFORM=offscreen ./gui_benchmark --frames 600 --output out.json
+//
+// Rendering still goes through OpenGL, so the machine needs a GL driver (Mesa's
+// llvmpipe will do), but no display.
+
+#include "chrono.h"
+#include "connected_device.h"
+#include "frame_profiler.h"
+#include "gui_state_container.h"
+#include "latching_alarm.h"
+#include "loop_graph.h"
+#include "periodic_closure.h"
+#include "time_series_graph.h"
+#include "waveform_graph.h"
+
+#include <QCommandLineParser>
+#include <QFile>
+#include <QGuiApplication>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QQmlApplicationEngine>
+#include <QQuickWindow>
+#include <QTimer>
+#include <algorithm>
+#include <cmath>
+#include <ctime>
+#include <iostream>
+#include <vector>
+
+namespace {
+
+// Same as main.cpp.
+QObject *gui_state_instance(QQmlEngine *engine, QJSEngine *scriptEngine) {
+  static GuiStateContainer state_container(
+      /*history_window=*/DurationMs(30000),
+      /*granularity=*/DurationMs(50));
+  Q_UNUSED(scriptEngine);
+  if (engine != nullptr) {
+    engine->setObjectOwnership(&state_container, QQmlEngine::CppOwnership);
+  }
+  return &state_container;
+}
+
+// The rate at which the controller sends its status in this benchmark. This
+// is faster than it does today, to leave room for it to speed up.
+constexpr DurationMs STATUS_INTERVAL = DurationMs(10);
+
+// A breath every 4 seconds: pressure and volume go up during the first
+// second, and back down after.
+ControllerStatus SyntheticStatus(DurationMs elapsed) {
+  constexpr int BREATH_MS = 4000;
+  constexpr int INSPIRATION_MS = 1000;
+  int breath = elapsed.count() / BREATH_MS;
+  float t = (elapsed.count() % BREATH_MS) / 1000.0f;
+  bool inspiring = elapsed.count() % BREATH_MS < INSPIRATION_MS;
+
+  ControllerStatus status = ControllerStatus_init_zero;
+  status.uptime_ms = elapsed.count();
+  status.sensor_readings.breath_id = breath;
+  status.sensor_readings.patient_pressure_cm_h2o =
+      inspiring ? 5 + 10 * (1 - std::exp(-10 * t)) : 5 + 10 * std::exp(-5 * t);
+  status.sensor_readings.flow_ml_per_min =
+      inspiring ? 30000 * std::exp(-5 * t) : -30000 * std::exp(-3 * (t - 1));
+  status.sensor_readings.volume_ml =
+      inspiring ? 500 * (1 - std::exp(-5 * t)) : 500 * std::exp(-3 * (t - 1));
+  status.sensor_readings.fio2 = 0.21f;
+  return status;
+}
+
+// Mean, median, 95th percentile and max of `values`, in microseconds.
+QJsonObject Stats(std::vector<double> values) {
+  QJsonObject stats;
+  if (values.empty()) {
+    return stats;
+  }
+  std::sort(values.begin(), values.end());
+  double sum = 0;
+  for (double v : values) {
+    sum += v;
+  }
+  auto percentile = [&](double p) {
+    return values[std::min(values.size() - 1,
+                           static_cast<size_t>(p * values.size()))];
+  };
+  stats["mean_us"] = sum / values.size();
+  stats["p50_us"] = percentile(0.5);
+  stats["p95_us"] = percentile(0.95);
+  stats["max_us"] = values.back();
+  return stats;
+}
+
+double Micros(std::chrono::nanoseconds time) { return time.count() * 1e-3; }
+
+} // namespace
+
+int main(int argc, char *argv[]) {
+  // No display needed, unless asked for another platform.
+  if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+    qputenv("QT_QPA_PLATFORM", "offscreen");
+  }
+  // Sync and render on the GUI thread, so that frames don't overlap and each
+  // phase is counted toward the frame it belongs to.
+  if (qEnvironmentVariableIsEmpty("QSG_RENDER_LOOP")) {
+    qputenv("QSG_RENDER_LOOP", "basic");
+  }
+
+  QGuiApplication app(argc, argv);
+
+  QCommandLineParser parser;
+  parser.setApplicationDescription("Headless GUI frame cost benchmark");
+  parser.addHelpOption();
+  QCommandLineOption framesOption("frames", "Frames to measure.", "count",
+                                  "600");
+  QCommandLineOption warmupOption(
+      "warmup", "Frames to render before measuring, e.g. to fill the graphs.",
+      "count", "120");
+  QCommandLineOption outputOption(
+      "output", "Where to write the JSON results, instead of stdout.", "file");
+  parser.addOption(framesOption);
+  parser.addOption(warmupOption);
+  parser.addOption(outputOption);
+  parser.process(app);
+  const int frames = parser.value(framesOption).toInt();
+  const int warmup = parser.value(warmupOption).toInt();
+  if (frames <= 0 || warmup < 0) {
+    std::cerr << "--frames must be positive, and --warmup not negative\n";
+    return EXIT_FAILURE;
+  }
+
+  GuiStateContainer *state_container =
+      static_cast<GuiStateContainer *>(gui_state_instance(nullptr, nullptr));
+  state_container->set_is_using_fake_data(true);
+
+  SteadyInstant base = SteadyClock::now();
+  FakeConnectedDevice device(
+      [](const GuiStatus &) {},
+      [base](ControllerStatus *controller_status) {
+        *controller_status =
+            SyntheticStatus(TimeAMinusB(SteadyClock::now(), base));
+      });
+  PeriodicClosure communicate(STATUS_INTERVAL, [&] {
+    auto now = SteadyClock::now();
+    ControllerStatus controller_status;
+    if (device.ReceiveControllerStatus(&controller_status)) {
+      QMetaObject::invokeMethod(state_container, [=]() {
+        state_container->controller_status_changed(now, controller_status);
+      });
+    }
+  });
+
+  qmlRegisterType<TimeSeriesGraph>("Respira", 1, 0, "TimeSeriesGraph");
+  qmlRegisterType<WaveformGraph>("Respira", 1, 0, "WaveformGraph");
+  qmlRegisterType<LoopGraph>("Respira", 1, 0, "LoopGraph");
+  qmlRegisterUncreatableType<AlarmPriority>("Respira", 1, 0, "AlarmPriority",
+                                            "is an enum");
+  qmlRegisterUncreatableType<AlarmManager>(
+      "Respira", 1, 0, "AlarmManager",
+      "AlarmManager cannot be instantiated from QML");
+  qmlRegisterUncreatableType<LatchingAlarm>(
+      "Respira", 1, 0, "LatchingAlarm",
+      "LatchingAlarm cannot be instantiated from QML");
+  qmlRegisterSingletonType<GuiStateContainer>(
+      "Respira", 1, 0, "GuiStateContainer", &gui_state_instance);
+
+  QQmlApplicationEngine engine;
+  engine.load(QUrl(QStringLiteral("qrc:/main.qml")));
+  if (engine.rootObjects().isEmpty()) {
+    std::cerr << "Could not load main.qml\n";
+    return EXIT_FAILURE;
+  }
+  auto *window = qobject_cast<QQuickWindow *>(engine.rootObjects().first());
+  if (window == nullptr) {
+    std::cerr << "main.qml is not a window\n";
+    return EXIT_FAILURE;
+  }
+
+  FrameProfiler profiler;
+  FrameProfiler::Install(&profiler);
+
+  // The scene graph phases, timed from the window's signals. These come from
+  // the render thread if there is one, hence the direct connections.
+  SteadyInstant sync_start, render_start;
+  QObject::connect(
+      window, &QQuickWindow::beforeSynchronizing, window,
+      [&] { sync_start = SteadyClock::now(); }, Qt::DirectConnection);
+  QObject::connect(
+      window, &QQuickWindow::afterSynchronizing, window,
+      [&] {
+        profiler.Add(FrameProfiler::Phase::SCENE_GRAPH_SYNC,
+                     SteadyClock::now() - sync_start);
+      },
+      Qt::DirectConnection);
+  QObject::connect(
+      window, &QQuickWindow::beforeRendering, window,
+      [&] { render_start = SteadyClock::now(); }, Qt::DirectConnection);
+  QObject::connect(
+      window, &QQuickWindow::afterRendering, window,
+      [&] {
+        profiler.Add(FrameProfiler::Phase::RENDER,
+                     SteadyClock::now() - render_start);
+      },
+      Qt::DirectConnection);
+
+  // Per measured frame: wall time since the previous frame, and the time
+  // spent in each phase since then.
+  std::vector<double> frame_times;
+  std::vector<std::vector<double>> phase_times(FrameProfiler::NUM_PHASES);
+  frame_times.reserve(frames);
+  for (auto &times : phase_times) {
+    times.reserve(frames);
+  }
+  int frame = 0;
+  SteadyInstant last_frame;
+  std::clock_t cpu_start = 0;
+  SteadyInstant wall_start;
+
+  QObject::connect(window, &QQuickWindow::frameSwapped, &app, [&] {
+    SteadyInstant now = SteadyClock::now();
+    FrameProfiler::Totals totals = profiler.TakeTotals();
+    if (frame == warmup) {
+      cpu_start = std::clock();
+      wall_start = now;
+    } else if (frame > warmup) {
+      frame_times.push_back(Micros(now - last_frame));
+      for (int i = 0; i < FrameProfiler::NUM_PHASES; i++) {
+        phase_times[i].push_back(Micros(totals[i]));
+      }
+    }
+    last_frame = now;
+    if (++frame > warmup + frames) {
+      app.quit();
+    } else {
+      // Render continuously, like a display would at its refresh rate.
+      window->update();
+    }
+  });
+
+  // Don't hang if frames stop coming, e.g. if the platform can't render.
+  QTimer::singleShot(std::chrono::minutes(5), &app, [&] {
+    std::cerr << "Timed out after " << frame << " frames\n";
+    app.exit(EXIT_FAILURE);
+  });
+
+  communicate.Start();
+  int status = app.exec();
+  communicate.Stop();
+  FrameProfiler::Install(nullptr);
+  if (status != 0) {
+    return status;
+  }
+
+  double cpu_ms = 1000.0 * (std::clock() - cpu_start) / CLOCKS_PER_SEC;
+  double wall_ms = Micros(last_frame - wall_start) * 1e-3;
+
+  QJsonObject phases;
+  for (int i = 0; i < FrameProfiler::NUM_PHASES; i++) {
+    phases[FrameProfiler::PhaseName(static_cast<FrameProfiler::Phase>(i))] =
+        Stats(phase_times[i]);
+  }
+  QJsonObject results;
+  results["frames"] = frames;
+  results["status_interval_ms"] = static_cast<int>(STATUS_INTERVAL.count());
+  results["platform"] = QGuiApplication::platformName();
+  results["fps"] = frames * 1000.0 / wall_ms;
+  // CPU time of the whole process, all threads included.
+  results["cpu_ms_per_frame"] = cpu_ms / frames;
+  results["frame"] = Stats(frame_times);
+  results["phases"] = phases;
+  QByteArray json = QJsonDocument(results).toJson();
+
+  if (parser.isSet(outputOption)) {
+    QFile file(parser.value(outputOption));
+    if (!file.open(QIODevice::WriteOnly) || file.write(json) != json.size()) {
+      std::cerr << "Could not write " << file.fileName().toStdString() << "\n";
+      return EXIT_FAILURE;
+    }
+  } else {
+    std::cout << json.toStdString();
+  }
+  return EXIT_SUCCESS;
+}
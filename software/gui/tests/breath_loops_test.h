@@ -0,0 +1,66 @@
+#ifndef BREATH_LOOPS_TEST_H_
+#define BREATH_LOOPS_TEST_H_
+
+#include "breath_loops.h"
+#include "network_protocol.pb.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+class BreathLoopsTest : public QObject {
+  Q_OBJECT
+public:
+  BreathLoopsTest() = default;
+  ~BreathLoopsTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testSplitsBreaths() {
+    BreathLoops loops;
+    loops.Update(Status(1, 5, 0));
+    loops.Update(Status(1, 15, 300));
+    loops.Update(Status(1, 10, 500));
+    QCOMPARE(loops.current().size(), 3ul);
+    QCOMPARE(loops.current()[1].pressure_cm_h2o, 15.0f);
+    QCOMPARE(loops.current()[1].volume_ml, 300.0f);
+    QVERIFY(qAbs(loops.current()[1].flow_l_per_min - 30.0f) < 1e-4f);
+    QVERIFY(loops.previous().empty());
+    uint64_t completed = loops.completed_breaths();
+
+    loops.Update(Status(2, 6, 10));
+    QCOMPARE(loops.completed_breaths(), completed + 1);
+    QCOMPARE(loops.previous().size(), 3ul);
+    QCOMPARE(loops.previous()[2].volume_ml, 500.0f);
+    QCOMPARE(loops.current().size(), 1ul);
+    QCOMPARE(loops.current()[0].pressure_cm_h2o, 6.0f);
+  }
+
+  void testLongBreathStartsOver() {
+    BreathLoops loops;
+    for (size_t i = 0; i < BreathLoops::MaxPoints; ++i) {
+      loops.Update(Status(1, 5, i));
+    }
+    uint64_t generation = loops.current_generation();
+    QCOMPARE(loops.current().size(), BreathLoops::MaxPoints);
+    loops.Update(Status(1, 5, 0));
+    QCOMPARE(loops.current().size(), 1ul);
+    QCOMPARE(loops.current_generation(), generation + 1);
+  }
+
+private:
+  // Status with the given breath, pressure, and volume, and flow at 100
+  // times the volume (in ml/min).
+  static ControllerStatus Status(uint64_t breath_id, float pressure,
+                                 float volume) {
+    ControllerStatus s = ControllerStatus_init_zero;
+    s.sensor_readings.breath_id = breath_id;
+    s.sensor_readings.patient_pressure_cm_h2o = pressure;
+    s.sensor_readings.volume_ml = volume;
+    s.sensor_readings.flow_ml_per_min = 100 * volume;
+    return s;
+  }
+};
+
+#endif // BREATH_LOOPS_TEST_H_
@@ -20,7 +20,7 @@ private slots:
   void testPipAndPeep() {
     SteadyInstant now = SteadyClock::now();
     auto pressure = [](uint64_t breath_id, float p) -> ControllerStatus {
-      ControllerStatus res;
+      ControllerStatus res = ControllerStatus_init_zero;
       res.sensor_readings.breath_id = breath_id;
       res.sensor_readings.patient_pressure_cm_h2o = p;
       return res;
@@ -92,6 +92,56 @@ private slots:
     b.Update(ms(10000), breath(7));
     QCOMPARE(30, b.rr().value_or(0.0));
   }
+
+  void testBreathSummaries() {
+    auto summary = [](uint64_t breath_id, float pip,
+                      uint32_t duration_ms) -> BreathSummary {
+      BreathSummary res = BreathSummary_init_zero;
+      res.breath_id = breath_id;
+      res.pip_cm_h2o = pip;
+      res.peep_cm_h2o = 5;
+      res.inspiratory_time_ms = duration_ms / 2;
+      res.expiratory_time_ms = duration_ms / 2;
+      return res;
+    };
+    SteadyInstant now = SteadyClock::now();
+    ControllerStatus status = ControllerStatus_init_zero;
+
+    BreathSignals b;
+    b.Update(now, status);
+    QVERIFY(!b.last_summary().has_value());
+    QVERIFY(!b.pip().has_value());
+
+    status.breath_summaries_count = 1;
+    status.breath_summaries[0] = summary(10, 20, 3000);
+    b.Update(now, status);
+    QCOMPARE(b.pip().value_or(0), 20.0);
+    QCOMPARE(b.peep().value_or(0), 5.0);
+    // One breath isn't enough to have an RR signal.
+    QVERIFY(!b.rr().has_value());
+
+    // Summaries are resent in every status; each only counts once.
+    b.Update(now, status);
+    status.breath_summaries_count = 2;
+    status.breath_summaries[1] = summary(20, 22, 2000);
+    b.Update(now, status);
+    b.Update(now, status);
+    QCOMPARE(b.last_summary()->breath_id, 20ul);
+    QCOMPARE(b.pip().value_or(0), 22.0);
+    // 2 breaths in 5 seconds => RR = 24
+    QCOMPARE(24.0, b.rr().value_or(0.0));
+
+    // A status that didn't make it to us doesn't lose a breath: its summary
+    // is still in the next one.
+    status.breath_summaries_count = 3;
+    status.breath_summaries[0] = summary(20, 22, 2000);
+    status.breath_summaries[1] = summary(30, 24, 1000);
+    status.breath_summaries[2] = summary(40, 26, 2000);
+    b.Update(now, status);
+    QCOMPARE(b.last_summary()->breath_id, 40ul);
+    // 4 breaths in 8 seconds => RR = 30
+    QCOMPARE(30.0, b.rr().value_or(0.0));
+  }
 };
 
 #endif // BREATH_SIGNALS_TEST_H_
@@ -0,0 +1,82 @@
+#ifndef GUI_STATE_CONTAINER_TEST_H_
+#define GUI_STATE_CONTAINER_TEST_H_
+
+#include "gui_state_container.h"
+
+#include <QCoreApplication>
+#include <QSignalSpy>
+#include <QtTest>
+
+class GuiStateContainerTest : public QObject {
+  Q_OBJECT
+public:
+  GuiStateContainerTest() = default;
+  ~GuiStateContainerTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testPublishesChangesOnce() {
+    GuiStateContainer container(/*history_window=*/DurationMs(30000),
+                                /*granularity=*/DurationMs(0));
+    QSignalSpy pressure(&container,
+                        &GuiStateContainer::measured_pressure_changed);
+    QSignalSpy tv(&container, &GuiStateContainer::measured_tv_changed);
+    QSignalSpy pressure_series(&container,
+                               &GuiStateContainer::PressureSeriesChanged);
+    QSignalSpy loops(&container, &GuiStateContainer::LoopsChanged);
+
+    SteadyInstant now = SteadyClock::now();
+    for (int i = 0; i < 5; i++) {
+      container.controller_status_changed(now + DurationMs(10 * i),
+                                          Status(5 + i, 300));
+    }
+    // Nothing until the next publish.
+    QCOMPARE(pressure.count(), 0);
+    QCOMPARE(pressure_series.count(), 0);
+    QCOMPARE(loops.count(), 0);
+
+    container.Publish();
+    QCOMPARE(pressure.count(), 1);
+    QCOMPARE(tv.count(), 1);
+    QCOMPARE(pressure_series.count(), 1);
+    QCOMPARE(loops.count(), 1);
+
+    // Only what changed since then.
+    container.controller_status_changed(now + DurationMs(50), Status(12, 300));
+    container.Publish();
+    QCOMPARE(pressure.count(), 2);
+    QCOMPARE(tv.count(), 1);
+
+    // Nothing new, nothing published.
+    container.Publish();
+    QCOMPARE(pressure.count(), 2);
+    QCOMPARE(pressure_series.count(), 2);
+    QCOMPARE(loops.count(), 2);
+  }
+
+  void testPublishesOnTimer() {
+    GuiStateContainer container(/*history_window=*/DurationMs(30000),
+                                /*granularity=*/DurationMs(0),
+                                /*publish_interval=*/DurationMs(10));
+    QSignalSpy pressure(&container,
+                        &GuiStateContainer::measured_pressure_changed);
+    container.controller_status_changed(SteadyClock::now(), Status(7, 300));
+    container.controller_status_changed(SteadyClock::now(), Status(8, 300));
+    QCOMPARE(pressure.count(), 0);
+    QVERIFY(pressure.wait(1000));
+    QCOMPARE(pressure.count(), 1);
+    QCOMPARE(container.property("measured_pressure").toReal(), 8.0);
+  }
+
+private:
+  static ControllerStatus Status(float pressure, float volume) {
+    ControllerStatus status = ControllerStatus_init_zero;
+    status.sensor_readings.patient_pressure_cm_h2o = pressure;
+    status.sensor_readings.volume_ml = volume;
+    return status;
+  }
+};
+
+#endif // GUI_STATE_CONTAINER_TEST_H_
@@ -148,7 +148,7 @@ private:
     return base_ + DurationMs(1000 * seconds);
   }
   ControllerStatus pressure(float p) const {
-    ControllerStatus res;
+    ControllerStatus res = ControllerStatus_init_zero;
     res.sensor_readings.patient_pressure_cm_h2o = p;
     return res;
   }
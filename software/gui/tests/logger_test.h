@@ -35,4 +35,28 @@ private slots:
   void testWriteDebug() { DBG("Debug test message"); }
 
   void testWriteTrace() { TRC("Trace test message"); }
+
+  void testLimiter() {
+    CustomLogger::LogLimiter limiter(std::chrono::hours(1));
+    size_t suppressed_before = CustomLogger::suppressedMessages();
+    size_t suppressed = 1;
+    QVERIFY(limiter.Allow(&suppressed));
+    QCOMPARE(suppressed, 0ul);
+    QVERIFY(!limiter.Allow(&suppressed));
+    QVERIFY(!limiter.Allow(&suppressed));
+    QCOMPARE(CustomLogger::suppressedMessages(), suppressed_before + 2);
+
+    CustomLogger::LogLimiter unlimited(std::chrono::milliseconds(0));
+    for (int i = 0; i < 3; i++) {
+      QVERIFY(unlimited.Allow(&suppressed));
+      QCOMPARE(suppressed, 0ul);
+    }
+  }
+
+  void testWriteLimited() {
+    CustomLogger::LogLimiter limiter(std::chrono::hours(1));
+    for (int i = 0; i < 10; i++) {
+      WARN_LIMITED(limiter, "Limited test message {}", i);
+    }
+  }
 };
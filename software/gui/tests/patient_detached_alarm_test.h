@@ -62,7 +62,7 @@ private:
     return base_ + DurationMs(1000 * seconds);
   }
   ControllerStatus flow_correction(float ml_per_sec) const {
-    ControllerStatus res;
+    ControllerStatus res = ControllerStatus_init_zero;
     res.sensor_readings.flow_correction_ml_per_min = ml_per_sec * 60;
     return res;
   }
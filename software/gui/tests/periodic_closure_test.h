@@ -0,0 +1,116 @@
+#ifndef PERIODIC_CLOSURE_TEST_H_
+#define PERIODIC_CLOSURE_TEST_H_
+
+#include "periodic_closure.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+#include <atomic>
+#include <thread>
+
+class PeriodicClosureTest : public QObject {
+  Q_OBJECT
+public:
+  PeriodicClosureTest() = default;
+  ~PeriodicClosureTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testStopWithoutStart() {
+    PeriodicClosure closure(DurationMs(10), [] {});
+    closure.Stop();
+    QCOMPARE(closure.GetStats().runs, uint64_t{0});
+  }
+
+  void testRunsAtFixedRate() {
+    // Each run takes most of the interval. Scheduling the next run after
+    // the previous one ends would run it about 6 times in 300ms.
+    std::atomic<int> runs{0};
+    PeriodicClosure closure(DurationMs(30), [&] {
+      std::this_thread::sleep_for(DurationMs(20));
+      runs++;
+    });
+    closure.Start();
+    std::this_thread::sleep_for(DurationMs(305));
+    closure.Stop();
+    QVERIFY(runs >= 9);
+    QVERIFY(runs <= 11);
+    PeriodicClosure::Stats stats = closure.GetStats();
+    QCOMPARE(stats.runs, static_cast<uint64_t>(runs));
+    QCOMPARE(stats.overruns, uint64_t{0});
+    QCOMPARE(stats.skipped, uint64_t{0});
+  }
+
+  void testSkipsAfterOverrun() {
+    std::atomic<int> runs{0};
+    PeriodicClosure closure(DurationMs(20), [&] {
+      // The first run takes up the time of 3 runs.
+      if (runs++ == 0) {
+        std::this_thread::sleep_for(DurationMs(50));
+      }
+    });
+    closure.Start();
+    std::this_thread::sleep_for(DurationMs(110));
+    closure.Stop();
+    PeriodicClosure::Stats stats = closure.GetStats();
+    QCOMPARE(stats.overruns, uint64_t{1});
+    QCOMPARE(stats.skipped, uint64_t{2});
+    // At 0, 60, 80 and 100ms.
+    QCOMPARE(runs.load(), 4);
+    QCOMPARE(stats.duration.counts[6], uint64_t{1}); // [32ms, 64ms)
+  }
+
+  void testCatchesUpAfterOverrun() {
+    std::atomic<int> runs{0};
+    PeriodicClosure closure(
+        DurationMs(20),
+        [&] {
+          if (runs++ == 0) {
+            std::this_thread::sleep_for(DurationMs(50));
+          }
+        },
+        PeriodicClosure::OverrunPolicy::CATCH_UP);
+    closure.Start();
+    std::this_thread::sleep_for(DurationMs(110));
+    closure.Stop();
+    PeriodicClosure::Stats stats = closure.GetStats();
+    QCOMPARE(stats.overruns, uint64_t{1});
+    QCOMPARE(stats.skipped, uint64_t{0});
+    // At 0, 20 and 40ms, late, then 60, 80 and 100ms.
+    QCOMPARE(runs.load(), 6);
+  }
+
+  void testNoRunsAfterStop() {
+    std::atomic<int> runs{0};
+    PeriodicClosure closure(DurationMs(1), [&] { runs++; });
+    closure.Start();
+    std::this_thread::sleep_for(DurationMs(20));
+    closure.Stop();
+    int runs_at_stop = runs;
+    std::this_thread::sleep_for(DurationMs(20));
+    QCOMPARE(runs.load(), runs_at_stop);
+
+    // And it can start over.
+    closure.Start();
+    std::this_thread::sleep_for(DurationMs(20));
+    closure.Stop();
+    QVERIFY(runs > runs_at_stop);
+  }
+
+  void testHistogramBuckets() {
+    PeriodicClosure::Histogram histogram;
+    histogram.Add(std::chrono::microseconds(500));
+    histogram.Add(DurationMs(1));
+    histogram.Add(DurationMs(3));
+    histogram.Add(std::chrono::hours(1));
+    QCOMPARE(histogram.counts[0], uint64_t{1});
+    QCOMPARE(histogram.counts[1], uint64_t{1});
+    QCOMPARE(histogram.counts[2], uint64_t{1});
+    QCOMPARE(histogram.counts[PeriodicClosure::Histogram::NUM_BUCKETS - 1],
+             uint64_t{1});
+  }
+};
+
+#endif // PERIODIC_CLOSURE_TEST_H_
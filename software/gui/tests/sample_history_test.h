@@ -0,0 +1,93 @@
+#ifndef SAMPLE_HISTORY_TEST_H_
+#define SAMPLE_HISTORY_TEST_H_
+
+#include "network_protocol.pb.h"
+#include "sample_history.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+class SampleHistoryTest : public QObject {
+  Q_OBJECT
+public:
+  SampleHistoryTest() = default;
+  ~SampleHistoryTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testDecodesEverySample() {
+    SampleHistory h(DurationMs(10000));
+    h.Append(ms(30), Batch(0, {500, 700, 900}));
+    h.Append(ms(60), Batch(3, {1100, 1300, 1500}));
+
+    QCOMPARE(h.samples().size(), 6ul);
+    for (int i = 0; i < 6; ++i) {
+      const auto &s = h.samples()[i];
+      QCOMPARE(s.patient_pressure_cm_h2o, 5.0f + 2 * i);
+      QCOMPARE(s.flow_ml_per_min, 1000.0f);
+      QVERIFY(qAbs(s.fio2 - 0.21f) < 1e-6f);
+      // Evenly spaced, with the newest sample of the first batch pinned to
+      // when that batch arrived.
+      QCOMPARE(TimeAMinusB(s.time, ms(0)).count(), 10 * (i + 1));
+    }
+  }
+
+  void testSkipsSamplesAlreadySeen() {
+    SampleHistory h(DurationMs(10000));
+    h.Append(ms(20), Batch(10, {100, 200}));
+    // The same samples again, plus a new one.
+    h.Append(ms(30), Batch(10, {100, 200, 300}));
+    QCOMPARE(h.samples().size(), 3ul);
+    QCOMPARE(h.samples().back().patient_pressure_cm_h2o, 3.0f);
+  }
+
+  void testControllerRestart() {
+    SampleHistory h(DurationMs(10000));
+    h.Append(ms(1000), Batch(500, {100}));
+    h.Append(ms(2000), Batch(0, {200, 300}));
+    QCOMPARE(h.samples().size(), 3ul);
+    QCOMPARE(TimeAMinusB(h.samples().back().time, ms(2000)).count(), 0);
+  }
+
+  void testWindow() {
+    SampleHistory h(DurationMs(50));
+    for (uint32_t i = 0; i < 10; ++i) {
+      h.Append(ms(10 * i), Batch(i, {static_cast<int32_t>(i)}));
+    }
+    QCOMPARE(h.samples().size(), 6ul);
+  }
+
+private:
+  SteadyInstant ms(int millis) const { return base_ + DurationMs(millis); }
+
+  // Batch of 10ms samples with the given pressures (in 100ths of cmH2O), and
+  // constant flow and FiO2.
+  static SampleBatch Batch(uint32_t first_sample,
+                           std::vector<int32_t> pressures) {
+    SampleBatch b = SampleBatch_init_zero;
+    b.first_sample = first_sample;
+    b.sample_period_us = 10000;
+    int32_t prev = 0;
+    for (int32_t p : pressures) {
+      pb_size_t i = b.patient_pressure_cm_h2o_x100_count;
+      b.patient_pressure_cm_h2o_x100[i] = p - prev;
+      b.flow_ml_per_min[i] = i == 0 ? 1000 : 0;
+      b.volume_ml_x10[i] = 0;
+      b.pressure_setpoint_cm_h2o_x100[i] = 0;
+      b.fio2_x1000[i] = i == 0 ? 210 : 0;
+      prev = p;
+      b.patient_pressure_cm_h2o_x100_count++;
+      b.flow_ml_per_min_count++;
+      b.volume_ml_x10_count++;
+      b.pressure_setpoint_cm_h2o_x100_count++;
+      b.fio2_x1000_count++;
+    }
+    return b;
+  }
+
+  SteadyInstant base_ = SteadyClock::now();
+};
+
+#endif // SAMPLE_HISTORY_TEST_H_
@@ -13,8 +13,14 @@ QMAKE_LFLAGS += --coverage
 SOURCES += tst_main.cpp
 HEADERS += \
   logger_test.h \
+  baud_rate_limit_test.h \
+  breath_loops_test.h \
   breath_signals_test.h \
+  gui_state_container_test.h \
   latching_alarm_test.h \
-  patient_detached_alarm_test.h
+  patient_detached_alarm_test.h \
+  periodic_closure_test.h \
+  sample_history_test.h \
+  trend_history_test.h
 
 LIBS += -L../src -leverything
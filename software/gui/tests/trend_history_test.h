@@ -0,0 +1,100 @@
+#ifndef TREND_HISTORY_TEST_H_
+#define TREND_HISTORY_TEST_H_
+
+#include "trend_history.h"
+
+#include <QCoreApplication>
+#include <QtTest>
+
+class TrendHistoryTest : public QObject {
+  Q_OBJECT
+public:
+  TrendHistoryTest() = default;
+  ~TrendHistoryTest() = default;
+
+private slots:
+  void initTestCase() {}
+  void cleanupTestCase() {}
+
+  void testBuckets() {
+    TrendHistory h({{DurationMs(1000), DurationMs(60000)}});
+    // 10 values a second: 0..9, 10..19, 20..29.
+    for (int i = 0; i < 30; ++i) {
+      h.Add(ms(100 * i), i);
+    }
+    auto buckets = h.Query(ms(0), ms(3000), 100);
+    QCOMPARE(buckets.size(), 3ul);
+    for (int i = 0; i < 3; ++i) {
+      QCOMPARE(buckets[i].start, ms(1000 * i));
+      QCOMPARE(buckets[i].count, 10);
+      QCOMPARE(buckets[i].min, 10.0f * i);
+      QCOMPARE(buckets[i].max, 10.0f * i + 9);
+      QCOMPARE(buckets[i].mean(), 10.0f * i + 4.5f);
+    }
+
+    // Only the buckets that overlap the range.
+    buckets = h.Query(ms(1500), ms(1700), 100);
+    QCOMPARE(buckets.size(), 1ul);
+    QCOMPARE(buckets[0].start, ms(1000));
+  }
+
+  void testGapsHaveNoBuckets() {
+    TrendHistory h({{DurationMs(1000), DurationMs(60000)}});
+    h.Add(ms(500), 1);
+    h.Add(ms(5200), 2);
+    auto buckets = h.Query(ms(0), ms(10000), 100);
+    QCOMPARE(buckets.size(), 2ul);
+    QCOMPARE(buckets[0].start, ms(500));
+    // Still aligned to whole seconds since the first value.
+    QCOMPARE(buckets[1].start, ms(4500));
+  }
+
+  void testPicksLevelForWidth() {
+    TrendHistory h;
+    // A value a second for two hours.
+    constexpr int SECS = 2 * 3600;
+    for (int i = 0; i <= SECS; ++i) {
+      h.Add(ms(1000 * i), i);
+    }
+    SteadyInstant now = ms(1000 * SECS);
+    SteadyInstant hour_ago = now - std::chrono::hours(1);
+
+    // One bucket a second fits in 3600 pixels...
+    auto buckets = h.Query(hour_ago, now, 3600);
+    QCOMPARE(buckets.size(), 3601ul);
+    QCOMPARE(buckets.front().count, 1);
+    // ...but 100 pixels take a bucket a minute.
+    buckets = h.Query(hour_ago, now, 100);
+    QCOMPARE(buckets.size(), 61ul);
+    QCOMPARE(buckets[1].count, 60);
+    QCOMPARE(buckets[1].mean(), buckets[1].min + 29.5f);
+
+    // The 1 second buckets only go back an hour, so two hours take the
+    // 10 second ones, even with enough pixels for more.
+    buckets = h.Query(ms(0), now, 10000);
+    QCOMPARE(buckets.size(), 721ul);
+    QCOMPARE(buckets.front().start, ms(0));
+    QCOMPARE(buckets.front().count, 10);
+  }
+
+  void testBoundedMemory() {
+    TrendHistory h;
+    // Three days and a bit of statuses, one every 100ms.
+    for (int64_t i = 0; i < 80ll * 3600 * 10; ++i) {
+      h.Add(ms(100 * i), 0);
+    }
+    // 3600 + 4320 + 4320 buckets, plus the ones being filled.
+    QVERIFY(h.Size() <= 12240 + 2 * 3);
+    // The coarsest level still covers 72 hours.
+    SteadyInstant now = ms(80 * 3600 * 1000);
+    auto buckets = h.Query(now - std::chrono::hours(72), now, 72 * 60);
+    QVERIFY(buckets.size() >= 72 * 60);
+  }
+
+private:
+  SteadyInstant ms(int64_t millis) const { return base_ + DurationMs(millis); }
+
+  SteadyInstant base_ = SteadyClock::now();
+};
+
+#endif // TREND_HISTORY_TEST_H_
@@ -1,10 +1,16 @@
 #include <QCoreApplication>
 #include <QtTest>
 
+#include "baud_rate_limit_test.h"
+#include "breath_loops_test.h"
 #include "breath_signals_test.h"
+#include "gui_state_container_test.h"
 #include "latching_alarm_test.h"
 #include "logger_test.h"
 #include "patient_detached_alarm_test.h"
+#include "periodic_closure_test.h"
+#include "sample_history_test.h"
+#include "trend_history_test.h"
 
 int main(int argc, char *argv[]) {
   QGuiApplication app(argc, argv);
@@ -26,10 +32,40 @@ int main(int argc, char *argv[]) {
     status += QTest::qExec(&tc, argc, argv);
   }
 
+  {
+    BaudRateLimitTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    BreathLoopsTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    GuiStateContainerTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
   {
     PatientDetachedAlarmTest tc;
     status += QTest::qExec(&tc, argc, argv);
   }
 
+  {
+    PeriodicClosureTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    SampleHistoryTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
+  {
+    TrendHistoryTest tc;
+    status += QTest::qExec(&tc, argc, argv);
+  }
+
   return status;
 }
@@ -21,6 +21,7 @@ __license__ = """
 """
 
 import serial
+import struct
 import threading
 import time
 import debug_types
@@ -42,6 +43,8 @@ OP_PBREAD = 0x03
 OP_VAR = 0x04
 OP_TRACE = 0x05
 OP_EEPROM = 0x06
+OP_CRASH_DUMP = 0x07
+OP_EVENT_LOG = 0x08
 
 # Some commands take a sub-command as their first byte of data
 SUBCMD_VAR_INFO = 0x00
@@ -62,6 +65,54 @@ SUBCMD_TRACE_GET_NUM_SAMPLES = 0x08
 SUBCMD_EEPROM_READ = 0x00
 SUBCMD_EEPROM_WRITE = 0x01
 
+SUBCMD_CRASH_DUMP_GET_SIZE = 0x00
+SUBCMD_CRASH_DUMP_READ = 0x01
+SUBCMD_CRASH_DUMP_ERASE = 0x02
+
+# Layout of the header of a crash dump (CrashDump::Header in the controller's
+# crash_dump.h, which embeds CrashInfo and LoopTiming from the HAL).  Keep this
+# in sync with those structures.
+CRASH_DUMP_HEADER = struct.Struct(
+    "<II"  # magic, size
+    "I8II4II"  # reason, registers, stack pointer, fault registers, uptime
+    "5I8I32HII"  # loop timing
+    "II4H"  # trace variables, trace samples, trace variable ids
+)
+CRASH_DUMP_MAGIC = 0x504D5544
+CRASH_DUMP_READ_CHUNK = 256
+SUBCMD_EVENT_LOG_GET_SIZE = 0x00
+SUBCMD_EVENT_LOG_READ = 0x01
+
+# Layout of the event log flash, see event_log.h and flash_log.h in the
+# controller.  Keep this in sync with those.
+EVENT_LOG_PAGE_SIZE = 2048
+EVENT_LOG_PAGE_HEADER = struct.Struct("<II")  # magic, sequence
+EVENT_LOG_BREATH_MAGIC = 0x42474F4C
+EVENT_LOG_HISTORY_MAGIC = 0x48474F4C
+EVENT_LOG_RECORDS = {
+    1: ("time", struct.Struct("<B3xI"), ["uptime_ms"]),
+    2: (
+        "breath",
+        struct.Struct("<BBBBHH"),
+        ["trigger", "pip", "peep", "volume_ml", "duration_ms"],
+    ),
+    3: (
+        "minute",
+        struct.Struct("<BBBBHH"),
+        ["breaths", "pip", "peep", "volume_ml", "uptime_min"],
+    ),
+    4: ("event", struct.Struct("<BBHI"), ["event", "arg", "uptime_ms"]),
+}
+EVENT_LOG_EVENTS = {1: "reset", 2: "mode change"}
+
+CRASH_REASONS = {
+    3: "hard fault",
+    4: "memory management fault",
+    5: "bus fault",
+    6: "usage fault",
+    0x100: "watchdog",
+}
+
 # Can trace this many variables at once.  Keep this in sync with
 # kMaxTraceVars in the controller.
 TRACE_VAR_CT = 4
@@ -593,6 +644,147 @@ class ControllerDebugInterface:
             [SUBCMD_EEPROM_WRITE] + debug_types.int16s_to_bytes(int(address, 0)) + data,
         )
 
+    def crash_dump_download(self):
+        """Returns the crash dump saved by the controller as bytes, empty if there is none."""
+        size = debug_types.bytes_to_int32s(
+            self.send_command(OP_CRASH_DUMP, [SUBCMD_CRASH_DUMP_GET_SIZE])
+        )[0]
+        data = []
+        while len(data) < size:
+            length = min(size - len(data), CRASH_DUMP_READ_CHUNK)
+            data += self.send_command(
+                OP_CRASH_DUMP,
+                [SUBCMD_CRASH_DUMP_READ]
+                + debug_types.int32s_to_bytes(len(data))
+                + debug_types.int16s_to_bytes(length),
+            )
+        return bytes(data)
+
+    def crash_dump_erase(self):
+        self.send_command(OP_CRASH_DUMP, [SUBCMD_CRASH_DUMP_ERASE])
+
+    def crash_dump_decode(self, data):
+        """Decodes a crash dump, as returned by crash_dump_download, into a dict.
+        Trace samples are converted using the variable metadata, so call
+        variables_update_info first."""
+        if len(data) < CRASH_DUMP_HEADER.size:
+            raise Error("Crash dump is too short")
+        fields = list(CRASH_DUMP_HEADER.unpack_from(data))
+        magic, size, reason = fields[0:3]
+        if magic != CRASH_DUMP_MAGIC or size != len(data):
+            raise Error("Invalid crash dump")
+        registers = fields[3:11]
+        stack_pointer, cfsr, hfsr, mmfar, bfar, uptime_ms = fields[11:17]
+        timing = fields[17:64]
+        trace_variables, trace_samples = fields[64:66]
+        trace_ids = fields[66 : 66 + trace_variables]
+
+        words = debug_types.bytes_to_int32s(
+            list(data[CRASH_DUMP_HEADER.size :]), signed=False
+        )
+        variables = [self.variable_by_id(vid) for vid in trace_ids]
+        trace = [[] for _ in variables]
+        for sample in range(trace_samples):
+            for i, var in enumerate(variables):
+                value = words[sample * trace_variables + i]
+                trace[i].append(var.convert_int(value) if var else value)
+
+        return {
+            "reason": CRASH_REASONS.get(reason, "exception %d" % reason),
+            "registers": dict(
+                zip(["r0", "r1", "r2", "r3", "r12", "lr", "pc", "xpsr"], registers)
+            ),
+            "sp": stack_pointer,
+            "cfsr": cfsr,
+            "hfsr": hfsr,
+            "mmfar": mmfar,
+            "bfar": bfar,
+            "uptime_ms": uptime_ms,
+            "loop_invocations": timing[1],
+            "loop_overruns": timing[2],
+            "loop_max_jitter_us": timing[3],
+            "loop_max_time_us": timing[4],
+            "loop_jitter_histogram": timing[5:13],
+            "loop_recent": list(zip(timing[13:45:2], timing[14:45:2])),
+            "trace": {
+                (var.name if var else "var%d" % vid): values
+                for vid, var, values in zip(trace_ids, variables, trace)
+            },
+        }
+
+    def event_log_download(self):
+        """Returns the event log flash of the controller, as bytes."""
+        size = debug_types.bytes_to_int32s(
+            self.send_command(OP_EVENT_LOG, [SUBCMD_EVENT_LOG_GET_SIZE])
+        )[0]
+        data = []
+        while len(data) < size:
+            length = min(size - len(data), CRASH_DUMP_READ_CHUNK)
+            data += self.send_command(
+                OP_EVENT_LOG,
+                [SUBCMD_EVENT_LOG_READ]
+                + debug_types.int32s_to_bytes(len(data))
+                + debug_types.int16s_to_bytes(length),
+            )
+        return bytes(data)
+
+    @staticmethod
+    def event_log_decode(data):
+        """Decodes the event log flash, as returned by event_log_download.
+        Returns the records of the breath log and of the history log, oldest
+        first, as dicts with a "type" key and the fields of that type."""
+        pages = {EVENT_LOG_BREATH_MAGIC: [], EVENT_LOG_HISTORY_MAGIC: []}
+        for offset in range(0, len(data), EVENT_LOG_PAGE_SIZE):
+            magic, sequence = EVENT_LOG_PAGE_HEADER.unpack_from(data, offset)
+            if magic in pages:
+                pages[magic].append((sequence, offset))
+
+        def records(magic):
+            ret = []
+            # Page sequence numbers only wrap around after years of use.
+            for _, offset in sorted(pages[magic]):
+                start = offset + EVENT_LOG_PAGE_HEADER.size
+                for pos in range(start, offset + EVENT_LOG_PAGE_SIZE, 8):
+                    record = data[pos : pos + 8]
+                    if record == b"\xff" * 8:
+                        break
+                    if record[0] not in EVENT_LOG_RECORDS:
+                        continue
+                    name, layout, fields = EVENT_LOG_RECORDS[record[0]]
+                    values = dict(zip(fields, layout.unpack(record)[1:]))
+                    values["type"] = name
+                    ret.append(values)
+            return ret
+
+        breaths = records(EVENT_LOG_BREATH_MAGIC)
+        history = records(EVENT_LOG_HISTORY_MAGIC)
+
+        # Convert units, and time breaths: a time record gives the end of the
+        # breath after it, each following breath ends its duration later.
+        for r in breaths + history:
+            if "pip" in r:
+                r["pip"] /= 2
+                r["peep"] /= 2
+            if r["type"] == "event":
+                r["event"] = EVENT_LOG_EVENTS.get(r["event"], r["event"])
+        time_record = None
+        last_end = None
+        for r in breaths:
+            if r["type"] == "time":
+                time_record = r["uptime_ms"]
+                continue
+            r["duration_ms"] *= 10
+            if time_record is not None:
+                r["uptime_ms"] = time_record
+            elif last_end is not None:
+                r["uptime_ms"] = last_end + r["duration_ms"]
+            else:
+                # The time record before it was lost with the oldest page.
+                r["uptime_ms"] = None
+            time_record = None
+            last_end = r["uptime_ms"]
+        return [r for r in breaths if r["type"] == "breath"], history
+
     # Wait for a response from the controller to the last command
     # The binary format uses two special characters to frame a
     # command or response.  This function removes those characters
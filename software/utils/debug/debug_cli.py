@@ -767,6 +767,101 @@ eeprom write <address> <data>
             print("Error: Unknown subcommand %s" % cl[0])
             return
 
+    def do_crash(self, line):
+        """The `crash` command reads the post-mortem dump the controller saves to
+flash when it faults or when the watchdog is about to reset it.
+
+crash show
+  Prints the saved dump: cause, registers, loop timing and the newest trace
+  samples.
+
+crash save <file>
+  Saves the trace samples of the dump to a text file, as `trace save` does.
+
+crash erase
+  Erases the saved dump.
+"""
+        cl = shlex.split(line)
+        if len(cl) < 1:
+            print("Error, please specify the operation to perform.")
+            return
+        if cl[0] == "erase":
+            self.interface.crash_dump_erase()
+            return
+        if cl[0] not in ["show", "save"]:
+            print("Error: Unknown subcommand %s" % cl[0])
+            return
+
+        data = self.interface.crash_dump_download()
+        if not data:
+            print("No crash dump saved.")
+            return
+        self.interface.variables_update_info()
+        dump = self.interface.crash_dump_decode(data)
+
+        if cl[0] == "save":
+            if len(cl) < 2:
+                print("Error, please provide a file name.")
+                return
+            with open(cl[1], "w") as fp:
+                names = list(dump["trace"].keys())
+                fp.write(" ".join(names) + "\n")
+                for row in zip(*dump["trace"].values()):
+                    fp.write(" ".join(str(x) for x in row) + "\n")
+            return
+
+        print("Crash: %s after %d ms" % (dump["reason"], dump["uptime_ms"]))
+        for name, value in dump["registers"].items():
+            print("  %-4s 0x%08x" % (name, value))
+        print("  sp   0x%08x" % dump["sp"])
+        for name in ["cfsr", "hfsr", "mmfar", "bfar"]:
+            print("  %-5s 0x%08x" % (name, dump[name]))
+        print(
+            "Loop: %d invocations, %d overruns, max jitter %d us, max run time %d us"
+            % (
+                dump["loop_invocations"],
+                dump["loop_overruns"],
+                dump["loop_max_jitter_us"],
+                dump["loop_max_time_us"],
+            )
+        )
+        print("  jitter histogram: %s" % dump["loop_jitter_histogram"])
+        print("  recent (jitter us, run time us): %s" % dump["loop_recent"])
+        for name, values in dump["trace"].items():
+            print("%s: %s" % (name, values))
+
+
+    def do_log(self, line):
+        """The `log` command reads the event log the controller keeps in flash.
+
+log breaths [file]
+  Prints the breath log, a record per breath over the last day or so, or
+  saves it to a text file.
+
+log history [file]
+  Prints the history log, a summary per minute of ventilation and events such
+  as resets and mode changes, over the last week or so, or saves it to a text
+  file.
+"""
+        cl = shlex.split(line)
+        if len(cl) < 1 or cl[0] not in ["breaths", "history"]:
+            print("Error, please specify breaths or history.")
+            return
+        breaths, history = self.interface.event_log_decode(
+            self.interface.event_log_download()
+        )
+        records = breaths if cl[0] == "breaths" else history
+
+        lines = []
+        for r in records:
+            fields = " ".join("%s=%s" % (k, v) for k, v in r.items() if k != "type")
+            lines.append("%-6s %s" % (r["type"], fields))
+        if len(cl) < 2:
+            print("\n".join(lines))
+            return
+        with open(cl[1], "w") as fp:
+            fp.write("\n".join(lines) + "\n")
+
 
 def auto_select_port():
     ports = detect_stm32_ports()
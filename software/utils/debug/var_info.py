@@ -25,7 +25,7 @@ from lib.error import Error
 
 # TODO: Import constants from proto instead!
 
-VAR_INVALID_ID = 100
+VAR_INVALID_ID = 128
 
 # Variable types (see vars.h)
 VAR_INT32 = 1